@@ -3,6 +3,23 @@
 #include "core.h"
 #include "cc.h"
 
+void ZCC::setBW(int64_t bw)
+{
+	this->setUserParam((char*)&(bw), sizeof(bw));
+}
+
+double ZCC::minSndPeriod() const
+{
+	if ((NULL == m_pcParam) || (m_iPSize != 8))
+		return 0;
+	
+	int64_t maxSR = *(int64_t*)m_pcParam;
+	if (maxSR <= 0)
+		return 0;
+	
+	return 1000000.0 / (double(maxSR) / m_iMSS);
+}
+
 ZUDTCC::ZUDTCC():
 m_iRCInterval(),
 m_LastRCTime(),
@@ -38,6 +55,19 @@ void ZUDTCC::init()
 	m_dCWndSize = 16;
 	m_dCWndModifier = 16;
 	m_dPktSndPeriod = 1;
+	
+	// warm start from the last connection to this peer, onACK rebuilds the window from the
+	// receive rate, which the cache seeded as well
+	if (m_dCachedSndPeriod > 0)
+	{
+		m_dPktSndPeriod = m_dCachedSndPeriod;
+		m_dLastDecPeriod = m_dCachedSndPeriod;
+		double minSP = minSndPeriod();
+		if (m_dPktSndPeriod < minSP)
+			m_dPktSndPeriod = minSP;
+	}
+	if (m_dCachedCWndSize > m_dCWndSize)
+		m_dCWndSize = m_dCachedCWndSize;
 }
 
 void ZUDTCC::onACK(const int32_t& ack)
@@ -66,8 +96,7 @@ void ZUDTCC::onACK(const int32_t& ack)
 	{
 		m_dCWndSize = m_iRcvRate / 1000000.0 * (m_iRTT + m_iRCInterval) + m_dCWndModifier;
 		m_dCWndModifier++;
-//		fprintf(stdout, "Increasing window modifier: %f\n", m_dCWndModifier);
-		//fprintf(stdout, "m_dCWndSize: %f  m_iRcvRate: %d  m_iRTT: %d  m_iRCInterval: %d\n", m_dCWndSize, m_iRcvRate, m_iRTT, m_iRCInterval);
+		trace(ZUDTCC_TRACE_MODIFIER, m_dCWndModifier);
 	}
 	
 	// During Slow Start, no rate increase
@@ -83,7 +112,7 @@ void ZUDTCC::onACK(const int32_t& ack)
 	int64_t B = (int64_t)(m_iBandwidth - 1000000.0 / m_dPktSndPeriod);
 	if ((m_dPktSndPeriod > m_dLastDecPeriod) && ((m_iBandwidth / 9) < B))
 		B = m_iBandwidth / 9;
-	//fprintf(stdout, "B: %lld  m_iBandwidth: %d\n", B, m_iBandwidth);
+	trace(ZUDTCC_TRACE_SPARE, (double)B);
 	
 	double inc;
 	
@@ -101,20 +130,13 @@ void ZUDTCC::onACK(const int32_t& ack)
 	}
 	
 	m_dPktSndPeriod = (m_dPktSndPeriod * m_iRCInterval) / (m_dPktSndPeriod * inc + m_iRCInterval);
-	//fprintf(stdout, "m_dPktSndPeriod: %f  inc: %f\n", m_dPktSndPeriod, inc);
+	trace(ZUDTCC_TRACE_INCREASE, inc);
 	
 	//set maximum transfer rate
-	if ((NULL != m_pcParam) && (m_iPSize == 8))
+	double minSP = minSndPeriod();
+	if (m_dPktSndPeriod < minSP)
 	{
-		int64_t maxSR = *(int64_t*)m_pcParam;
-		if (maxSR <= 0)
-			return;
-		
-		double minSP = 1000000.0 / (double(maxSR) / m_iMSS);
-		if (m_dPktSndPeriod < minSP)
-		{
-			m_dPktSndPeriod = minSP;
-		}
+		m_dPktSndPeriod = minSP;
 	}
 }
 
@@ -123,8 +145,8 @@ void ZUDTCC::onLoss(const int32_t* losslist, const int&)
 	if (m_dCWndModifier > 16)
 	{
 		m_dCWndModifier--;
+		trace(ZUDTCC_TRACE_MODIFIER, m_dCWndModifier);
 	}
-//	fprintf(stdout, "Decreasing window modifier: %f\n", m_dCWndModifier);
 	//Slow Start stopped, if it hasn't yet
 	if (m_bSlowStart)
 	{
@@ -181,7 +203,547 @@ void ZUDTCC::onTimeout()
 	}
 }
 
-void ZUDTCC::setBW(int64_t bw)
+// pacing gains of the ProbeBW phases, one phase lasts about one min RTT
+static const double ZBBRCC_CYCLE[ZBBRCC_CYCLE_LENGTH] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+ZBBRCC::ZBBRCC():
+m_pSamples(NULL),
+m_iSampleMask(),
+m_llDelivered(),
+m_ullDeliveredTime(),
+m_iLastAck(),
+m_llRoundCount(),
+m_iRoundEndSeq(),
+m_bRoundStart(),
+m_iRoundLost(),
+m_iRoundDelivered(),
+m_dBtlBw(),
+m_iMinRTT(),
+m_ullMinRTTStamp(),
+m_iMode(),
+m_dPacingGain(),
+m_dCWndGain(),
+m_iCycleIndex(),
+m_ullCycleStamp(),
+m_dFullBw(),
+m_iFullBwCount(),
+m_bFullBw(),
+m_ullProbeRTTDone(),
+m_llProbeRTTRound(),
+m_dPriorCWnd()
 {
-	this->setUserParam((char*)&(bw), sizeof(bw));
+	memset(m_adBwFilter, 0, sizeof(m_adBwFilter));
+}
+
+ZBBRCC::~ZBBRCC()
+{
+	delete [] m_pSamples;
+}
+
+void ZBBRCC::init()
+{
+	uint64_t currtime = CTimer::getTime();
+	setACKTimer(m_iSYNInterval);
+	
+	// one slot per packet the flow window allows in flight, so the newest acknowledged packet
+	// still has its send state when the ACK arrives
+	int slots = 1024;
+	while ((slots < m_dMaxCWndSize) && (slots < (1 << 20)))
+		slots <<= 1;
+	delete [] m_pSamples;
+	m_pSamples = new ZBBRCCSample[slots];
+	memset(m_pSamples, 0, sizeof(ZBBRCCSample) * slots);
+	for (int i = 0; i < slots; ++ i)
+		m_pSamples[i].seqno = -1;
+	m_iSampleMask = slots - 1;
+	
+	m_llDelivered = 0;
+	m_ullDeliveredTime = currtime;
+	m_iLastAck = CSeqNo::incseq(m_iSndCurrSeqNo);
+	
+	m_llRoundCount = 0;
+	m_iRoundEndSeq = m_iSndCurrSeqNo;
+	m_bRoundStart = false;
+	m_iRoundLost = 0;
+	m_iRoundDelivered = 0;
+	
+	memset(m_adBwFilter, 0, sizeof(m_adBwFilter));
+	m_dBtlBw = 0;
+	m_iMinRTT = m_iRTT;
+	m_ullMinRTTStamp = currtime;
+	
+	m_dFullBw = 0;
+	m_iFullBwCount = 0;
+	m_bFullBw = false;
+	m_ullProbeRTTDone = 0;
+	m_llProbeRTTRound = 0;
+	
+	m_dCWndSize = 16;
+	
+	// a cached path seeds the model; Startup still runs, but from the known rate it finds the
+	// bandwidth plateau within a few rounds
+	if (m_dCachedSndPeriod > 0)
+	{
+		m_adBwFilter[0] = 1000000.0 / m_dCachedSndPeriod;
+		m_dBtlBw = m_adBwFilter[0];
+		m_dFullBw = m_dBtlBw;
+	}
+	if (m_dCachedCWndSize > m_dCWndSize)
+		m_dCWndSize = m_dCachedCWndSize;
+	
+	m_dPriorCWnd = m_dCWndSize;
+	enterMode(ZBBRCC_MODE_STARTUP, currtime);
+	updateControl(0);
+	
+	// the RTT is the cached one when the path is known, otherwise the UDT default
+	updateRTO();
+}
+
+void ZBBRCC::onPktSent(const CPacket* packet)
+{
+	// retransmissions carry no rate information, only new packets are sampled
+	if (packet->m_iSeqNo != m_iSndCurrSeqNo)
+		return;
+	
+	ZBBRCCSample& sample = m_pSamples[packet->m_iSeqNo & m_iSampleMask];
+	sample.delivered = m_llDelivered;
+	sample.delivered_time = m_ullDeliveredTime;
+	sample.seqno = packet->m_iSeqNo;
+}
+
+void ZBBRCC::onACK(const int32_t& ack)
+{
+	int newly = CSeqNo::seqoff(m_iLastAck, ack);
+	if (newly <= 0)
+		return;
+	
+	uint64_t currtime = CTimer::getTime();
+	m_iLastAck = ack;
+	m_llDelivered += newly;
+	m_ullDeliveredTime = currtime;
+	m_iRoundDelivered += newly;
+	
+	updateRound(ack);
+	
+	// delivery rate since the newest acknowledged packet was sent
+	int32_t seqno = CSeqNo::decseq(ack);
+	const ZBBRCCSample& sample = m_pSamples[seqno & m_iSampleMask];
+	if ((sample.seqno == seqno) && (currtime > sample.delivered_time) && (m_llDelivered > sample.delivered))
+		updateBtlBw((m_llDelivered - sample.delivered) * 1000000.0 / (currtime - sample.delivered_time));
+	
+	updateMode(ack, currtime);
+	updateControl(newly);
+	
+	if (m_bRoundStart)
+	{
+		m_iRoundLost = 0;
+		m_iRoundDelivered = 0;
+	}
+	
+	updateRTO();
+}
+
+void ZBBRCC::onLoss(const int32_t* losslist, const int& size)
+{
+	// loss only counts against Startup, the model bounds the queue instead of backing off
+	for (int i = 0; i < size; ++ i)
+	{
+		if (0 != (losslist[i] & 0x80000000))
+		{
+			if (i + 1 < size)
+				m_iRoundLost += CSeqNo::seqlen(losslist[i] & 0x7FFFFFFF, losslist[i + 1]);
+			++ i;
+		}
+		else
+			++ m_iRoundLost;
+	}
+}
+
+void ZBBRCC::onTimeout()
+{
+	// everything in flight is being resent, restart from a minimal window and let ACKs grow it back
+	m_dCWndSize = ZBBRCC_MIN_CWND;
+}
+
+void ZBBRCC::enterMode(int mode, uint64_t currtime)
+{
+	m_iMode = mode;
+	
+	switch (mode)
+	{
+	case ZBBRCC_MODE_STARTUP:
+		m_dPacingGain = ZBBRCC_STARTUP_GAIN;
+		m_dCWndGain = ZBBRCC_STARTUP_GAIN;
+		break;
+		
+	case ZBBRCC_MODE_DRAIN:
+		m_dPacingGain = 1.0 / ZBBRCC_STARTUP_GAIN;
+		m_dCWndGain = ZBBRCC_STARTUP_GAIN;
+		break;
+		
+	case ZBBRCC_MODE_PROBE_BW:
+		// start at a random phase other than the draining one to desynchronize competing flows
+		srand((unsigned int)currtime);
+		m_iCycleIndex = rand() % (ZBBRCC_CYCLE_LENGTH - 1);
+		if (m_iCycleIndex >= 1)
+			++ m_iCycleIndex;
+		m_ullCycleStamp = currtime;
+		m_dPacingGain = ZBBRCC_CYCLE[m_iCycleIndex];
+		m_dCWndGain = 2;
+		break;
+		
+	case ZBBRCC_MODE_PROBE_RTT:
+		m_dPriorCWnd = m_dCWndSize;
+		m_ullProbeRTTDone = 0;
+		m_dPacingGain = 1;
+		m_dCWndGain = 1;
+		break;
+	}
+	
+	trace(ZBBRCC_TRACE_MODE, mode);
+}
+
+void ZBBRCC::updateRound(const int32_t& ack)
+{
+	m_bRoundStart = false;
+	if (CSeqNo::seqcmp(ack, m_iRoundEndSeq) <= 0)
+		return;
+	
+	++ m_llRoundCount;
+	m_iRoundEndSeq = m_iSndCurrSeqNo;
+	m_bRoundStart = true;
+	
+	// the oldest round leaves the max filter
+	m_adBwFilter[m_llRoundCount % ZBBRCC_BW_ROUNDS] = 0;
+	updateBtlBw(0);
+}
+
+void ZBBRCC::updateBtlBw(double rate)
+{
+	double& slot = m_adBwFilter[m_llRoundCount % ZBBRCC_BW_ROUNDS];
+	if (rate > slot)
+		slot = rate;
+	
+	double btlbw = 0;
+	for (int i = 0; i < ZBBRCC_BW_ROUNDS; ++ i)
+	{
+		if (m_adBwFilter[i] > btlbw)
+			btlbw = m_adBwFilter[i];
+	}
+	
+	if (btlbw != m_dBtlBw)
+	{
+		m_dBtlBw = btlbw;
+		trace(ZBBRCC_TRACE_BTLBW, m_dBtlBw);
+	}
+}
+
+void ZBBRCC::updateMinRTT(uint64_t currtime)
+{
+	bool expired = (currtime - m_ullMinRTTStamp > ZBBRCC_MIN_RTT_WINDOW);
+	if ((m_iRTT > 0) && ((m_iRTT <= m_iMinRTT) || expired))
+	{
+		if (m_iRTT != m_iMinRTT)
+			trace(ZBBRCC_TRACE_MIN_RTT, m_iRTT);
+		m_iMinRTT = m_iRTT;
+		m_ullMinRTTStamp = currtime;
+	}
+	
+	// no lower RTT seen for a whole window, drain the queue to measure it again
+	if (expired && (ZBBRCC_MODE_PROBE_RTT != m_iMode))
+		enterMode(ZBBRCC_MODE_PROBE_RTT, currtime);
+}
+
+void ZBBRCC::updateMode(const int32_t& ack, uint64_t currtime)
+{
+	int inflight = CSeqNo::seqlen(ack, m_iSndCurrSeqNo);
+	
+	switch (m_iMode)
+	{
+	case ZBBRCC_MODE_STARTUP:
+		if (m_bRoundStart)
+		{
+			// the pipe is full once the bandwidth stops growing by a quarter per round, or the
+			// buffer is shallow enough to drop packets before it does
+			if (m_dBtlBw >= m_dFullBw * 1.25)
+			{
+				m_dFullBw = m_dBtlBw;
+				m_iFullBwCount = 0;
+			}
+			else if (++ m_iFullBwCount >= 3)
+				m_bFullBw = true;
+			
+			if (m_iRoundLost > ZBBRCC_STARTUP_LOSS * (m_iRoundDelivered + m_iRoundLost))
+				m_bFullBw = true;
+		}
+		if (m_bFullBw)
+			enterMode(ZBBRCC_MODE_DRAIN, currtime);
+		break;
+		
+	case ZBBRCC_MODE_DRAIN:
+		if (inflight <= bdp(1))
+			enterMode(ZBBRCC_MODE_PROBE_BW, currtime);
+		break;
+		
+	case ZBBRCC_MODE_PROBE_BW:
+		{
+			bool advance = (currtime - m_ullCycleStamp > (uint64_t)m_iMinRTT);
+			if (m_dPacingGain > 1)
+				advance = advance && ((m_iRoundLost > 0) || (inflight >= bdp(m_dPacingGain)));
+			else if (m_dPacingGain < 1)
+				advance = advance || (inflight <= bdp(1));
+			
+			if (advance)
+			{
+				m_iCycleIndex = (m_iCycleIndex + 1) % ZBBRCC_CYCLE_LENGTH;
+				m_ullCycleStamp = currtime;
+				m_dPacingGain = ZBBRCC_CYCLE[m_iCycleIndex];
+			}
+		}
+		break;
+		
+	case ZBBRCC_MODE_PROBE_RTT:
+		if (0 == m_ullProbeRTTDone)
+		{
+			if (inflight <= ZBBRCC_MIN_CWND)
+			{
+				m_ullProbeRTTDone = currtime + ZBBRCC_PROBE_RTT_TIME;
+				m_llProbeRTTRound = m_llRoundCount;
+			}
+		}
+		else if ((currtime > m_ullProbeRTTDone) && (m_llRoundCount > m_llProbeRTTRound))
+		{
+			m_ullMinRTTStamp = currtime;
+			if (m_dCWndSize < m_dPriorCWnd)
+				m_dCWndSize = m_dPriorCWnd;
+			enterMode(m_bFullBw ? ZBBRCC_MODE_PROBE_BW : ZBBRCC_MODE_STARTUP, currtime);
+		}
+		break;
+	}
+	
+	updateMinRTT(currtime);
+}
+
+void ZBBRCC::updateControl(int newly)
+{
+	if (m_dBtlBw > 0)
+		m_dPktSndPeriod = 1000000.0 / (m_dPacingGain * m_dBtlBw);
+	else
+		m_dPktSndPeriod = m_iRTT / (m_dPacingGain * m_dCWndSize);
+	
+	//set maximum transfer rate
+	double minSP = minSndPeriod();
+	if (m_dPktSndPeriod < minSP)
+		m_dPktSndPeriod = minSP;
+	
+	if (ZBBRCC_MODE_PROBE_RTT == m_iMode)
+	{
+		m_dCWndSize = ZBBRCC_MIN_CWND;
+		return;
+	}
+	
+	// grow like slow start until the pipe is full, then hold at the target
+	double target = bdp(m_dCWndGain);
+	if (m_bFullBw)
+	{
+		if (m_dCWndSize + newly < target)
+			m_dCWndSize += newly;
+		else
+			m_dCWndSize = target;
+	}
+	else if (m_dCWndSize < target || m_dBtlBw <= 0)
+		m_dCWndSize += newly;
+	
+	if (m_dCWndSize < ZBBRCC_MIN_CWND)
+		m_dCWndSize = ZBBRCC_MIN_CWND;
+}
+
+void ZBBRCC::updateRTO()
+{
+	// the default RTO adds 4 RTT variances, which the ProbeBW gain cycle inflates on purpose
+	int rto = m_iRTT * 4 + m_iSYNInterval;
+	if (rto < 100000)
+		rto = 100000;
+	setRTO(rto);
+}
+
+double ZBBRCC::bdp(double gain) const
+{
+	// ACKs are timer based, the window must also cover the data sent between two of them
+	return gain * m_dBtlBw * (m_iMinRTT + m_iSYNInterval) / 1000000.0 + ZBBRCC_MIN_CWND;
+}
+
+ZLEDBATCC::ZLEDBATCC():
+m_iLastAck(),
+m_iLastDecSeq(),
+m_bUseOWD(),
+m_iBaseIndex(),
+m_iBaseCount(),
+m_ullBaseStamp(),
+m_iCurrentIndex(),
+m_iCurrentCount(),
+m_iQueueDelay()
+{
+}
+
+void ZLEDBATCC::init()
+{
+	setACKTimer(m_iSYNInterval);
+	
+	m_iLastAck = CSeqNo::incseq(m_iSndCurrSeqNo);
+	m_iLastDecSeq = m_iSndCurrSeqNo;
+	m_bUseOWD = false;
+	resetDelay();
+	
+	m_dCWndSize = 16;
+	
+	// start from the window the last connection to this peer ended with, the delay signal
+	// still cuts it back if the path is busy now
+	if (m_dCachedCWndSize > m_dCWndSize)
+		m_dCWndSize = m_dCachedCWndSize;
+	updatePeriod();
+}
+
+void ZLEDBATCC::onACK(const int32_t& ack)
+{
+	int newly = CSeqNo::seqoff(m_iLastAck, ack);
+	if (newly <= 0)
+		return;
+	m_iLastAck = ack;
+	
+	// receivers that do not report one-way delay leave the RTT as the delay signal, the base
+	// delay cancels the reverse path just as it cancels the clock offset
+	if (m_bOWD && !m_bUseOWD)
+	{
+		m_bUseOWD = true;
+		resetDelay();
+	}
+	updateDelay(m_bUseOWD ? m_iOWD : m_iRTT, CTimer::getTime());
+	trace(ZLEDBATCC_TRACE_QUEUE_DELAY, m_iQueueDelay);
+	
+	double off_target = double(ZLEDBATCC_TARGET - m_iQueueDelay) / ZLEDBATCC_TARGET;
+	if (off_target >= ZLEDBATCC_RAMP)
+	{
+		// (almost) no queue, the link is idle: grow by up to the acknowledged packets, like slow start
+		m_dCWndSize += off_target * newly;
+	}
+	else if (off_target >= 0)
+	{
+		m_dCWndSize += ZLEDBATCC_GAIN * off_target * newly / m_dCWndSize;
+	}
+	else
+	{
+		// give way in proportion to the window, so a large window empties the queue as fast as a small one
+		double decrease = ZLEDBATCC_DECREASE * off_target * newly;
+		if (decrease < -m_dCWndSize / 2)
+			decrease = -m_dCWndSize / 2;
+		m_dCWndSize += decrease;
+	}
+	
+	updatePeriod();
+}
+
+void ZLEDBATCC::onLoss(const int32_t* losslist, const int&)
+{
+	// halve once per window of data, like TCP, in case the queue overflowed before the delay rose
+	if (CSeqNo::seqcmp(losslist[0] & 0x7FFFFFFF, m_iLastDecSeq) > 0)
+		decrease();
+}
+
+void ZLEDBATCC::onTimeout()
+{
+	// UDT times out early while its RTT estimate is still the 100ms default,
+	// so a timeout counts as one more loss event instead of collapsing the window
+	if (CSeqNo::seqcmp(m_iLastAck, m_iLastDecSeq) > 0)
+		decrease();
+}
+
+void ZLEDBATCC::decrease()
+{
+	m_dCWndSize /= 2;
+	m_iLastDecSeq = m_iSndCurrSeqNo;
+	updatePeriod();
+	trace(ZLEDBATCC_TRACE_LOSS, m_dCWndSize);
+}
+
+void ZLEDBATCC::resetDelay()
+{
+	m_iBaseIndex = 0;
+	m_iBaseCount = 0;
+	m_ullBaseStamp = 0;
+	m_iCurrentIndex = 0;
+	m_iCurrentCount = 0;
+	m_iQueueDelay = 0;
+}
+
+void ZLEDBATCC::updateDelay(int32_t delay, uint64_t currtime)
+{
+	// delays carry an unknown clock offset and wrap, so they are only compared by difference
+	if (0 == m_iBaseCount)
+	{
+		m_aiBaseDelay[0] = delay;
+		m_iBaseIndex = 0;
+		m_iBaseCount = 1;
+		m_ullBaseStamp = currtime;
+	}
+	else if (currtime - m_ullBaseStamp > ZLEDBATCC_BASE_PERIOD)
+	{
+		// the oldest period ages out, which also follows clock drift between the hosts
+		m_iBaseIndex = (m_iBaseIndex + 1) % ZLEDBATCC_BASE_HISTORY;
+		m_aiBaseDelay[m_iBaseIndex] = delay;
+		if (m_iBaseCount < ZLEDBATCC_BASE_HISTORY)
+			++ m_iBaseCount;
+		m_ullBaseStamp = currtime;
+	}
+	else if (int32_t(delay - m_aiBaseDelay[m_iBaseIndex]) < 0)
+		m_aiBaseDelay[m_iBaseIndex] = delay;
+	
+	m_aiCurrentDelay[m_iCurrentIndex] = delay;
+	m_iCurrentIndex = (m_iCurrentIndex + 1) % ZLEDBATCC_CURRENT_FILTER;
+	if (m_iCurrentCount < ZLEDBATCC_CURRENT_FILTER)
+		++ m_iCurrentCount;
+	
+	int32_t base = m_aiBaseDelay[0];
+	for (int i = 1; i < m_iBaseCount; ++ i)
+	{
+		if (int32_t(m_aiBaseDelay[i] - base) < 0)
+			base = m_aiBaseDelay[i];
+	}
+	
+	int32_t current = m_aiCurrentDelay[0];
+	for (int i = 1; i < m_iCurrentCount; ++ i)
+	{
+		if (int32_t(m_aiCurrentDelay[i] - current) < 0)
+			current = m_aiCurrentDelay[i];
+	}
+	
+	m_iQueueDelay = int32_t(current - base);
+}
+
+void ZLEDBATCC::updatePeriod()
+{
+	if (m_dCWndSize > m_dMaxCWndSize)
+		m_dCWndSize = m_dMaxCWndSize;
+	if (m_dCWndSize < ZLEDBATCC_MIN_CWND)
+		m_dCWndSize = ZLEDBATCC_MIN_CWND;
+	
+	// pace at twice the window rate, the window is the limit and pacing only breaks up bursts
+	m_dPktSndPeriod = (m_iRTT + m_iSYNInterval) / (2 * m_dCWndSize);
+	
+	//set maximum transfer rate
+	double minSP = minSndPeriod();
+	if (m_dPktSndPeriod < minSP)
+		m_dPktSndPeriod = minSP;
+}
+
+CCCVirtualFactory* createCCFactory(const char* name)
+{
+	if (strcmp(name, "udt") == 0)
+		return new CCCFactory<ZUDTCC>;
+	else if (strcmp(name, "bbr") == 0)
+		return new CCCFactory<ZBBRCC>;
+	else if (strcmp(name, "ledbat") == 0)
+		return new CCCFactory<ZLEDBATCC>;
+	
+	return NULL;
 }
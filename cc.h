@@ -21,7 +21,26 @@ public:
    }
 };
 
-class ZUDTCC: public CCC
+// event codes ZUDTCC logs to the socket trace with CCC::trace()
+enum ZUDTCCTrace
+{
+	ZUDTCC_TRACE_MODIFIER = 1,	// window modifier changed, value is m_dCWndModifier
+	ZUDTCC_TRACE_SPARE,			// spare bandwidth estimate before a rate increase, value is B
+	ZUDTCC_TRACE_INCREASE		// rate increase step, value is inc
+};
+
+// common base of the NetworkHelper controllers, holds the per-socket bandwidth cap
+// set through UDT_MAXBW or setBW() so the application can retune any of them
+class ZCC: public CCC
+{
+public:
+	void setBW(int64_t bw);
+	
+protected:
+	double minSndPeriod() const;	// smallest sending period allowed by the cap, 0 if uncapped
+};
+
+class ZUDTCC: public ZCC
 {
 public:
 	ZUDTCC();
@@ -31,7 +50,6 @@ public:
 	virtual void onACK(const int32_t&);
 	virtual void onLoss(const int32_t*, const int&);
 	virtual void onTimeout();
-	void setBW(int64_t bw);
 	
 private:
 	int m_iRCInterval;			// UDT Rate control interval
@@ -49,4 +67,152 @@ private:
 	double m_dCWndModifier;		// Modifier for window size to increase aggressiveness
 };
 
+#define ZBBRCC_STARTUP_GAIN 2.885		// 2/ln(2), doubles the sending rate every round trip
+#define ZBBRCC_CYCLE_LENGTH 8			// number of phases in the ProbeBW pacing gain cycle
+#define ZBBRCC_BW_ROUNDS 10			// round trips covered by the bottleneck bandwidth max filter
+#define ZBBRCC_MIN_RTT_WINDOW 10000000	// lifetime of a min RTT estimate, microseconds
+#define ZBBRCC_PROBE_RTT_TIME 200000	// time spent at the minimum window in ProbeRTT, microseconds
+#define ZBBRCC_MIN_CWND 4				// window used in ProbeRTT and after a timeout, packets
+#define ZBBRCC_STARTUP_LOSS 0.02		// loss rate in a round that ends Startup early
+
+// phases of the ZBBRCC state machine
+enum ZBBRCCMode
+{
+	ZBBRCC_MODE_STARTUP = 1,
+	ZBBRCC_MODE_DRAIN,
+	ZBBRCC_MODE_PROBE_BW,
+	ZBBRCC_MODE_PROBE_RTT
+};
+
+// event codes ZBBRCC logs to the socket trace with CCC::trace()
+enum ZBBRCCTrace
+{
+	ZBBRCC_TRACE_MODE = 1,		// state machine changed phase, value is the new ZBBRCCMode
+	ZBBRCC_TRACE_BTLBW,			// bottleneck bandwidth estimate changed, value is packets per second
+	ZBBRCC_TRACE_MIN_RTT		// min RTT estimate changed, value is microseconds
+};
+
+// delivery state at the time a packet was sent, used to take a rate sample when it is acknowledged
+struct ZBBRCCSample
+{
+	int32_t seqno;
+	int64_t delivered;
+	uint64_t delivered_time;
+};
+
+// Model-based controller in the style of BBR: paces at a gain over the bottleneck bandwidth
+// (max delivery rate over the last rounds) and bounds inflight data by a multiple of the
+// bandwidth-delay product measured against the min RTT. Loss is not treated as a congestion signal.
+class ZBBRCC: public ZCC
+{
+public:
+	ZBBRCC();
+	virtual ~ZBBRCC();
+	
+public:
+	virtual void init();
+	virtual void onACK(const int32_t&);
+	virtual void onLoss(const int32_t*, const int&);
+	virtual void onTimeout();
+	virtual void onPktSent(const CPacket*);
+	
+private:
+	void enterMode(int mode, uint64_t currtime);
+	void updateRound(const int32_t& ack);
+	void updateBtlBw(double rate);
+	void updateMinRTT(uint64_t currtime);
+	void updateMode(const int32_t& ack, uint64_t currtime);
+	void updateControl(int newly);
+	void updateRTO();
+	double bdp(double gain) const;
+	
+private:
+	ZBBRCCSample* m_pSamples;	// send time delivery state, indexed by seq no
+	int m_iSampleMask;			// size of m_pSamples - 1
+	int64_t m_llDelivered;		// packets acknowledged so far
+	uint64_t m_ullDeliveredTime;	// time m_llDelivered last changed
+	int32_t m_iLastAck;			// last ACKed seq no
+	
+	int64_t m_llRoundCount;		// round trips counted on delivery
+	int32_t m_iRoundEndSeq;		// a new round starts once this seq no is acknowledged
+	bool m_bRoundStart;			// if the last ACK started a new round
+	int m_iRoundLost;			// packets reported lost in this round
+	int m_iRoundDelivered;		// packets acknowledged in this round
+	
+	double m_adBwFilter[ZBBRCC_BW_ROUNDS];	// max delivery rate seen in each of the last rounds
+	double m_dBtlBw;			// bottleneck bandwidth estimate, packets per second
+	int m_iMinRTT;				// min RTT estimate, microseconds
+	uint64_t m_ullMinRTTStamp;	// time m_iMinRTT was taken
+	
+	int m_iMode;				// current ZBBRCCMode
+	double m_dPacingGain;		// sending rate relative to m_dBtlBw
+	double m_dCWndGain;			// window relative to the bandwidth-delay product
+	int m_iCycleIndex;			// phase in the ProbeBW gain cycle
+	uint64_t m_ullCycleStamp;	// time the current phase started
+	
+	double m_dFullBw;			// bandwidth at the last significant Startup increase
+	int m_iFullBwCount;			// rounds without a significant increase
+	bool m_bFullBw;				// if the pipe has been filled once
+	
+	uint64_t m_ullProbeRTTDone;	// time ProbeRTT may end, 0 until the window has drained
+	int64_t m_llProbeRTTRound;	// round in which ProbeRTT drained
+	double m_dPriorCWnd;		// window saved before ProbeRTT
+};
+
+#define ZLEDBATCC_TARGET 25000			// queuing delay the controller settles at, microseconds
+#define ZLEDBATCC_GAIN 1.0				// window increase per round trip at zero queuing delay, packets
+#define ZLEDBATCC_DECREASE 0.5			// fraction of the window given up per round trip for each target of excess delay
+#define ZLEDBATCC_RAMP 0.75				// off target fraction above which the link is treated as idle and the window grows exponentially
+#define ZLEDBATCC_BASE_HISTORY 10		// one minute minima kept for the base delay
+#define ZLEDBATCC_BASE_PERIOD 60000000	// length of one base delay period, microseconds
+#define ZLEDBATCC_CURRENT_FILTER 4		// samples the current delay is the minimum of
+#define ZLEDBATCC_MIN_CWND 2			// smallest window, packets
+
+// event codes ZLEDBATCC logs to the socket trace with CCC::trace()
+enum ZLEDBATCCTrace
+{
+	ZLEDBATCC_TRACE_QUEUE_DELAY = 1,	// queuing delay estimate on an ACK, value is microseconds
+	ZLEDBATCC_TRACE_LOSS				// window halved on a loss or timeout, value is the new window
+};
+
+// Scavenger controller in the style of LEDBAT: keeps the queuing delay it adds, measured as the
+// one-way delay above its base, under a fixed target. It backs off as soon as other traffic builds a
+// queue and grows back quickly once the queue is gone, so background transfers yield to everything else.
+class ZLEDBATCC: public ZCC
+{
+public:
+	ZLEDBATCC();
+	
+public:
+	virtual void init();
+	virtual void onACK(const int32_t&);
+	virtual void onLoss(const int32_t*, const int&);
+	virtual void onTimeout();
+	
+private:
+	void decrease();
+	void resetDelay();
+	void updateDelay(int32_t delay, uint64_t currtime);
+	void updatePeriod();
+	
+private:
+	int32_t m_iLastAck;			// last ACKed seq no
+	int32_t m_iLastDecSeq;		// max pkt seq no sent out when the window was last halved
+	bool m_bUseOWD;				// if the delay samples come from the receiver's one-way delay rather than the RTT
+	
+	int32_t m_aiBaseDelay[ZLEDBATCC_BASE_HISTORY];		// min delay of each recent period
+	int m_iBaseIndex;			// period currently being filled
+	int m_iBaseCount;			// valid entries in m_aiBaseDelay
+	uint64_t m_ullBaseStamp;	// start of the current period
+	
+	int32_t m_aiCurrentDelay[ZLEDBATCC_CURRENT_FILTER];	// latest delay samples
+	int m_iCurrentIndex;		// next entry to overwrite
+	int m_iCurrentCount;		// valid entries in m_aiCurrentDelay
+	
+	int32_t m_iQueueDelay;		// current delay above the base delay, microseconds
+};
+
+// controller factory for a name given on the command line ("udt", "bbr" or "ledbat"), NULL if unknown
+CCCVirtualFactory* createCCFactory(const char* name);
+
 #endif
@@ -0,0 +1,431 @@
+/*
+ *  metrics_exporter.cpp
+ *  NetworkHelper
+ *
+ *  Minimal HTTP endpoint serving Prometheus text format metrics. Metrics are
+ *  rendered into a snapshot by the collecting thread and published whole, so
+ *  a scrape only copies the latest snapshot and never touches a UDT socket.
+ *
+ */
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#elif defined(WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define snprintf _snprintf
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "metrics_exporter.h"
+
+using namespace std;
+
+// bucket upper bounds, in seconds
+static const double metrics_buckets[METRICS_BUCKET_COUNT] = {0.000001, 0.00001, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1.0};
+
+// per connection families, rendered from the trace of every connection in the snapshot
+struct MetricsFamily
+{
+	const char* name;
+	const char* type;
+	const char* help;
+	double (*value)(const MetricsConnection& connection);
+};
+
+static double packetsSent(const MetricsConnection& c) { return (double)c.trace.pktSentTotal; }
+static double packetsReceived(const MetricsConnection& c) { return (double)c.trace.pktRecvTotal; }
+static double packetsSendLost(const MetricsConnection& c) { return c.trace.pktSndLossTotal; }
+static double packetsReceiveLost(const MetricsConnection& c) { return c.trace.pktRcvLossTotal; }
+static double packetsRetransmitted(const MetricsConnection& c) { return c.trace.pktRetransTotal; }
+static double paritySent(const MetricsConnection& c) { return c.trace.pktSndParityTotal; }
+static double packetsRecovered(const MetricsConnection& c) { return c.trace.pktRcvRecoveredTotal; }
+static double acksSent(const MetricsConnection& c) { return c.trace.pktSentACKTotal; }
+static double acksReceived(const MetricsConnection& c) { return c.trace.pktRecvACKTotal; }
+static double naksSent(const MetricsConnection& c) { return c.trace.pktSentNAKTotal; }
+static double naksReceived(const MetricsConnection& c) { return c.trace.pktRecvNAKTotal; }
+static double diskBytes(const MetricsConnection& c) { return (double)c.disk_bytes; }
+static double rtt(const MetricsConnection& c) { return c.trace.msRTT/1000; }
+static double bandwidth(const MetricsConnection& c) { return c.trace.mbpsBandwidth; }
+static double sendRate(const MetricsConnection& c) { return c.send_mbps; }
+static double sendPeriod(const MetricsConnection& c) { return c.trace.usPktSndPeriod/1000000; }
+static double flowWindow(const MetricsConnection& c) { return c.trace.pktFlowWindow; }
+static double congestionWindow(const MetricsConnection& c) { return c.trace.pktCongestionWindow; }
+static double flight(const MetricsConnection& c) { return c.trace.pktFlightSize; }
+static double sendBufferAvailable(const MetricsConnection& c) { return c.trace.byteAvailSndBuf; }
+static double receiveBufferAvailable(const MetricsConnection& c) { return c.trace.byteAvailRcvBuf; }
+
+static const MetricsFamily metrics_families[] =
+{
+	{"udt_packets_sent_total", "counter", "Data packets sent, including retransmissions.", &packetsSent},
+	{"udt_packets_received_total", "counter", "Packets received.", &packetsReceived},
+	{"udt_packets_send_lost_total", "counter", "Packets reported lost by the peer.", &packetsSendLost},
+	{"udt_packets_receive_lost_total", "counter", "Packets detected lost locally.", &packetsReceiveLost},
+	{"udt_packets_retransmitted_total", "counter", "Packets retransmitted.", &packetsRetransmitted},
+	{"udt_fec_parity_sent_total", "counter", "FEC parity packets sent.", &paritySent},
+	{"udt_fec_recovered_total", "counter", "Lost packets rebuilt from FEC parity instead of retransmitted.", &packetsRecovered},
+	{"udt_acks_sent_total", "counter", "ACK packets sent.", &acksSent},
+	{"udt_acks_received_total", "counter", "ACK packets received.", &acksReceived},
+	{"udt_naks_sent_total", "counter", "NAK packets sent.", &naksSent},
+	{"udt_naks_received_total", "counter", "NAK packets received.", &naksReceived},
+	{"udt_disk_bytes_total", "counter", "Bytes moved between disk and the connection.", &diskBytes},
+	{"udt_rtt_seconds", "gauge", "Smoothed round trip time.", &rtt},
+	{"udt_bandwidth_mbps", "gauge", "Estimated link capacity.", &bandwidth},
+	{"udt_send_rate_mbps", "gauge", "Send rate over the last snapshot interval.", &sendRate},
+	{"udt_send_period_seconds", "gauge", "Current inter-packet send period.", &sendPeriod},
+	{"udt_flow_window_packets", "gauge", "Flow window advertised by the peer.", &flowWindow},
+	{"udt_congestion_window_packets", "gauge", "Congestion window.", &congestionWindow},
+	{"udt_flight_packets", "gauge", "Packets in flight.", &flight},
+	{"udt_send_buffer_available_bytes", "gauge", "Free space in the UDT send buffer.", &sendBufferAvailable},
+	{"udt_receive_buffer_available_bytes", "gauge", "Free space in the UDT receive buffer.", &receiveBufferAvailable}
+};
+
+MetricsExporter::MetricsExporter()
+{
+	listen_fd = -1;
+	send_rate = 0;
+	generation = 0;
+
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_init(&snapshot_lock, NULL);
+#elif defined(WIN32)
+	snapshot_lock = CreateMutex(NULL, false, NULL);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+MetricsExporter::~MetricsExporter()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	if (listen_fd >= 0)
+		close(listen_fd);
+	pthread_mutex_destroy(&snapshot_lock);
+#elif defined(WIN32)
+	if (listen_fd >= 0)
+		closesocket(listen_fd);
+	CloseHandle(snapshot_lock);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+bool MetricsExporter::open(const char* target)
+{
+	// a number is a TCP port on the loopback interface, anything else is a Unix socket path
+	char* end = NULL;
+	long port = strtol(target, &end, 10);
+	if (end != target && *end == '\0')
+	{
+		if (port <= 0 || port > 65535)
+		{
+			cout << "error\tmetrics\tInvalid port " << target << "." << endl;
+			return false;
+		}
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons((unsigned short)port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		listen_fd = (int)socket(AF_INET, SOCK_STREAM, 0);
+		int reuse = 1;
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, (char*)&reuse, sizeof(reuse));
+		if (listen_fd < 0 || bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0)
+		{
+			cout << "error\tmetrics\t" << strerror(errno) << endl;
+			return false;
+		}
+	}
+	else
+	{
+#if defined(__linux__) || defined(__APPLE__)
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(target) >= sizeof(addr.sun_path))
+		{
+			cout << "error\tmetrics\tSocket path too long." << endl;
+			return false;
+		}
+		strncpy(addr.sun_path, target, sizeof(addr.sun_path)-1);
+		unlink(target);
+
+		listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_fd < 0 || bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0)
+		{
+			cout << "error\tmetrics\t" << strerror(errno) << endl;
+			return false;
+		}
+#elif defined(WIN32)
+		cout << "error\tmetrics\tUnix sockets are not supported on this platform." << endl;
+		return false;
+#else
+#error Not implemented on this platform
+#endif
+	}
+
+#if defined(__linux__) || defined(__APPLE__)
+	// a scraper hanging up mid response must not kill the transfer
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	return true;
+}
+
+void MetricsExporter::start()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_t serverthread;
+	pthread_create(&serverthread, NULL, &this->startServerThread, this);
+	pthread_detach(serverthread);
+#elif defined(WIN32)
+	HANDLE serverthread;
+	serverthread = CreateThread(NULL, 0, &MetricsExporter::startServerThread, this, 0, NULL);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+void MetricsExporter::beginSnapshot()
+{
+	connections.clear();
+	gauges.clear();
+	send_rate = 0;
+	generation++;
+}
+
+void MetricsExporter::addConnection(const char* role, UDTSOCKET socket, const char* ip, const char* port, int64_t disk_bytes)
+{
+	// perfstats reads the counters and histograms lock free and leaves the status line intervals alone
+	UDT::TRACESTATS stats;
+	if (UDT::ERROR == UDT::perfstats(socket, &stats))
+		return;
+
+	MetricsConnection connection;
+	connection.trace = stats.trace;
+	connection.rtt = stats.usRTT;
+	connection.send_interval = stats.usPktSndInterval;
+	connection.ack_nak_delay = stats.usAckToNakDelay;
+
+	char labels[256];
+	snprintf(labels, sizeof(labels), "role=\"%s\",socket=\"%d\",peer=\"%s:%s\"", role, (int)socket, ip, port);
+	connection.labels = labels;
+	connection.disk_bytes = disk_bytes;
+
+	map<UDTSOCKET, MetricsHistory>::iterator history_it = history.find(socket);
+	if (history_it == history.end())
+	{
+		MetricsHistory& created = history[socket];
+		memset(&created, 0, sizeof(created));
+
+		history_it = history.find(socket);
+	}
+
+	MetricsHistory& previous = history_it->second;
+	double elapsed = (double)(connection.trace.msTimeStamp - previous.timestamp)*1000;
+	connection.send_mbps = (elapsed > 0) ? (connection.trace.byteSentTotal - previous.sent)*8.0/elapsed : 0;
+	previous.timestamp = connection.trace.msTimeStamp;
+	previous.sent = connection.trace.byteSentTotal;
+	previous.generation = generation;
+
+	send_rate += connection.send_mbps;
+	connections.push_back(connection);
+}
+
+void MetricsExporter::addGauge(const char* name, const char* help, double value)
+{
+	char line[512];
+	snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n", name, help, name, name, value);
+	gauges += line;
+}
+
+double MetricsExporter::sendRate()
+{
+	return send_rate;
+}
+
+void MetricsExporter::publishSnapshot()
+{
+	string body = gauges;
+	char line[512];
+
+	for (size_t i=0; i < sizeof(metrics_families)/sizeof(metrics_families[0]); i++)
+	{
+		const MetricsFamily& family = metrics_families[i];
+		snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", family.name, family.help, family.name, family.type);
+		body += line;
+
+		vector<MetricsConnection>::iterator connection_it;
+		for (connection_it=connections.begin(); connection_it != connections.end(); connection_it++)
+		{
+			snprintf(line, sizeof(line), "%s{%s} %.17g\n", family.name, connection_it->labels.c_str(), family.value(*connection_it));
+			body += line;
+		}
+	}
+
+	renderHistogram(body, "udt_rtt_sample_seconds", "Round trip time samples.", &MetricsConnection::rtt);
+	renderHistogram(body, "udt_packet_send_interval_seconds", "Time between consecutive data packets sent.", &MetricsConnection::send_interval);
+	renderHistogram(body, "udt_ack_to_nak_delay_seconds", "Time from the latest ACK to each NAK sent.", &MetricsConnection::ack_nak_delay);
+
+	// forget connections that were not part of this snapshot
+	map<UDTSOCKET, MetricsHistory>::iterator history_it = history.begin();
+	while (history_it != history.end())
+	{
+		if (history_it->second.generation == generation)
+			history_it++;
+		else
+			history.erase(history_it++);
+	}
+
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_lock(&snapshot_lock);
+	snapshot.swap(body);
+	pthread_mutex_unlock(&snapshot_lock);
+#elif defined(WIN32)
+	WaitForSingleObject(snapshot_lock, INFINITE);
+	snapshot.swap(body);
+	ReleaseMutex(snapshot_lock);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+void MetricsExporter::renderHistogram(string& body, const char* name, const char* help, UDT::HISTOGRAM MetricsConnection::*histogram)
+{
+	char line[512];
+	snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+	body += line;
+
+	vector<MetricsConnection>::iterator connection_it;
+	for (connection_it=connections.begin(); connection_it != connections.end(); connection_it++)
+	{
+		const UDT::HISTOGRAM& source = (*connection_it).*histogram;
+		const char* labels = connection_it->labels.c_str();
+
+		// the finer UDT buckets are folded into the Prometheus ones by their upper bound, and
+		// Prometheus buckets are cumulative
+		int64_t cumulative = 0;
+		int source_bucket = 0;
+		for (int i=0; i < METRICS_BUCKET_COUNT; i++)
+		{
+			while (source_bucket < UDT_HIST_BUCKETS && UDT::histogram_bound(source_bucket) <= metrics_buckets[i]*1000000)
+				cumulative += source.counts[source_bucket++];
+			snprintf(line, sizeof(line), "%s_bucket{%s,le=\"%g\"} %lld\n", name, labels, metrics_buckets[i], (long long)cumulative);
+			body += line;
+		}
+		snprintf(line, sizeof(line), "%s_bucket{%s,le=\"+Inf\"} %lld\n%s_sum{%s} %.17g\n%s_count{%s} %lld\n",
+				 name, labels, (long long)source.count, name, labels, source.usSum/1000000.0, name, labels, (long long)source.count);
+		body += line;
+	}
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+void* MetricsExporter::startServerThread(void* obj)
+#elif defined(WIN32)
+DWORD WINAPI MetricsExporter::startServerThread(LPVOID obj)
+#else
+#error Not implemented on this platform
+#endif
+{
+	reinterpret_cast<MetricsExporter *>(obj)->serverThread();
+	return NULL;
+}
+
+void MetricsExporter::serverThread()
+{
+	while (true)
+	{
+		int client_fd = (int)accept(listen_fd, NULL, NULL);
+		if (client_fd < 0)
+		{
+#if defined(__linux__) || defined(__APPLE__)
+			if (errno == EINTR)
+				continue;
+#endif
+			cout << "error\tmetrics\t" << strerror(errno) << endl;
+			return;
+		}
+
+		serveClient(client_fd);
+
+#if defined(__linux__) || defined(__APPLE__)
+		close(client_fd);
+#elif defined(WIN32)
+		closesocket(client_fd);
+#else
+#error Not implemented on this platform
+#endif
+	}
+}
+
+void MetricsExporter::serveClient(int client_fd)
+{
+	// a stalled scraper gets dropped instead of blocking the next one
+#if defined(__linux__) || defined(__APPLE__)
+	timeval timeout;
+	timeout.tv_sec = 2;
+	timeout.tv_usec = 0;
+#elif defined(WIN32)
+	DWORD timeout = 2000;
+#endif
+	setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+	setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, (char*)&timeout, sizeof(timeout));
+
+	string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == string::npos && request.size() < 8192)
+	{
+		int received = recv(client_fd, buffer, sizeof(buffer), 0);
+		if (received <= 0)
+			return;
+		request.append(buffer, received);
+	}
+
+	string response;
+	if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0)
+	{
+		string body;
+#if defined(__linux__) || defined(__APPLE__)
+		pthread_mutex_lock(&snapshot_lock);
+		body = snapshot;
+		pthread_mutex_unlock(&snapshot_lock);
+#elif defined(WIN32)
+		WaitForSingleObject(snapshot_lock, INFINITE);
+		body = snapshot;
+		ReleaseMutex(snapshot_lock);
+#else
+#error Not implemented on this platform
+#endif
+
+		char header[256];
+		snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)body.size());
+		response = header;
+		response += body;
+	}
+	else
+	{
+		response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+	}
+
+	size_t sent = 0;
+	while (sent < response.size())
+	{
+		int result = send(client_fd, response.data()+sent, (int)(response.size()-sent), 0);
+		if (result <= 0)
+			return;
+		sent += result;
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ *  metrics_exporter.h
+ *  NetworkHelper
+ *
+ *  Minimal HTTP endpoint serving Prometheus text format metrics. Metrics are
+ *  rendered into a snapshot by the collecting thread and published whole, so
+ *  a scrape only copies the latest snapshot and never touches a UDT socket.
+ *
+ */
+
+#ifndef METRICSEXPORTER
+#define METRICSEXPORTER
+
+#include <udt.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// how often the sender refreshes the published snapshot, in milliseconds
+#define METRICS_INTERVAL 1000
+
+// number of finite buckets in the rendered latency histograms
+#define METRICS_BUCKET_COUNT 12
+
+struct MetricsConnection
+{
+	std::string labels;
+	UDT::TRACEINFO trace;
+	int64_t disk_bytes;
+	double send_mbps;
+	UDT::HISTOGRAM rtt;
+	UDT::HISTOGRAM send_interval;
+	UDT::HISTOGRAM ack_nak_delay;
+};
+
+struct MetricsHistory
+{
+	int64_t timestamp;
+	int64_t sent;
+	int64_t generation;
+};
+
+class MetricsExporter
+{
+public:
+	MetricsExporter();
+	~MetricsExporter();
+	bool open(const char* target);
+	void start();
+	void beginSnapshot();
+	void addConnection(const char* role, UDTSOCKET socket, const char* ip, const char* port, int64_t disk_bytes);
+	void addGauge(const char* name, const char* help, double value);
+	void publishSnapshot();
+	double sendRate();
+
+private:
+	int listen_fd;
+	std::string snapshot;
+	std::string gauges;
+	std::vector<MetricsConnection> connections;
+	std::map<UDTSOCKET, MetricsHistory> history;
+	double send_rate;
+	int64_t generation;
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_t snapshot_lock;
+	static void* startServerThread(void* obj);
+#elif defined(WIN32)
+	HANDLE snapshot_lock;
+	static DWORD WINAPI startServerThread(LPVOID obj);
+#else
+#error Not implemented on this platform
+#endif
+	void serverThread();
+	void serveClient(int client_fd);
+	void renderHistogram(std::string& body, const char* name, const char* help, UDT::HISTOGRAM MetricsConnection::*histogram);
+};
+
+#endif
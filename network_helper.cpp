@@ -12,6 +12,9 @@
 #include <string.h>
 #include "network_sender.h"
 #include "network_receiver.h"
+#include "network_stream.h"
+#include "telemetry.h"
+#include "metrics_exporter.h"
 
 #ifdef __linux__
 #include <bsd/bsd.h>
@@ -19,8 +22,77 @@
 
 using namespace std;
 
+// path parameters older than this are not used to warm start a connection, in seconds
+#define PATH_CACHE_MAX_AGE (7 * 24 * 3600)
+// memory the buffers of all connections may use together unless -b says otherwise, in megabytes
+#define BUFFER_BUDGET_MB 1024
+
 int main(int argc, char* argv[])
 {
+	// optional settings come before the mode:
+	// [-t fd|unix_socket_path] [-i interval_ms] [-m port|unix_socket_path] [-c udt|bbr|ledbat] [-p cache_path] [-f 0|1]
+	// [-a local_ip,local_ip...] [-b budget_mb] [-u max_packet_bytes]
+	// the congestion control algorithm, the parity packets (-f 1) and the additional paths (-a) apply to the
+	// sending side, the cache file keeps per-peer path parameters between runs; the buffers grow with the
+	// bandwidth-delay product of each connection, within a budget for all of them (-b 0 for none); with -u both
+	// sides start at 1500-byte packets and probe for larger ones up to the given size, e.g. 9000 on a jumbo frame LAN
+	const char* telemetry_target = NULL;
+	const char* metrics_target = NULL;
+	const char* cc_name = NULL;
+	const char* cache_path = NULL;
+	const char* path_addresses = NULL;
+	int telemetry_interval = 1000;
+	bool fec = false;
+	int64_t budget = BUFFER_BUDGET_MB;
+	int max_packet = 0;
+	while (argc > 2 && argv[1][0] == '-' && (argv[1][1] == 't' || argv[1][1] == 'i' || argv[1][1] == 'm' || argv[1][1] == 'c' || argv[1][1] == 'p' || argv[1][1] == 'f' || argv[1][1] == 'a' || argv[1][1] == 'b' || argv[1][1] == 'u'))
+	{
+		if (argv[1][1] == 't')
+			telemetry_target = argv[2];
+		else if (argv[1][1] == 'm')
+			metrics_target = argv[2];
+		else if (argv[1][1] == 'c')
+			cc_name = argv[2];
+		else if (argv[1][1] == 'p')
+			cache_path = argv[2];
+		else if (argv[1][1] == 'f')
+			fec = atoi(argv[2]) != 0;
+		else if (argv[1][1] == 'a')
+			path_addresses = argv[2];
+		else if (argv[1][1] == 'b')
+			budget = atoi(argv[2]);
+		else if (argv[1][1] == 'u')
+			max_packet = atoi(argv[2]);
+		else
+			telemetry_interval = atoi(argv[2]);
+		
+		argv += 2;
+		argc -= 2;
+	}
+	
+	Telemetry* telemetry = NULL;
+	if (telemetry_target)
+	{
+		telemetry = new Telemetry(telemetry_interval);
+		if (!telemetry->open(telemetry_target))
+			exit(1);
+	}
+	
+	if (budget >= 0)
+		UDT::setbufferbudget(budget*1024*1024);
+	
+	// without the cache every run starts from the default window, which is slower but works
+	if (cache_path && UDT::ERROR == UDT::setcachefile(cache_path, PATH_CACHE_MAX_AGE))
+		cout << "error\tcachefile\t" << UDT::getlasterror().getErrorMessage() << endl;
+	
+	MetricsExporter* metrics = NULL;
+	if (metrics_target)
+	{
+		metrics = new MetricsExporter();
+		if (!metrics->open(metrics_target))
+			exit(1);
+	}
+	
 	if (argc > 1 && argv[1][0] == '-' && argv[1][1] == 's')
 	{
 		int count = atoi(argv[4]);
@@ -39,11 +111,33 @@ int main(int argc, char* argv[])
 		}
 		
 		NetworkSender* sender = new NetworkSender(atoi(argv[2]), atoi(argv[3]), count, file_array);
+		sender->setTelemetry(telemetry);
+		sender->setMetrics(metrics);
+		if (cc_name && !sender->setCongestionControl(cc_name))
+			exit(1);
+		sender->setFEC(fec);
+		sender->setMaxPacketSize(max_packet);
+		if (path_addresses && !sender->setPaths(path_addresses))
+			exit(1);
 		exit(sender->startSend());
 	}
 	else if (argc > 1 && argv[1][0] == '-' && argv[1][1] == 'r')
 	{
 		NetworkReceiver* receiver = new NetworkReceiver(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), argv[6]);
+		receiver->setTelemetry(telemetry);
+		receiver->setMaxPacketSize(max_packet);
+		exit(receiver->startReceive());
+	}
+	else if (argc > 4 && argv[1][0] == '-' && argv[1][1] == 'S')
+	{
+		// live stream: -S port ttl_ms source|- [message_bytes], messages older than ttl_ms are dropped
+		StreamSender* sender = new StreamSender(atoi(argv[2]), atoi(argv[3]), argv[4], (argc > 5) ? atoi(argv[5]) : 0);
+		exit(sender->startSend());
+	}
+	else if (argc > 5 && argv[1][0] == '-' && argv[1][1] == 'R')
+	{
+		// live stream: -R sender_ip|peer_id port ttl_ms destination|-, messages arriving after ttl_ms are not written
+		StreamReceiver* receiver = new StreamReceiver(argv[2], atoi(argv[3]), atoi(argv[4]), argv[5]);
 		exit(receiver->startReceive());
 	}
 	else
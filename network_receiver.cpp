@@ -36,6 +36,7 @@
 
 #include "holepoke/network.h"
 #include "network_receiver.h"
+#include "resume_ticket.h"
 #include "holepoke/receiver.h"
 
 #include "hole_poke_delegate.h"
@@ -58,14 +59,52 @@ NetworkReceiver::NetworkReceiver(char* id, int port, int64_t speed, int64_t offs
 	max_speed = speed;
 	transferred = offset;
 	recv_finished = false;
+	telemetry = NULL;
+	trace_enabled = false;
+	max_packet = 0;
+}
+
+void NetworkReceiver::setTelemetry(Telemetry* new_telemetry)
+{
+	telemetry = new_telemetry;
+}
+
+void NetworkReceiver::setMaxPacketSize(int size)
+{
+	max_packet = size;
 }
 
 int NetworkReceiver::startReceive()
 {
 	recv_socket = UDT::socket(AF_INET, SOCK_STREAM, 0);
+	if (max_packet > 0)
+	{
+		// the connection uses the smaller of both sides' sizes, so the receiver has to allow large packets as well;
+		// set before the buffer sizes, which the library counts in packets of this size
+		bool pmtud = true;
+		UDT::setsockopt(recv_socket, 0, UDT_MSS, &max_packet, sizeof(int));
+		UDT::setsockopt(recv_socket, 0, UDT_PMTUD, &pmtud, sizeof(bool));
+	}
+	// 500 MB is only the ceiling, the buffer grows with the bandwidth-delay product of the connection
+	bool autotune = true;
 	UDT::setsockopt(recv_socket, 0, UDT_RCVBUF, new int(1024*1024*500), sizeof(int));
+	UDT::setsockopt(recv_socket, 0, UDT_AUTOTUNE, &autotune, sizeof(bool));
 	UDT::setsockopt(recv_socket, 0, UDP_RCVBUF, new int(1024*1024*50), sizeof(int));
 	UDT::setsockopt(recv_socket, 0, UDT_MAXBW, new int64_t(max_speed), sizeof(int64_t));
+	if (trace_enabled)
+		UDT::setsockopt(recv_socket, 0, UDT_TRACE, &trace_enabled, sizeof(bool));
+	
+	// with the ticket and manifest of an earlier connection to this sender, the offset goes out in
+	// the connection request and the sender starts on the files in its first reply
+	ResumeTicket resume(save_directory, peer_id.c_str(), peer_port);
+	bool resuming = resume.load();
+	if (resuming)
+	{
+		char request[RESUME_REQUEST_SIZE];
+		resume.makeRequest(request, transferred);
+		UDT::setsockopt(recv_socket, 0, UDT_TICKET, resume.ticket(), RESUME_TICKET_SIZE);
+		UDT::setsockopt(recv_socket, 0, UDT_EARLYDATA, request, sizeof(request));
+	}
 	
 	if (peer_port == 0)
 	{
@@ -150,57 +189,91 @@ int NetworkReceiver::startReceive()
 		cout << "starting\t" << peer_id << "\t" << peer_port << endl;
 	}
 	
-	if (UDT::ERROR == UDT::recv(recv_socket, (char*)&total_size, sizeof(int64_t), 0))
+	char ticket[RESUME_TICKET_SIZE];
+	int ticket_len = sizeof(ticket);
+	if (UDT::ERROR != UDT::getsockopt(recv_socket, 0, UDT_TICKET, ticket, &ticket_len))
+		resume.setTicket(ticket);
+	
+	iovec size_vector;
+	size_vector.iov_base = (char*)&total_size;
+	size_vector.iov_len = sizeof(int64_t);
+	if (!receiveAll(&size_vector, 1))
 	{
 		cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
 		return 1;
 	}
 	
-	if (UDT::ERROR == UDT::recv(recv_socket, (char*)&file_count, sizeof(int), 0))
+	if (resuming && total_size == RESUME_ACCEPTED)
 	{
-		cout << "error\trecv\t" << UDT::getlasterror().getErrorMessage() << endl;
-		return 1;
+		// the sender accepted the offset sent with the connection request, the files follow
+		if (!ResumeTicket::parseManifest(resume.manifest(), resume.manifestLength(), &total_size, &file_count, &file_names, &file_sizes))
+		{
+			cout << "error\tresume\t" << "Cached manifest is corrupt." << endl;
+			return 1;
+		}
 	}
-	
-	cout << "fileinfo\t" << total_size << "\t" << file_count;
-	
-	file_names = (char**)malloc(sizeof(char*)*file_count);
-	file_sizes = (int64_t*)malloc(sizeof(int64_t)*file_count);
-	for (int i=0; i < file_count; i++)
+	else
 	{
-		// retrieving filename from sender
-		int len;		
-		if (UDT::ERROR == UDT::recv(recv_socket, (char*)&len, sizeof(int), 0))
+		// the file list arrives in one call per file: its name and size together with the length of the next name
+		iovec header[3];
+		header[0].iov_base = (char*)&file_count;
+		header[0].iov_len = sizeof(int);
+		if (!receiveAll(header, 1))
 		{
 			cout << "error\trecv\t" << UDT::getlasterror().getErrorMessage() << endl;
 			return 1;
 		}
 		
-		file_names[i] = (char*)malloc(len+1);
-		if (UDT::ERROR == UDT::recv(recv_socket, file_names[i], len, 0))
+		file_names = (char**)malloc(sizeof(char*)*file_count);
+		file_sizes = (int64_t*)malloc(sizeof(int64_t)*file_count);
+		int len = 0;
+		header[0].iov_base = (char*)&len;
+		header[0].iov_len = sizeof(int);
+		if (file_count > 0 && !receiveAll(header, 1))
 		{
 			cout << "error\trecv\t" << UDT::getlasterror().getErrorMessage() << endl;
 			return 1;
 		}
-		file_names[i][len] = '\0';
-			
-		// get size information
-		if (UDT::ERROR == UDT::recv(recv_socket, (char*)&file_sizes[i], sizeof(int64_t), 0))
+		
+		for (int i=0; i < file_count; i++)
+		{
+			int name_len = len;
+			file_names[i] = (char*)malloc(name_len+1);
+			header[0].iov_base = file_names[i];
+			header[0].iov_len = name_len;
+			header[1].iov_base = (char*)&file_sizes[i];
+			header[1].iov_len = sizeof(int64_t);
+			header[2].iov_base = (char*)&len;
+			header[2].iov_len = sizeof(int);
+			if (!receiveAll(header, (i+1 < file_count) ? 3 : 2))
+			{
+				cout << "error\trecv\t" << UDT::getlasterror().getErrorMessage() << endl;
+				return 1;
+			}
+			file_names[i][name_len] = '\0';
+		}
+		
+		if (UDT::ERROR == UDT::send(recv_socket, (char*)&transferred, sizeof(transferred), 0))
 		{
 			cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
 			return 1;
 		}
 		
-		cout << "\t" << file_names[i] << "\t" << file_sizes[i];
+		int manifest_len;
+		char* manifest = ResumeTicket::buildManifest(total_size, file_count, file_names, file_sizes, &manifest_len);
+		resume.setManifest(manifest, manifest_len);
+		free(manifest);
 	}
 	
-	cout << endl;
+	// keep the new ticket for the next attempt
+	resume.save();
 	
-	if (UDT::ERROR == UDT::send(recv_socket, (char*)&transferred, sizeof(transferred), 0))
+	cout << "fileinfo\t" << total_size << "\t" << file_count;
+	for (int i=0; i < file_count; i++)
 	{
-		cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
-		return 1;
+		cout << "\t" << file_names[i] << "\t" << file_sizes[i];
 	}
+	cout << endl;
 	
 	int64_t start_at;
 	int64_t size_count;
@@ -224,6 +297,18 @@ int NetworkReceiver::startReceive()
 	pthread_detach(statusthread);
 #endif
 	
+	if (telemetry && telemetry->enabled())
+	{
+#ifdef WIN32
+		HANDLE telemetrythread;
+		telemetrythread = CreateThread(NULL, 0, &NetworkReceiver::startTelemetryThread, this, 0, NULL);
+#elif defined(__linux__) || defined(__APPLE__)
+		pthread_t telemetrythread;
+		pthread_create(&telemetrythread, NULL, &this->startTelemetryThread, this);
+		pthread_detach(telemetrythread);
+#endif
+	}
+	
 	int64_t remaining;
 	for (int64_t i=start_at; i < file_count; i++)
 	{
@@ -279,6 +364,15 @@ int NetworkReceiver::startReceive()
 		ofs.close();
 	}
 	
+	// the sender closes as soon as it sees the end time, so sample the connection first
+	if (telemetry)
+	{
+		char port[16];
+		snprintf(port, sizeof(port), "%d", peer_port);
+		telemetry->addRecord("receiver", "finished", recv_socket, peer_id.c_str(), port, -1);
+		telemetry->flush();
+	}
+	
 	time_t endtime;
 	time(&endtime);
 	
@@ -375,6 +469,38 @@ void NetworkReceiver::statusThread()
 	}
 }
 
+#ifdef WIN32
+DWORD NetworkReceiver::startTelemetryThread(LPVOID obj)
+#elif (__linux__) || (__APPLE__)
+void* NetworkReceiver::startTelemetryThread(void* obj)
+#else
+#error not defined for this platform
+#endif
+{
+	reinterpret_cast<NetworkReceiver *>(obj)->telemetryThread();
+	return NULL;
+}
+
+void NetworkReceiver::telemetryThread()
+{
+	char port[16];
+	snprintf(port, sizeof(port), "%d", peer_port);
+	
+	while (!recv_finished && telemetry->enabled())
+	{
+		telemetry->addRecord("receiver", "sample", recv_socket, peer_id.c_str(), port, -1);
+		telemetry->flush();
+		
+#ifdef WIN32
+		Sleep(telemetry->interval());
+#elif defined(__linux__) || defined(__APPLE__)
+		usleep(telemetry->interval()*1000);
+#else
+#error not defined for this platform
+#endif
+	}
+}
+
 #ifdef WIN32
 DWORD NetworkReceiver::startInputThread(LPVOID obj)
 #elif defined(__linux__) || defined(__APPLE__)
@@ -425,6 +551,19 @@ void NetworkReceiver::processCommand(char* command, size_t len)
 		int64_t new_speed = atoi(strtok(NULL, "\t"));
 		setMaxSpeed(new_speed);
 	}
+	else if (strncmp(command_split, "telemetry_interval", 18) == 0)
+	{
+		if (telemetry)
+			telemetry->setInterval(atoi(strtok(NULL, "\t")));
+	}
+	else if (strncmp(command_split, "trace_dump", 10) == 0)
+	{
+		dumpTrace(strtok(NULL, "\t"));
+	}
+	else if (strncmp(command_split, "trace", 5) == 0)
+	{
+		setTrace(atoi(strtok(NULL, "\t")) != 0);
+	}
 	else if (strncmp(command_split, "stop", 4) == 0)
 	{
 		recv_finished = true;
@@ -433,9 +572,54 @@ void NetworkReceiver::processCommand(char* command, size_t len)
 	}
 }
 
+bool NetworkReceiver::receiveAll(iovec* vector, int count)
+{
+	// UDT::recvv returns as soon as part of the data has arrived, the vector is advanced past it
+	while (count > 0)
+	{
+		int received = UDT::recvv(recv_socket, vector, count, 0);
+		if (UDT::ERROR == received)
+			return false;
+		
+		while (count > 0 && received >= (int)vector->iov_len)
+		{
+			received -= vector->iov_len;
+			vector++;
+			count--;
+		}
+		
+		if (count > 0)
+		{
+			vector->iov_base = (char*)vector->iov_base + received;
+			vector->iov_len -= received;
+		}
+	}
+	
+	return true;
+}
+
+void NetworkReceiver::setTrace(bool enabled)
+{
+	trace_enabled = enabled;
+	UDT::setsockopt(recv_socket, 0, UDT_TRACE, &enabled, sizeof(bool));
+}
+
+void NetworkReceiver::dumpTrace(const char* directory)
+{
+	if (directory == NULL)
+		return;
+	
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/trace_%d.udtt", directory, (int)recv_socket);
+	if (UDT::ERROR == UDT::tracedump(recv_socket, path))
+		cout << "error\ttracedump\t" << UDT::getlasterror().getErrorMessage() << endl;
+	else
+		cout << "tracedump\t" << path << endl;
+}
+
 void NetworkReceiver::setMaxSpeed(int64_t new_speed)
 {
-	ZUDTCC* cchandle = NULL;
+	ZCC* cchandle = NULL;
 	int size;
 	UDT::getsockopt(recv_socket, 0, UDT_CC, &cchandle, &size);
 	cchandle->setBW(new_speed);
@@ -12,11 +12,14 @@
 
 #include <udt.h>
 #include <ccc.h>
+#include "telemetry.h"
 
 class NetworkReceiver
 {
 public:
 	NetworkReceiver(char* id, int port, int64_t speed, int64_t offset, char* directory);
+	void setTelemetry(Telemetry* new_telemetry);
+	void setMaxPacketSize(int size);
 	int startReceive();
 	
 private:
@@ -32,6 +35,9 @@ private:
 	time_t starttime;
 	bool recv_finished;
 	int64_t transferred;
+	Telemetry* telemetry;
+	bool trace_enabled;
+	int max_packet;
 
 #if defined(__linux__) || defined(__APPLE__)
 	static void* startStatusThread(void* obj);
@@ -41,6 +47,14 @@ private:
 #error Not implemented on this platform
 #endif
 	void statusThread();
+#if defined(__linux__) || defined(__APPLE__)
+	static void* startTelemetryThread(void* obj);
+#elif defined(WIN32)
+	static DWORD WINAPI startTelemetryThread(LPVOID obj);
+#else
+#error Not implemented on this platform
+#endif
+	void telemetryThread();
 #if defined(__linux__) || defined(__APPLE__)
 	static void* startInputThread(void* obj);
 #elif defined(WIN32)
@@ -50,7 +64,11 @@ private:
 #endif
 	void inputThread();
 	void processCommand(char* command, size_t len);
+	// receives exactly the blocks of the vector, which is modified on the way
+	bool receiveAll(iovec* vector, int count);
 	void setMaxSpeed(int64_t new_speed);
+	void setTrace(bool enabled);
+	void dumpTrace(const char* directory);
 };
 
 #endif
\ No newline at end of file
@@ -16,6 +16,7 @@
 #elif defined(WIN32)
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#define snprintf _snprintf
 
 #ifndef STDIN_FILENO
 #define STDIN_FILENO 0
@@ -50,6 +51,8 @@ NetworkSender::NetworkSender(int port, int64_t speed, int count, const char** fi
 	UDT::startup();
 	
 	listen_port = port;
+	listen_socket = UDT::INVALID_SOCK;
+	cc_factory = new CCCFactory<ZUDTCC>;
 	file_count = count;
 	file_locations = file_array;
 	file_names = (char**)malloc(sizeof(char*)*count);
@@ -57,6 +60,19 @@ NetworkSender::NetworkSender(int port, int64_t speed, int count, const char** fi
 	max_speed = speed;
 	send_finished = false;
 	total_size = 0;
+	telemetry = NULL;
+	metrics = NULL;
+	trace_enabled = false;
+	fec_enabled = false;
+	max_packet = 0;
+	
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_init(&send_sockets_lock, NULL);
+#elif defined(WIN32)
+	send_sockets_lock = CreateMutex(NULL, false, NULL);
+#else
+#error Not implemented on this platform
+#endif
 	
 	for (int i=0; i < file_count; i++)
 	{
@@ -116,6 +132,20 @@ NetworkSender::NetworkSender(int port, int64_t speed, int count, const char** fi
 		
 		free(file_location_copy);
 	}
+	
+	// every connection gets the same header, receivers resuming with its hash skip it
+	manifest = ResumeTicket::buildManifest(total_size, file_count, file_names, file_sizes, &manifest_len);
+	manifest_hash = ResumeTicket::hashManifest(manifest, manifest_len);
+}
+
+void NetworkSender::setTelemetry(Telemetry* new_telemetry)
+{
+	telemetry = new_telemetry;
+}
+
+void NetworkSender::setMetrics(MetricsExporter* new_metrics)
+{
+	metrics = new_metrics;
 }
 
 int NetworkSender::startSend()
@@ -140,13 +170,69 @@ int NetworkSender::startSend()
 	statusthread = CreateThread(NULL, 0, &NetworkSender::startStatusThread, this, 0, NULL);
 #endif
 	
+	if (telemetry && telemetry->enabled())
+	{
+#if defined(__linux__) || defined(__APPLE__)
+		pthread_t telemetrythread;
+		pthread_create(&telemetrythread, NULL, &this->startTelemetryThread, this);
+		pthread_detach(telemetrythread);
+#elif defined(WIN32)
+		HANDLE telemetrythread;
+		telemetrythread = CreateThread(NULL, 0, &NetworkSender::startTelemetryThread, this, 0, NULL);
+#endif
+	}
+	
+	if (metrics)
+	{
+		metrics->start();
+#if defined(__linux__) || defined(__APPLE__)
+		pthread_t metricsthread;
+		pthread_create(&metricsthread, NULL, &this->startMetricsThread, this);
+		pthread_detach(metricsthread);
+#elif defined(WIN32)
+		HANDLE metricsthread;
+		metricsthread = CreateThread(NULL, 0, &NetworkSender::startMetricsThread, this, 0, NULL);
+#endif
+	}
+	
+	// a fixed pool of workers multiplexes every accepted connection over UDT::epoll
+	for (int i=0; i < SEND_WORKER_COUNT; i++)
+	{
+		send_workers[i].sender = this;
+		send_workers[i].index = i;
+		send_workers[i].eid = UDT::epoll_create();
+		send_workers[i].connections = 0;
+		
+		if (send_workers[i].eid < 0)
+		{
+			cout << "error\tepoll_create\t" << UDT::getlasterror().getErrorMessage() << endl;
+			return 1;
+		}
+		
+#if defined(__linux__) || defined(__APPLE__)
+		pthread_t sendthread;
+		pthread_create(&sendthread, NULL, &this->startSendThread, &send_workers[i]);
+		pthread_detach(sendthread);
+#elif defined(WIN32)
+		HANDLE sendthread;
+		sendthread = CreateThread(NULL, 0, &NetworkSender::startSendThread, &send_workers[i], 0, NULL);
+#else
+#error Not implemented on this platform.
+#endif
+	}
+	
 	bool listening = false;
 	while (!send_finished)
 	{
+		lockSockets();
+		size_t connection_count = send_sockets.size();
+		unlockSockets();
+		
+		bool autotune = true;
 		int64_t speed;
 		if (max_speed > 0)
 		{
-			speed = max_speed/(send_sockets.size()+1);
+			speed = max_speed/(connection_count+1);
 		}
 		else
 		{
@@ -156,17 +242,19 @@ int NetworkSender::startSend()
 		if (listen_port == 0)
 		{
 			listen_socket = UDT::socket(AF_INET, SOCK_STREAM, 0);
-			UDT::setsockopt(listen_socket, 0, UDT_CC, new CCCFactory<ZUDTCC>, sizeof(CCCFactory<ZUDTCC>));
+			lockSockets();
+			UDT::setsockopt(listen_socket, 0, UDT_CC, cc_factory, sizeof(CCCVirtualFactory));
+			unlockSockets();
+			setPacketSize(listen_socket);
+			// 500 MB is only the ceiling, the buffer grows with the bandwidth-delay product of the connection
 			UDT::setsockopt(listen_socket, 0, UDT_SNDBUF, new int(1024*1024*500), sizeof(int));
+			UDT::setsockopt(listen_socket, 0, UDT_AUTOTUNE, &autotune, sizeof(bool));
 			UDT::setsockopt(listen_socket, 0, UDP_SNDBUF, new int(1024*1024*50), sizeof(int));
+			UDT::setsockopt(listen_socket, 0, UDT_FEC, &fec_enabled, sizeof(bool));
 			if (speed > 0)
 			{
 				UDT::setsockopt(listen_socket, 0, UDT_MAXBW, new int64_t(speed), sizeof(int64_t));
 			}
-#ifdef WIN32
-			int mss = 1052;
-			UDT::setsockopt(listen_socket, 0, UDT_MSS, &mss, sizeof(int));
-#endif			
 			
 			const char* holepokeIPAddressString = "50.16.103.211";
 			const char* holepokePortString = "3333";
@@ -217,17 +305,19 @@ int NetworkSender::startSend()
 		else if (!listening)
 		{
 			listen_socket = UDT::socket(AF_INET, SOCK_STREAM, 0);
-			UDT::setsockopt(listen_socket, 0, UDT_CC, new CCCFactory<ZUDTCC>, sizeof(CCCFactory<ZUDTCC>));
+			lockSockets();
+			UDT::setsockopt(listen_socket, 0, UDT_CC, cc_factory, sizeof(CCCVirtualFactory));
+			unlockSockets();
+			setPacketSize(listen_socket);
+			// 500 MB is only the ceiling, the buffer grows with the bandwidth-delay product of the connection
 			UDT::setsockopt(listen_socket, 0, UDT_SNDBUF, new int(1024*1024*500), sizeof(int));
+			UDT::setsockopt(listen_socket, 0, UDT_AUTOTUNE, &autotune, sizeof(bool));
 			UDT::setsockopt(listen_socket, 0, UDP_SNDBUF, new int(1024*1024*50), sizeof(int));
+			UDT::setsockopt(listen_socket, 0, UDT_FEC, &fec_enabled, sizeof(bool));
 			if (speed > 0)
 			{
 				UDT::setsockopt(listen_socket, 0, UDT_MAXBW, new int64_t(speed), sizeof(int64_t));
 			}
-#ifdef WIN32
-			int mss = 1052;
-			UDT::setsockopt(listen_socket, 0, UDT_MSS, &mss, sizeof(int));
-#endif
 			
 			sockaddr_in my_addr;
 			my_addr.sin_family = AF_INET;
@@ -267,20 +357,7 @@ int NetworkSender::startSend()
 		time_t start_time;
 		time(&start_time);
 		SocketListItem* newItem = new SocketListItem(send_socket, start_time, remote_ip, remote_port);
-		send_sockets.push_back(newItem);
-		
-		cout << "starting\t" << remote_ip << "\t" << remote_port << "\t" << send_sockets.size() << endl;
-		
-#if defined(__linux__) || defined(__APPLE__)
-		pthread_t sendthread;
-		pthread_create(&sendthread, NULL, &this->startSendThread, this);
-		pthread_detach(sendthread);
-#elif defined(WIN32)
-		HANDLE sendthread;
-		sendthread = CreateThread(NULL, 0, &NetworkSender::startSendThread, this, 0, NULL);
-#else
-#error Not implemented on this platform.
-#endif
+		addConnection(newItem);
 	}
 	
 end:
@@ -294,7 +371,9 @@ end:
 #error Not implemented on this platform
 #endif
 	
+	lockSockets();
 	send_sockets.clear();
+	unlockSockets();
 	if (file_names)
 		free(file_names);
 	if (file_sizes)
@@ -327,114 +406,398 @@ DWORD NetworkSender::startSendThread(LPVOID obj)
 #error Not defined for this platform
 #endif
 {
-	reinterpret_cast<NetworkSender *>(obj)->sendThread();
+	SendWorker* worker = reinterpret_cast<SendWorker *>(obj);
+	worker->sender->sendThread(worker);
 	return NULL;
 }
+
+void NetworkSender::sendThread(SendWorker* worker)
+{
+	set<UDTSOCKET> readfds;
+	set<UDTSOCKET> writefds;
+	time_t last_sweep;
+	time(&last_sweep);
 	
-void NetworkSender::sendThread()
+	while (!send_finished)
+	{
+		if (UDT::ERROR == UDT::epoll_wait(worker->eid, &readfds, &writefds, 1000))
+		{
+			cout << "error\tepoll_wait\t" << UDT::getlasterror().getErrorMessage() << endl;
+			break;
+		}
+		
+		set<UDTSOCKET> ready;
+		ready.insert(readfds.begin(), readfds.end());
+		ready.insert(writefds.begin(), writefds.end());
+		
+		// broken connections are not always signaled, so every connection gets polled once a second
+		time_t now;
+		time(&now);
+		if (now != last_sweep)
+		{
+			last_sweep = now;
+			lockSockets();
+			map<UDTSOCKET, SocketListItem*>::iterator socket_it;
+			for (socket_it=send_sockets.begin(); socket_it != send_sockets.end(); socket_it++)
+			{
+				if (socket_it->second->worker == worker->index)
+					ready.insert(socket_it->first);
+			}
+			unlockSockets();
+		}
+		
+		set<UDTSOCKET>::iterator ready_it;
+		for (ready_it=ready.begin(); ready_it != ready.end(); ready_it++)
+		{
+			// items are only deleted by their own worker, so it is safe to use one after the lookup
+			SocketListItem* item = NULL;
+			lockSockets();
+			map<UDTSOCKET, SocketListItem*>::iterator socket_it = send_sockets.find(*ready_it);
+			if (socket_it != send_sockets.end() && socket_it->second->worker == worker->index)
+				item = socket_it->second;
+			unlockSockets();
+			
+			if (item && !processConnection(item))
+			{
+				removeConnection(item);
+			}
+		}
+	}
+	
+	UDT::epoll_release(worker->eid);
+}
+
+void NetworkSender::lockSockets()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_lock(&send_sockets_lock);
+#elif defined(WIN32)
+	WaitForSingleObject(send_sockets_lock, INFINITE);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+void NetworkSender::unlockSockets()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_unlock(&send_sockets_lock);
+#elif defined(WIN32)
+	ReleaseMutex(send_sockets_lock);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+vector<UDTSOCKET> NetworkSender::socketList()
 {
-	list<SocketListItem*>::iterator socket_it;
-	socket_it = send_sockets.end();
-	socket_it--;
+	// the library calls on the sockets run after the lock is dropped, a socket closed meanwhile only fails them
+	vector<UDTSOCKET> sockets;
+	lockSockets();
+	sockets.reserve(send_sockets.size());
+	map<UDTSOCKET, SocketListItem*>::iterator socket_it;
+	for (socket_it=send_sockets.begin(); socket_it != send_sockets.end(); socket_it++)
+		sockets.push_back(socket_it->first);
+	unlockSockets();
 	
-	UDTSOCKET send_socket = (*socket_it)->socket();
+	return sockets;
+}
+
+void NetworkSender::addConnection(SocketListItem* item)
+{
+	UDTSOCKET send_socket = item->socket();
+	
+	// workers must never block on a single receiver
+	bool blocking = false;
+	UDT::setsockopt(send_socket, 0, UDT_SNDSYN, &blocking, sizeof(bool));
+	UDT::setsockopt(send_socket, 0, UDT_RCVSYN, &blocking, sizeof(bool));
+	if (trace_enabled)
+		UDT::setsockopt(send_socket, 0, UDT_TRACE, &trace_enabled, sizeof(bool));
+	
+	// every extra local address becomes a path of the connection once the receiver accepts its join
+	list<sockaddr_in>::iterator path_it;
+	for (path_it=path_addresses.begin(); path_it != path_addresses.end(); path_it++)
+	{
+		if (UDT::ERROR == UDT::addpath(send_socket, (sockaddr*)&(*path_it), sizeof(sockaddr_in)))
+			cout << "error	addpath	" << UDT::getlasterror().getErrorMessage() << endl;
+	}
 	
-	// send total size
-	if (UDT::ERROR == UDT::send(send_socket, (char*)&total_size, sizeof(int64_t), 0))
+	// a receiver that resumes with the manifest of this transfer only needs to be told that its
+	// offset is accepted, otherwise stage the header and wait for the offset
+	char request[RESUME_REQUEST_SIZE];
+	int request_len = sizeof(request);
+	int64_t resume_offset;
+	uint64_t resume_hash;
+	if (UDT::ERROR != UDT::getsockopt(send_socket, 0, UDT_EARLYDATA, request, &request_len) &&
+		ResumeTicket::parseRequest(request, request_len, &resume_offset, &resume_hash) &&
+		resume_hash == manifest_hash && resume_offset >= 0 && resume_offset <= total_size)
+	{
+		int64_t accepted = RESUME_ACCEPTED;
+		item->buffer = (char*)malloc(sizeof(int64_t));
+		memcpy(item->buffer, &accepted, sizeof(int64_t));
+		item->buffer_len = sizeof(int64_t);
+		item->resume_offset = resume_offset;
+	}
+	else
 	{
-		cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
-		goto end;
+		item->buffer = (char*)malloc(manifest_len);
+		memcpy(item->buffer, manifest, manifest_len);
+		item->buffer_len = manifest_len;
 	}
+	item->buffer_pos = 0;
+	item->state = SEND_HEADER;
 	
-	// send file count
-	if (UDT::ERROR == UDT::send(send_socket, (char*)&file_count, sizeof(int), 0))
+	// hand the connection to the least loaded worker
+	lockSockets();
+	SendWorker* worker = &send_workers[0];
+	for (int i=1; i < SEND_WORKER_COUNT; i++)
 	{
-		cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
-		goto end;
+		if (send_workers[i].connections < worker->connections)
+			worker = &send_workers[i];
 	}
+	item->worker = worker->index;
+	worker->connections++;
 	
-	for (int i=0; i < file_count; i++)
+	// register with the worker before the item is published, so that nothing sees it half set up
+	int events = UDT_EPOLL_OUT;
+	UDT::epoll_add_usock(worker->eid, send_socket, &events);
+	send_sockets[send_socket] = item;
+	
+	cout << "starting\t" << item->remoteIP() << "\t" << item->remotePort() << "\t" << send_sockets.size() << endl;
+	unlockSockets();
+}
+
+void NetworkSender::removeConnection(SocketListItem* item)
+{
+	if (telemetry && item->state != WAIT_FINISH)
 	{
-		// send file name and size
-		int len = strlen(file_names[i]);
-		if (UDT::ERROR == UDT::send(send_socket, (char*)&len, sizeof(int), 0))
+		telemetry->addRecord("sender", "closed", item->socket(), item->remoteIP(), item->remotePort(), CAtomic::load(item->disk_bytes));
+		telemetry->flush();
+	}
+	
+	lockSockets();
+	send_sockets.erase(item->socket());
+	send_workers[item->worker].connections--;
+	unlockSockets();
+	
+	UDT::epoll_remove_usock(send_workers[item->worker].eid, item->socket());
+	delete item;
+}
+
+void NetworkSender::watchConnection(SocketListItem* item, int events)
+{
+	int eid = send_workers[item->worker].eid;
+	int all_events = UDT_EPOLL_IN | UDT_EPOLL_OUT;
+	
+	UDT::epoll_remove_usock(eid, item->socket(), &all_events);
+	UDT::epoll_add_usock(eid, item->socket(), &events);
+}
+
+bool NetworkSender::processConnection(SocketListItem* item)
+{
+	switch (item->state)
+	{
+		case SEND_HEADER:
+			return sendHeader(item);
+		case WAIT_OFFSET:
+			return receiveOffset(item);
+		case SEND_FILES:
+			return sendFiles(item);
+		case WAIT_FINISH:
+			return receiveFinish(item);
+	}
+	
+	return false;
+}
+
+bool NetworkSender::sendHeader(SocketListItem* item)
+{
+	while (item->buffer_pos < item->buffer_len)
+	{
+		int sent = UDT::send(item->socket(), item->buffer+item->buffer_pos, item->buffer_len-item->buffer_pos, 0);
+		if (UDT::ERROR == sent)
 		{
+			if (UDT::getlasterror().getErrorCode() == UDT::ERRORINFO::EASYNCSND)
+				return true;
+			
 			cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
-			goto end;
+			return false;
 		}
 		
-		if (UDT::ERROR == UDT::send(send_socket, file_names[i], len, 0))
-		{
-			cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
-			goto end;
-		}
+		if (sent == 0)
+			return true;
 		
-		if (UDT::ERROR == UDT::send(send_socket, (char*)&file_sizes[i], sizeof(int64_t), 0))
+		item->buffer_pos += sent;
+	}
+	
+	if (item->resume_offset >= 0)
+	{
+		startFiles(item, item->resume_offset);
+		return true;
+	}
+	
+	// the header buffer is reused to collect the receiver's resume offset
+	item->buffer_pos = 0;
+	item->buffer_len = sizeof(int64_t);
+	item->state = WAIT_OFFSET;
+	watchConnection(item, UDT_EPOLL_IN);
+	
+	return true;
+}
+
+bool NetworkSender::receiveOffset(SocketListItem* item)
+{
+	while (item->buffer_pos < item->buffer_len)
+	{
+		int received = UDT::recv(item->socket(), item->buffer+item->buffer_pos, item->buffer_len-item->buffer_pos, 0);
+		if (UDT::ERROR == received)
 		{
-			cout << "error\tsend\t" << UDT::getlasterror().getErrorMessage() << endl;
-			goto end;
+			if (UDT::getlasterror().getErrorCode() == UDT::ERRORINFO::EASYNCRCV)
+				return true;
+			
+			cout << "error\trecv\t" << UDT::getlasterror().getErrorMessage() << endl;
+			return false;
 		}
+		
+		item->buffer_pos += received;
 	}
 	
 	int64_t transferred;
-	if (UDT::ERROR == UDT::recv(send_socket, (char*)&transferred, sizeof(transferred), 0))
+	memcpy(&transferred, item->buffer, sizeof(int64_t));
+	if (transferred < 0 || transferred > total_size)
 	{
-		cout << "error\trecv\t" << UDT::getlasterror().getErrorMessage() << endl;
-		goto end;
+		cout << "error\tresume\tinvalid offset " << transferred << endl;
+		return false;
 	}
+	startFiles(item, transferred);
 	
+	return true;
+}
+
+void NetworkSender::startFiles(SocketListItem* item, int64_t transferred)
+{
 	int64_t start_at;
 	int64_t size_count;
-	for (start_at=size_count=0; size_count+file_sizes[start_at] <= transferred; start_at++)
+	for (start_at=size_count=0; start_at < file_count && size_count+file_sizes[start_at] <= transferred; start_at++)
 	{
 		size_count += file_sizes[start_at];
 	}
-	int64_t offset;
-	offset = transferred-size_count;
-	int64_t remaining;
-	remaining = file_sizes[start_at]-offset;
+	item->file_index = start_at;
+	item->offset = transferred-size_count;
+	
+	lockSockets();
+	item->start_offset = transferred;
+	unlockSockets();
+	item->remaining = (start_at < file_count) ? file_sizes[start_at]-item->offset : 0;
 	
 	time_t start_time;
 	time(&start_time);
-	(*socket_it)->startTime(start_time);
+	item->startTime(start_time);
 	
-	int64_t total_sent;
-	total_sent = 0;
-	for (int64_t i=start_at; i < file_count; i++)
+	free(item->buffer);
+	item->buffer = (char*)malloc(SEND_CHUNK_SIZE);
+	item->buffer_pos = 0;
+	item->buffer_len = 0;
+	item->state = SEND_FILES;
+	watchConnection(item, UDT_EPOLL_OUT);
+}
+
+bool NetworkSender::sendFiles(SocketListItem* item)
+{
+	// stage a bounded number of chunks per wakeup so one fast receiver cannot starve the rest
+	for (int chunks=0; chunks < 8;)
 	{
-		fstream ifs(file_locations[i], ios::in | ios::binary);
-		
-		if (i != start_at)
+		if (item->buffer_pos == item->buffer_len)
 		{
-			offset = 0;
-			remaining = file_sizes[i];
-		}		
+			while (item->remaining <= 0 && item->file_index < file_count)
+			{
+				if (item->file)
+				{
+					item->file->close();
+					delete item->file;
+					item->file = NULL;
+				}
+				
+				item->file_index++;
+				item->offset = 0;
+				if (item->file_index < file_count)
+					item->remaining = file_sizes[item->file_index];
+			}
+			
+			if (item->file_index >= file_count)
+			{
+				item->state = WAIT_FINISH;
+				watchConnection(item, UDT_EPOLL_IN);
+				return true;
+			}
+			
+			if (item->file == NULL)
+			{
+				item->file = new fstream(file_locations[item->file_index], ios::in | ios::binary);
+				item->file->seekg(item->offset);
+			}
+			
+			int64_t chunk_size = (item->remaining < SEND_CHUNK_SIZE) ? item->remaining : SEND_CHUNK_SIZE;
+			item->file->read(item->buffer, chunk_size);
+			if (item->file->gcount() <= 0)
+			{
+				cout << "error\tsendfile\t" << "Error reading " << file_names[item->file_index] << "." << endl;
+				return false;
+			}
+			
+			item->buffer_pos = 0;
+			item->buffer_len = item->file->gcount();
+			item->offset += item->buffer_len;
+			item->remaining -= item->buffer_len;
+			chunks++;
+			
+			CAtomic::add(item->disk_bytes, item->buffer_len);
+		}
 		
-		// send the actual file
-		int64_t send_size;
-		if (UDT::ERROR == (send_size = UDT::sendfile(send_socket, ifs, offset, remaining)))
+		int sent = UDT::send(item->socket(), item->buffer+item->buffer_pos, item->buffer_len-item->buffer_pos, 0);
+		if (UDT::ERROR == sent)
 		{
+			if (UDT::getlasterror().getErrorCode() == UDT::ERRORINFO::EASYNCSND)
+				return true;
+			
 			cout << "error\tsendfile\t" << UDT::getlasterror().getErrorMessage() << endl;
-			goto end;
+			return false;
 		}
 		
-		total_sent += send_size;
-		ifs.close();
+		if (sent == 0)
+			return true;
+		
+		item->buffer_pos += sent;
+		item->total_sent += sent;
 	}
 	
+	return true;
+}
+
+bool NetworkSender::receiveFinish(SocketListItem* item)
+{
 	time_t end_time;
-	if (UDT::ERROR == UDT::recv(send_socket, (char*)&end_time, sizeof(end_time), 0))
+	if (UDT::ERROR == UDT::recv(item->socket(), (char*)&end_time, sizeof(end_time), 0))
 	{
+		if (UDT::getlasterror().getErrorCode() == UDT::ERRORINFO::EASYNCRCV)
+			return true;
+		
 		time(&end_time);
 	}
 	
-	cout << "finished\t" << send_sockets.size()-1 << "\t" << (*socket_it)->remoteIP() << "\t" << (*socket_it)->remotePort() << "\t" << total_sent << endl;
+	lockSockets();
+	size_t connection_count = send_sockets.size();
+	unlockSockets();
 	
-end:
-	// cleanup
-	send_sockets.erase(socket_it);
+	cout << "finished\t" << connection_count-1 << "\t" << item->remoteIP() << "\t" << item->remotePort() << "\t" << item->total_sent << endl;
 	
-	return;
+	if (telemetry)
+	{
+		telemetry->addRecord("sender", "finished", item->socket(), item->remoteIP(), item->remotePort(), CAtomic::load(item->disk_bytes));
+		telemetry->flush();
+	}
+	
+	return false;
 }
 
 #if defined(__linux__) || defined(__APPLE__)
@@ -470,13 +833,16 @@ void NetworkSender::statusThread()
 		double total_current_speed = 0;
 //		double total_overall_speed = 0;
 		
-		list<SocketListItem*>::iterator socket_it;
-		for (socket_it=send_sockets.begin(); socket_it != send_sockets.end(); socket_it++)
+		vector<UDTSOCKET> sockets = socketList();
+		size_t connection_count = sockets.size();
+		vector<UDTSOCKET>::iterator socket_it;
+		for (socket_it=sockets.begin(); socket_it != sockets.end(); socket_it++)
 		{
-			UDTSOCKET send_socket = (*socket_it)->socket();
+			UDTSOCKET send_socket = *socket_it;
 //			time_t starttime = (*socket_it)->startTime();
 			time(&curtime);
-			UDT::perfmon(send_socket, &trace);
+			if (UDT::ERROR == UDT::perfmon(send_socket, &trace))
+				continue;
 			
 			total_current_speed += trace.mbpsSendRate/8;
 			//total_overall_speed += ((double)(trace.pktSentTotal-trace.pktRetransTotal)*1476)/(1024*1024*(double)(curtime-starttime));
@@ -484,7 +850,7 @@ void NetworkSender::statusThread()
 		
 		//double guesstimated_speed = (total_current_speed+(total_overall_speed*2))/3;
 		//cout << "status\t" << send_sockets.size() << "\t" << total_current_speed << "\t" << total_overall_speed << "\t" << guesstimated_speed << endl;
-		cout << "status\t" << send_sockets.size() << "\t" << total_current_speed << "\t" << endl;
+		cout << "status\t" << connection_count << "\t" << total_current_speed << "\t" << endl;
 
 #if defined(__linux__) || defined(__APPLE__)
 		usleep(millisecondsToSleep*1000);
@@ -496,6 +862,112 @@ void NetworkSender::statusThread()
 	}
 }
 
+#if defined(__linux__) || defined(__APPLE__)
+void* NetworkSender::startTelemetryThread(void* obj)
+#elif defined(WIN32)
+DWORD WINAPI NetworkSender::startTelemetryThread(LPVOID obj)
+#else
+#error Not implemented on this platform
+#endif
+{
+	reinterpret_cast<NetworkSender *>(obj)->telemetryThread();
+	return NULL;
+}
+
+void NetworkSender::telemetryThread()
+{
+	while (!send_finished && telemetry->enabled())
+	{
+		// perfmon on every socket would hold up the workers, so only the list is taken under the lock
+		vector<ConnectionSample> samples;
+		lockSockets();
+		samples.reserve(send_sockets.size());
+		map<UDTSOCKET, SocketListItem*>::iterator socket_it;
+		for (socket_it=send_sockets.begin(); socket_it != send_sockets.end(); socket_it++)
+		{
+			SocketListItem* item = socket_it->second;
+			ConnectionSample sample;
+			sample.socket = item->socket();
+			sample.ip = item->remoteIP();
+			sample.port = item->remotePort();
+			sample.disk_bytes = CAtomic::load(item->disk_bytes);
+			samples.push_back(sample);
+		}
+		unlockSockets();
+		
+		vector<ConnectionSample>::iterator sample_it;
+		for (sample_it=samples.begin(); sample_it != samples.end(); sample_it++)
+			telemetry->addRecord("sender", "sample", sample_it->socket, sample_it->ip.c_str(), sample_it->port.c_str(), sample_it->disk_bytes);
+		
+		telemetry->flush();
+
+#if defined(__linux__) || defined(__APPLE__)
+		usleep(telemetry->interval()*1000);
+#elif defined(WIN32)
+		Sleep(telemetry->interval());
+#else
+#error Not implemented on this platform
+#endif
+	}
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+void* NetworkSender::startMetricsThread(void* obj)
+#elif defined(WIN32)
+DWORD WINAPI NetworkSender::startMetricsThread(LPVOID obj)
+#else
+#error Not implemented on this platform
+#endif
+{
+	reinterpret_cast<NetworkSender *>(obj)->metricsThread();
+	return NULL;
+}
+
+void NetworkSender::metricsThread()
+{
+	while (!send_finished)
+	{
+		metrics->beginSnapshot();
+		
+		// perfstats on every socket would hold up the workers, so only the list is taken under the lock
+		vector<ConnectionSample> samples;
+		int64_t bytes_remaining = 0;
+		lockSockets();
+		samples.reserve(send_sockets.size());
+		map<UDTSOCKET, SocketListItem*>::iterator socket_it;
+		for (socket_it=send_sockets.begin(); socket_it != send_sockets.end(); socket_it++)
+		{
+			SocketListItem* item = socket_it->second;
+			ConnectionSample sample;
+			sample.socket = item->socket();
+			sample.ip = item->remoteIP();
+			sample.port = item->remotePort();
+			sample.disk_bytes = CAtomic::load(item->disk_bytes);
+			samples.push_back(sample);
+			bytes_remaining += total_size-item->start_offset-sample.disk_bytes;
+		}
+		unlockSockets();
+		size_t connection_count = samples.size();
+		
+		vector<ConnectionSample>::iterator sample_it;
+		for (sample_it=samples.begin(); sample_it != samples.end(); sample_it++)
+			metrics->addConnection("sender", sample_it->socket, sample_it->ip.c_str(), sample_it->port.c_str(), sample_it->disk_bytes);
+		
+		metrics->addGauge("networkhelper_active_receivers", "Receivers currently connected.", (double)connection_count);
+		metrics->addGauge("networkhelper_send_rate_mbps", "Aggregate send rate of all connections.", metrics->sendRate());
+		metrics->addGauge("networkhelper_bytes_remaining", "Bytes still to be read from disk for all connections.", (double)bytes_remaining);
+		metrics->publishSnapshot();
+
+#if defined(__linux__) || defined(__APPLE__)
+		usleep(METRICS_INTERVAL*1000);
+#elif defined(WIN32)
+		Sleep(METRICS_INTERVAL);
+#else
+#error Not implemented on this platform
+#endif
+	}
+}
+
 #if defined(__linux__) || defined(__APPLE__)
 void* NetworkSender::startInputThread(void* obj)
 #elif defined(WIN32)
@@ -545,36 +1017,173 @@ void NetworkSender::processCommand(char* command, size_t len)
 		int64_t new_speed = atoi(strtok(NULL, "\t"));
 		setMaxSpeed(new_speed);
 	}
+	else if (strncmp(command_split, "telemetry_interval", 18) == 0)
+	{
+		if (telemetry)
+			telemetry->setInterval(atoi(strtok(NULL, "\t")));
+	}
+	else if (strncmp(command_split, "trace_dump", 10) == 0)
+	{
+		dumpTrace(strtok(NULL, "\t"));
+	}
+	else if (strncmp(command_split, "trace", 5) == 0)
+	{
+		setTrace(atoi(strtok(NULL, "\t")) != 0);
+	}
+	else if (strncmp(command_split, "cc", 2) == 0)
+	{
+		char* name = strtok(NULL, "\t");
+		if (name && setCongestionControl(name))
+			cout << "cc\t" << name << endl;
+	}
 	else if (strncmp(command_split, "stop", 4) == 0)
 	{
 		send_finished = true;
+		lockSockets();
 		send_sockets.clear();
+		unlockSockets();
 		exit(0);
 	}
 }
 
+bool NetworkSender::setCongestionControl(const char* name)
+{
+	CCCVirtualFactory* factory = createCCFactory(name);
+	if (factory == NULL)
+	{
+		cout << "error\tcc\tunknown congestion control " << name << endl;
+		return false;
+	}
+	
+	lockSockets();
+	delete cc_factory;
+	cc_factory = factory;
+	
+	// running connections swap controllers in place and keep their max_speed share,
+	// the listening socket hands the new one to connections accepted from now on
+	map<UDTSOCKET, SocketListItem*>::iterator socket_it;
+	for (socket_it=send_sockets.begin(); socket_it != send_sockets.end(); socket_it++)
+	{
+		UDT::setsockopt(socket_it->first, 0, UDT_CC, cc_factory, sizeof(CCCVirtualFactory));
+	}
+	if (listen_socket != UDT::INVALID_SOCK)
+		UDT::setsockopt(listen_socket, 0, UDT_CC, cc_factory, sizeof(CCCVirtualFactory));
+	unlockSockets();
+	
+	return true;
+}
+
+void NetworkSender::setFEC(bool enabled)
+{
+	// takes effect for the listening socket, connections inherit it when they are accepted
+	fec_enabled = enabled;
+}
+
+void NetworkSender::setMaxPacketSize(int size)
+{
+	// takes effect for the listening socket like the parity packets
+	max_packet = size;
+}
+
+void NetworkSender::setPacketSize(UDTSOCKET socket)
+{
+	// before the buffer sizes, which the library counts in packets of the largest size
+	if (max_packet > 0)
+	{
+		// connections start at 1500 bytes and probe for larger packets up to the given size
+		bool pmtud = true;
+		UDT::setsockopt(socket, 0, UDT_MSS, &max_packet, sizeof(int));
+		UDT::setsockopt(socket, 0, UDT_PMTUD, &pmtud, sizeof(bool));
+	}
+#ifdef WIN32
+	else
+	{
+		int mss = 1052;
+		UDT::setsockopt(socket, 0, UDT_MSS, &mss, sizeof(int));
+	}
+#endif
+}
+
+bool NetworkSender::setPaths(const char* addresses)
+{
+	// comma separated local IPv4 addresses, the port of each path is picked by the system
+	char* address_list = strdup(addresses);
+	bool valid = true;
+	for (char* address = strtok(address_list, ","); address != NULL; address = strtok(NULL, ","))
+	{
+		sockaddr_in path_addr;
+		memset(&path_addr, 0, sizeof(path_addr));
+		path_addr.sin_family = AF_INET;
+		path_addr.sin_port = 0;
+		path_addr.sin_addr.s_addr = inet_addr(address);
+		if (INADDR_NONE == path_addr.sin_addr.s_addr)
+		{
+			cout << "error	path	" << address << endl;
+			valid = false;
+			break;
+		}
+		path_addresses.push_back(path_addr);
+	}
+	free(address_list);
+	
+	return valid;
+}
+
+void NetworkSender::setTrace(bool enabled)
+{
+	trace_enabled = enabled;
+	
+	vector<UDTSOCKET> sockets = socketList();
+	vector<UDTSOCKET>::iterator socket_it;
+	for (socket_it=sockets.begin(); socket_it != sockets.end(); socket_it++)
+	{
+		UDT::setsockopt(*socket_it, 0, UDT_TRACE, &enabled, sizeof(bool));
+	}
+}
+
+void NetworkSender::dumpTrace(const char* directory)
+{
+	if (directory == NULL)
+		return;
+	
+	// the files are written after the lock is dropped, a slow disk must not hold up the transfer
+	vector<UDTSOCKET> sockets = socketList();
+	vector<UDTSOCKET>::iterator socket_it;
+	for (socket_it=sockets.begin(); socket_it != sockets.end(); socket_it++)
+	{
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/trace_%d.udtt", directory, (int)*socket_it);
+		if (UDT::ERROR == UDT::tracedump(*socket_it, path))
+			cout << "error\ttracedump\t" << UDT::getlasterror().getErrorMessage() << endl;
+		else
+			cout << "tracedump\t" << path << endl;
+	}
+}
+
 void NetworkSender::setMaxSpeed(int64_t new_speed)
 {
 	max_speed = new_speed;
-	if (send_sockets.size() > 1)
+	
+	vector<UDTSOCKET> sockets = socketList();
+	if (sockets.size() > 1)
 	{
 		int64_t speed;
 		if (new_speed > 0)
 		{
-			speed = new_speed/send_sockets.size();
+			speed = new_speed/sockets.size();
 		}
 		else
 		{
 			speed = -1;
 		}
 		
-		list<SocketListItem*>::iterator socket_it;
-		for (socket_it=send_sockets.begin(); socket_it != send_sockets.end(); socket_it++)
+		vector<UDTSOCKET>::iterator socket_it;
+		for (socket_it=sockets.begin(); socket_it != sockets.end(); socket_it++)
 		{
-			ZUDTCC* cchandle = NULL;
+			ZCC* cchandle = NULL;
 			int size;
-			UDT::getsockopt((*socket_it)->socket(), 0, UDT_CC, &cchandle, &size);
-			cchandle->setBW(speed);
+			if (UDT::ERROR != UDT::getsockopt(*socket_it, 0, UDT_CC, &cchandle, &size) && cchandle != NULL)
+				cchandle->setBW(speed);
 		}		
 	}
 }
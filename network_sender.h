@@ -13,27 +13,82 @@
 #include <udt.h>
 #include <ccc.h>
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 #include "socket_list_item.h"
+#include "telemetry.h"
+#include "metrics_exporter.h"
+#include "resume_ticket.h"
+
+// number of threads serving accepted connections, independent of the receiver count
+#define SEND_WORKER_COUNT 4
+// size of the file chunk each connection stages for a non-blocking send
+#define SEND_CHUNK_SIZE 364000
 
 using namespace std;
 
+class NetworkSender;
+
+// what the telemetry and metrics threads copy out of a connection, so that sampling runs without the socket lock
+struct ConnectionSample
+{
+	UDTSOCKET socket;
+	string ip;
+	string port;
+	int64_t disk_bytes;
+};
+
+struct SendWorker
+{
+	NetworkSender* sender;
+	int index;
+	int eid;
+	int connections;
+};
+
 class NetworkSender
 {
 public:
 	NetworkSender(int port, int64_t speed, int count, const char** file_array);
+	void setTelemetry(Telemetry* new_telemetry);
+	void setMetrics(MetricsExporter* new_metrics);
+	bool setCongestionControl(const char* name);
+	void setFEC(bool enabled);
+	void setMaxPacketSize(int size);
+	bool setPaths(const char* addresses);
 	int startSend();
 	
 private:
-	list<SocketListItem*> send_sockets;
+	// connection registry, every access goes through send_sockets_lock
+	map<UDTSOCKET, SocketListItem*> send_sockets;
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_t send_sockets_lock;
+#elif defined(WIN32)
+	HANDLE send_sockets_lock;
+#else
+#error Not implemented on this platform
+#endif
+	SendWorker send_workers[SEND_WORKER_COUNT];
 	int listen_port;
 	UDTSOCKET listen_socket;
+	CCCVirtualFactory* cc_factory;
 	int64_t max_speed;
 	int file_count;
 	const char** file_locations;
 	char** file_names;
 	int64_t* file_sizes;
 	int64_t total_size;
+	char* manifest;
+	int manifest_len;
+	uint64_t manifest_hash;
 	bool send_finished;
+	Telemetry* telemetry;
+	MetricsExporter* metrics;
+	bool trace_enabled;
+	bool fec_enabled;
+	int max_packet;
+	list<sockaddr_in> path_addresses;
 
 #if defined(__linux__) || defined(__APPLE__)
 	static void* startSendThread(void* obj);
@@ -42,7 +97,19 @@ private:
 #else
 #error Not implemented on this platform
 #endif
-	void sendThread();
+	void sendThread(SendWorker* worker);
+	void lockSockets();
+	void unlockSockets();
+	vector<UDTSOCKET> socketList();
+	void addConnection(SocketListItem* item);
+	void removeConnection(SocketListItem* item);
+	void watchConnection(SocketListItem* item, int events);
+	bool processConnection(SocketListItem* item);
+	bool sendHeader(SocketListItem* item);
+	bool receiveOffset(SocketListItem* item);
+	void startFiles(SocketListItem* item, int64_t transferred);
+	bool sendFiles(SocketListItem* item);
+	bool receiveFinish(SocketListItem* item);
 #if defined(__linux__) || defined(__APPLE__)
 	static void* startStatusThread(void* obj);
 #elif defined(WIN32)
@@ -51,6 +118,22 @@ private:
 #error Not implemented on this platform
 #endif
 	void statusThread();
+#if defined(__linux__) || defined(__APPLE__)
+	static void* startTelemetryThread(void* obj);
+#elif defined(WIN32)
+	static DWORD WINAPI startTelemetryThread(LPVOID obj);
+#else
+#error Not implemented on this platform
+#endif
+	void telemetryThread();
+#if defined(__linux__) || defined(__APPLE__)
+	static void* startMetricsThread(void* obj);
+#elif defined(WIN32)
+	static DWORD WINAPI startMetricsThread(LPVOID obj);
+#else
+#error Not implemented on this platform
+#endif
+	void metricsThread();
 #if defined(__linux__) || defined(__APPLE__)
 	static void* startInputThread(void* obj);
 #elif defined(WIN32)
@@ -61,6 +144,9 @@ private:
 	void inputThread();
 	void processCommand(char* command, size_t len);
 	void setMaxSpeed(int64_t new_speed);
+	void setTrace(bool enabled);
+	void dumpTrace(const char* directory);
+	void setPacketSize(UDTSOCKET socket);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,641 @@
+/*
+ *  network_stream.cpp
+ *  NetworkHelper
+ *
+ *  Live streaming mode: the sender frames a pipe or stdin into UDT messages
+ *  that carry a deadline, stale messages are dropped instead of retransmitted,
+ *  and the receiver reports the one-way latency of what it delivers.
+ *
+ */
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/time.h>
+#include <unistd.h>
+#elif defined(WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <io.h>
+#include <fcntl.h>
+
+#ifndef STDIN_FILENO
+#define STDIN_FILENO 0
+#define STDOUT_FILENO 1
+#define STDERR_FILENO 2
+#endif
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "holepoke/network.h"
+#include "holepoke/sender.h"
+#include "holepoke/receiver.h"
+#include "network_stream.h"
+
+#include "hole_poke_delegate.h"
+
+using namespace std;
+
+// wall clock in microseconds, the two ends only share it as far as their clocks agree
+static int64_t wallclock()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec*1000000 + tv.tv_usec;
+#elif defined(WIN32)
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	return ((((int64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime) - 116444736000000000LL)/10;
+#else
+#error Not implemented on this platform
+#endif
+}
+
+static int openFile(const char* path, bool output)
+{
+#if defined(__linux__) || defined(__APPLE__)
+	return output ? open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644) : open(path, O_RDONLY);
+#elif defined(WIN32)
+	return output ? _open(path, _O_WRONLY|_O_CREAT|_O_TRUNC|_O_BINARY, _S_IREAD|_S_IWRITE) : _open(path, _O_RDONLY|_O_BINARY);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+static int readFile(int fd, char* data, int len)
+{
+#if defined(__linux__) || defined(__APPLE__)
+	return read(fd, data, len);
+#elif defined(WIN32)
+	return _read(fd, data, len);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+static int writeFile(int fd, const char* data, int len)
+{
+#if defined(__linux__) || defined(__APPLE__)
+	return write(fd, data, len);
+#elif defined(WIN32)
+	return _write(fd, data, len);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+static void closeFile(int fd)
+{
+#if defined(__linux__) || defined(__APPLE__)
+	close(fd);
+#elif defined(WIN32)
+	_close(fd);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+static void sleepms(int ms)
+{
+#if defined(__linux__) || defined(__APPLE__)
+	usleep(ms*1000);
+#elif defined(WIN32)
+	Sleep(ms);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::add(int64_t latency)
+{
+	if (latency < 0)
+		latency = 0;
+
+	int64_t bucket;
+	if (latency < FINE_BUCKETS*100)
+		bucket = latency/100;
+	else if (latency < 1000000 + COARSE_BUCKETS*10000LL)
+		bucket = FINE_BUCKETS + (latency-1000000)/10000;
+	else
+		bucket = FINE_BUCKETS+COARSE_BUCKETS;
+
+	buckets[bucket]++;
+	samples++;
+	if (latency > largest)
+		largest = latency;
+}
+
+void LatencyHistogram::reset()
+{
+	memset(buckets, 0, sizeof(buckets));
+	samples = 0;
+	largest = 0;
+}
+
+int64_t LatencyHistogram::count()
+{
+	return samples;
+}
+
+int64_t LatencyHistogram::maximum()
+{
+	return largest;
+}
+
+int64_t LatencyHistogram::percentile(double fraction)
+{
+	if (samples == 0)
+		return 0;
+
+	int64_t rank = (int64_t)(fraction*samples);
+	if (rank >= samples)
+		rank = samples-1;
+
+	int64_t seen = 0;
+	for (int i=0; i < FINE_BUCKETS+COARSE_BUCKETS; i++)
+	{
+		seen += buckets[i];
+		if (seen > rank)
+		{
+			int64_t bound = (i < FINE_BUCKETS) ? (int64_t)(i+1)*100 : 1000000 + (int64_t)(i-FINE_BUCKETS+1)*10000;
+			return (bound < largest) ? bound : largest;
+		}
+	}
+
+	return largest;
+}
+
+StreamSender::StreamSender(int port, int ttl, const char* source, int message_size)
+{
+	UDT::startup();
+
+	listen_port = port;
+	message_ttl = ttl;
+	source_path = string(source);
+	max_message = (message_size > 0 && message_size <= STREAM_MAX_MESSAGE) ? message_size : STREAM_DEFAULT_MESSAGE;
+	send_socket = UDT::INVALID_SOCK;
+	send_finished = false;
+	messages = 0;
+	bytes = 0;
+	expired = 0;
+}
+
+int StreamSender::startSend()
+{
+	int source_fd = STDIN_FILENO;
+	if (source_path != "-" && (source_fd = openFile(source_path.c_str(), false)) < 0)
+	{
+		cout << "error\topen\t" << "Could not open " << source_path << "." << endl;
+		return 1;
+	}
+
+	send_socket = acceptReceiver();
+	if (send_socket == UDT::INVALID_SOCK)
+		return 1;
+
+	// a message that cannot be queued within its deadline is dropped here, before it costs bandwidth
+	UDT::setsockopt(send_socket, 0, UDT_SNDTIMEO, &message_ttl, sizeof(int));
+
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_t statusthread;
+	pthread_create(&statusthread, NULL, &this->startStatusThread, this);
+	pthread_detach(statusthread);
+#elif defined(WIN32)
+	HANDLE statusthread;
+	statusthread = CreateThread(NULL, 0, &StreamSender::startStatusThread, this, 0, NULL);
+#endif
+
+	// whatever one read returns goes out as one message, so a writer that flushes per record gets a message per record
+	char* message = (char*)malloc(STREAM_HEADER_SIZE + max_message);
+	uint32_t sequence = 0;
+	int result = 0;
+	while (true)
+	{
+		int len = readFile(source_fd, message+STREAM_HEADER_SIZE, max_message);
+		if (len < 0)
+		{
+			cout << "error\tread\t" << "Could not read " << source_path << "." << endl;
+			result = 1;
+			len = 0;
+		}
+
+		uint32_t flags = (len == 0) ? STREAM_FLAG_END : 0;
+		int64_t timestamp = wallclock();
+		memcpy(message, &sequence, sizeof(uint32_t));
+		memcpy(message+4, &flags, sizeof(uint32_t));
+		memcpy(message+8, &timestamp, sizeof(int64_t));
+		sequence++;
+
+		// the end of the stream is not subject to the deadline, the receiver would wait for it otherwise;
+		// the send timeout would still give up on it while the buffer is full
+		if (flags & STREAM_FLAG_END)
+		{
+			int forever = -1;
+			UDT::setsockopt(send_socket, 0, UDT_SNDTIMEO, &forever, sizeof(int));
+		}
+
+		int sent = UDT::sendmsg(send_socket, message, STREAM_HEADER_SIZE+len, (flags & STREAM_FLAG_END) ? -1 : message_ttl, true);
+		if (UDT::ERROR == sent)
+		{
+			cout << "error\tsendmsg\t" << UDT::getlasterror().getErrorMessage() << endl;
+			result = 1;
+			break;
+		}
+
+		if (sent == 0)
+			expired++;
+		else
+		{
+			messages++;
+			bytes += len;
+		}
+
+		if (flags & STREAM_FLAG_END)
+			break;
+	}
+	free(message);
+
+	if (source_fd != STDIN_FILENO)
+		closeFile(source_fd);
+
+	send_finished = true;
+	cout << "finished\t" << messages << "\t" << bytes << "\t" << expired << endl;
+
+	// closing lingers until the end message and the messages before it are delivered or expired
+	UDT::close(send_socket);
+	UDT::cleanup();
+	return result;
+}
+
+UDTSOCKET StreamSender::acceptReceiver()
+{
+	UDTSOCKET listen_socket = UDT::socket(AF_INET, SOCK_DGRAM, 0);
+#ifdef WIN32
+	int mss = 1052;
+	UDT::setsockopt(listen_socket, 0, UDT_MSS, &mss, sizeof(int));
+#endif
+
+	if (listen_port == 0)
+	{
+		const char* holepokeIPAddressString = "50.16.103.211";
+		const char* holepokePortString = "3333";
+
+		struct sockaddr_storage saddrHolepokeStorage;
+		socklen_t saddrHolepokeLen = sizeof(saddrHolepokeStorage);
+		struct sockaddr* saddrHolepoke = (struct sockaddr*)&saddrHolepokeStorage;
+
+		if ( !network::MakeSocketAddress(holepokeIPAddressString, holepokePortString, saddrHolepoke, &saddrHolepokeLen) )
+		{
+			cout << "error\tMakeSocketAddress\tError making socket address for peer." << endl;
+			return UDT::INVALID_SOCK;
+		}
+
+		senderDelegate sender_delegate;
+		holepoke::Sender sender(saddrHolepoke, saddrHolepokeLen);
+		sender.setDelegate(&sender_delegate);
+
+		cout << "listening" << endl;
+		sender.connectToReceiver();
+
+		int udp_socket = sender.takeSocket();
+		if (udp_socket < 0 || sender.isConnected() == false)
+		{
+			cout << "error\tconnectToReceiver\t" << "Could not connect to receiver." << endl;
+			return UDT::INVALID_SOCK;
+		}
+
+		if (UDT::ERROR == UDT::bind(listen_socket, udp_socket))
+		{
+			cout << "error\tbind\t" << UDT::getlasterror().getErrorMessage() << endl;
+			return UDT::INVALID_SOCK;
+		}
+	}
+	else
+	{
+		sockaddr_in my_addr;
+		my_addr.sin_family = AF_INET;
+		my_addr.sin_port = htons(listen_port);
+		my_addr.sin_addr.s_addr = INADDR_ANY;
+		memset(&(my_addr.sin_zero), '\0', 8);
+
+		if (UDT::ERROR == UDT::bind(listen_socket, (sockaddr*)&my_addr, sizeof(my_addr)))
+		{
+			cout << "error\tbind\t" << UDT::getlasterror().getErrorMessage() << endl;
+			return UDT::INVALID_SOCK;
+		}
+
+		cout << "listening" << endl;
+	}
+
+	if (UDT::ERROR == UDT::listen(listen_socket, 1))
+	{
+		cout << "error\tlisten\t" << UDT::getlasterror().getErrorMessage() << endl;
+		return UDT::INVALID_SOCK;
+	}
+
+	sockaddr_storage clientaddr;
+	int addrlen = sizeof(clientaddr);
+	UDTSOCKET accepted = UDT::accept(listen_socket, (sockaddr*)&clientaddr, &addrlen);
+	if (accepted == UDT::INVALID_SOCK)
+	{
+		cout << "error\taccept\t" << UDT::getlasterror().getErrorMessage() << endl;
+		return UDT::INVALID_SOCK;
+	}
+
+	// a live stream has a single receiver
+	UDT::close(listen_socket);
+
+	char remote_ip[NI_MAXHOST];
+	char remote_port[NI_MAXSERV];
+	getnameinfo((sockaddr*)&clientaddr, addrlen, remote_ip, NI_MAXHOST, remote_port, NI_MAXSERV, NI_NUMERICHOST|NI_NUMERICSERV);
+	cout << "starting\t" << remote_ip << "\t" << remote_port << endl;
+
+	return accepted;
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+void* StreamSender::startStatusThread(void* obj)
+#elif defined(WIN32)
+DWORD WINAPI StreamSender::startStatusThread(LPVOID obj)
+#else
+#error Not implemented on this platform
+#endif
+{
+	reinterpret_cast<StreamSender *>(obj)->statusThread();
+	return NULL;
+}
+
+void StreamSender::statusThread()
+{
+	UDT::TRACEINFO trace;
+	while (!send_finished)
+	{
+		sleepms(1000);
+		if (send_finished || UDT::ERROR == UDT::perfmon(send_socket, &trace))
+			break;
+
+		cout << "streaming\t" << messages << "\t" << bytes << "\t" << expired << "\t" << trace.msRTT;
+		cout << "\t" << trace.pktSndLossTotal << "\t" << trace.pktRetransTotal << endl;
+	}
+}
+
+StreamReceiver::StreamReceiver(char* id, int port, int ttl, const char* destination)
+{
+	UDT::startup();
+
+	peer_id = string(id);
+	peer_port = port;
+	message_ttl = ttl;
+	destination_path = string(destination);
+	recv_socket = UDT::INVALID_SOCK;
+	recv_finished = false;
+	status = (destination_path == "-") ? &cerr : &cout;
+	received = 0;
+	lost = 0;
+	late = 0;
+	base_delay = 0;
+	rtt = 0;
+
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_init(&stats_lock, NULL);
+#elif defined(WIN32)
+	stats_lock = CreateMutex(NULL, false, NULL);
+#endif
+}
+
+int StreamReceiver::startReceive()
+{
+	int destination_fd = STDOUT_FILENO;
+	if (destination_path != "-" && (destination_fd = openFile(destination_path.c_str(), true)) < 0)
+	{
+		*status << "error\topen\t" << "Could not open " << destination_path << "." << endl;
+		return 1;
+	}
+
+	if (!connectSender())
+		return 1;
+
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_t statusthread;
+	pthread_create(&statusthread, NULL, &this->startStatusThread, this);
+	pthread_detach(statusthread);
+#elif defined(WIN32)
+	HANDLE statusthread;
+	statusthread = CreateThread(NULL, 0, &StreamReceiver::startStatusThread, this, 0, NULL);
+#endif
+
+	char* message = (char*)malloc(STREAM_HEADER_SIZE + STREAM_MAX_MESSAGE);
+	uint32_t expected = 0;
+	bool have_base = false;
+	int result = 0;
+	while (true)
+	{
+		int len = UDT::recvmsg(recv_socket, message, STREAM_HEADER_SIZE + STREAM_MAX_MESSAGE);
+		if (UDT::ERROR == len)
+		{
+			*status << "error\trecvmsg\t" << UDT::getlasterror().getErrorMessage() << endl;
+			result = 1;
+			break;
+		}
+		if (len < STREAM_HEADER_SIZE)
+			continue;
+
+		uint32_t sequence;
+		uint32_t flags;
+		int64_t timestamp;
+		memcpy(&sequence, message, sizeof(uint32_t));
+		memcpy(&flags, message+4, sizeof(uint32_t));
+		memcpy(&timestamp, message+8, sizeof(int64_t));
+
+		// the clocks of the two hosts are not synchronized: the smallest difference seen stands for the offset
+		// between them plus the one-way delay of an empty path, which is taken as half the round trip time
+		int64_t delay = wallclock()-timestamp;
+		lockStats();
+		if (!have_base || delay < base_delay)
+		{
+			base_delay = delay;
+			have_base = true;
+		}
+		int64_t latency = delay - base_delay + (int64_t)(rtt*500);
+
+		// messages are delivered in order, a gap is what the sender dropped at its deadline or never queued
+		if ((int32_t)(sequence-expected) > 0)
+			lost += (uint32_t)(sequence-expected);
+		expected = sequence+1;
+
+		bool on_time = (message_ttl < 0) || (latency <= (int64_t)message_ttl*1000);
+		if (on_time)
+		{
+			received++;
+			interval_latency.add(latency);
+			total_latency.add(latency);
+		}
+		else
+			late++;
+		unlockStats();
+
+		if (flags & STREAM_FLAG_END)
+			break;
+
+		// a message past its deadline is of no use to a live consumer, it is counted but not written
+		if (on_time && len > STREAM_HEADER_SIZE && writeFile(destination_fd, message+STREAM_HEADER_SIZE, len-STREAM_HEADER_SIZE) < 0)
+		{
+			*status << "error\twrite\t" << "Could not write " << destination_path << "." << endl;
+			result = 1;
+			break;
+		}
+	}
+	free(message);
+
+	recv_finished = true;
+	if (destination_fd != STDOUT_FILENO)
+		closeFile(destination_fd);
+
+	lockStats();
+	printLatency("finished", &total_latency);
+	unlockStats();
+
+	UDT::close(recv_socket);
+	UDT::cleanup();
+	return result;
+}
+
+bool StreamReceiver::connectSender()
+{
+	recv_socket = UDT::socket(AF_INET, SOCK_DGRAM, 0);
+#ifdef WIN32
+	int mss = 1052;
+	UDT::setsockopt(recv_socket, 0, UDT_MSS, &mss, sizeof(int));
+#endif
+
+	if (peer_port == 0)
+	{
+		const char* holepokeIPAddressString = "50.16.103.211";
+		const char* holepokePortString = "3333";
+
+		struct sockaddr_storage saddrHolepokeStorage;
+		socklen_t saddrHolepokeLen = sizeof(saddrHolepokeStorage);
+		struct sockaddr* saddrHolepoke = (struct sockaddr*)&saddrHolepokeStorage;
+
+		if ( !network::MakeSocketAddress(holepokeIPAddressString, holepokePortString, saddrHolepoke, &saddrHolepokeLen) )
+		{
+			*status << "error\tMakeSocketAddress\tError making socket address for peer." << endl;
+			return false;
+		}
+
+		receiverDelegate receiver_delegate;
+		holepoke::Receiver receiver(saddrHolepoke, saddrHolepokeLen);
+		receiver.setDelegate(&receiver_delegate);
+		receiver.connectToSender(peer_id);
+
+		int udp_socket = receiver.takeSocket();
+		if (udp_socket < 0 || receiver.isConnected() == false)
+		{
+			*status << "error\tconnectToSender\t" << "Could not connect to sender." << endl;
+			return false;
+		}
+
+		if (UDT::ERROR == UDT::bind(recv_socket, udp_socket))
+		{
+			*status << "error\tbind\t" << UDT::getlasterror().getErrorMessage() << endl;
+			return false;
+		}
+
+		struct sockaddr_storage peer_addr_storage;
+		struct sockaddr* peer_addr = (struct sockaddr*)&peer_addr_storage;
+		socklen_t addr_len = sizeof(peer_addr_storage);
+		receiver.getPeerAddress(peer_addr, &addr_len);
+
+		if (UDT::ERROR == UDT::connect(recv_socket, peer_addr, addr_len))
+		{
+			*status << "error\tconnect\t" << UDT::getlasterror().getErrorMessage() << endl;
+			return false;
+		}
+	}
+	else
+	{
+		sockaddr_in peer_addr_in;
+		peer_addr_in.sin_family = AF_INET;
+		peer_addr_in.sin_port = htons(peer_port);
+		inet_pton(AF_INET, peer_id.c_str(), &peer_addr_in.sin_addr);
+		memset(&(peer_addr_in.sin_zero), '\0', 8);
+
+		if (UDT::ERROR == UDT::connect(recv_socket, (sockaddr*)&peer_addr_in, sizeof(peer_addr_in)))
+		{
+			*status << "error\tconnect\t" << UDT::getlasterror().getErrorMessage() << endl;
+			return false;
+		}
+	}
+
+	*status << "starting\t" << peer_id << "\t" << peer_port << endl;
+	return true;
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+void* StreamReceiver::startStatusThread(void* obj)
+#elif defined(WIN32)
+DWORD WINAPI StreamReceiver::startStatusThread(LPVOID obj)
+#else
+#error Not implemented on this platform
+#endif
+{
+	reinterpret_cast<StreamReceiver *>(obj)->statusThread();
+	return NULL;
+}
+
+void StreamReceiver::statusThread()
+{
+	UDT::TRACEINFO trace;
+	while (!recv_finished)
+	{
+		sleepms(1000);
+		if (recv_finished || UDT::ERROR == UDT::perfmon(recv_socket, &trace))
+			break;
+
+		lockStats();
+		rtt = trace.msRTT;
+		printLatency("latency", &interval_latency);
+		interval_latency.reset();
+		unlockStats();
+	}
+}
+
+void StreamReceiver::lockStats()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_lock(&stats_lock);
+#elif defined(WIN32)
+	WaitForSingleObject(stats_lock, INFINITE);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+void StreamReceiver::unlockStats()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_unlock(&stats_lock);
+#elif defined(WIN32)
+	ReleaseMutex(stats_lock);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+void StreamReceiver::printLatency(const char* label, LatencyHistogram* histogram)
+{
+	// counts are totals, the percentiles cover the messages delivered on time in the histogram, in milliseconds
+	*status << label << "\t" << received << "\t" << lost << "\t" << late << "\t" << histogram->count();
+	*status << "\t" << histogram->percentile(0.5)/1000.0 << "\t" << histogram->percentile(0.9)/1000.0;
+	*status << "\t" << histogram->percentile(0.99)/1000.0 << "\t" << histogram->maximum()/1000.0 << endl;
+}
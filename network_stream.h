@@ -0,0 +1,118 @@
+/*
+ *  network_stream.h
+ *  NetworkHelper
+ *
+ *  Live streaming mode: the sender frames a pipe or stdin into UDT messages
+ *  that carry a deadline, stale messages are dropped instead of retransmitted,
+ *  and the receiver reports the one-way latency of what it delivers.
+ *
+ */
+
+#ifndef NETSTREAM
+#define NETSTREAM
+
+#include <udt.h>
+#include <iostream>
+#include <string>
+
+// every message starts with its sequence number, flags and the sender's clock at framing time
+#define STREAM_HEADER_SIZE 16
+// set on the message that ends the stream
+#define STREAM_FLAG_END 1
+// payload of a message unless asked otherwise, small enough for one packet at the default MSS
+#define STREAM_DEFAULT_MESSAGE 1400
+// largest payload the receiver accepts
+#define STREAM_MAX_MESSAGE (64*1024-STREAM_HEADER_SIZE)
+
+// latency distribution in fixed buckets: 100us up to one second, 10ms up to a minute, then one overflow bucket
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+	void add(int64_t latency);
+	void reset();
+	int64_t count();
+	int64_t maximum();
+	// upper bound of the bucket holding the given fraction of the samples, in microseconds
+	int64_t percentile(double fraction);
+
+private:
+	enum { FINE_BUCKETS = 10000, COARSE_BUCKETS = 5900 };
+	int64_t buckets[FINE_BUCKETS+COARSE_BUCKETS+1];
+	int64_t samples;
+	int64_t largest;
+};
+
+class StreamSender
+{
+public:
+	StreamSender(int port, int ttl, const char* source, int message_size);
+	int startSend();
+
+private:
+	int listen_port;
+	int message_ttl;
+	std::string source_path;
+	int max_message;
+	UDTSOCKET send_socket;
+	bool send_finished;
+	int64_t messages;
+	int64_t bytes;
+	int64_t expired;
+
+#if defined(__linux__) || defined(__APPLE__)
+	static void* startStatusThread(void* obj);
+#elif defined(WIN32)
+	static DWORD WINAPI startStatusThread(LPVOID obj);
+#else
+#error Not implemented on this platform
+#endif
+	void statusThread();
+	UDTSOCKET acceptReceiver();
+};
+
+class StreamReceiver
+{
+public:
+	StreamReceiver(char* id, int port, int ttl, const char* destination);
+	int startReceive();
+
+private:
+	std::string peer_id;
+	int peer_port;
+	int message_ttl;
+	std::string destination_path;
+	UDTSOCKET recv_socket;
+	bool recv_finished;
+	// status lines go to stderr when the stream itself is written to stdout
+	std::ostream* status;
+	int64_t received;
+	int64_t lost;
+	int64_t late;
+	int64_t base_delay;
+	double rtt;
+	LatencyHistogram interval_latency;
+	LatencyHistogram total_latency;
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_t stats_lock;
+#elif defined(WIN32)
+	HANDLE stats_lock;
+#else
+#error Not implemented on this platform
+#endif
+
+#if defined(__linux__) || defined(__APPLE__)
+	static void* startStatusThread(void* obj);
+#elif defined(WIN32)
+	static DWORD WINAPI startStatusThread(LPVOID obj);
+#else
+#error Not implemented on this platform
+#endif
+	void statusThread();
+	bool connectSender();
+	void lockStats();
+	void unlockStats();
+	void printLatency(const char* label, LatencyHistogram* histogram);
+};
+
+#endif
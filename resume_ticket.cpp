@@ -0,0 +1,237 @@
+/*
+ *  resume_ticket.cpp
+ *  NetworkHelper
+ *
+ *  Resumption state a receiver keeps between runs for one sender: the ticket
+ *  the sender issued with the last connection and the manifest of the transfer,
+ *  so that a reconnect resumes the transfer in its first round trip.
+ *
+ */
+
+#if defined(WIN32)
+#include <winsock2.h>
+#define snprintf _snprintf
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "resume_ticket.h"
+
+using namespace std;
+
+// first bytes of the resume file and of a resume request
+static const char resume_file_magic[4] = {'N', 'H', 'R', 'T'};
+static const char resume_request_magic[4] = {'N', 'H', 'R', '1'};
+
+ResumeTicket::ResumeTicket(const char* directory, const char* peer, int port)
+{
+	// one file per sender, named after its address or holepoke ID
+	string name(peer);
+	for (size_t i=0; i < name.size(); i++)
+	{
+		char c = name[i];
+		if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-'))
+			name[i] = '_';
+	}
+
+	char port_string[16];
+	snprintf(port_string, sizeof(port_string), "%d", port);
+	path = string(directory) + "/.resume_" + name + "_" + port_string;
+
+	memset(ticket_data, 0, RESUME_TICKET_SIZE);
+	manifest_data = NULL;
+	manifest_len = 0;
+}
+
+ResumeTicket::~ResumeTicket()
+{
+	if (manifest_data)
+		free(manifest_data);
+}
+
+bool ResumeTicket::load()
+{
+	fstream ifs(path.c_str(), ios::in | ios::binary);
+	if (!ifs)
+		return false;
+
+	char magic[4];
+	int len = 0;
+	ifs.read(magic, sizeof(magic));
+	ifs.read(ticket_data, RESUME_TICKET_SIZE);
+	ifs.read((char*)&len, sizeof(int));
+	if (!ifs || memcmp(magic, resume_file_magic, sizeof(magic)) != 0 || len <= 0 || len > 64*1024*1024)
+		return false;
+
+	char* data = (char*)malloc(len);
+	ifs.read(data, len);
+	if (!ifs)
+	{
+		free(data);
+		return false;
+	}
+
+	if (manifest_data)
+		free(manifest_data);
+	manifest_data = data;
+	manifest_len = len;
+
+	return true;
+}
+
+bool ResumeTicket::save()
+{
+	if (manifest_data == NULL)
+		return false;
+
+	fstream ofs(path.c_str(), ios::out | ios::trunc | ios::binary);
+	ofs.write(resume_file_magic, sizeof(resume_file_magic));
+	ofs.write(ticket_data, RESUME_TICKET_SIZE);
+	ofs.write((char*)&manifest_len, sizeof(int));
+	ofs.write(manifest_data, manifest_len);
+
+	return ofs.good();
+}
+
+const char* ResumeTicket::ticket()
+{
+	return ticket_data;
+}
+
+void ResumeTicket::setTicket(const char* new_ticket)
+{
+	memcpy(ticket_data, new_ticket, RESUME_TICKET_SIZE);
+}
+
+const char* ResumeTicket::manifest()
+{
+	return manifest_data;
+}
+
+int ResumeTicket::manifestLength()
+{
+	return manifest_len;
+}
+
+void ResumeTicket::setManifest(const char* new_manifest, int len)
+{
+	if (manifest_data)
+		free(manifest_data);
+	manifest_data = (char*)malloc(len);
+	memcpy(manifest_data, new_manifest, len);
+	manifest_len = len;
+}
+
+void ResumeTicket::makeRequest(char* request, int64_t offset)
+{
+	uint64_t hash = hashManifest(manifest_data, manifest_len);
+	memcpy(request, resume_request_magic, sizeof(resume_request_magic));
+	memcpy(request+4, &offset, sizeof(int64_t));
+	memcpy(request+12, &hash, sizeof(uint64_t));
+}
+
+char* ResumeTicket::buildManifest(int64_t total_size, int file_count, char** file_names, int64_t* file_sizes, int* len)
+{
+	int manifest_len = sizeof(int64_t) + sizeof(int);
+	for (int i=0; i < file_count; i++)
+	{
+		manifest_len += sizeof(int) + strlen(file_names[i]) + sizeof(int64_t);
+	}
+
+	char* manifest = (char*)malloc(manifest_len);
+	char* pos = manifest;
+	memcpy(pos, &total_size, sizeof(int64_t));
+	pos += sizeof(int64_t);
+	memcpy(pos, &file_count, sizeof(int));
+	pos += sizeof(int);
+	for (int i=0; i < file_count; i++)
+	{
+		int name_len = strlen(file_names[i]);
+		memcpy(pos, &name_len, sizeof(int));
+		pos += sizeof(int);
+		memcpy(pos, file_names[i], name_len);
+		pos += name_len;
+		memcpy(pos, &file_sizes[i], sizeof(int64_t));
+		pos += sizeof(int64_t);
+	}
+
+	*len = manifest_len;
+	return manifest;
+}
+
+bool ResumeTicket::parseManifest(const char* manifest, int len, int64_t* total_size, int* file_count, char*** file_names, int64_t** file_sizes)
+{
+	const char* pos = manifest;
+	const char* end = manifest + len;
+
+	int count;
+	if (end-pos < (int)(sizeof(int64_t) + sizeof(int)))
+		return false;
+	memcpy(total_size, pos, sizeof(int64_t));
+	pos += sizeof(int64_t);
+	memcpy(&count, pos, sizeof(int));
+	pos += sizeof(int);
+	if (count < 0 || count > len)
+		return false;
+
+	char** names = (char**)malloc(sizeof(char*)*count);
+	int64_t* sizes = (int64_t*)malloc(sizeof(int64_t)*count);
+	int parsed;
+	for (parsed=0; parsed < count; parsed++)
+	{
+		int name_len;
+		if (end-pos < (int)sizeof(int))
+			break;
+		memcpy(&name_len, pos, sizeof(int));
+		pos += sizeof(int);
+		if (name_len < 0 || end-pos < name_len + (int)sizeof(int64_t))
+			break;
+
+		names[parsed] = (char*)malloc(name_len+1);
+		memcpy(names[parsed], pos, name_len);
+		names[parsed][name_len] = '\0';
+		pos += name_len;
+		memcpy(&sizes[parsed], pos, sizeof(int64_t));
+		pos += sizeof(int64_t);
+	}
+
+	if (parsed < count)
+	{
+		for (int i=0; i < parsed; i++)
+			free(names[i]);
+		free(names);
+		free(sizes);
+		return false;
+	}
+
+	*file_count = count;
+	*file_names = names;
+	*file_sizes = sizes;
+	return true;
+}
+
+uint64_t ResumeTicket::hashManifest(const char* manifest, int len)
+{
+	// 64 bit FNV-1a, this only tells the sender whether the receiver still has the same file list
+	uint64_t hash = 14695981039346656037ULL;
+	for (int i=0; i < len; i++)
+	{
+		hash ^= (unsigned char)manifest[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+bool ResumeTicket::parseRequest(const char* request, int len, int64_t* offset, uint64_t* hash)
+{
+	if (len != RESUME_REQUEST_SIZE || memcmp(request, resume_request_magic, sizeof(resume_request_magic)) != 0)
+		return false;
+
+	memcpy(offset, request+4, sizeof(int64_t));
+	memcpy(hash, request+12, sizeof(uint64_t));
+	return *offset >= 0;
+}
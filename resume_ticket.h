@@ -0,0 +1,52 @@
+/*
+ *  resume_ticket.h
+ *  NetworkHelper
+ *
+ *  Resumption state a receiver keeps between runs for one sender: the ticket
+ *  the sender issued with the last connection and the manifest of the transfer,
+ *  so that a reconnect resumes the transfer in its first round trip.
+ *
+ */
+
+#ifndef RESUMETICKET
+#define RESUMETICKET
+
+#include <udt.h>
+#include <string>
+
+// size of the UDT_TICKET option
+#define RESUME_TICKET_SIZE 8
+// size of the resume request carried in the connection request as UDT_EARLYDATA
+#define RESUME_REQUEST_SIZE 20
+// sent by the sender instead of the total size when it accepts a resume request
+#define RESUME_ACCEPTED -1
+
+class ResumeTicket
+{
+public:
+	ResumeTicket(const char* directory, const char* peer, int port);
+	~ResumeTicket();
+	bool load();
+	bool save();
+	const char* ticket();
+	void setTicket(const char* new_ticket);
+	const char* manifest();
+	int manifestLength();
+	void setManifest(const char* new_manifest, int len);
+	// fills a resume request for the cached manifest, starting at offset
+	void makeRequest(char* request, int64_t offset);
+
+	// the manifest is the header the sender stages: total size, file count, then name length, name and size of every file
+	static char* buildManifest(int64_t total_size, int file_count, char** file_names, int64_t* file_sizes, int* len);
+	static bool parseManifest(const char* manifest, int len, int64_t* total_size, int* file_count, char*** file_names, int64_t** file_sizes);
+	static uint64_t hashManifest(const char* manifest, int len);
+	static bool parseRequest(const char* request, int len, int64_t* offset, uint64_t* hash);
+
+private:
+	std::string path;
+	char ticket_data[RESUME_TICKET_SIZE];
+	char* manifest_data;
+	int manifest_len;
+};
+
+#endif
@@ -28,12 +28,32 @@ SocketListItem::SocketListItem(UDTSOCKET socket, time_t time, char* ip, char* po
 	start_time = time;
 	remote_ip = ip;
 	remote_port = port;
+	worker = 0;
+	state = SEND_HEADER;
+	buffer = NULL;
+	buffer_len = 0;
+	buffer_pos = 0;
+	file = NULL;
+	file_index = 0;
+	offset = 0;
+	remaining = 0;
+	total_sent = 0;
+	disk_bytes = 0;
+	start_offset = 0;
+	resume_offset = -1;
 }
 SocketListItem::~SocketListItem()
 {
 	UDT::close(send_socket);
 	free(remote_ip);
 	free(remote_port);
+	if (file)
+	{
+		file->close();
+		delete file;
+	}
+	if (buffer)
+		free(buffer);
 }
 UDTSOCKET SocketListItem::socket()
 {
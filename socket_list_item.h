@@ -12,10 +12,23 @@
 
 #include <udt.h>
 #include <ccc.h>
+#include <common.h>
 #include <list>
+#include <fstream>
+
+// transfer stages of a connection driven by the sender's worker pool
+enum SendState
+{
+	SEND_HEADER,
+	WAIT_OFFSET,
+	SEND_FILES,
+	WAIT_FINISH
+};
 
 class SocketListItem
 {
+friend class NetworkSender;
+
 public:
 	SocketListItem(UDTSOCKET socket, time_t time, char* ip, char* port);
 	~SocketListItem();
@@ -37,6 +50,23 @@ private:
 	time_t start_time;
 	char* remote_ip;
 	char* remote_port;
+
+	// per connection transfer state, only touched by the owning worker
+	int worker;
+	SendState state;
+	char* buffer;
+	int buffer_len;
+	int buffer_pos;
+	std::fstream* file;
+	int64_t file_index;
+	int64_t offset;
+	int64_t remaining;
+	int64_t total_sent;
+	// bumped by the owning worker, read by the telemetry and metrics threads with CAtomic
+	volatile int64_t disk_bytes;
+	int64_t start_offset;
+	// offset a resuming receiver asked for with its connection request, -1 if it did not
+	int64_t resume_offset;
 };
 
 #endif
\ No newline at end of file
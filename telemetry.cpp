@@ -0,0 +1,298 @@
+/*
+ *  telemetry.cpp
+ *  NetworkHelper
+ *
+ *  Newline delimited JSON records describing every live connection, written
+ *  to a file descriptor or Unix socket separate from the stdout protocol.
+ *
+ */
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#elif defined(WIN32)
+#include <winsock2.h>
+#include <io.h>
+#define snprintf _snprintf
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "telemetry.h"
+
+using namespace std;
+
+Telemetry::Telemetry(int interval)
+{
+	telemetry_fd = -1;
+	dropped = 0;
+	setInterval(interval);
+
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_init(&telemetry_lock, NULL);
+#elif defined(WIN32)
+	telemetry_lock = CreateMutex(NULL, false, NULL);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+Telemetry::~Telemetry()
+{
+	flush();
+
+#if defined(__linux__) || defined(__APPLE__)
+	if (telemetry_fd > STDERR_FILENO)
+		close(telemetry_fd);
+	pthread_mutex_destroy(&telemetry_lock);
+#elif defined(WIN32)
+	if (telemetry_fd > 2)
+		_close(telemetry_fd);
+	CloseHandle(telemetry_lock);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+bool Telemetry::open(const char* target)
+{
+	// a number names an already open descriptor, anything else is a Unix socket path
+	char* end = NULL;
+	long fd = strtol(target, &end, 10);
+	if (end != target && *end == '\0')
+	{
+		if (fd <= 1)
+		{
+			cout << "error\ttelemetry\tTelemetry cannot share stdin or stdout." << endl;
+			return false;
+		}
+		telemetry_fd = (int)fd;
+	}
+	else
+	{
+#if defined(__linux__) || defined(__APPLE__)
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(target) >= sizeof(addr.sun_path))
+		{
+			cout << "error\ttelemetry\tSocket path too long." << endl;
+			return false;
+		}
+		strncpy(addr.sun_path, target, sizeof(addr.sun_path)-1);
+
+		telemetry_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (telemetry_fd < 0 || connect(telemetry_fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+		{
+			cout << "error\ttelemetry\t" << strerror(errno) << endl;
+			if (telemetry_fd >= 0)
+				close(telemetry_fd);
+			telemetry_fd = -1;
+			return false;
+		}
+#elif defined(WIN32)
+		cout << "error\ttelemetry\tUnix sockets are not supported on this platform." << endl;
+		return false;
+#else
+#error Not implemented on this platform
+#endif
+	}
+
+#if defined(__linux__) || defined(__APPLE__)
+	// a slow or dead reader must never stall the transfer
+	int flags = fcntl(telemetry_fd, F_GETFL);
+	if (flags < 0 || fcntl(telemetry_fd, F_SETFL, flags | O_NONBLOCK) < 0)
+	{
+		cout << "error\ttelemetry\t" << strerror(errno) << endl;
+		telemetry_fd = -1;
+		return false;
+	}
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	return true;
+}
+
+bool Telemetry::enabled()
+{
+	return telemetry_fd >= 0;
+}
+
+int Telemetry::interval()
+{
+	return telemetry_interval;
+}
+
+void Telemetry::setInterval(int new_interval)
+{
+	if (new_interval < TELEMETRY_MIN_INTERVAL)
+		new_interval = TELEMETRY_MIN_INTERVAL;
+	telemetry_interval = new_interval;
+}
+
+void Telemetry::addRecord(const char* role, const char* event, UDTSOCKET socket, const char* ip, const char* port, int64_t disk_bytes)
+{
+	if (!enabled())
+		return;
+
+	// perfmon without clearing leaves the interval counters of the status line alone
+	// and only reads the connection state, so sampling never blocks the data path
+	UDT::TRACEINFO trace;
+	if (UDT::ERROR == UDT::perfmon(socket, &trace, false))
+	{
+		lock();
+		samples.erase(socket);
+		unlock();
+		return;
+	}
+
+	if (disk_bytes < 0)
+		disk_bytes = trace.pktFileBytesRecvd;
+
+	int64_t now;
+#if defined(__linux__) || defined(__APPLE__)
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	now = (int64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+#elif defined(WIN32)
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	now = ((((int64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime) - 116444736000000000LL)/10000;
+#else
+#error Not implemented on this platform
+#endif
+
+	lock();
+
+	map<UDTSOCKET, TelemetrySample>::iterator sample_it = samples.find(socket);
+	TelemetrySample previous;
+	if (sample_it == samples.end())
+	{
+		// rates of the first record cover the whole connection lifetime
+		previous.timestamp = 0;
+		previous.sent = 0;
+		previous.received = 0;
+		previous.disk_bytes = 0;
+	}
+	else
+	{
+		previous = sample_it->second;
+	}
+
+	double elapsed = (double)(trace.msTimeStamp - previous.timestamp)*1000;
+	double send_mbps = 0;
+	double recv_mbps = 0;
+	double disk_mbps = 0;
+	if (elapsed > 0)
+	{
+		// the packets change size with the path MTU, the payload is counted in bytes
+		send_mbps = (trace.byteSentTotal - previous.sent)*8.0/elapsed;
+		recv_mbps = (trace.byteRecvTotal - previous.received)*8.0/elapsed;
+		disk_mbps = (disk_bytes - previous.disk_bytes)*8.0/elapsed;
+	}
+
+	if (strcmp(event, "sample") == 0)
+	{
+		TelemetrySample& current = samples[socket];
+		current.timestamp = trace.msTimeStamp;
+		current.sent = trace.byteSentTotal;
+		current.received = trace.byteRecvTotal;
+		current.disk_bytes = disk_bytes;
+	}
+	else
+	{
+		samples.erase(socket);
+	}
+
+	char record[1024];
+	int len = snprintf(record, sizeof(record),
+		"{\"ts\":%lld,\"role\":\"%s\",\"event\":\"%s\",\"socket\":%d,\"ip\":\"%s\",\"port\":\"%s\","
+		"\"elapsed_ms\":%lld,\"rtt_ms\":%.3f,\"bandwidth_mbps\":%.3f,\"send_mbps\":%.3f,\"recv_mbps\":%.3f,"
+		"\"pkt_sent\":%lld,\"pkt_recv\":%lld,\"pkt_snd_loss\":%d,\"pkt_rcv_loss\":%d,\"pkt_retrans\":%d,"
+		"\"pkt_parity\":%d,\"pkt_recovered\":%d,"
+		"\"pkt_snd_period_us\":%.3f,\"flow_window\":%d,\"cwnd\":%d,\"flight\":%d,"
+		"\"snd_buf_avail\":%d,\"rcv_buf_avail\":%d,\"disk_bytes\":%lld,\"disk_mbps\":%.3f,\"dropped\":%lld}\n",
+		(long long)now, role, event, (int)socket, ip, port,
+		(long long)trace.msTimeStamp, trace.msRTT, trace.mbpsBandwidth, send_mbps, recv_mbps,
+		(long long)trace.pktSentTotal, (long long)trace.pktRecvTotal, trace.pktSndLossTotal, trace.pktRcvLossTotal, trace.pktRetransTotal,
+		trace.pktSndParityTotal, trace.pktRcvRecoveredTotal,
+		trace.usPktSndPeriod, trace.pktFlowWindow, trace.pktCongestionWindow, trace.pktFlightSize,
+		trace.byteAvailSndBuf, trace.byteAvailRcvBuf, (long long)disk_bytes, disk_mbps, (long long)dropped);
+
+	// whole records are dropped rather than cut so the stream always stays parseable
+	if (len > 0 && len < (int)sizeof(record) && pending.size() < TELEMETRY_MAX_PENDING)
+		pending.append(record, len);
+	else
+		dropped++;
+
+	unlock();
+}
+
+void Telemetry::flush()
+{
+	lock();
+
+	while (enabled() && pending.size() > 0)
+	{
+#if defined(__linux__) || defined(__APPLE__)
+		ssize_t written = write(telemetry_fd, pending.data(), pending.size());
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				// the reader went away, stop producing records
+				cout << "error\ttelemetry\t" << strerror(errno) << endl;
+				telemetry_fd = -1;
+				pending.clear();
+			}
+			break;
+		}
+#elif defined(WIN32)
+		int written = _write(telemetry_fd, pending.data(), (unsigned int)pending.size());
+		if (written < 0)
+		{
+			cout << "error\ttelemetry\t" << strerror(errno) << endl;
+			telemetry_fd = -1;
+			pending.clear();
+			break;
+		}
+#else
+#error Not implemented on this platform
+#endif
+		pending.erase(0, written);
+	}
+
+	unlock();
+}
+
+void Telemetry::lock()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_lock(&telemetry_lock);
+#elif defined(WIN32)
+	WaitForSingleObject(telemetry_lock, INFINITE);
+#else
+#error Not implemented on this platform
+#endif
+}
+
+void Telemetry::unlock()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_unlock(&telemetry_lock);
+#elif defined(WIN32)
+	ReleaseMutex(telemetry_lock);
+#else
+#error Not implemented on this platform
+#endif
+}
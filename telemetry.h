@@ -0,0 +1,61 @@
+/*
+ *  telemetry.h
+ *  NetworkHelper
+ *
+ *  Newline delimited JSON records describing every live connection, written
+ *  to a file descriptor or Unix socket separate from the stdout protocol.
+ *
+ */
+
+#ifndef TELEMETRY
+#define TELEMETRY
+
+#include <udt.h>
+#include <map>
+#include <string>
+
+// shortest sampling interval accepted, in milliseconds
+#define TELEMETRY_MIN_INTERVAL 10
+// records queued for a slow reader before new ones are dropped
+#define TELEMETRY_MAX_PENDING (1024*1024)
+
+struct TelemetrySample
+{
+	int64_t timestamp;
+	int64_t sent;
+	int64_t received;
+	int64_t disk_bytes;
+};
+
+class Telemetry
+{
+public:
+	Telemetry(int interval);
+	~Telemetry();
+	bool open(const char* target);
+	bool enabled();
+	int interval();
+	void setInterval(int new_interval);
+	// disk_bytes is the count moved to or from disk, -1 takes the bytes UDT wrote to file
+	void addRecord(const char* role, const char* event, UDTSOCKET socket, const char* ip, const char* port, int64_t disk_bytes);
+	void flush();
+
+private:
+	int telemetry_fd;
+	int telemetry_interval;
+	std::string pending;
+	std::map<UDTSOCKET, TelemetrySample> samples;
+	int64_t dropped;
+#if defined(__linux__) || defined(__APPLE__)
+	pthread_mutex_t telemetry_lock;
+#elif defined(WIN32)
+	HANDLE telemetry_lock;
+#else
+#error Not implemented on this platform
+#endif
+
+	void lock();
+	void unlock();
+};
+
+#endif
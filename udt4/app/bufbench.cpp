@@ -0,0 +1,400 @@
+#ifndef WIN32
+   #include <cstdlib>
+   #include <cstring>
+#else
+   #include <winsock2.h>
+   #include <ws2tcpip.h>
+#endif
+#include <iostream>
+#include <iomanip>
+#include <udt.h>
+#include <common.h>
+#include <buffer.h>
+
+using namespace std;
+
+// measures the sender buffer, a flat ring of packet slots, against the circular list of blocks it replaced:
+// creating and destroying the 32 slot buffer every connection starts with, filling a buffer from empty and
+// giving it back, and a steady window of data that is added, sent, partly sent again and acknowledged
+
+const int g_iMSS = 1456;
+
+int64_t g_llSink = 0;
+
+// the replaced buffer, for reference
+class CListSndBuffer
+{
+public:
+   CListSndBuffer(const int& size, const int& mss);
+   ~CListSndBuffer();
+
+   void addBuffer(const char* data, const int& len, const int& ttl = -1, const bool& order = false);
+   int readData(char** data, int32_t& msgno);
+   int readData(char** data, const int offset, int32_t& msgno, int& msglen);
+   void ackData(const int& offset);
+
+private:
+   void increase();
+
+   pthread_mutex_t m_BufLock;
+
+   struct Block
+   {
+      char* m_pcData;
+      int m_iLength;
+      int32_t m_iMsgNo;
+      uint64_t m_OriginTime;
+      int m_iTTL;
+      Block* m_pNext;
+   } *m_pBlock, *m_pFirstBlock, *m_pCurrBlock, *m_pLastBlock;
+
+   struct Buffer
+   {
+      char* m_pcData;
+      int m_iSize;
+      Buffer* m_pNext;
+   } *m_pBuffer;
+
+   int32_t m_iNextMsgNo;
+   int m_iSize;
+   int m_iMSS;
+   int m_iCount;
+};
+
+CListSndBuffer::CListSndBuffer(const int& size, const int& mss):
+m_pBlock(NULL),
+m_pFirstBlock(NULL),
+m_pCurrBlock(NULL),
+m_pLastBlock(NULL),
+m_pBuffer(NULL),
+m_iNextMsgNo(1),
+m_iSize(size),
+m_iMSS(mss),
+m_iCount(0)
+{
+   m_pBuffer = new Buffer;
+   m_pBuffer->m_pcData = new char [m_iSize * m_iMSS];
+   m_pBuffer->m_iSize = m_iSize;
+   m_pBuffer->m_pNext = NULL;
+
+   m_pBlock = new Block;
+   Block* pb = m_pBlock;
+   for (int i = 1; i < m_iSize; ++ i)
+   {
+      pb->m_pNext = new Block;
+      pb->m_iMsgNo = 0;
+      pb = pb->m_pNext;
+   }
+   pb->m_pNext = m_pBlock;
+
+   pb = m_pBlock;
+   char* pc = m_pBuffer->m_pcData;
+   for (int i = 0; i < m_iSize; ++ i)
+   {
+      pb->m_pcData = pc;
+      pb = pb->m_pNext;
+      pc += m_iMSS;
+   }
+
+   m_pFirstBlock = m_pCurrBlock = m_pLastBlock = m_pBlock;
+
+   #ifndef WIN32
+      pthread_mutex_init(&m_BufLock, NULL);
+   #else
+      m_BufLock = CreateMutex(NULL, false, NULL);
+   #endif
+}
+
+CListSndBuffer::~CListSndBuffer()
+{
+   Block* pb = m_pBlock->m_pNext;
+   while (pb != m_pBlock)
+   {
+      Block* temp = pb;
+      pb = pb->m_pNext;
+      delete temp;
+   }
+   delete m_pBlock;
+
+   while (m_pBuffer != NULL)
+   {
+      Buffer* temp = m_pBuffer;
+      m_pBuffer = m_pBuffer->m_pNext;
+      delete [] temp->m_pcData;
+      delete temp;
+   }
+
+   #ifndef WIN32
+      pthread_mutex_destroy(&m_BufLock);
+   #else
+      CloseHandle(m_BufLock);
+   #endif
+}
+
+void CListSndBuffer::addBuffer(const char* data, const int& len, const int& ttl, const bool& order)
+{
+   int size = len / m_iMSS;
+   if ((len % m_iMSS) != 0)
+      size ++;
+
+   while (size + m_iCount >= m_iSize)
+      increase();
+
+   uint64_t time = CTimer::getTime();
+   int32_t inorder = order;
+   inorder <<= 29;
+
+   Block* s = m_pLastBlock;
+   for (int i = 0; i < size; ++ i)
+   {
+      int pktlen = len - i * m_iMSS;
+      if (pktlen > m_iMSS)
+         pktlen = m_iMSS;
+
+      memcpy(s->m_pcData, data + i * m_iMSS, pktlen);
+      s->m_iLength = pktlen;
+
+      s->m_iMsgNo = m_iNextMsgNo | inorder;
+      if (i == 0)
+         s->m_iMsgNo |= 0x80000000;
+      if (i == size - 1)
+         s->m_iMsgNo |= 0x40000000;
+
+      s->m_OriginTime = time;
+      s->m_iTTL = ttl;
+
+      s = s->m_pNext;
+   }
+   m_pLastBlock = s;
+
+   CGuard::enterCS(m_BufLock);
+   m_iCount += size;
+   CGuard::leaveCS(m_BufLock);
+
+   m_iNextMsgNo ++;
+   if (m_iNextMsgNo == CMsgNo::m_iMaxMsgNo)
+      m_iNextMsgNo = 1;
+}
+
+int CListSndBuffer::readData(char** data, int32_t& msgno)
+{
+   if (m_pCurrBlock == m_pLastBlock)
+      return 0;
+
+   *data = m_pCurrBlock->m_pcData;
+   int readlen = m_pCurrBlock->m_iLength;
+   msgno = m_pCurrBlock->m_iMsgNo;
+
+   m_pCurrBlock = m_pCurrBlock->m_pNext;
+
+   return readlen;
+}
+
+int CListSndBuffer::readData(char** data, const int offset, int32_t& msgno, int& msglen)
+{
+   CGuard bufferguard(m_BufLock);
+
+   Block* p = m_pFirstBlock;
+
+   for (int i = 0; i < offset; ++ i)
+      p = p->m_pNext;
+
+   if ((p->m_iTTL >= 0) && ((CTimer::getTime() - p->m_OriginTime) / 1000 > (uint64_t)p->m_iTTL))
+   {
+      msgno = p->m_iMsgNo & 0x1FFFFFFF;
+
+      msglen = 1;
+      p = p->m_pNext;
+      bool move = false;
+      while (msgno == (p->m_iMsgNo & 0x1FFFFFFF))
+      {
+         if (p == m_pCurrBlock)
+            move = true;
+         p = p->m_pNext;
+         if (move)
+            m_pCurrBlock = p;
+         msglen ++;
+      }
+
+      return -1;
+   }
+
+   *data = p->m_pcData;
+   int readlen = p->m_iLength;
+   msgno = p->m_iMsgNo;
+
+   return readlen;
+}
+
+void CListSndBuffer::ackData(const int& offset)
+{
+   CGuard bufferguard(m_BufLock);
+
+   for (int i = 0; i < offset; ++ i)
+      m_pFirstBlock = m_pFirstBlock->m_pNext;
+
+   m_iCount -= offset;
+
+   CTimer::triggerEvent();
+}
+
+void CListSndBuffer::increase()
+{
+   int unitsize = m_pBuffer->m_iSize;
+
+   Buffer* nbuf = new Buffer;
+   nbuf->m_pcData = new char [unitsize * m_iMSS];
+   nbuf->m_iSize = unitsize;
+   nbuf->m_pNext = NULL;
+
+   Buffer* p = m_pBuffer;
+   while (NULL != p->m_pNext)
+      p = p->m_pNext;
+   p->m_pNext = nbuf;
+
+   Block* nblk = new Block;
+   Block* pb = nblk;
+   for (int i = 1; i < unitsize; ++ i)
+   {
+      pb->m_pNext = new Block;
+      pb = pb->m_pNext;
+   }
+
+   pb->m_pNext = m_pLastBlock->m_pNext;
+   m_pLastBlock->m_pNext = nblk;
+
+   pb = nblk;
+   char* pc = nbuf->m_pcData;
+   for (int i = 0; i < unitsize; ++ i)
+   {
+      pb->m_pcData = pc;
+      pb = pb->m_pNext;
+      pc += m_iMSS;
+   }
+
+   m_iSize += unitsize;
+}
+
+// the two buffers behind one interface; the ring skips what has expired with -1 instead of a zero read
+struct Old
+{
+   CListSndBuffer m_Buffer;
+   Old(int size, int limit): m_Buffer(size, g_iMSS) {(void)limit;}
+   int read(char** data, int32_t& msgno) {return m_Buffer.readData(data, msgno);}
+   CListSndBuffer* operator->() {return &m_Buffer;}
+};
+
+struct New
+{
+   CSndBuffer m_Buffer;
+   New(int size, int limit): m_Buffer(size, g_iMSS, limit) {}
+   int read(char** data, int32_t& msgno) {int msglen; return m_Buffer.readData(data, msgno, msglen);}
+   CSndBuffer* operator->() {return &m_Buffer;}
+};
+
+// microseconds to create and destroy one buffer as a connection does, for a send buffer limit of 8192 packets
+template <class T> double create(int rounds)
+{
+   uint64_t start = CTimer::getTime();
+   for (int r = 0; r < rounds; ++ r)
+   {
+      T* b = new T(32, 8192);
+      g_llSink += (int64_t)b & 1;
+      delete b;
+   }
+   return double(CTimer::getTime() - start) / rounds;
+}
+
+// seconds to add the given number of packets to an empty buffer, send them and acknowledge them all
+template <class T> double fill(const char* data, int packets)
+{
+   uint64_t start = CTimer::getTime();
+
+   T b(32, packets);
+   const int chunk = 45;
+   for (int i = 0; i < packets; i += chunk)
+      b->addBuffer(data, chunk * g_iMSS);
+
+   char* p;
+   int32_t msgno;
+   while (b.read(&p, msgno) > 0)
+      g_llSink += p[0];
+   b->ackData(packets / chunk * chunk + ((packets % chunk) ? chunk : 0));
+
+   return double(CTimer::getTime() - start) / 1000000;
+}
+
+// million packets per second through a window of the given size: every round adds a 64 KB message, sends it,
+// sends one packet of the window again and acknowledges a message
+template <class T> double cycle(const char* data, int window, int64_t packets)
+{
+   const int chunk = 45;
+   T b(32, window * 2);
+   char* p;
+   int32_t msgno;
+   int msglen;
+
+   for (int i = 0; i < window; i += chunk)
+      b->addBuffer(data, chunk * g_iMSS);
+   while (b.read(&p, msgno) > 0)
+   {
+   }
+
+   uint64_t start = CTimer::getTime();
+   for (int64_t n = 0; n < packets; n += chunk)
+   {
+      b->addBuffer(data, chunk * g_iMSS);
+      while (b.read(&p, msgno) > 0)
+         g_llSink += p[0];
+      if (b->readData(&p, int(n % window), msgno, msglen) > 0)
+         g_llSink += p[0];
+      b->ackData(chunk);
+   }
+
+   return packets / double(CTimer::getTime() - start);
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc > 2) || ((2 == argc) && (0 >= atoi(argv[1]))))
+   {
+      cout << "usage: bufbench [megabytes]" << endl;
+      return 0;
+   }
+
+   // the size of the filled buffer, the steady window is a tenth of it
+   int packets = int(((2 == argc) ? atoi(argv[1]) : 200) * 1000000LL / g_iMSS);
+   int window = packets / 10;
+
+   char* data = new char[45 * g_iMSS];
+   memset(data, 'x', 45 * g_iMSS);
+
+   double t[6];
+
+   // warm up, then measure
+   create<Old>(1000);
+   create<New>(1000);
+   t[0] = create<Old>(100000);
+   t[1] = create<New>(100000);
+
+   fill<Old>(data, packets / 10);
+   fill<New>(data, packets / 10);
+   t[2] = fill<Old>(data, packets);
+   t[3] = fill<New>(data, packets);
+
+   t[4] = cycle<Old>(data, window, packets * 10LL);
+   t[5] = cycle<New>(data, window, packets * 10LL);
+
+   cout << setw(24) << "" << setw(14) << "list" << setw(14) << "ring" << endl;
+   cout << fixed << setprecision(2);
+   cout << setw(24) << "create 32 slots (us)" << setw(14) << t[0] << setw(14) << t[1] << endl;
+   cout << setw(24) << "fill and ack (s)" << setw(14) << t[2] << setw(14) << t[3] << endl;
+   cout << setw(24) << "cycle (Mpackets/s)" << setw(14) << t[4] << setw(14) << t[5] << endl;
+
+   if (0 == g_llSink)
+      cout << endl;
+
+   delete [] data;
+
+   return 0;
+}
@@ -0,0 +1,162 @@
+#ifndef WIN32
+   #include <arpa/inet.h>
+#else
+   #include <winsock2.h>
+   #include <ws2tcpip.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <udt.h>
+#include <coro.h>
+
+using namespace std;
+
+// runs many concurrent loopback streams as coroutines over the asynchronous UDT calls, on a small
+// executor and the one UDT worker thread, and reports the aggregate throughput
+
+const int g_iChunkSize = 32768;
+
+atomic<int> g_iStreams(0);
+atomic<int> g_iFailed(0);
+atomic<int64_t> g_llReceived(0);
+
+UDT::coro::task sendStream(UDTSOCKET u, const char* data, int64_t size, UDT::coro::executor& ex)
+{
+   try
+   {
+      for (int64_t sent = 0; sent < size; )
+      {
+         int len = int((size - sent < g_iChunkSize) ? size - sent : g_iChunkSize);
+         sent += co_await UDT::coro::send(u, data, len, ex);
+      }
+   }
+   catch (UDT::ERRORINFO& e)
+   {
+      ++ g_iFailed;
+   }
+}
+
+UDT::coro::task recvStream(UDTSOCKET u, int64_t size, UDT::coro::executor& ex)
+{
+   vector<char> buf(g_iChunkSize);
+   try
+   {
+      for (int64_t received = 0; received < size; )
+      {
+         int64_t len = co_await UDT::coro::recv(u, &buf[0], g_iChunkSize, ex);
+         received += len;
+         g_llReceived += len;
+      }
+   }
+   catch (UDT::ERRORINFO& e)
+   {
+      ++ g_iFailed;
+   }
+   -- g_iStreams;
+}
+
+int threadCount()
+{
+   #ifdef __linux__
+      ifstream status("/proc/self/status");
+      string line;
+      while (getline(status, line))
+      {
+         if (0 == line.compare(0, 8, "Threads:"))
+            return atoi(line.c_str() + 8);
+      }
+   #endif
+   return 0;
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc < 2) || (argc > 5) || (0 == atoi(argv[1])))
+   {
+      cout << "usage: coxfer port [streams] [KB per stream] [executor threads]" << endl;
+      return 0;
+   }
+
+   int port = atoi(argv[1]);
+   int streams = (argc >= 3) ? atoi(argv[2]) : 256;
+   int64_t size = ((argc >= 4) ? atoi(argv[3]) : 1024) * 1024LL;
+   int threads = (argc >= 5) ? atoi(argv[4]) : 2;
+
+   UDT::startup();
+
+   sockaddr_in server;
+   memset(&server, 0, sizeof(sockaddr_in));
+   server.sin_family = AF_INET;
+   server.sin_port = htons(port);
+   server.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+   UDTSOCKET serv = UDT::socket(AF_INET, SOCK_STREAM, 0);
+   if ((UDT::ERROR == UDT::bind(serv, (sockaddr*)&server, sizeof(sockaddr_in))) || (UDT::ERROR == UDT::listen(serv, streams)))
+   {
+      cout << "listen: " << UDT::getlasterror().getErrorMessage() << endl;
+      return 0;
+   }
+
+   // small buffers, the point is the number of streams
+   int bufsize = 1024000;
+   vector<UDTSOCKET> senders(streams);
+   vector<UDTSOCKET> recvers(streams);
+   for (int i = 0; i < streams; ++ i)
+   {
+      senders[i] = UDT::socket(AF_INET, SOCK_STREAM, 0);
+      UDT::setsockopt(senders[i], 0, UDT_SNDBUF, &bufsize, sizeof(int));
+      UDT::setsockopt(senders[i], 0, UDT_RCVBUF, &bufsize, sizeof(int));
+      if (UDT::ERROR == UDT::connect(senders[i], (sockaddr*)&server, sizeof(sockaddr_in)))
+      {
+         cout << "connect: " << UDT::getlasterror().getErrorMessage() << endl;
+         return 0;
+      }
+
+      sockaddr_in addr;
+      int addrlen = sizeof(sockaddr_in);
+      recvers[i] = UDT::accept(serv, (sockaddr*)&addr, &addrlen);
+   }
+
+   vector<char> data(g_iChunkSize, 'x');
+   int idle = threadCount();
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   {
+      UDT::coro::executor ex(threads);
+
+      g_iStreams = streams;
+      for (int i = 0; i < streams; ++ i)
+      {
+         recvStream(recvers[i], size, ex);
+         sendStream(senders[i], &data[0], size, ex);
+      }
+
+      int busy = threadCount();
+      while ((g_iStreams > 0) && (g_iFailed == 0))
+         this_thread::sleep_for(chrono::milliseconds(10));
+
+      double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      cout << setw(8) << "streams" << setw(12) << "MB" << setw(10) << "seconds" << setw(12) << "Mb/s" << setw(10) << "threads" << endl;
+      cout << setw(8) << streams << setw(12) << g_llReceived / 1000000.0 << setw(10) << seconds << setw(12) << g_llReceived * 8.0 / 1000000 / seconds;
+      cout << setw(10) << busy << " (" << busy - idle << " for the streams)" << endl;
+      if (g_iFailed > 0)
+         cout << g_iFailed << " streams failed" << endl;
+   }
+
+   for (int i = 0; i < streams; ++ i)
+   {
+      UDT::close(senders[i]);
+      UDT::close(recvers[i]);
+   }
+   UDT::close(serv);
+   UDT::cleanup();
+
+   return 0;
+}
@@ -0,0 +1,253 @@
+#ifndef WIN32
+   #include <unistd.h>
+   #include <cstdlib>
+   #include <cstring>
+   #include <netdb.h>
+   #include <arpa/inet.h>
+   #include <sys/time.h>
+#else
+   #include <winsock2.h>
+   #include <ws2tcpip.h>
+   #include <wspiapi.h>
+#endif
+#include <iostream>
+#include <iomanip>
+#include <udt.h>
+
+using namespace std;
+
+// measures how many connection requests a listener answers per second, and how much a flood of
+// them slows down a transfer that runs on the same UDP port
+
+#ifndef WIN32
+void* drain(void*);
+void* stream(void*);
+void* flood(void*);
+void* count(void*);
+#else
+DWORD WINAPI drain(LPVOID);
+DWORD WINAPI stream(LPVOID);
+DWORD WINAPI flood(LPVOID);
+DWORD WINAPI count(LPVOID);
+#endif
+
+volatile bool g_bFlooding = false;
+volatile bool g_bDone = false;
+volatile int64_t g_llReceived = 0;
+volatile int64_t g_llRequests = 0;
+volatile int64_t g_llAnswers = 0;
+
+sockaddr_in g_Server;
+#ifndef WIN32
+int g_iFloodSock;
+#else
+SOCKET g_iFloodSock;
+#endif
+
+void sleepms(int ms)
+{
+   #ifndef WIN32
+      usleep(ms * 1000);
+   #else
+      Sleep(ms);
+   #endif
+}
+
+void run(void* (*proc)(void*), void* arg)
+{
+   #ifndef WIN32
+      pthread_t t;
+      pthread_create(&t, NULL, proc, arg);
+      pthread_detach(t);
+   #else
+      CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)proc, arg, 0, NULL);
+   #endif
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc < 2) || (argc > 3) || (0 == atoi(argv[1])))
+   {
+      cout << "usage: hsbench port [seconds]" << endl;
+      return 0;
+   }
+
+   int port = atoi(argv[1]);
+   int seconds = (3 == argc) ? atoi(argv[2]) : 5;
+
+   UDT::startup();
+
+   memset(&g_Server, 0, sizeof(sockaddr_in));
+   g_Server.sin_family = AF_INET;
+   g_Server.sin_port = htons(port);
+   g_Server.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+   UDTSOCKET serv = UDT::socket(AF_INET, SOCK_STREAM, 0);
+   if ((UDT::ERROR == UDT::bind(serv, (sockaddr*)&g_Server, sizeof(sockaddr_in))) || (UDT::ERROR == UDT::listen(serv, 10)))
+   {
+      cout << "listen: " << UDT::getlasterror().getErrorMessage() << endl;
+      return 0;
+   }
+
+   UDTSOCKET client = UDT::socket(AF_INET, SOCK_STREAM, 0);
+   if (UDT::ERROR == UDT::connect(client, (sockaddr*)&g_Server, sizeof(sockaddr_in)))
+   {
+      cout << "connect: " << UDT::getlasterror().getErrorMessage() << endl;
+      return 0;
+   }
+
+   sockaddr_in addr;
+   int addrlen = sizeof(sockaddr_in);
+   UDTSOCKET recver = UDT::accept(serv, (sockaddr*)&addr, &addrlen);
+
+   run(drain, new UDTSOCKET(recver));
+   run(stream, new UDTSOCKET(client));
+
+   // the requests come from a plain UDP socket, they are never completed
+   g_iFloodSock = socket(AF_INET, SOCK_DGRAM, 0);
+   run(count, NULL);
+   run(flood, NULL);
+
+   cout << setw(8) << "phase" << setw(14) << "data(Mb/s)" << setw(14) << "requests/s" << setw(14) << "answered/s" << endl;
+
+   for (int phase = 0; phase < 2; ++ phase)
+   {
+      // settle, then measure
+      g_bFlooding = (1 == phase);
+      sleepms(500);
+
+      int64_t received = g_llReceived;
+      int64_t requests = g_llRequests;
+      int64_t answers = g_llAnswers;
+      sleepms(seconds * 1000);
+
+      cout << setw(8) << (g_bFlooding ? "flood" : "idle");
+      cout << setw(14) << (g_llReceived - received) * 8.0 / 1000000 / seconds;
+      cout << setw(14) << (g_llRequests - requests) / seconds;
+      cout << setw(14) << (g_llAnswers - answers) / seconds << endl;
+   }
+
+   g_bDone = true;
+   g_bFlooding = false;
+   sleepms(100);
+
+   // the sender would otherwise linger until its buffer is delivered
+   linger l;
+   l.l_onoff = 0;
+   l.l_linger = 0;
+   UDT::setsockopt(client, 0, UDT_LINGER, &l, sizeof(linger));
+
+   UDT::close(client);
+   UDT::close(recver);
+   UDT::close(serv);
+   UDT::cleanup();
+
+   return 0;
+}
+
+#ifndef WIN32
+void* drain(void* usocket)
+#else
+DWORD WINAPI drain(LPVOID usocket)
+#endif
+{
+   UDTSOCKET recver = *(UDTSOCKET*)usocket;
+   delete (UDTSOCKET*)usocket;
+
+   char* data = new char[1000000];
+   while (!g_bDone)
+   {
+      int rs = UDT::recv(recver, data, 1000000, 0);
+      if (UDT::ERROR == rs)
+         break;
+      g_llReceived += rs;
+   }
+   delete [] data;
+
+   return 0;
+}
+
+#ifndef WIN32
+void* stream(void* usocket)
+#else
+DWORD WINAPI stream(LPVOID usocket)
+#endif
+{
+   UDTSOCKET client = *(UDTSOCKET*)usocket;
+   delete (UDTSOCKET*)usocket;
+
+   char* data = new char[1000000];
+   memset(data, 0, 1000000);
+   while (!g_bDone)
+   {
+      if (UDT::ERROR == UDT::send(client, data, 1000000, 0))
+         break;
+   }
+   delete [] data;
+
+   return 0;
+}
+
+#ifndef WIN32
+void* flood(void*)
+#else
+DWORD WINAPI flood(LPVOID)
+#endif
+{
+   // a control packet of type 0 to socket 0, carrying a regular connection request (see CHandShake);
+   // every field goes out in network byte order
+   uint32_t request[4 + 18];
+   memset(request, 0, sizeof(request));
+   request[0] = htonl(0x80000000);
+   request[4] = htonl(4);			// version
+   request[5] = htonl(1);			// socket type, UDT_STREAM
+   request[7] = htonl(1500);			// MSS
+   request[8] = htonl(25600);			// flow window
+   request[9] = htonl(1);			// request type
+
+   int32_t id = 1;
+   while (!g_bDone)
+   {
+      if (!g_bFlooding)
+      {
+         sleepms(10);
+         continue;
+      }
+
+      // a new ISN and socket ID for every request, as from different clients
+      request[6] = htonl(id);
+      request[10] = htonl(id);
+      id = (id + 1) & 0x3FFFFFFF;
+
+      if (sendto(g_iFloodSock, (char*)request, sizeof(request), 0, (sockaddr*)&g_Server, sizeof(sockaddr_in)) > 0)
+         ++ g_llRequests;
+   }
+
+   return 0;
+}
+
+#ifndef WIN32
+void* count(void*)
+#else
+DWORD WINAPI count(LPVOID)
+#endif
+{
+   #ifndef WIN32
+      timeval tv;
+      tv.tv_sec = 0;
+      tv.tv_usec = 100000;
+   #else
+      DWORD tv = 100;
+   #endif
+   setsockopt(g_iFloodSock, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv));
+
+   char reply[1500];
+   while (!g_bDone)
+   {
+      // every answer to a request is a cookie
+      if (recv(g_iFloodSock, reply, sizeof(reply), 0) > 0)
+         ++ g_llAnswers;
+   }
+
+   return 0;
+}
@@ -0,0 +1,210 @@
+#ifndef WIN32
+   #include <unistd.h>
+   #include <cstdlib>
+   #include <cstring>
+   #include <netdb.h>
+   #include <arpa/inet.h>
+   #include <sys/time.h>
+   #include <sys/resource.h>
+#else
+   #include <winsock2.h>
+   #include <ws2tcpip.h>
+   #include <wspiapi.h>
+#endif
+#include <iostream>
+#include <iomanip>
+#include <udt.h>
+
+using namespace std;
+
+// measures throughput and CPU cost of a loopback transfer for a number of largest packet sizes, every
+// connection starts at 1500 bytes and finds the size it can use by path MTU probing
+
+#ifndef WIN32
+void* drain(void*);
+void* stream(void*);
+#else
+DWORD WINAPI drain(LPVOID);
+DWORD WINAPI stream(LPVOID);
+#endif
+
+volatile bool g_bDone = false;
+volatile int64_t g_llReceived = 0;
+
+void sleepms(int ms)
+{
+   #ifndef WIN32
+      usleep(ms * 1000);
+   #else
+      Sleep(ms);
+   #endif
+}
+
+void run(void* (*proc)(void*), void* arg)
+{
+   #ifndef WIN32
+      pthread_t t;
+      pthread_create(&t, NULL, proc, arg);
+      pthread_detach(t);
+   #else
+      CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)proc, arg, 0, NULL);
+   #endif
+}
+
+// user and system time of the process, in microseconds
+int64_t cputime()
+{
+   #ifndef WIN32
+      rusage ru;
+      getrusage(RUSAGE_SELF, &ru);
+      return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+   #else
+      FILETIME c, e, k, u;
+      GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u);
+      return ((((int64_t)k.dwHighDateTime << 32) | k.dwLowDateTime) + (((int64_t)u.dwHighDateTime << 32) | u.dwLowDateTime)) / 10;
+   #endif
+}
+
+UDTSOCKET prepare()
+{
+   UDTSOCKET u = UDT::socket(AF_INET, SOCK_STREAM, 0);
+   int udpbuf = 8 * 1024 * 1024;
+   bool pmtud = true;
+   UDT::setsockopt(u, 0, UDP_SNDBUF, &udpbuf, sizeof(int));
+   UDT::setsockopt(u, 0, UDP_RCVBUF, &udpbuf, sizeof(int));
+   UDT::setsockopt(u, 0, UDT_PMTUD, &pmtud, sizeof(bool));
+   return u;
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc < 2) || (argc > 3) || (0 == atoi(argv[1])))
+   {
+      cout << "usage: mtubench port [seconds]" << endl;
+      return 0;
+   }
+
+   int port = atoi(argv[1]);
+   int seconds = (3 == argc) ? atoi(argv[2]) : 5;
+   int mss[3] = {1500, 9000, 65535};
+
+   UDT::startup();
+
+   cout << setw(8) << "mss" << setw(10) << "payload" << setw(14) << "data(Mb/s)" << setw(14) << "cpu(s/GB)" << setw(12) << "packets/s" << endl;
+
+   for (int i = 0; i < 3; ++ i)
+   {
+      // a multiplexer is shared only by sockets of the same MSS, every round gets a port of its own
+      sockaddr_in server;
+      memset(&server, 0, sizeof(sockaddr_in));
+      server.sin_family = AF_INET;
+      server.sin_port = htons(port + i);
+      server.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+      UDTSOCKET serv = prepare();
+      UDT::setsockopt(serv, 0, UDT_MSS, &mss[i], sizeof(int));
+      if ((UDT::ERROR == UDT::bind(serv, (sockaddr*)&server, sizeof(sockaddr_in))) || (UDT::ERROR == UDT::listen(serv, 1)))
+      {
+         cout << "listen: " << UDT::getlasterror().getErrorMessage() << endl;
+         return 0;
+      }
+
+      UDTSOCKET client = prepare();
+      UDT::setsockopt(client, 0, UDT_MSS, &mss[i], sizeof(int));
+      if (UDT::ERROR == UDT::connect(client, (sockaddr*)&server, sizeof(sockaddr_in)))
+      {
+         cout << "connect: " << UDT::getlasterror().getErrorMessage() << endl;
+         return 0;
+      }
+
+      sockaddr_in addr;
+      int addrlen = sizeof(sockaddr_in);
+      UDTSOCKET recver = UDT::accept(serv, (sockaddr*)&addr, &addrlen);
+
+      g_bDone = false;
+      g_llReceived = 0;
+      run(drain, new UDTSOCKET(recver));
+      run(stream, new UDTSOCKET(client));
+
+      // settle, then measure
+      sleepms(1000);
+      UDT::TRACEINFO perf;
+      UDT::perfmon(client, &perf, true);
+      int64_t sent = perf.byteSentTotal;
+
+      int64_t received = g_llReceived;
+      int64_t cpu = cputime();
+      sleepms(seconds * 1000);
+      received = g_llReceived - received;
+      cpu = cputime() - cpu;
+
+      UDT::perfmon(client, &perf, true);
+      // average payload over the measurement, the probing is over by then
+      int packet = (perf.pktSent > 0) ? int((perf.byteSentTotal - sent) / perf.pktSent) : 0;
+
+      g_bDone = true;
+
+      // the sender would otherwise linger until its buffer is delivered
+      linger l;
+      l.l_onoff = 0;
+      l.l_linger = 0;
+      UDT::setsockopt(client, 0, UDT_LINGER, &l, sizeof(linger));
+
+      UDT::close(client);
+      UDT::close(recver);
+      UDT::close(serv);
+      sleepms(200);
+
+      cout << setw(8) << mss[i] << setw(10) << packet;
+      cout << setw(14) << received * 8.0 / 1000000 / seconds;
+      cout << setw(14) << ((received > 0) ? cpu / 1000000.0 / (received / 1000000000.0) : 0);
+      cout << setw(12) << perf.pktSent / seconds << endl;
+   }
+
+   UDT::cleanup();
+
+   return 0;
+}
+
+#ifndef WIN32
+void* drain(void* usocket)
+#else
+DWORD WINAPI drain(LPVOID usocket)
+#endif
+{
+   UDTSOCKET recver = *(UDTSOCKET*)usocket;
+   delete (UDTSOCKET*)usocket;
+
+   char* data = new char[1000000];
+   while (!g_bDone)
+   {
+      int rs = UDT::recv(recver, data, 1000000, 0);
+      if (UDT::ERROR == rs)
+         break;
+      g_llReceived += rs;
+   }
+   delete [] data;
+
+   return 0;
+}
+
+#ifndef WIN32
+void* stream(void* usocket)
+#else
+DWORD WINAPI stream(LPVOID usocket)
+#endif
+{
+   UDTSOCKET client = *(UDTSOCKET*)usocket;
+   delete (UDTSOCKET*)usocket;
+
+   char* data = new char[1000000];
+   memset(data, 0, 1000000);
+   while (!g_bDone)
+   {
+      if (UDT::ERROR == UDT::send(client, data, 1000000, 0))
+         break;
+   }
+   delete [] data;
+
+   return 0;
+}
@@ -0,0 +1,182 @@
+#ifndef WIN32
+   #include <unistd.h>
+   #include <cstdlib>
+   #include <cstring>
+   #include <netdb.h>
+   #include <arpa/inet.h>
+#else
+   #include <winsock2.h>
+   #include <ws2tcpip.h>
+   #include <wspiapi.h>
+#endif
+#include <iostream>
+#include <iomanip>
+#include <udt.h>
+
+using namespace std;
+
+// measures how UDT::perfmon() calls scale with the number of threads making them, every thread
+// watches a connection of its own so that only the socket lookup is shared
+
+#ifndef WIN32
+void* monitor(void*);
+#else
+DWORD WINAPI monitor(LPVOID);
+#endif
+
+volatile int g_iActive = 0;
+volatile bool g_bDone = false;
+
+struct Monitor
+{
+   int m_iIndex;
+   UDTSOCKET m_Socket;
+   volatile int64_t m_llCalls;
+   volatile int64_t m_llErrors;
+};
+
+void sleepms(int ms)
+{
+   #ifndef WIN32
+      usleep(ms * 1000);
+   #else
+      Sleep(ms);
+   #endif
+}
+
+void run(void* (*proc)(void*), void* arg)
+{
+   #ifndef WIN32
+      pthread_t t;
+      pthread_create(&t, NULL, proc, arg);
+      pthread_detach(t);
+   #else
+      CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)proc, arg, 0, NULL);
+   #endif
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc < 2) || (argc > 4) || (0 == atoi(argv[1])))
+   {
+      cout << "usage: pmbench port [threads] [seconds]" << endl;
+      return 0;
+   }
+
+   int port = atoi(argv[1]);
+   int threads = (argc >= 3) ? atoi(argv[2]) : 64;
+   int seconds = (argc >= 4) ? atoi(argv[3]) : 2;
+
+   UDT::startup();
+
+   sockaddr_in server;
+   memset(&server, 0, sizeof(sockaddr_in));
+   server.sin_family = AF_INET;
+   server.sin_port = htons(port);
+   server.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+   UDTSOCKET serv = UDT::socket(AF_INET, SOCK_STREAM, 0);
+   if ((UDT::ERROR == UDT::bind(serv, (sockaddr*)&server, sizeof(sockaddr_in))) || (UDT::ERROR == UDT::listen(serv, threads)))
+   {
+      cout << "listen: " << UDT::getlasterror().getErrorMessage() << endl;
+      return 0;
+   }
+
+   Monitor* mon = new Monitor[threads];
+   UDTSOCKET* peer = new UDTSOCKET[threads];
+   for (int i = 0; i < threads; ++ i)
+   {
+      mon[i].m_iIndex = i;
+      mon[i].m_Socket = UDT::socket(AF_INET, SOCK_STREAM, 0);
+      mon[i].m_llCalls = 0;
+      mon[i].m_llErrors = 0;
+      if (UDT::ERROR == UDT::connect(mon[i].m_Socket, (sockaddr*)&server, sizeof(sockaddr_in)))
+      {
+         cout << "connect: " << UDT::getlasterror().getErrorMessage() << endl;
+         return 0;
+      }
+
+      sockaddr_in addr;
+      int addrlen = sizeof(sockaddr_in);
+      peer[i] = UDT::accept(serv, (sockaddr*)&addr, &addrlen);
+   }
+
+   cout << setw(8) << "threads" << setw(16) << "calls/s" << setw(18) << "calls/s/thread" << endl;
+
+   // all threads start at once, in every round the first n of them call perfmon() while the others wait
+   for (int i = 0; i < threads; ++ i)
+      run(monitor, mon + i);
+
+   for (int n = 1; n <= threads; n *= 2)
+   {
+      // settle, then measure
+      g_iActive = n;
+      sleepms(200);
+
+      int64_t calls = 0;
+      int64_t errors = 0;
+      for (int i = 0; i < n; ++ i)
+      {
+         calls -= mon[i].m_llCalls;
+         errors -= mon[i].m_llErrors;
+      }
+      sleepms(seconds * 1000);
+      for (int i = 0; i < n; ++ i)
+      {
+         calls += mon[i].m_llCalls;
+         errors += mon[i].m_llErrors;
+      }
+
+      g_iActive = 0;
+      sleepms(50);
+
+      cout << setw(8) << n << setw(16) << calls / seconds << setw(18) << calls / seconds / n;
+      if (errors > 0)
+         cout << "   (" << errors << " failed calls)";
+      cout << endl;
+
+      if ((n < threads) && (n * 2 > threads))
+         n = threads / 2;
+   }
+
+   g_bDone = true;
+   sleepms(100);
+
+   for (int i = 0; i < threads; ++ i)
+   {
+      UDT::close(mon[i].m_Socket);
+      UDT::close(peer[i]);
+   }
+   UDT::close(serv);
+   UDT::cleanup();
+
+   delete [] mon;
+   delete [] peer;
+
+   return 0;
+}
+
+#ifndef WIN32
+void* monitor(void* m)
+#else
+DWORD WINAPI monitor(LPVOID m)
+#endif
+{
+   Monitor* self = (Monitor*)m;
+
+   UDT::TRACEINFO perf;
+   while (!g_bDone)
+   {
+      if (self->m_iIndex >= g_iActive)
+      {
+         sleepms(10);
+         continue;
+      }
+
+      if (UDT::ERROR == UDT::perfmon(self->m_Socket, &perf, false))
+         ++ self->m_llErrors;
+      ++ self->m_llCalls;
+   }
+
+   return 0;
+}
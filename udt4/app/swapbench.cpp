@@ -0,0 +1,126 @@
+#ifndef WIN32
+   #include <arpa/inet.h>
+   #include <cstdlib>
+   #include <cstring>
+#else
+   #include <winsock2.h>
+   #include <ws2tcpip.h>
+#endif
+#include <iostream>
+#include <iomanip>
+#include <udt.h>
+#include <common.h>
+
+using namespace std;
+
+// measures the byte order kernels that convert control packets in CChannel against the word by word
+// htonl()/ntohl() loop they replaced: hton() into a scratch buffer as on sending, ntoh() in place as on
+// receiving, for the sizes of a header, an ACK, a handshake and loss reports of a 1500 and a 9000 byte MSS
+
+int64_t g_llSink = 0;
+
+// the replaced loops, for reference
+void scalar_hton(uint32_t* dst, const uint32_t* src, int n)
+{
+   for (int i = 0; i < n; ++ i)
+      dst[i] = htonl(src[i]);
+}
+
+void scalar_ntoh(uint32_t* p, int n)
+{
+   for (int i = 0; i < n; ++ i)
+      p[i] = ntohl(p[i]);
+}
+
+// nanoseconds per call of the given variant
+double measure(int variant, uint32_t* src, uint32_t* dst, int n, int64_t calls)
+{
+   uint64_t start = CTimer::getTime();
+   for (int64_t c = 0; c < calls; ++ c)
+   {
+      switch (variant)
+      {
+      case 0:
+         scalar_hton(dst, src, n);
+         break;
+      case 1:
+         CByteOrder::hton(dst, src, n);
+         break;
+      case 2:
+         scalar_ntoh(src, n);
+         break;
+      case 3:
+         CByteOrder::ntoh(src, src, n);
+         break;
+      }
+      g_llSink += dst[c % n] + src[c % n];
+   }
+   return (CTimer::getTime() - start) * 1000.0 / calls;
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc > 2) || ((2 == argc) && (0 >= atoi(argv[1]))))
+   {
+      cout << "usage: swapbench [megabytes]" << endl;
+      return 0;
+   }
+
+   // the amount of data every measurement converts
+   int64_t total = ((2 == argc) ? atoi(argv[1]) : 2000) * 1000000LL;
+
+   const char* label[5] = {"header", "ack", "handshake", "nak/1500", "nak/9000"};
+   int words[5] = {4, 10, 12, 364, 2239};
+
+   uint32_t* src = new uint32_t[2239];
+   uint32_t* dst = new uint32_t[2239];
+   uint32_t* ref = new uint32_t[2239];
+
+   // the kernels must agree with htonl() on every length, including the tails
+   for (int n = 0; n <= 100; ++ n)
+   {
+      for (int i = 0; i < n; ++ i)
+         src[i] = rand();
+      scalar_hton(ref, src, n);
+      CByteOrder::hton(dst, src, n);
+      CByteOrder::ntoh(src, src, n);
+      if ((0 != memcmp(ref, dst, n * 4)) || (0 != memcmp(ref, src, n * 4)))
+      {
+         cout << "mismatch at " << n << " words" << endl;
+         return 1;
+      }
+   }
+
+   cout << setw(10) << "packet" << setw(7) << "words";
+   cout << setw(14) << "htonl(ns)" << setw(14) << "hton(ns)" << setw(9) << "gain";
+   cout << setw(14) << "ntohl(ns)" << setw(14) << "ntoh(ns)" << setw(9) << "gain" << endl;
+
+   for (int k = 0; k < 5; ++ k)
+   {
+      int n = words[k];
+      for (int i = 0; i < n; ++ i)
+         src[i] = rand();
+
+      int64_t calls = total / (n * 4);
+      double t[4];
+      for (int v = 0; v < 4; ++ v)
+      {
+         // warm up, then measure
+         measure(v, src, dst, n, calls / 10 + 1);
+         t[v] = measure(v, src, dst, n, calls);
+      }
+
+      cout << setw(10) << label[k] << setw(7) << n << fixed << setprecision(1);
+      cout << setw(14) << t[0] << setw(14) << t[1] << setw(8) << t[0] / t[1] << "x";
+      cout << setw(14) << t[2] << setw(14) << t[3] << setw(8) << t[2] / t[3] << "x" << endl;
+   }
+
+   if (0 == g_llSink)
+      cout << endl;
+
+   delete [] src;
+   delete [] dst;
+   delete [] ref;
+
+   return 0;
+}
@@ -0,0 +1,108 @@
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <udt.h>
+
+using namespace std;
+
+// converts a trace ring dump written by UDT::tracedump() into a timeline, one event per line
+
+const char* eventName(int type)
+{
+   switch (type)
+   {
+   case UDT_TRACE_SEND:
+      return "send";
+   case UDT_TRACE_RETRANS:
+      return "retrans";
+   case UDT_TRACE_ACK:
+      return "ack";
+   case UDT_TRACE_NAK:
+      return "nak";
+   case UDT_TRACE_LOSS:
+      return "loss";
+   case UDT_TRACE_TIMEOUT:
+      return "timeout";
+   case UDT_TRACE_CC:
+      return "cc";
+   case UDT_TRACE_CC_USER:
+      return "cc_user";
+   default:
+      return "unknown";
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   if ((argc < 2) || (argc > 3) || ((3 == argc) && (0 != strcmp(argv[2], "csv"))))
+   {
+      cout << "usage: traceview dump_file [csv]" << endl;
+      return 0;
+   }
+
+   bool csv = (3 == argc);
+
+   ifstream ifs(argv[1], ios::in | ios::binary);
+   if (!ifs)
+   {
+      cout << "cannot open " << argv[1] << endl;
+      return -1;
+   }
+
+   CTraceHeader header;
+   ifs.read((char*)&header, sizeof(CTraceHeader));
+   if (!ifs || (0 != memcmp(header.magic, "UDTTRACE", 8)) || (1 != header.version))
+   {
+      cout << argv[1] << " is not a UDT trace dump" << endl;
+      return -1;
+   }
+
+   if (header.ticksPerUs <= 0)
+      header.ticksPerUs = 1;
+
+   if (csv)
+      cout << "time_us,event,seqno,snd_period_us,cwnd,value" << endl;
+   else
+   {
+      time_t start = time_t(header.startTime / 1000000);
+      cout << "# socket " << header.socket << ", " << header.count << " events, tracing started " << ctime(&start);
+      cout << "#" << setw(13) << "time_us" << setw(10) << "event" << setw(12) << "seqno" << setw(14) << "snd_period_us" << setw(12) << "cwnd" << setw(14) << "value" << endl;
+   }
+
+   cout << fixed;
+
+   int64_t expected = -1;
+   CTraceEvent e;
+   for (int64_t i = 0; i < header.count; ++ i)
+   {
+      ifs.read((char*)&e, sizeof(CTraceEvent));
+      if (!ifs)
+      {
+         cout << "# dump truncated after " << i << " events" << endl;
+         return -1;
+      }
+
+      // the ring overwrites its oldest events and skips the ones being written during the dump
+      if ((expected >= 0) && (e.index != expected) && !csv)
+         cout << "# " << e.index - expected << " events missing" << endl;
+      expected = e.index + 1;
+
+      double time = double(int64_t(e.tsc - header.startTSC)) / header.ticksPerUs;
+
+      if (csv)
+      {
+         cout << setprecision(3) << time << "," << eventName(e.type) << "," << e.seqno << ","
+              << e.sndPeriod << "," << e.cwnd << "," << e.value << endl;
+      }
+      else
+      {
+         cout << setprecision(3) << setw(14) << time << setw(10) << eventName(e.type) << setw(12) << e.seqno
+              << setw(14) << e.sndPeriod << setw(12) << e.cwnd << setw(14) << e.value << endl;
+      }
+   }
+
+   return 0;
+}
@@ -47,6 +47,7 @@ written by
 #else
    #include <unistd.h>
 #endif
+#include <cstdlib>
 #include <cstring>
 #include "api.h"
 #include "core.h"
@@ -110,8 +111,172 @@ CUDTSocket::~CUDTSocket()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+CSocketTable::CSocketTable():
+m_vRetired(),
+m_llEpoch(0)
+{
+   for (int i = 0; i < m_iShardCount; ++ i)
+      m_pShard[i] = newShard(0);
+
+   m_pllReaders[0][0] = m_pllReaders[1][0] = 0;
+}
+
+CSocketTable::~CSocketTable()
+{
+   for (int i = 0; i < m_iShardCount; ++ i)
+      free(m_pShard[i]);
+
+   for (vector<pair<int64_t, Shard*> >::iterator i = m_vRetired.begin(); i != m_vRetired.end(); ++ i)
+      free(i->second);
+}
+
+CUDTSocket* CSocketTable::find(const UDTSOCKET& u) const
+{
+   // count this reader in the current epoch; if the epoch has moved on meanwhile, reclaim() may not have
+   // seen the count, and the reader counts itself in the new one instead
+   volatile int64_t* readers;
+   while (true)
+   {
+      int64_t epoch = CAtomic::load(m_llEpoch);
+      readers = &m_pllReaders[epoch & 1][0];
+      CAtomic::add(*readers, 1);
+      CAtomic::fullFence();
+      if (CAtomic::acquire(m_llEpoch) == epoch)
+         break;
+      CAtomic::add(*readers, -1);
+   }
+
+   // the shard is filled before it is published, see replace()
+   const Shard* s = m_pShard[u & (m_iShardCount - 1)];
+   CAtomic::acquireFence();
+
+   CUDTSocket* found = NULL;
+   int l = 0;
+   int h = s->m_iCount - 1;
+   while (l <= h)
+   {
+      int m = (l + h) / 2;
+      if (s->m_pEntry[m].m_SocketID == u)
+      {
+         found = s->m_pEntry[m].m_pSocket;
+         break;
+      }
+
+      if (s->m_pEntry[m].m_SocketID < u)
+         l = m + 1;
+      else
+         h = m - 1;
+   }
+
+   // the shard is not read after the count drops
+   CAtomic::fullFence();
+   CAtomic::add(*readers, -1);
+
+   return found;
+}
+
+void CSocketTable::insert(CUDTSocket* s)
+{
+   int index = s->m_SocketID & (m_iShardCount - 1);
+   const Shard* os = m_pShard[index];
+
+   int pos = 0;
+   while ((pos < os->m_iCount) && (os->m_pEntry[pos].m_SocketID < s->m_SocketID))
+      ++ pos;
+   bool exist = (pos < os->m_iCount) && (os->m_pEntry[pos].m_SocketID == s->m_SocketID);
+
+   Shard* ns = newShard(exist ? os->m_iCount : os->m_iCount + 1);
+   memcpy(ns->m_pEntry, os->m_pEntry, pos * sizeof(Shard::Entry));
+   ns->m_pEntry[pos].m_SocketID = s->m_SocketID;
+   ns->m_pEntry[pos].m_pSocket = s;
+   int next = exist ? pos + 1 : pos;
+   memcpy(ns->m_pEntry + pos + 1, os->m_pEntry + next, (os->m_iCount - next) * sizeof(Shard::Entry));
+
+   replace(index, ns);
+}
+
+void CSocketTable::erase(const UDTSOCKET& u)
+{
+   int index = u & (m_iShardCount - 1);
+   const Shard* os = m_pShard[index];
+
+   int pos = 0;
+   while ((pos < os->m_iCount) && (os->m_pEntry[pos].m_SocketID != u))
+      ++ pos;
+   if (pos == os->m_iCount)
+      return;
+
+   Shard* ns = newShard(os->m_iCount - 1);
+   memcpy(ns->m_pEntry, os->m_pEntry, pos * sizeof(Shard::Entry));
+   memcpy(ns->m_pEntry + pos, os->m_pEntry + pos + 1, (os->m_iCount - pos - 1) * sizeof(Shard::Entry));
+
+   replace(index, ns);
+}
+
+void CSocketTable::clear()
+{
+   for (int i = 0; i < m_iShardCount; ++ i)
+   {
+      if (m_pShard[i]->m_iCount > 0)
+         replace(i, newShard(0));
+   }
+}
+
+uint64_t CSocketTable::reclaim()
+{
+   // a new epoch is only started once the readers of the one before the current have left, so the readers
+   // that can still scan a shard replaced in an earlier epoch are all counted by the parity of the previous one
+   int64_t epoch = m_llEpoch;
+   CAtomic::fullFence();
+   if (0 != CAtomic::load(m_pllReaders[(epoch - 1) & 1][0]))
+      return CTimer::getTime() + m_iReclaimInterval;
+
+   // the shards are retired in epoch order
+   vector<pair<int64_t, Shard*> >::iterator i = m_vRetired.begin();
+   for (; (i != m_vRetired.end()) && (i->first < epoch); ++ i)
+      free(i->second);
+   m_vRetired.erase(m_vRetired.begin(), i);
+
+   if (m_vRetired.empty())
+      return 0;
+
+   // the shards replaced in the current epoch can be freed once the readers counted in it have left;
+   // the new readers will see the new shards only
+   CAtomic::publish(m_llEpoch, epoch + 1);
+   return CTimer::getTime() + m_iReclaimInterval;
+}
+
+CSocketTable::Shard* CSocketTable::newShard(const int& count)
+{
+   Shard* s = (Shard*)malloc(sizeof(Shard) + (count > 0 ? count - 1 : 0) * sizeof(Shard::Entry));
+   if (NULL == s)
+      throw CUDTException(3, 2, 0);
+
+   s->m_iCount = count;
+   return s;
+}
+
+void CSocketTable::replace(const int& index, Shard* s)
+{
+   try
+   {
+      m_vRetired.push_back(pair<int64_t, Shard*>(m_llEpoch, m_pShard[index]));
+   }
+   catch (...)
+   {
+      free(s);
+      throw CUDTException(3, 2, 0);
+   }
+
+   CAtomic::releaseFence();
+   m_pShard[index] = s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 CUDTUnited::CUDTUnited():
 m_Sockets(),
+m_SocketTable(),
 m_ControlLock(),
 m_IDLock(),
 m_SocketID(0),
@@ -119,6 +284,7 @@ m_TLSError(),
 m_mMultiplexer(),
 m_MultiplexerLock(),
 m_pCache(NULL),
+m_BufferBudget(),
 m_bClosing(false),
 m_GCStopLock(),
 m_GCStopCond(),
@@ -126,7 +292,9 @@ m_InitLock(),
 m_iInstanceCount(0),
 m_bGCStatus(false),
 m_GCThread(),
-m_ClosedSockets()
+m_ClosedSockets(),
+m_vGCEvents(),
+m_GCQueue()
 {
    // Socket ID MUST start from a random value
    srand((unsigned int)CTimer::getTime());
@@ -225,13 +393,20 @@ int CUDTUnited::cleanup()
    if (!m_bGCStatus)
       return 0;
 
-   m_bClosing = true;
+   // pending asynchronous operations fail before the sockets go away
+   m_AsyncIO.stop();
+
    #ifndef WIN32
+      // the GC thread may wait without a timeout, it checks m_bClosing under the lock before it does
+      pthread_mutex_lock(&m_GCStopLock);
+      m_bClosing = true;
       pthread_cond_signal(&m_GCStopCond);
+      pthread_mutex_unlock(&m_GCStopLock);
       pthread_join(m_GCThread, NULL);
       pthread_mutex_destroy(&m_GCStopLock);
       pthread_cond_destroy(&m_GCStopCond);
    #else
+      m_bClosing = true;
       SetEvent(m_GCStopCond);
       WaitForSingleObject(m_GCThread, INFINITE);
       CloseHandle(m_GCThread);
@@ -293,10 +468,12 @@ UDTSOCKET CUDTUnited::newSocket(const int& af, const int& type)
    try
    {
       m_Sockets[ns->m_SocketID] = ns;
+      m_SocketTable.insert(ns);
    }
    catch (...)
    {
       //failure and rollback
+      m_Sockets.erase(ns->m_SocketID);
       delete ns;
       ns = NULL;
    }
@@ -308,7 +485,7 @@ UDTSOCKET CUDTUnited::newSocket(const int& af, const int& type)
    return ns->m_SocketID;
 }
 
-int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHandShake* hs)
+int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHandShake* hs, const char* earlydata, const int& earlysize)
 {
    CUDTSocket* ns = NULL;
    CUDTSocket* ls = locate(listen);
@@ -340,6 +517,10 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
          hs->m_iFlightFlagSize = ns->m_pUDT->m_iFlightFlagSize;
          hs->m_iReqType = -1;
          hs->m_iID = ns->m_SocketID;
+         hs->m_iACKMode = ns->m_pUDT->m_bAdaptiveACK ? 1 : 0;
+         hs->m_iLossMode = ns->m_pUDT->m_bCompactNAK ? 1 : 0;
+         hs->m_iFECMode = ns->m_pUDT->m_bFEC ? CFECEncoder::m_iInitGroupSize : 1;
+         hs->m_iToken = ns->m_pUDT->m_iToken;
 
          return 0;
 
@@ -393,6 +574,7 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
       // bind to the same addr of listening socket
       ns->m_pUDT->open();
       updateMux(ns, ls);
+      ns->m_pUDT->setEarlyData(earlydata, earlysize);
       ns->m_pUDT->connect(peer, hs);
    }
    catch (...)
@@ -412,6 +594,7 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
    try
    {
       m_Sockets[ns->m_SocketID] = ns;
+      m_SocketTable.insert(ns);
       m_PeerRec[(ns->m_PeerID << 30) + ns->m_iISN].insert(ns->m_SocketID);
    }
    catch (...)
@@ -457,31 +640,26 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
 
 CUDT* CUDTUnited::lookup(const UDTSOCKET u)
 {
-   // protects the m_Sockets structure
-   CGuard cg(m_ControlLock);
+   // a socket is deleted at least 1 second after it leaves the table, see reapSocket()
+   CUDTSocket* s = m_SocketTable.find(u);
 
-   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
-
-   if ((i == m_Sockets.end()) || (i->second->m_Status == CUDTSocket::CLOSED))
+   if ((NULL == s) || (s->m_Status == CUDTSocket::CLOSED))
       throw CUDTException(5, 4, 0);
 
-   return i->second->m_pUDT;
+   return s->m_pUDT;
 }
 
 CUDTSocket::UDTSTATUS CUDTUnited::getStatus(const UDTSOCKET u)
 {
-   // protects the m_Sockets structure
-   CGuard cg(m_ControlLock);
+   CUDTSocket* s = m_SocketTable.find(u);
 
-   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
-
-   if (i == m_Sockets.end())
+   if (NULL == s)
       return CUDTSocket::INIT;
 
-   if (i->second->m_pUDT->m_bBroken)
+   if (s->m_pUDT->m_bBroken)
       return CUDTSocket::BROKEN;
 
-   return i->second->m_Status;   
+   return s->m_Status;
 }
 
 int CUDTUnited::bind(const UDTSOCKET u, const sockaddr* name, const int& namelen)
@@ -557,6 +735,55 @@ int CUDTUnited::bind(UDTSOCKET u, UDPSOCKET udpsock)
    return 0;
 }
 
+int CUDTUnited::addPath(const UDTSOCKET u, const sockaddr* name, const int& namelen, const sockaddr* peer, const int& peerlen)
+{
+   CUDTSocket* s = locate(u);
+
+   if (NULL == s)
+      throw CUDTException(5, 4, 0);
+
+   if (CUDTSocket::CONNECTED != s->m_Status)
+      throw CUDTException(2, 2, 0);
+
+   // check the size of SOCKADDR structure
+   int len = (AF_INET == s->m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+   if ((NULL == name) || (namelen != len) || ((NULL != peer) && (peerlen != len)))
+      throw CUDTException(5, 3, 0);
+
+   // a path has a multiplexer of its own, bound to its local address and never shared
+   CMultiplexer m;
+   m.m_bReusable = false;
+
+   CGuard::enterCS(m_IDLock);
+   m.m_iID = -- m_SocketID;
+   CGuard::leaveCS(m_IDLock);
+
+   CGuard::enterCS(m_ControlLock);
+   try
+   {
+      createMux(m, s->m_pUDT, name, NULL);
+   }
+   catch (...)
+   {
+      CGuard::leaveCS(m_ControlLock);
+      throw;
+   }
+   CGuard::leaveCS(m_ControlLock);
+
+   try
+   {
+      s->m_pUDT->addPath(m.m_iID, m.m_pSndQueue, (NULL != peer) ? peer : s->m_pPeerAddr);
+   }
+   catch (...)
+   {
+      CGuard cg(m_ControlLock);
+      releaseMux(m.m_iID);
+      throw;
+   }
+
+   return 0;
+}
+
 int CUDTUnited::listen(const UDTSOCKET u, const int& backlog)
 {
    CUDTSocket* s = locate(u);
@@ -774,6 +1001,7 @@ int CUDTUnited::close(const UDTSOCKET u)
 
       s->m_TimeStamp = CTimer::getTime();
       s->m_pUDT->m_bBroken = true;
+      notifyGC(u);
 
       // broadcast all "accept" waiting
       #ifndef WIN32
@@ -789,6 +1017,8 @@ int CUDTUnited::close(const UDTSOCKET u)
 
    s->m_pUDT->close();
 
+   m_AsyncIO.cancel(u);
+
    // synchronize with garbage collection.
    CGuard cg(m_ControlLock);
 
@@ -806,8 +1036,11 @@ int CUDTUnited::close(const UDTSOCKET u)
    s->m_TimeStamp = CTimer::getTime();
 
    m_Sockets.erase(s->m_SocketID);
+   m_SocketTable.erase(s->m_SocketID);
    m_ClosedSockets.insert(pair<UDTSOCKET, CUDTSocket*>(s->m_SocketID, s));
 
+   notifyGC(u);
+
    CTimer::triggerEvent();
 
    return 0;
@@ -831,8 +1064,8 @@ int CUDTUnited::getpeername(const UDTSOCKET u, sockaddr* name, int* namelen)
    else
       *namelen = sizeof(sockaddr_in6);
 
-   // copy address information of peer node
-   memcpy(name, s->m_pPeerAddr, *namelen);
+   // copy address information of peer node, the peer may have moved since the connection was set up
+   memcpy(name, s->m_pUDT->m_pPeerAddr, *namelen);
 
    return 0;
 }
@@ -940,7 +1173,7 @@ int CUDTUnited::select(ud_set* readfds, ud_set* writefds, ud_set* exceptfds, con
       {
          s = *j2;
 
-         if ((s->m_pUDT->m_bConnected && (s->m_pUDT->m_pSndBuffer->getCurrBufSize() < s->m_pUDT->m_iSndBufSize))
+         if ((s->m_pUDT->m_bConnected && (s->m_pUDT->m_pSndBuffer->getCurrBufSize() < s->m_pUDT->m_iSndBufLimit))
             || s->m_pUDT->m_bBroken || !s->m_pUDT->m_bConnected || (s->m_Status == CUDTSocket::CLOSED))
          {
             ws.insert(s->m_SocketID);
@@ -1019,7 +1252,7 @@ int CUDTUnited::selectEx(const vector<UDTSOCKET>& fds, vector<UDTSOCKET>* readfd
 
          if (NULL != writefds)
          {
-            if (s->m_pUDT->m_bConnected && (s->m_pUDT->m_pSndBuffer->getCurrBufSize() < s->m_pUDT->m_iSndBufSize))
+            if (s->m_pUDT->m_bConnected && (s->m_pUDT->m_pSndBuffer->getCurrBufSize() < s->m_pUDT->m_iSndBufLimit))
             {
                writefds->push_back(s->m_SocketID);
                ++ count;
@@ -1064,16 +1297,14 @@ int CUDTUnited::epoll_add_ssock(const int eid, const SYSSOCKET s, const int* eve
 int CUDTUnited::epoll_remove_usock(const int eid, const UDTSOCKET u, const int* events)
 {
    CUDTSocket* s = locate(u);
-   if (NULL != s)
-   {
-      s->m_pUDT->removeEPoll(eid);
-   }
-   else
-   {
+   if (NULL == s)
       throw CUDTException(5, 4);
-   }
 
-   return m_EPoll.remove_usock(eid, u, events);
+   // stop the socket from signaling this epoll once no event is watched any more, however many calls that took
+   if (1 == m_EPoll.remove_usock(eid, u, events))
+      s->m_pUDT->removeEPoll(eid);
+
+   return 0;
 }
 
 int CUDTUnited::epoll_remove_ssock(const int eid, const SYSSOCKET s, const int* events)
@@ -1093,14 +1324,12 @@ int CUDTUnited::epoll_release(const int eid)
 
 CUDTSocket* CUDTUnited::locate(const UDTSOCKET u)
 {
-   CGuard cg(m_ControlLock);
+   CUDTSocket* s = m_SocketTable.find(u);
 
-   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
-
-   if ((i == m_Sockets.end()) || (i->second->m_Status == CUDTSocket::CLOSED))
+   if ((NULL == s) || (s->m_Status == CUDTSocket::CLOSED))
       return NULL;
 
-   return i->second;
+   return s;
 }
 
 CUDTSocket* CUDTUnited::locate(const UDTSOCKET /*u*/, const sockaddr* peer, const UDTSOCKET& id, const int32_t& isn)
@@ -1125,67 +1354,108 @@ CUDTSocket* CUDTUnited::locate(const UDTSOCKET /*u*/, const sockaddr* peer, cons
    return NULL;
 }
 
-void CUDTUnited::checkBrokenSockets()
+void CUDTUnited::notifyGC(const UDTSOCKET u)
+{
+   CGuard gcguard(m_GCStopLock);
+
+   m_vGCEvents.push_back(u);
+
+   #ifndef WIN32
+      pthread_cond_signal(&m_GCStopCond);
+   #else
+      SetEvent(m_GCStopCond);
+   #endif
+}
+
+uint64_t CUDTUnited::reapSockets(const vector<UDTSOCKET>& events)
 {
    CGuard cg(m_ControlLock);
 
-   // set of sockets To Be Closed and To Be Removed
-   vector<UDTSOCKET> tbc;
-   vector<UDTSOCKET> tbr;
+   uint64_t currtime = CTimer::getTime();
+
+   for (vector<UDTSOCKET>::const_iterator i = events.begin(); i != events.end(); ++ i)
+      reapSocket(*i, currtime);
 
-   for (map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.begin(); i != m_Sockets.end(); ++ i)
+   // a socket may be queued again while the due ones are handled, but never for the current time
+   while (!m_GCQueue.empty() && (m_GCQueue.begin()->first <= currtime))
    {
+      UDTSOCKET u = m_GCQueue.begin()->second;
+      m_GCQueue.erase(m_GCQueue.begin());
+      reapSocket(u, currtime);
+   }
+
+   uint64_t next = m_SocketTable.reclaim();
+
+   if (!m_GCQueue.empty() && ((0 == next) || (m_GCQueue.begin()->first < next)))
+      next = m_GCQueue.begin()->first;
+
+   return next;
+}
+
+void CUDTUnited::reapSocket(const UDTSOCKET u, const uint64_t& currtime)
+{
+   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
+
+   if (i != m_Sockets.end())
+   {
+      CUDTSocket* s = i->second;
+
       // check broken connection
-      if (i->second->m_pUDT->m_bBroken)
+      if (!s->m_pUDT->m_bBroken)
+         return;
+
+      if (s->m_Status == CUDTSocket::LISTENING)
       {
-         if (i->second->m_Status == CUDTSocket::LISTENING)
+         // for a listening socket, it should wait an extra 3 seconds in case a client is connecting
+         if (currtime - s->m_TimeStamp < 3000000)
          {
-            // for a listening socket, it should wait an extra 3 seconds in case a client is connecting
-            if (CTimer::getTime() - i->second->m_TimeStamp < 3000000)
-               continue;
+            m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(s->m_TimeStamp + 3000000, u));
+            return;
          }
-         else if ((i->second->m_pUDT->m_pRcvBuffer->getRcvDataSize() > 0) && (i->second->m_pUDT->m_iBrokenCounter -- > 0))
-         {
-            // if there is still data in the receiver buffer, wait longer
-            continue;
-         }
-
-         //close broken connections and start removal timer
-         i->second->m_Status = CUDTSocket::CLOSED;
-         i->second->m_TimeStamp = CTimer::getTime();
-         tbc.push_back(i->first);
-         m_ClosedSockets[i->first] = i->second;
+      }
+      else if ((s->m_pUDT->m_pRcvBuffer->getRcvDataSize() > 0) && (s->m_pUDT->m_iBrokenCounter -- > 0))
+      {
+         // if there is still data in the receiver buffer, wait longer
+         m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(currtime + 1000000, u));
+         return;
+      }
 
-         // remove from listener's queue
-         map<UDTSOCKET, CUDTSocket*>::iterator ls = m_Sockets.find(i->second->m_ListenSocket);
-         if (ls == m_Sockets.end())
-         {
-            ls = m_ClosedSockets.find(i->second->m_ListenSocket);
-            if (ls == m_ClosedSockets.end())
-               continue;
-         }
+      //close broken connections and start removal timer
+      s->m_Status = CUDTSocket::CLOSED;
+      s->m_TimeStamp = currtime;
+      m_ClosedSockets[u] = s;
+      m_Sockets.erase(i);
+      m_SocketTable.erase(u);
+      m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(currtime + 1000000, u));
 
-         CGuard::enterCS(ls->second->m_AcceptLock);
-         ls->second->m_pQueuedSockets->erase(i->second->m_SocketID);
-         ls->second->m_pAcceptSockets->erase(i->second->m_SocketID);
-         CGuard::leaveCS(ls->second->m_AcceptLock);
+      // remove from listener's queue
+      map<UDTSOCKET, CUDTSocket*>::iterator ls = m_Sockets.find(s->m_ListenSocket);
+      if (ls == m_Sockets.end())
+      {
+         ls = m_ClosedSockets.find(s->m_ListenSocket);
+         if (ls == m_ClosedSockets.end())
+            return;
       }
-   }
 
-   for (map<UDTSOCKET, CUDTSocket*>::iterator j = m_ClosedSockets.begin(); j != m_ClosedSockets.end(); ++ j)
-   {
-      // timeout 1 second to destroy a socket AND it has been removed from RcvUList
-      if ((CTimer::getTime() - j->second->m_TimeStamp > 1000000) && ((NULL == j->second->m_pUDT->m_pRNode) || !j->second->m_pUDT->m_pRNode->m_bOnList))
-         tbr.push_back(j->first);
+      CGuard::enterCS(ls->second->m_AcceptLock);
+      ls->second->m_pQueuedSockets->erase(u);
+      ls->second->m_pAcceptSockets->erase(u);
+      CGuard::leaveCS(ls->second->m_AcceptLock);
+
+      return;
    }
 
-   // move closed sockets to the ClosedSockets structure
-   for (vector<UDTSOCKET>::iterator k = tbc.begin(); k != tbc.end(); ++ k)
-      m_Sockets.erase(*k);
+   i = m_ClosedSockets.find(u);
+   if (i == m_ClosedSockets.end())
+      return;
 
-   // remove those timeout sockets
-   for (vector<UDTSOCKET>::iterator l = tbr.begin(); l != tbr.end(); ++ l)
-      removeSocket(*l);
+   // timeout 1 second to destroy a socket AND it has been removed from RcvUList
+   if (currtime - i->second->m_TimeStamp <= 1000000)
+      m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(i->second->m_TimeStamp + 1000001, u));
+   else if ((NULL != i->second->m_pUDT->m_pRNode) && i->second->m_pUDT->m_pRNode->m_bOnList)
+      m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(currtime + 10000, u));
+   else
+      removeSocket(u);
 }
 
 void CUDTUnited::removeSocket(const UDTSOCKET u)
@@ -1196,6 +1466,18 @@ void CUDTUnited::removeSocket(const UDTSOCKET u)
    if (i == m_ClosedSockets.end())
       return;
 
+   // a listener leaves its receiving queue first; a request the handshaker is still serving holds
+   // it, and the socket is removed on a later round
+   if ((NULL != i->second->m_pQueuedSockets) && (NULL != i->second->m_pUDT->m_pRcvQueue))
+   {
+      i->second->m_pUDT->close();
+      if (i->second->m_pUDT->m_pRcvQueue->ifServing(i->second->m_pUDT))
+      {
+         m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(CTimer::getTime() + 10000, u));
+         return;
+      }
+   }
+
    // decrease multiplexer reference count, and remove it if necessary
    const int mid = i->second->m_iMuxID;
 
@@ -1212,6 +1494,8 @@ void CUDTUnited::removeSocket(const UDTSOCKET u)
          m_Sockets[*q]->m_Status = CUDTSocket::CLOSED;
          m_ClosedSockets[*q] = m_Sockets[*q];
          m_Sockets.erase(*q);
+         m_SocketTable.erase(*q);
+         m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(m_ClosedSockets[*q]->m_TimeStamp + 1000001, *q));
       }
 
       CGuard::leaveCS(i->second->m_AcceptLock);
@@ -1228,9 +1512,19 @@ void CUDTUnited::removeSocket(const UDTSOCKET u)
 
    // delete this one
    i->second->m_pUDT->close();
+
+   // the additional paths have stopped sending, their multiplexers are not shared
+   for (int k = 0; k < i->second->m_pUDT->getPathCount(); ++ k)
+      releaseMux(i->second->m_pUDT->m_pPath[k]->m_iMuxID);
+
    delete i->second;
    m_ClosedSockets.erase(i);
 
+   releaseMux(mid);
+}
+
+void CUDTUnited::releaseMux(const int& mid)
+{
    map<int, CMultiplexer>::iterator m;
    m = m_mMultiplexer.find(mid);
    if (m == m_mMultiplexer.end())
@@ -1319,7 +1613,7 @@ void CUDTUnited::updateMux(CUDTSocket* s, const sockaddr* addr, const UDPSOCKET*
       // find a reusable address
       for (map<int, CMultiplexer>::iterator i = m_mMultiplexer.begin(); i != m_mMultiplexer.end(); ++ i)
       {
-         if ((i->second.m_iIPversion == s->m_pUDT->m_iIPversion) && (i->second.m_iMSS == s->m_pUDT->m_iMSS) && i->second.m_bReusable)
+         if ((i->second.m_iIPversion == s->m_pUDT->m_iIPversion) && (i->second.m_iMSS == s->m_pUDT->m_iMSS) && (i->second.m_bPMTUD == s->m_pUDT->m_bPMTUD) && i->second.m_bReusable)
          {
             if (i->second.m_iPort == port)
             {
@@ -1336,15 +1630,26 @@ void CUDTUnited::updateMux(CUDTSocket* s, const sockaddr* addr, const UDPSOCKET*
 
    // a new multiplexer is needed
    CMultiplexer m;
-   m.m_iMSS = s->m_pUDT->m_iMSS;
-   m.m_iIPversion = s->m_pUDT->m_iIPversion;
-   m.m_iRefCount = 1;
    m.m_bReusable = s->m_pUDT->m_bReuseAddr;
    m.m_iID = s->m_SocketID;
+   createMux(m, s->m_pUDT, addr, udpsock);
+
+   s->m_pUDT->m_pSndQueue = m.m_pSndQueue;
+   s->m_pUDT->m_pRcvQueue = m.m_pRcvQueue;
+   s->m_iMuxID = m.m_iID;
+}
+
+void CUDTUnited::createMux(CMultiplexer& m, const CUDT* u, const sockaddr* addr, const UDPSOCKET* udpsock)
+{
+   m.m_iMSS = u->m_iMSS;
+   m.m_bPMTUD = u->m_bPMTUD;
+   m.m_iIPversion = u->m_iIPversion;
+   m.m_iRefCount = 1;
 
-   m.m_pChannel = new CChannel(s->m_pUDT->m_iIPversion);
-   m.m_pChannel->setSndBufSize(s->m_pUDT->m_iUDPSndBufSize);
-   m.m_pChannel->setRcvBufSize(s->m_pUDT->m_iUDPRcvBufSize);
+   m.m_pChannel = new CChannel(u->m_iIPversion);
+   m.m_pChannel->setSndBufSize(u->m_iUDPSndBufSize);
+   m.m_pChannel->setRcvBufSize(u->m_iUDPRcvBufSize);
+   m.m_pChannel->setDontFragment(u->m_bPMTUD ? CUDT::m_iPMTUBase - 28 : 0);
 
    try
    {
@@ -1360,23 +1665,19 @@ void CUDTUnited::updateMux(CUDTSocket* s, const sockaddr* addr, const UDPSOCKET*
       throw e;
    }
 
-   sockaddr* sa = (AF_INET == s->m_pUDT->m_iIPversion) ? (sockaddr*) new sockaddr_in : (sockaddr*) new sockaddr_in6;
+   sockaddr* sa = (AF_INET == u->m_iIPversion) ? (sockaddr*) new sockaddr_in : (sockaddr*) new sockaddr_in6;
    m.m_pChannel->getSockAddr(sa);
-   m.m_iPort = (AF_INET == s->m_pUDT->m_iIPversion) ? ntohs(((sockaddr_in*)sa)->sin_port) : ntohs(((sockaddr_in6*)sa)->sin6_port);
-   if (AF_INET == s->m_pUDT->m_iIPversion) delete (sockaddr_in*)sa; else delete (sockaddr_in6*)sa;
+   m.m_iPort = (AF_INET == u->m_iIPversion) ? ntohs(((sockaddr_in*)sa)->sin_port) : ntohs(((sockaddr_in6*)sa)->sin6_port);
+   if (AF_INET == u->m_iIPversion) delete (sockaddr_in*)sa; else delete (sockaddr_in6*)sa;
 
    m.m_pTimer = new CTimer;
 
    m.m_pSndQueue = new CSndQueue;
    m.m_pSndQueue->init(m.m_pChannel, m.m_pTimer);
    m.m_pRcvQueue = new CRcvQueue;
-   m.m_pRcvQueue->init(32, s->m_pUDT->m_iPayloadSize, m.m_iIPversion, 1024, m.m_pChannel, m.m_pTimer);
+   m.m_pRcvQueue->init(32, u->m_iPayloadSize, m.m_iIPversion, 1024, m.m_pChannel, m.m_pTimer);
 
    m_mMultiplexer[m.m_iID] = m;
-
-   s->m_pUDT->m_pSndQueue = m.m_pSndQueue;
-   s->m_pUDT->m_pRcvQueue = m.m_pRcvQueue;
-   s->m_iMuxID = m.m_iID;
 }
 
 void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
@@ -1408,28 +1709,52 @@ void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
 {
    CUDTUnited* self = (CUDTUnited*)p;
 
-   CGuard gcguard(self->m_GCStopLock);
-
+   // sockets are reaped when they are reported broken or closed, and when one of them is due again
+   CGuard::enterCS(self->m_GCStopLock);
    while (!self->m_bClosing)
    {
-      self->checkBrokenSockets();
+      vector<UDTSOCKET> events;
+      events.swap(self->m_vGCEvents);
+      CGuard::leaveCS(self->m_GCStopLock);
+
+      uint64_t next = self->reapSockets(events);
 
       #ifdef WIN32
          self->checkTLSValue();
       #endif
 
+      CGuard::enterCS(self->m_GCStopLock);
+      if (self->m_bClosing || !self->m_vGCEvents.empty())
+         continue;
+
       #ifndef WIN32
-         timeval now;
-         timespec timeout;
-         gettimeofday(&now, 0);
-         timeout.tv_sec = now.tv_sec + 1;
-         timeout.tv_nsec = now.tv_usec * 1000;
+         if (0 == next)
+            pthread_cond_wait(&self->m_GCStopCond, &self->m_GCStopLock);
+         else
+         {
+            uint64_t currtime = CTimer::getTime();
+            uint64_t wait = (next > currtime) ? next - currtime : 0;
 
-         pthread_cond_timedwait(&self->m_GCStopCond, &self->m_GCStopLock, &timeout);
+            timeval now;
+            timespec timeout;
+            gettimeofday(&now, 0);
+            timeout.tv_sec = now.tv_sec + (now.tv_usec + wait) / 1000000;
+            timeout.tv_nsec = ((now.tv_usec + wait) % 1000000) * 1000;
+
+            pthread_cond_timedwait(&self->m_GCStopCond, &self->m_GCStopLock, &timeout);
+         }
       #else
-         WaitForSingleObject(self->m_GCStopCond, 1000);
+         // the TLS records of exited threads are still checked every second
+         CGuard::leaveCS(self->m_GCStopLock);
+         uint64_t currtime = CTimer::getTime();
+         DWORD wait = 1000;
+         if ((0 != next) && (next < currtime + 1000000))
+            wait = (next > currtime) ? DWORD((next - currtime + 999) / 1000) : 0;
+         WaitForSingleObject(self->m_GCStopCond, wait);
+         CGuard::enterCS(self->m_GCStopLock);
       #endif
    }
+   CGuard::leaveCS(self->m_GCStopLock);
 
    // remove all sockets and multiplexers
    CGuard::enterCS(self->m_ControlLock);
@@ -1456,6 +1781,7 @@ void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
       CGuard::leaveCS(ls->second->m_AcceptLock);
    }
    self->m_Sockets.clear();
+   self->m_SocketTable.clear();
 
    for (map<UDTSOCKET, CUDTSocket*>::iterator j = self->m_ClosedSockets.begin(); j != self->m_ClosedSockets.end(); ++ j)
    {
@@ -1465,10 +1791,22 @@ void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
 
    while (true)
    {
-      self->checkBrokenSockets();
-
       CGuard::enterCS(self->m_ControlLock);
+
+      // timeout 1 second to destroy a socket AND it has been removed from RcvUList
+      vector<UDTSOCKET> tbr;
+      for (map<UDTSOCKET, CUDTSocket*>::iterator j = self->m_ClosedSockets.begin(); j != self->m_ClosedSockets.end(); ++ j)
+      {
+         if ((CTimer::getTime() - j->second->m_TimeStamp > 1000000) && ((NULL == j->second->m_pUDT->m_pRNode) || !j->second->m_pUDT->m_pRNode->m_bOnList))
+            tbr.push_back(j->first);
+      }
+
+      for (vector<UDTSOCKET>::iterator l = tbr.begin(); l != tbr.end(); ++ l)
+         self->removeSocket(*l);
+
       bool empty = self->m_ClosedSockets.empty();
+      if (empty)
+         self->m_GCQueue.clear();
       CGuard::leaveCS(self->m_ControlLock);
 
       if (empty)
@@ -1477,6 +1815,10 @@ void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
       CTimer::sleep();
    }
 
+   CGuard::enterCS(self->m_GCStopLock);
+   self->m_vGCEvents.clear();
+   CGuard::leaveCS(self->m_GCStopLock);
+
    #ifndef WIN32
       return NULL;
    #else
@@ -1769,6 +2111,60 @@ int CUDT::recv(UDTSOCKET u, char* buf, int len, int)
    }
 }
 
+int CUDT::sendv(UDTSOCKET u, const iovec* iov, int iovcnt, int)
+{
+   try
+   {
+      if ((iovcnt < 0) || ((NULL == iov) && (iovcnt > 0)))
+         throw CUDTException(5, 3, 0);
+
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->sendv(iov, iovcnt);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::recvv(UDTSOCKET u, const iovec* iov, int iovcnt, int)
+{
+   try
+   {
+      if ((iovcnt < 0) || ((NULL == iov) && (iovcnt > 0)))
+         throw CUDTException(5, 3, 0);
+
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->recvv(iov, iovcnt);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
 int CUDT::sendmsg(UDTSOCKET u, const char* buf, int len, int ttl, bool inorder)
 {
    try
@@ -1855,6 +2251,166 @@ int64_t CUDT::recvfile(UDTSOCKET u, fstream& ofs, int64_t& offset, const int64_t
    }
 }
 
+int CUDT::async_send(UDTSOCKET u, const char* buf, int len, UDT_ASYNC_HANDLER handler, void* context)
+{
+   try
+   {
+      if ((NULL == buf) || (len <= 0) || (NULL == handler))
+         throw CUDTException(5, 3, 0);
+
+      CAsyncOp* op = new CAsyncOp;
+      op->m_Type = CAsyncOp::SEND;
+      op->m_Socket = u;
+      op->m_pcData = (char*)buf;
+      op->m_iLength = len;
+      op->m_pFile = NULL;
+      op->m_llOffset = 0;
+      op->m_llSize = len;
+      op->m_iBlock = 0;
+      op->m_llDone = 0;
+      op->m_pHandler = handler;
+      op->m_pContext = context;
+
+      s_UDTUnited.m_AsyncIO.submit(op);
+      return 0;
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::async_recv(UDTSOCKET u, char* buf, int len, UDT_ASYNC_HANDLER handler, void* context)
+{
+   try
+   {
+      if ((NULL == buf) || (len <= 0) || (NULL == handler))
+         throw CUDTException(5, 3, 0);
+
+      CAsyncOp* op = new CAsyncOp;
+      op->m_Type = CAsyncOp::RECV;
+      op->m_Socket = u;
+      op->m_pcData = buf;
+      op->m_iLength = len;
+      op->m_pFile = NULL;
+      op->m_llOffset = 0;
+      op->m_llSize = len;
+      op->m_iBlock = 0;
+      op->m_llDone = 0;
+      op->m_pHandler = handler;
+      op->m_pContext = context;
+
+      s_UDTUnited.m_AsyncIO.submit(op);
+      return 0;
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::async_sendfile(UDTSOCKET u, fstream& ifs, int64_t offset, int64_t size, UDT_ASYNC_HANDLER handler, void* context, int block)
+{
+   try
+   {
+      if ((offset < 0) || (size <= 0) || (block <= 0) || (NULL == handler))
+         throw CUDTException(5, 3, 0);
+
+      CAsyncOp* op = new CAsyncOp;
+      op->m_Type = CAsyncOp::SENDFILE;
+      op->m_Socket = u;
+      op->m_pcData = NULL;
+      op->m_iLength = 0;
+      op->m_pFile = &ifs;
+      op->m_llOffset = offset;
+      op->m_llSize = size;
+      op->m_iBlock = block;
+      op->m_llDone = 0;
+      op->m_pHandler = handler;
+      op->m_pContext = context;
+
+      s_UDTUnited.m_AsyncIO.submit(op);
+      return 0;
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::async_recvfile(UDTSOCKET u, fstream& ofs, int64_t offset, int64_t size, UDT_ASYNC_HANDLER handler, void* context, int block)
+{
+   try
+   {
+      if ((offset < 0) || (size <= 0) || (block <= 0) || (NULL == handler))
+         throw CUDTException(5, 3, 0);
+
+      CAsyncOp* op = new CAsyncOp;
+      op->m_Type = CAsyncOp::RECVFILE;
+      op->m_Socket = u;
+      op->m_pcData = NULL;
+      op->m_iLength = 0;
+      op->m_pFile = &ofs;
+      op->m_llOffset = offset;
+      op->m_llSize = size;
+      op->m_iBlock = block;
+      op->m_llDone = 0;
+      op->m_pHandler = handler;
+      op->m_pContext = context;
+
+      s_UDTUnited.m_AsyncIO.submit(op);
+      return 0;
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
 int CUDT::select(int, ud_set* readfds, ud_set* writefds, ud_set* exceptfds, const timeval* timeout)
 {
    if ((NULL == readfds) && (NULL == writefds) && (NULL == exceptfds))
@@ -2064,6 +2620,92 @@ int CUDT::perfmon(UDTSOCKET u, CPerfMon* perf, bool clear)
    }
 }
 
+int CUDT::perfstats(UDTSOCKET u, CPerfStats* stats)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      udt->sample(stats);
+      return 0;
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::tracedump(UDTSOCKET u, const char* path)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      udt->m_Trace.dump(path, u);
+      return 0;
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::setcachefile(const char* path, const int& maxage)
+{
+   if (0 != s_UDTUnited.m_pCache->open(path, maxage))
+   {
+      s_UDTUnited.setError(new CUDTException(4, 4, 0));
+      return ERROR;
+   }
+
+   return 0;
+}
+
+int CUDT::setbufferbudget(const int64_t& bytes)
+{
+   if (bytes < 0)
+   {
+      s_UDTUnited.setError(new CUDTException(5, 3, 0));
+      return ERROR;
+   }
+
+   s_UDTUnited.m_BufferBudget.setLimit(bytes);
+   return 0;
+}
+
+int CUDT::addpath(UDTSOCKET u, const sockaddr* name, int namelen, const sockaddr* peer, int peerlen)
+{
+   try
+   {
+      return s_UDTUnited.addPath(u, name, namelen, peer, peerlen);
+   }
+   catch (CUDTException& e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
 CUDT* CUDT::getUDTHandle(UDTSOCKET u)
 {
    try
@@ -2156,6 +2798,16 @@ int recv(UDTSOCKET u, char* buf, int len, int flags)
    return CUDT::recv(u, buf, len, flags);
 }
 
+int sendv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags)
+{
+   return CUDT::sendv(u, iov, iovcnt, flags);
+}
+
+int recvv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags)
+{
+   return CUDT::recvv(u, iov, iovcnt, flags);
+}
+
 int sendmsg(UDTSOCKET u, const char* buf, int len, int ttl, bool inorder)
 {
    return CUDT::sendmsg(u, buf, len, ttl, inorder);
@@ -2176,6 +2828,26 @@ int64_t recvfile(UDTSOCKET u, fstream& ofs, int64_t& offset, int64_t size, int b
    return CUDT::recvfile(u, ofs, offset, size, block);
 }
 
+int async_send(UDTSOCKET u, const char* buf, int len, ASYNCHANDLER handler, void* context)
+{
+   return CUDT::async_send(u, buf, len, handler, context);
+}
+
+int async_recv(UDTSOCKET u, char* buf, int len, ASYNCHANDLER handler, void* context)
+{
+   return CUDT::async_recv(u, buf, len, handler, context);
+}
+
+int async_sendfile(UDTSOCKET u, fstream& ifs, int64_t offset, int64_t size, ASYNCHANDLER handler, void* context, int block)
+{
+   return CUDT::async_sendfile(u, ifs, offset, size, handler, context, block);
+}
+
+int async_recvfile(UDTSOCKET u, fstream& ofs, int64_t offset, int64_t size, ASYNCHANDLER handler, void* context, int block)
+{
+   return CUDT::async_recvfile(u, ofs, offset, size, handler, context, block);
+}
+
 int select(int nfds, UDSET* readfds, UDSET* writefds, UDSET* exceptfds, const struct timeval* timeout)
 {
    return CUDT::select(nfds, readfds, writefds, exceptfds, timeout);
@@ -2231,4 +2903,55 @@ int perfmon(UDTSOCKET u, TRACEINFO* perf, bool clear)
    return CUDT::perfmon(u, perf, clear);
 }
 
+int perfstats(UDTSOCKET u, TRACESTATS* stats)
+{
+   return CUDT::perfstats(u, stats);
+}
+
+int tracedump(UDTSOCKET u, const char* path)
+{
+   return CUDT::tracedump(u, path);
+}
+
+int setcachefile(const char* path, int maxage)
+{
+   return CUDT::setcachefile(path, maxage);
+}
+
+int setbufferbudget(int64_t bytes)
+{
+   return CUDT::setbufferbudget(bytes);
+}
+
+int addpath(UDTSOCKET u, const struct sockaddr* name, int namelen, const struct sockaddr* peer, int peerlen)
+{
+   return CUDT::addpath(u, name, namelen, peer, peerlen);
+}
+
+int64_t histogram_bound(int bucket)
+{
+   return CHistogram::bound(bucket);
+}
+
+int64_t histogram_percentile(const HISTOGRAM& hist, double percentile)
+{
+   if (hist.count <= 0)
+      return 0;
+
+   // smallest bucket bound that covers the requested share of all values
+   int64_t rank = int64_t(hist.count * percentile / 100.0 + 0.5);
+   if (rank < 1)
+      rank = 1;
+
+   int64_t seen = 0;
+   for (int i = 0; i < UDT_HIST_BUCKETS; ++ i)
+   {
+      seen += hist.counts[i];
+      if (seen >= rank)
+         return CHistogram::bound(i);
+   }
+
+   return CHistogram::bound(UDT_HIST_BUCKETS - 1);
+}
+
 }
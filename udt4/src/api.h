@@ -47,8 +47,10 @@ written by
 #include "udt.h"
 #include "packet.h"
 #include "queue.h"
+#include "buffer.h"
 #include "cache.h"
 #include "epoll.h"
+#include "async.h"
 
 class CUDT;
 
@@ -92,9 +94,100 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Socket ID to socket map that is read without a lock. It is split into shards by the low bits of the ID,
+// and a writer replaces the whole shard it changes, so a reader always sees a complete shard. Writers
+// are serialized by the caller. Replaced shards are kept until no reader can still be scanning them:
+// a reader counts itself in the current epoch while it scans, and the shards replaced in an epoch are
+// freed once the epoch has been left behind and its count has dropped to 0.
+
+class CSocketTable
+{
+public:
+   CSocketTable();
+   ~CSocketTable();
+
+      // Functionality:
+      //    Find a socket, may run concurrently with the writers.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    the socket, or NULL if the ID is not in the table.
+
+   CUDTSocket* find(const UDTSOCKET& u) const;
+
+      // Functionality:
+      //    Add a socket, or replace the one with the same ID.
+      // Parameters:
+      //    0) [in] s: the socket.
+      // Returned value:
+      //    None.
+
+   void insert(CUDTSocket* s);
+
+      // Functionality:
+      //    Remove a socket.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    None.
+
+   void erase(const UDTSOCKET& u);
+
+      // Functionality:
+      //    Remove all sockets.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void clear();
+
+      // Functionality:
+      //    Free the replaced shards no reader can still be scanning, and start a new epoch for the rest.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    time when the kept shards should be checked again, 0 if none is kept.
+
+   uint64_t reclaim();
+
+private:
+   struct Shard
+   {
+      int m_iCount;                          // number of sockets in the shard
+
+      struct Entry
+      {
+         UDTSOCKET m_SocketID;
+         CUDTSocket* m_pSocket;
+      } m_pEntry[1];                         // sorted by socket ID, m_iCount entries follow
+   };
+
+   static Shard* newShard(const int& count);
+   void replace(const int& index, Shard* s);
+
+private:
+   static const int m_iShardCount = 64;      // a power of 2
+
+   static const int m_iReclaimInterval = 10000;  // time between two reclaim rounds while shards are kept, in microseconds
+
+   Shard* volatile m_pShard[m_iShardCount];  // current version of every shard, never NULL
+   std::vector<std::pair<int64_t, Shard*> > m_vRetired;  // replaced shards and the epoch they were replaced in
+
+   volatile int64_t m_llEpoch;               // current epoch, only changed by reclaim()
+   mutable volatile int64_t m_pllReaders[2][UDT_CACHE_LINE / sizeof(int64_t)];  // readers scanning a shard, by epoch parity, first slot of each line used
+
+private:
+   CSocketTable(const CSocketTable&);
+   CSocketTable& operator=(const CSocketTable&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class CUDTUnited
 {
 friend class CUDT;
+friend class CAsyncIO;
 
 public:
    CUDTUnited();
@@ -136,10 +229,12 @@ public:
       //    0) [in] listen: the listening UDT socket;
       //    1) [in] peer: peer address.
       //    2) [in/out] hs: handshake information from peer side (in), negotiated value (out);
+      //    3) [in] earlydata: application data sent with the connection request.
+      //    4) [in] earlysize: size of the early data, 0 if none.
       // Returned value:
       //    If the new connection is successfully created: 1 success, 0 already exist, -1 error.
 
-   int newConnection(const UDTSOCKET listen, const sockaddr* peer, CHandShake* hs);
+   int newConnection(const UDTSOCKET listen, const sockaddr* peer, CHandShake* hs, const char* earlydata = NULL, const int& earlysize = 0);
 
       // Functionality:
       //    look up the UDT entity according to its ID.
@@ -178,6 +273,7 @@ public:
    int epoll_remove_ssock(const int eid, const SYSSOCKET s, const int* events = NULL);
    int epoll_wait(const int eid, std::set<UDTSOCKET>* readfds, std::set<UDTSOCKET>* writefds, int64_t msTimeOut, std::set<SYSSOCKET>* lrfds = NULL, std::set<SYSSOCKET>* lwfds = NULL);
    int epoll_release(const int eid);
+   int addPath(const UDTSOCKET u, const sockaddr* name, const int& namelen, const sockaddr* peer, const int& peerlen);
 
       // Functionality:
       //    record the UDT exception.
@@ -199,6 +295,7 @@ public:
 
 private:
    std::map<UDTSOCKET, CUDTSocket*> m_Sockets;       // stores all the socket structures
+   CSocketTable m_SocketTable;                       // copy of m_Sockets for lookups without m_ControlLock
 
    pthread_mutex_t m_ControlLock;                    // used to synchronize UDT API
 
@@ -222,6 +319,8 @@ private:
    CUDTSocket* locate(const UDTSOCKET u, const sockaddr* peer, const UDTSOCKET& id, const int32_t& isn);
    void updateMux(CUDTSocket* s, const sockaddr* addr = NULL, const UDPSOCKET* = NULL);
    void updateMux(CUDTSocket* s, const CUDTSocket* ls);
+   void createMux(CMultiplexer& m, const CUDT* u, const sockaddr* addr, const UDPSOCKET* udpsock);
+   void releaseMux(const int& mid);
 
 private:
    std::map<int, CMultiplexer> m_mMultiplexer;		// UDP multiplexer
@@ -229,6 +328,7 @@ private:
 
 private:
    CCache* m_pCache;					// UDT network information cache
+   CBufferBudget m_BufferBudget;			// memory the autotuned buffers of all sockets may use
 
 private:
    volatile bool m_bClosing;
@@ -248,11 +348,41 @@ private:
 
    std::map<UDTSOCKET, CUDTSocket*> m_ClosedSockets;   // temporarily store closed sockets
 
-   void checkBrokenSockets();
+   std::vector<UDTSOCKET> m_vGCEvents;                 // sockets reported to the GC thread, protected by m_GCStopLock
+   std::multimap<uint64_t, UDTSOCKET> m_GCQueue;       // sockets the GC thread looks at again and when, protected by m_ControlLock
+
+      // Functionality:
+      //    Wake up the GC thread to look at a socket that was broken or closed.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    None.
+
+   void notifyGC(const UDTSOCKET u);
+
+      // Functionality:
+      //    Handle the reported sockets and those that are due in m_GCQueue.
+      // Parameters:
+      //    0) [in] events: sockets reported since the last call.
+      // Returned value:
+      //    time when the GC thread has to run next, 0 if it can wait for the next report.
+
+   uint64_t reapSockets(const std::vector<UDTSOCKET>& events);
+
+      // Functionality:
+      //    Close a broken socket, or remove a closed one, if it is time to; otherwise queue it again.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      //    1) [in] currtime: current time.
+      // Returned value:
+      //    None.
+
+   void reapSocket(const UDTSOCKET u, const uint64_t& currtime);
    void removeSocket(const UDTSOCKET u);
 
 private:
    CEPoll m_EPoll;                                     // handling epoll data structures and events
+   CAsyncIO m_AsyncIO;                                 // pending asynchronous operations and their worker
 
 private:
    CUDTUnited(const CUDTUnited&);
@@ -0,0 +1,329 @@
+/*****************************************************************************
+Copyright (c) 2001 - 2009, The Board of Trustees of the University of Illinois.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the
+  above copyright notice, this list of conditions
+  and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the University of Illinois
+  nor the names of its contributors may be used to
+  endorse or promote products derived from this
+  software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*****************************************************************************/
+
+#include <set>
+#include <vector>
+#include "api.h"
+#include "core.h"
+#include "async.h"
+
+using namespace std;
+
+CAsyncIO::CAsyncIO():
+m_mQueues(),
+m_iEID(-1),
+m_bRunning(false),
+m_bClosing(false)
+{
+   CGuard::createMutex(m_AsyncLock);
+}
+
+CAsyncIO::~CAsyncIO()
+{
+   CGuard::releaseMutex(m_AsyncLock);
+}
+
+void CAsyncIO::submit(CAsyncOp* op)
+{
+   CGuard asyncguard(m_AsyncLock);
+
+   try
+   {
+      CUDT* udt = CUDT::s_UDTUnited.lookup(op->m_Socket);
+      if (UDT_DGRAM == udt->m_iSockType)
+         throw CUDTException(5, 10, 0);
+
+      if (m_bClosing)
+         throw CUDTException(5, 4, 0);
+   }
+   catch (...)
+   {
+      delete op;
+      throw;
+   }
+
+   if (!m_bRunning)
+   {
+      m_iEID = CUDT::s_UDTUnited.m_EPoll.create();
+
+      #ifndef WIN32
+         pthread_create(&m_WorkerThread, NULL, worker, this);
+      #else
+         DWORD ThreadID;
+         m_WorkerThread = CreateThread(NULL, 0, worker, this, 0, &ThreadID);
+      #endif
+
+      m_bRunning = true;
+   }
+
+   bool send = (CAsyncOp::SEND == op->m_Type) || (CAsyncOp::SENDFILE == op->m_Type);
+   CAsyncQueue& q = m_mQueues[op->m_Socket];
+   deque<CAsyncOp*>& ops = send ? q.m_SendOps : q.m_RecvOps;
+   ops.push_back(op);
+
+   try
+   {
+      // adding the socket again re-arms it, so the worker looks at it now if it is ready
+      int events = UDT_EPOLL_IN | UDT_EPOLL_OUT | UDT_EPOLL_ET;
+      CUDT::s_UDTUnited.epoll_add_usock(m_iEID, op->m_Socket, &events);
+
+      // a socket that is broken already will not report it again
+      CUDT* udt = CUDT::s_UDTUnited.lookup(op->m_Socket);
+      if (udt->m_bBroken || udt->m_bClosing || !udt->m_bConnected)
+         wake(op->m_Socket);
+   }
+   catch (...)
+   {
+      ops.pop_back();
+      if (q.m_SendOps.empty() && q.m_RecvOps.empty())
+         m_mQueues.erase(op->m_Socket);
+      delete op;
+      throw;
+   }
+}
+
+void CAsyncIO::cancel(const UDTSOCKET& u)
+{
+   CGuard asyncguard(m_AsyncLock);
+
+   // the worker finds the socket closed and fails the operations
+   if (m_mQueues.find(u) != m_mQueues.end())
+      wake(u);
+}
+
+void CAsyncIO::stop()
+{
+   CGuard::enterCS(m_AsyncLock);
+   if (!m_bRunning)
+   {
+      CGuard::leaveCS(m_AsyncLock);
+      return;
+   }
+   m_bClosing = true;
+   CGuard::leaveCS(m_AsyncLock);
+
+   // the worker returns from its wait with an error
+   try
+   {
+      CUDT::s_UDTUnited.m_EPoll.release(m_iEID);
+   }
+   catch (...)
+   {
+   }
+
+   #ifndef WIN32
+      pthread_join(m_WorkerThread, NULL);
+   #else
+      WaitForSingleObject(m_WorkerThread, INFINITE);
+      CloseHandle(m_WorkerThread);
+   #endif
+
+   CGuard asyncguard(m_AsyncLock);
+   m_bRunning = false;
+   m_bClosing = false;
+   m_iEID = -1;
+}
+
+#ifndef WIN32
+void* CAsyncIO::worker(void* param)
+#else
+DWORD WINAPI CAsyncIO::worker(LPVOID param)
+#endif
+{
+   CAsyncIO* self = (CAsyncIO*)param;
+
+   set<UDTSOCKET> readfds;
+   set<UDTSOCKET> writefds;
+
+   while (!self->m_bClosing)
+   {
+      // no timeout: new operations and cancel() report the socket through wake(), stop() releases the EPoll
+      try
+      {
+         CUDT::s_UDTUnited.m_EPoll.wait(self->m_iEID, &readfds, &writefds, -1, NULL, NULL);
+      }
+      catch (...)
+      {
+         break;
+      }
+
+      // whatever the event, both directions of the socket are looked at
+      readfds.insert(writefds.begin(), writefds.end());
+      for (set<UDTSOCKET>::iterator i = readfds.begin(); i != readfds.end(); ++ i)
+         self->process(*i);
+   }
+
+   // fail what is left
+   vector<CAsyncOp*> left;
+   CGuard::enterCS(self->m_AsyncLock);
+   for (map<UDTSOCKET, CAsyncQueue>::iterator i = self->m_mQueues.begin(); i != self->m_mQueues.end(); ++ i)
+   {
+      left.insert(left.end(), i->second.m_SendOps.begin(), i->second.m_SendOps.end());
+      left.insert(left.end(), i->second.m_RecvOps.begin(), i->second.m_RecvOps.end());
+   }
+   self->m_mQueues.clear();
+   CGuard::leaveCS(self->m_AsyncLock);
+
+   CUDTException e(5, 4, 0);
+   for (vector<CAsyncOp*>::iterator i = left.begin(); i != left.end(); ++ i)
+      complete(*i, &e);
+
+   #ifndef WIN32
+      return NULL;
+   #else
+      return 0;
+   #endif
+}
+
+void CAsyncIO::process(const UDTSOCKET& u)
+{
+   // a handler may queue the next operation right away, it is served in the same pass
+   while (progress(u, true) | progress(u, false))
+   {
+   }
+
+   CGuard asyncguard(m_AsyncLock);
+
+   map<UDTSOCKET, CAsyncQueue>::iterator q = m_mQueues.find(u);
+   if ((q == m_mQueues.end()) || !q->second.m_SendOps.empty() || !q->second.m_RecvOps.empty())
+      return;
+
+   m_mQueues.erase(q);
+
+   // an idle socket would wake up the worker with every event
+   try
+   {
+      CUDT::s_UDTUnited.epoll_remove_usock(m_iEID, u);
+   }
+   catch (...)
+   {
+      try
+      {
+         CUDT::s_UDTUnited.m_EPoll.remove_usock(m_iEID, u);
+      }
+      catch (...)
+      {
+      }
+   }
+}
+
+bool CAsyncIO::progress(const UDTSOCKET& u, const bool& send)
+{
+   CAsyncOp* op;
+
+   CGuard::enterCS(m_AsyncLock);
+   map<UDTSOCKET, CAsyncQueue>::iterator q = m_mQueues.find(u);
+   if ((q == m_mQueues.end()) || (send ? q->second.m_SendOps.empty() : q->second.m_RecvOps.empty()))
+   {
+      CGuard::leaveCS(m_AsyncLock);
+      return false;
+   }
+   op = send ? q->second.m_SendOps.front() : q->second.m_RecvOps.front();
+   CGuard::leaveCS(m_AsyncLock);
+
+   // only this thread removes operations, so op stays at the front
+   bool done = false;
+   CUDTException* error = NULL;
+
+   try
+   {
+      CUDT* udt = CUDT::s_UDTUnited.lookup(u);
+
+      switch (op->m_Type)
+      {
+      case CAsyncOp::SEND:
+         op->m_llDone += udt->trySend(op->m_pcData + op->m_llDone, op->m_iLength - int(op->m_llDone));
+         done = (op->m_llDone == op->m_iLength);
+         break;
+
+      case CAsyncOp::RECV:
+         op->m_llDone = udt->tryRecv(op->m_pcData, op->m_iLength);
+         done = (op->m_llDone > 0);
+         break;
+
+      case CAsyncOp::SENDFILE:
+         op->m_llDone += udt->trySendFile(*op->m_pFile, op->m_llOffset, op->m_llSize - op->m_llDone, op->m_iBlock);
+         // like sendfile(), a file shorter than the requested size ends the operation early
+         done = (op->m_llDone == op->m_llSize) || op->m_pFile->eof();
+         break;
+
+      case CAsyncOp::RECVFILE:
+         op->m_llDone += udt->tryRecvFile(*op->m_pFile, op->m_llOffset, op->m_llSize - op->m_llDone, op->m_iBlock);
+         done = (op->m_llDone == op->m_llSize);
+         break;
+      }
+   }
+   catch (CUDTException& e)
+   {
+      error = new CUDTException(e);
+   }
+   catch (bad_alloc&)
+   {
+      error = new CUDTException(3, 2, 0);
+   }
+   catch (...)
+   {
+      error = new CUDTException(-1, 0, 0);
+   }
+
+   if (!done && (NULL == error))
+      return false;
+
+   CGuard::enterCS(m_AsyncLock);
+   if (send)
+      q->second.m_SendOps.pop_front();
+   else
+      q->second.m_RecvOps.pop_front();
+   CGuard::leaveCS(m_AsyncLock);
+
+   complete(op, error);
+   delete error;
+
+   return true;
+}
+
+void CAsyncIO::wake(const UDTSOCKET& u)
+{
+   // reported as writable, like a broken socket
+   set<int> eids;
+   eids.insert(m_iEID);
+   CUDT::s_UDTUnited.m_EPoll.enable_write(u, eids);
+}
+
+void CAsyncIO::complete(CAsyncOp* op, const CUDTException* e)
+{
+   op->m_pHandler(op->m_Socket, (NULL == e) ? op->m_llDone : -1, e, op->m_pContext);
+   delete op;
+}
@@ -0,0 +1,163 @@
+/*****************************************************************************
+Copyright (c) 2001 - 2009, The Board of Trustees of the University of Illinois.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the
+  above copyright notice, this list of conditions
+  and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the University of Illinois
+  nor the names of its contributors may be used to
+  endorse or promote products derived from this
+  software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*****************************************************************************/
+
+#ifndef __UDT_ASYNC_H__
+#define __UDT_ASYNC_H__
+
+
+#include <deque>
+#include <map>
+#include <fstream>
+#include "udt.h"
+#include "common.h"
+
+// Asynchronous send/recv/sendfile/recvfile. Every call queues an operation on its socket and returns;
+// one worker thread watches the sockets with pending operations through an edge-triggered EPoll of the
+// library, so the same events that wake up blocking calls and epoll users (data arrival, ACKs, broken
+// connections) drive the operations. The worker moves the data with the non-blocking CUDT calls and
+// runs the completion handler when an operation is done. Operations of one socket and direction
+// complete in the order they were queued.
+
+struct CAsyncOp
+{
+   enum Type {SEND, RECV, SENDFILE, RECVFILE};
+   Type m_Type;
+
+   UDTSOCKET m_Socket;
+   char* m_pcData;                           // application buffer, SEND/RECV
+   int m_iLength;                            // size of the buffer
+   std::fstream* m_pFile;                    // application file, SENDFILE/RECVFILE
+   int64_t m_llOffset;                       // where the next file data goes, moves with the transfer
+   int64_t m_llSize;                         // bytes of the file to transfer
+   int m_iBlock;                             // size of block per file read or write
+   int64_t m_llDone;                         // bytes transferred so far
+
+   UDT_ASYNC_HANDLER m_pHandler;             // completion handler
+   void* m_pContext;                         // application context passed to the handler
+};
+
+class CAsyncIO
+{
+public:
+   CAsyncIO();
+   ~CAsyncIO();
+
+public:
+
+      // Functionality:
+      //    Queue an operation, the worker thread is started with the first one.
+      // Parameters:
+      //    0) [in] op: the operation, owned by CAsyncIO from now on.
+      // Returned value:
+      //    None. Throws if the socket is invalid, the handler is not called then.
+
+   void submit(CAsyncOp* op);
+
+      // Functionality:
+      //    Fail the pending operations of a socket that is being closed.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    None.
+
+   void cancel(const UDTSOCKET& u);
+
+      // Functionality:
+      //    Stop the worker thread and fail all pending operations.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void stop();
+
+private:
+   struct CAsyncQueue
+   {
+      std::deque<CAsyncOp*> m_SendOps;       // SEND and SENDFILE
+      std::deque<CAsyncOp*> m_RecvOps;       // RECV and RECVFILE
+   };
+
+   #ifndef WIN32
+      static void* worker(void* param);
+   #else
+      static DWORD WINAPI worker(LPVOID param);
+   #endif
+
+      // Functionality:
+      //    Move the operations of a socket forward until they have to wait for the next event.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    None.
+
+   void process(const UDTSOCKET& u);
+
+      // Functionality:
+      //    Move the first operation of a queue forward, and complete it if it is done or failed.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      //    1) [in] send: the send queue if true, otherwise the receive queue.
+      // Returned value:
+      //    true if an operation was completed, false if the queue has to wait.
+
+   bool progress(const UDTSOCKET& u, const bool& send);
+
+      // Functionality:
+      //    Make the worker look at a socket whose state changed without an EPoll event.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    None.
+
+   void wake(const UDTSOCKET& u);
+
+   static void complete(CAsyncOp* op, const CUDTException* e);
+
+private:
+   pthread_mutex_t m_AsyncLock;              // protects m_mQueues and the worker state
+   std::map<UDTSOCKET, CAsyncQueue> m_mQueues;  // pending operations of every socket
+
+   int m_iEID;                               // EPoll the worker waits on
+   bool m_bRunning;                          // if the worker thread has been started
+   volatile bool m_bClosing;
+   pthread_t m_WorkerThread;
+
+private:
+   CAsyncIO(const CAsyncIO&);
+   CAsyncIO& operator=(const CAsyncIO&);
+};
+
+#endif
@@ -38,51 +38,109 @@ written by
    Yunhong Gu, last updated 10/02/2010
 *****************************************************************************/
 
+#ifndef WIN32
+   #include <unistd.h>
+   #include <sys/mman.h>
+#endif
 #include <cstring>
 #include <cmath>
 #include "buffer.h"
 
 using namespace std;
 
-CSndBuffer::CSndBuffer(const int& size, const int& mss):
+CBufferBudget::CBufferBudget():
+m_Lock(),
+m_llLimit(0),
+m_llUsed(0)
+{
+   #ifndef WIN32
+      pthread_mutex_init(&m_Lock, NULL);
+   #else
+      m_Lock = CreateMutex(NULL, false, NULL);
+   #endif
+}
+
+CBufferBudget::~CBufferBudget()
+{
+   #ifndef WIN32
+      pthread_mutex_destroy(&m_Lock);
+   #else
+      CloseHandle(m_Lock);
+   #endif
+}
+
+void CBufferBudget::setLimit(const int64_t& limit)
+{
+   CGuard budgetguard(m_Lock);
+
+   // a lower limit is not taken back from the sockets, they stop growing until they have shrunk below it
+   m_llLimit = limit;
+}
+
+int CBufferBudget::acquire(const int& count, const int& unitsize, const int& minimum)
+{
+   CGuard budgetguard(m_Lock);
+
+   int granted = count;
+   if (m_llLimit > 0)
+   {
+      int64_t left = (m_llLimit > m_llUsed) ? (m_llLimit - m_llUsed) / unitsize : 0;
+      if (granted > left)
+         granted = (left > minimum) ? int(left) : minimum;
+   }
+
+   m_llUsed += int64_t(granted) * unitsize;
+
+   return granted;
+}
+
+void CBufferBudget::release(const int& count, const int& unitsize)
+{
+   CGuard budgetguard(m_Lock);
+
+   m_llUsed -= int64_t(count) * unitsize;
+}
+
+CSndBuffer::CSndBuffer(const int& size, const int& mss, const int& maxsize):
 m_BufLock(),
 m_pBlock(NULL),
-m_pFirstBlock(NULL),
-m_pCurrBlock(NULL),
-m_pLastBlock(NULL),
-m_pBuffer(NULL),
+m_pcData(NULL),
+m_iStartPos(0),
+m_iCurrPos(0),
+m_iLastPos(0),
 m_iNextMsgNo(1),
 m_iSize(size),
+m_iMaxSize(size),
+m_iMinSize(size),
 m_iMSS(mss),
+m_iPayloadSize(mss),
+m_iDataPageSize(0),
 m_iCount(0)
 {
-   // initial physical buffer of "size"
-   m_pBuffer = new Buffer;
-   m_pBuffer->m_pcData = new char [m_iSize * m_iMSS];
-   m_pBuffer->m_iSize = m_iSize;
-   m_pBuffer->m_pNext = NULL;
+   // The slots are reserved up front for the largest buffer the socket may use, and committed as the buffer grows.
+   // The buffer doubles, and one slot always stays free, so twice the limit leaves room for the last doubling.
+   while (m_iMaxSize <= maxsize * 2)
+      m_iMaxSize *= 2;
 
-   // circular linked list for out bound packets
-   m_pBlock = new Block;
-   Block* pb = m_pBlock;
-   for (int i = 1; i < m_iSize; ++ i)
+   // on a small address space, settle for less and fail in increase() if that is not enough
+   while (NULL == (m_pcData = reserve(int64_t(m_iMaxSize) * m_iMSS, m_iDataPageSize)))
    {
-      pb->m_pNext = new Block;
-      pb->m_iMsgNo = 0;
-      pb = pb->m_pNext;
+      if ((m_iMaxSize /= 2) < m_iSize)
+         throw CUDTException(3, 2, 0);
    }
-   pb->m_pNext = m_pBlock;
 
-   pb = m_pBlock;
-   char* pc = m_pBuffer->m_pcData;
-   for (int i = 0; i < m_iSize; ++ i)
+   // every connection creates one, so the descriptors, which the sending thread does not hold on to, stay on the heap
+   try
    {
-      pb->m_pcData = pc;
-      pb = pb->m_pNext;
-      pc += m_iMSS;
+      if (!commit(m_pcData, 0, int64_t(m_iSize) * m_iMSS, m_iDataPageSize))
+         throw CUDTException(3, 2, 0);
+      m_pBlock = new Block[m_iSize];
+   }
+   catch (...)
+   {
+      release(m_pcData, int64_t(m_iMaxSize) * m_iMSS, m_iDataPageSize);
+      throw CUDTException(3, 2, 0);
    }
-
-   m_pFirstBlock = m_pCurrBlock = m_pLastBlock = m_pBlock;
 
    #ifndef WIN32
       pthread_mutex_init(&m_BufLock, NULL);
@@ -93,22 +151,8 @@ m_iCount(0)
 
 CSndBuffer::~CSndBuffer()
 {
-   Block* pb = m_pBlock->m_pNext;
-   while (pb != m_pBlock)
-   {
-      Block* temp = pb;
-      pb = pb->m_pNext;
-      delete temp;
-   }
-   delete m_pBlock;
-
-   while (m_pBuffer != NULL)
-   {
-      Buffer* temp = m_pBuffer;
-      m_pBuffer = m_pBuffer->m_pNext;
-      delete [] temp->m_pcData;
-      delete temp;
-   }
+   release(m_pcData, int64_t(m_iMaxSize) * m_iMSS, m_iDataPageSize);
+   delete [] m_pBlock;
 
    #ifndef WIN32
       pthread_mutex_destroy(&m_BufLock);
@@ -119,8 +163,10 @@ CSndBuffer::~CSndBuffer()
 
 void CSndBuffer::addBuffer(const char* data, const int& len, const int& ttl, const bool& order)
 {
-   int size = len / m_iMSS;
-   if ((len % m_iMSS) != 0)
+   // the packet size may change meanwhile, a call cuts all of its data alike
+   int payload = m_iPayloadSize;
+   int size = len / payload;
+   if ((len % payload) != 0)
       size ++;
 
    // dynamically increase sender buffer
@@ -131,30 +177,102 @@ void CSndBuffer::addBuffer(const char* data, const int& len, const int& ttl, con
    int32_t inorder = order;
    inorder <<= 29;
 
-   Block* s = m_pLastBlock;
+   // the free slots are only touched by this thread, the lock is needed to publish them
+   int s = m_iLastPos;
+   for (int i = 0; i < size; ++ i)
+   {
+      int pktlen = len - i * payload;
+      if (pktlen > payload)
+         pktlen = payload;
+
+      memcpy(m_pcData + s * m_iMSS, data + i * payload, pktlen);
+
+      Block* b = m_pBlock + s;
+      b->m_iLength = pktlen;
+
+      b->m_iMsgNo = m_iNextMsgNo | inorder;
+      if (i == 0)
+         b->m_iMsgNo |= 0x80000000;
+      if (i == size - 1)
+         b->m_iMsgNo |= 0x40000000;
+
+      b->m_OriginTime = time;
+      b->m_iTTL = ttl;
+
+      if (++ s == m_iSize)
+         s = 0;
+   }
+
+   CGuard::enterCS(m_BufLock);
+   m_iLastPos = s;
+   m_iCount += size;
+   CGuard::leaveCS(m_BufLock);
+
+   m_iNextMsgNo ++;
+   if (m_iNextMsgNo == CMsgNo::m_iMaxMsgNo)
+      m_iNextMsgNo = 1;
+}
+
+void CSndBuffer::addBuffer(const iovec* iov, const int& iovcnt, const int& len)
+{
+   int payload = m_iPayloadSize;
+   int size = len / payload;
+   if ((len % payload) != 0)
+      size ++;
+
+   // dynamically increase sender buffer
+   while (size + m_iCount >= m_iSize)
+      increase();
+
+   uint64_t time = CTimer::getTime();
+
+   // a packet is filled from as many blocks as fit, so small blocks do not end up in packets of their own
+   int v = 0;
+   int vpos = 0;
+   int s = m_iLastPos;
    for (int i = 0; i < size; ++ i)
    {
-      int pktlen = len - i * m_iMSS;
-      if (pktlen > m_iMSS)
-         pktlen = m_iMSS;
+      int pktlen = len - i * payload;
+      if (pktlen > payload)
+         pktlen = payload;
+
+      char* pos = m_pcData + s * m_iMSS;
+      for (int rs = pktlen; rs > 0; )
+      {
+         int unitsize = int(iov[v].iov_len) - vpos;
+         if (unitsize > rs)
+            unitsize = rs;
+
+         memcpy(pos, (char*)iov[v].iov_base + vpos, unitsize);
+         pos += unitsize;
+         rs -= unitsize;
+
+         if ((vpos += unitsize) == int(iov[v].iov_len))
+         {
+            vpos = 0;
+            if (++ v == iovcnt)
+               break;
+         }
+      }
 
-      memcpy(s->m_pcData, data + i * m_iMSS, pktlen);
-      s->m_iLength = pktlen;
+      Block* b = m_pBlock + s;
+      b->m_iLength = pktlen;
 
-      s->m_iMsgNo = m_iNextMsgNo | inorder;
+      b->m_iMsgNo = m_iNextMsgNo;
       if (i == 0)
-         s->m_iMsgNo |= 0x80000000;
+         b->m_iMsgNo |= 0x80000000;
       if (i == size - 1)
-         s->m_iMsgNo |= 0x40000000;
+         b->m_iMsgNo |= 0x40000000;
 
-      s->m_OriginTime = time;
-      s->m_iTTL = ttl;
+      b->m_OriginTime = time;
+      b->m_iTTL = -1;
 
-      s = s->m_pNext;
+      if (++ s == m_iSize)
+         s = 0;
    }
-   m_pLastBlock = s;
 
    CGuard::enterCS(m_BufLock);
+   m_iLastPos = s;
    m_iCount += size;
    CGuard::leaveCS(m_BufLock);
 
@@ -165,55 +283,80 @@ void CSndBuffer::addBuffer(const char* data, const int& len, const int& ttl, con
 
 int CSndBuffer::addBufferFromFile(fstream& ifs, const int& len)
 {
-   int size = len / m_iMSS;
-   if ((len % m_iMSS) != 0)
+   int payload = m_iPayloadSize;
+   int size = len / payload;
+   if ((len % payload) != 0)
       size ++;
 
    // dynamically increase sender buffer
    while (size + m_iCount >= m_iSize)
       increase();
 
-   Block* s = m_pLastBlock;
+   int s = m_iLastPos;
    int total = 0;
+   int count = 0;
    for (int i = 0; i < size; ++ i)
    {
       if (ifs.bad() || ifs.fail() || ifs.eof())
          break;
 
-      int pktlen = len - i * m_iMSS;
-      if (pktlen > m_iMSS)
-         pktlen = m_iMSS;
+      int pktlen = len - i * payload;
+      if (pktlen > payload)
+         pktlen = payload;
 
-      ifs.read(s->m_pcData, pktlen);
+      ifs.read(m_pcData + s * m_iMSS, pktlen);
       if ((pktlen = ifs.gcount()) <= 0)
          break;
 
-      s->m_iLength = pktlen;
-      s->m_iTTL = -1;
-      s = s->m_pNext;
+      m_pBlock[s].m_iLength = pktlen;
+      m_pBlock[s].m_iTTL = -1;
+      if (++ s == m_iSize)
+         s = 0;
 
       total += pktlen;
+      ++ count;
    }
 
+   // count only the blocks that were filled, so that the buffer drains to empty after a short read
    CGuard::enterCS(m_BufLock);
-   m_pLastBlock = s;
-   m_iCount += size;
+   m_iLastPos = s;
+   m_iCount += count;
    CGuard::leaveCS(m_BufLock);
 
    return total;
 }
 
-int CSndBuffer::readData(char** data, int32_t& msgno)
+int CSndBuffer::readData(char** data, int32_t& msgno, int& msglen)
 {
+   CGuard bufferguard(m_BufLock);
+
    // No data to read
-   if (m_pCurrBlock == m_pLastBlock)
+   if (m_iCurrPos == m_iLastPos)
       return 0;
 
-   *data = m_pCurrBlock->m_pcData;
-   int readlen = m_pCurrBlock->m_iLength;
-   msgno = m_pCurrBlock->m_iMsgNo;
+   // a message that expired while it was queued is not sent at all, the rest of it is skipped
+   Block* b = m_pBlock + m_iCurrPos;
+   if ((b->m_iTTL >= 0) && ((CTimer::getTime() - b->m_OriginTime) / 1000 > (uint64_t)b->m_iTTL))
+   {
+      msgno = b->m_iMsgNo & 0x1FFFFFFF;
+
+      msglen = 0;
+      while ((m_iCurrPos != m_iLastPos) && (msgno == (m_pBlock[m_iCurrPos].m_iMsgNo & 0x1FFFFFFF)))
+      {
+         ++ msglen;
+         if (++ m_iCurrPos == m_iSize)
+            m_iCurrPos = 0;
+      }
+
+      return -1;
+   }
+
+   *data = m_pcData + m_iCurrPos * m_iMSS;
+   int readlen = m_pBlock[m_iCurrPos].m_iLength;
+   msgno = m_pBlock[m_iCurrPos].m_iMsgNo;
 
-   m_pCurrBlock = m_pCurrBlock->m_pNext;
+   if (++ m_iCurrPos == m_iSize)
+      m_iCurrPos = 0;
 
    return readlen;
 }
@@ -222,34 +365,35 @@ int CSndBuffer::readData(char** data, const int offset, int32_t& msgno, int& msg
 {
    CGuard bufferguard(m_BufLock);
 
-   Block* p = m_pFirstBlock;
+   int p = m_iStartPos + offset;
+   if (p >= m_iSize)
+      p -= m_iSize;
 
-   for (int i = 0; i < offset; ++ i)
-      p = p->m_pNext;
-
-   if ((p->m_iTTL >= 0) && ((CTimer::getTime() - p->m_OriginTime) / 1000 > (uint64_t)p->m_iTTL))
+   if ((m_pBlock[p].m_iTTL >= 0) && ((CTimer::getTime() - m_pBlock[p].m_OriginTime) / 1000 > (uint64_t)m_pBlock[p].m_iTTL))
    {
-      msgno = p->m_iMsgNo & 0x1FFFFFFF;
+      msgno = m_pBlock[p].m_iMsgNo & 0x1FFFFFFF;
 
       msglen = 1;
-      p = p->m_pNext;
+      if (++ p == m_iSize)
+         p = 0;
       bool move = false;
-      while (msgno == (p->m_iMsgNo & 0x1FFFFFFF))
+      while ((p != m_iLastPos) && (msgno == (m_pBlock[p].m_iMsgNo & 0x1FFFFFFF)))
       {
-         if (p == m_pCurrBlock)
+         if (p == m_iCurrPos)
             move = true;
-         p = p->m_pNext;
+         if (++ p == m_iSize)
+            p = 0;
          if (move)
-            m_pCurrBlock = p;
+            m_iCurrPos = p;
          msglen ++;
       }
 
       return -1;
    }
 
-   *data = p->m_pcData;
-   int readlen = p->m_iLength;
-   msgno = p->m_iMsgNo;
+   *data = m_pcData + p * m_iMSS;
+   int readlen = m_pBlock[p].m_iLength;
+   msgno = m_pBlock[p].m_iMsgNo;
 
    return readlen;
 }
@@ -258,8 +402,9 @@ void CSndBuffer::ackData(const int& offset)
 {
    CGuard bufferguard(m_BufLock);
 
-   for (int i = 0; i < offset; ++ i)
-      m_pFirstBlock = m_pFirstBlock->m_pNext;
+   m_iStartPos += offset;
+   if (m_iStartPos >= m_iSize)
+      m_iStartPos -= m_iSize;
 
    m_iCount -= offset;
 
@@ -273,61 +418,168 @@ int CSndBuffer::getCurrBufSize() const
 
 void CSndBuffer::increase()
 {
-   int unitsize = m_pBuffer->m_iSize;
+   CGuard bufferguard(m_BufLock);
 
-   // new physical buffer
-   Buffer* nbuf = NULL;
+   int size = m_iSize * 2;
+   Block* block = NULL;
    try
    {
-      nbuf  = new Buffer;
-      nbuf->m_pcData = new char [unitsize * m_iMSS];
+      if ((size > m_iMaxSize) || !commit(m_pcData, int64_t(m_iSize) * m_iMSS, int64_t(size) * m_iMSS, m_iDataPageSize))
+         throw CUDTException(3, 2, 0);
+      block = new Block[size];
    }
    catch (...)
    {
-      delete nbuf;
       throw CUDTException(3, 2, 0);
    }
-   nbuf->m_iSize = unitsize;
-   nbuf->m_pNext = NULL;
 
-   // insert the buffer at the end of the buffer list
-   Buffer* p = m_pBuffer;
-   while (NULL != p->m_pNext)
-      p = p->m_pNext;
-   p->m_pNext = nbuf;
+   // the descriptors are only read under the lock, they may move
+   memcpy(block, m_pBlock, m_iSize * sizeof(Block));
+   delete [] m_pBlock;
+   m_pBlock = block;
 
-   // new packet blocks
-   Block* nblk = NULL;
-   try
+   // a new connection does not pay for the advice, a buffer gets it when it has grown large enough to use huge pages
+   if (int64_t(size) * m_iMSS >= m_iHugePageSize)
+      advise(m_pcData, int64_t(m_iMaxSize) * m_iMSS);
+
+   // If the used slots wrap around, move the ones at the front behind the old end, so that they follow on in the larger ring.
+   // The old copies are not reused before the writer has filled all the new slots, so a packet the sending thread is
+   // still holding keeps its content.
+   if (m_iLastPos < m_iStartPos)
    {
-      nblk = new Block;
+      memcpy(m_pcData + m_iSize * m_iMSS, m_pcData, m_iLastPos * m_iMSS);
+      memcpy(m_pBlock + m_iSize, m_pBlock, m_iLastPos * sizeof(Block));
+
+      if (m_iCurrPos < m_iStartPos)
+         m_iCurrPos += m_iSize;
+      m_iLastPos += m_iSize;
    }
-   catch (...)
+
+   m_iSize = size;
+}
+
+void CSndBuffer::shrink(const int size)
+{
+   // m_iSize changes only in this thread, which also adds the data
+   if ((m_iSize / 2 < m_iMinSize) || (m_iSize / 2 < size * 2))
+      return;
+
+   CGuard bufferguard(m_BufLock);
+
+   int oldsize = m_iSize;
+
+   // an empty buffer starts over at the first slot, wherever the ring stopped
+   if (m_iStartPos == m_iLastPos)
+      m_iStartPos = m_iCurrPos = m_iLastPos = 0;
+
+   // the ring is halved only while its data sits in the lower half without wrapping around,
+   // otherwise it is tried again the next time
+   while ((m_iSize / 2 >= m_iMinSize) && (m_iSize / 2 >= size * 2) && (m_iStartPos <= m_iLastPos) && (m_iLastPos < m_iSize / 2))
    {
-      delete nblk;
-      throw CUDTException(3, 2, 0);
+      int half = m_iSize / 2;
+      decommit(m_pcData, int64_t(half) * m_iMSS, int64_t(m_iSize) * m_iMSS, m_iDataPageSize);
+      m_iSize = half;
    }
-   Block* pb = nblk;
-   for (int i = 1; i < unitsize; ++ i)
+
+   // the descriptors follow the ring, they stay as they are if there is no memory for the smaller copy
+   if (m_iSize < oldsize)
    {
-      pb->m_pNext = new Block;
-      pb = pb->m_pNext;
+      try
+      {
+         Block* block = new Block[m_iSize];
+         memcpy(block, m_pBlock, m_iSize * sizeof(Block));
+         delete [] m_pBlock;
+         m_pBlock = block;
+      }
+      catch (...)
+      {
+      }
    }
+}
 
-   // insert the new blocks onto the existing one
-   pb->m_pNext = m_pLastBlock->m_pNext;
-   m_pLastBlock->m_pNext = nblk;
+void CSndBuffer::setPayloadSize(const int size)
+{
+   m_iPayloadSize = (size < m_iMSS) ? size : m_iMSS;
+}
 
-   pb = nblk;
-   char* pc = nbuf->m_pcData;
-   for (int i = 0; i < unitsize; ++ i)
-   {
-      pb->m_pcData = pc;
-      pb = pb->m_pNext;
-      pc += m_iMSS;
-   }
+char* CSndBuffer::reserve(const int64_t& size, int& pagesize)
+{
+   #ifndef WIN32
+      pagesize = sysconf(_SC_PAGESIZE);
+
+      #if defined(HUGETLB) && defined(MAP_HUGETLB)
+         // explicit huge pages have to be set aside by the administrator, use them only when the library is built for it
+         int64_t hugesize = (size + m_iHugePageSize - 1) / m_iHugePageSize * m_iHugePageSize;
+         void* huge = mmap(NULL, hugesize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_HUGETLB, -1, 0);
+         if (MAP_FAILED != huge)
+         {
+            pagesize = m_iHugePageSize;
+            return (char*)huge;
+         }
+      #endif
+
+      void* addr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (MAP_FAILED == addr)
+         return NULL;
+
+      return (char*)addr;
+   #else
+      SYSTEM_INFO si;
+      GetSystemInfo(&si);
+      pagesize = si.dwPageSize;
+
+      return (char*)VirtualAlloc(NULL, (SIZE_T)size, MEM_RESERVE, PAGE_NOACCESS);
+   #endif
+}
+
+void CSndBuffer::advise(char* addr, const int64_t& size)
+{
+   #ifdef MADV_HUGEPAGE
+      // let the kernel back large buffers by transparent huge pages
+      madvise(addr, size, MADV_HUGEPAGE);
+   #else
+      (void)addr;
+      (void)size;
+   #endif
+}
+
+bool CSndBuffer::commit(char* addr, const int64_t& from, const int64_t& to, const int& pagesize)
+{
+   int64_t start = (from + pagesize - 1) / pagesize * pagesize;
+   int64_t end = (to + pagesize - 1) / pagesize * pagesize;
+   if (start >= end)
+      return true;
+
+   #ifndef WIN32
+      return 0 == mprotect(addr + start, end - start, PROT_READ | PROT_WRITE);
+   #else
+      return NULL != VirtualAlloc(addr + start, (SIZE_T)(end - start), MEM_COMMIT, PAGE_READWRITE);
+   #endif
+}
 
-   m_iSize += unitsize;
+void CSndBuffer::release(char* addr, const int64_t& size, const int& pagesize)
+{
+   #ifndef WIN32
+      munmap(addr, (size + pagesize - 1) / pagesize * pagesize);
+   #else
+      VirtualFree(addr, 0, MEM_RELEASE);
+   #endif
+}
+
+void CSndBuffer::decommit(char* addr, const int64_t& from, const int64_t& to, const int& pagesize)
+{
+   // the page that holds the new end of the buffer stays, as commit() expects
+   int64_t start = (from + pagesize - 1) / pagesize * pagesize;
+   int64_t end = (to + pagesize - 1) / pagesize * pagesize;
+   if (start >= end)
+      return;
+
+   #ifndef WIN32
+      madvise(addr + start, end - start, MADV_DONTNEED);
+      mprotect(addr + start, end - start, PROT_NONE);
+   #else
+      VirtualFree(addr + start, (SIZE_T)(end - start), MEM_DECOMMIT);
+   #endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////
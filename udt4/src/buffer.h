@@ -47,10 +47,57 @@ written by
 #include "queue.h"
 #include <fstream>
 
+// the bytes that the autotuned sockets of the process may hold in their buffers, shared by all of them
+class CBufferBudget
+{
+public:
+   CBufferBudget();
+   ~CBufferBudget();
+
+      // Functionality:
+      //    Set the number of bytes that the sockets may hold together.
+      // Parameters:
+      //    0) [in] limit: the budget in bytes, 0 for no limit.
+      // Returned value:
+      //    None.
+
+   void setLimit(const int64_t& limit);
+
+      // Functionality:
+      //    Take a share of the budget, in units of a fixed size.
+      // Parameters:
+      //    0) [in] count: number of units wanted.
+      //    1) [in] unitsize: size of a unit in bytes.
+      //    2) [in] minimum: number of units granted even if the budget is used up.
+      // Returned value:
+      //    number of units granted, less than count when the budget is running out.
+
+   int acquire(const int& count, const int& unitsize, const int& minimum = 0);
+
+      // Functionality:
+      //    Return a share taken by acquire().
+      // Parameters:
+      //    0) [in] count: number of units.
+      //    1) [in] unitsize: size of a unit in bytes.
+      // Returned value:
+      //    None.
+
+   void release(const int& count, const int& unitsize);
+
+private:
+   pthread_mutex_t m_Lock;
+   int64_t m_llLimit;                   // budget in bytes, 0 means no limit
+   int64_t m_llUsed;                    // bytes granted to the sockets
+
+private:
+   CBufferBudget(const CBufferBudget&);
+   CBufferBudget& operator=(const CBufferBudget&);
+};
+
 class CSndBuffer
 {
 public:
-   CSndBuffer(const int& size, const int& mss);
+   CSndBuffer(const int& size, const int& mss, const int& maxsize);
    ~CSndBuffer();
 
       // Functionality:
@@ -65,6 +112,17 @@ public:
 
    void addBuffer(const char* data, const int& len, const int& ttl = -1, const bool& order = false);
 
+      // Functionality:
+      //    Insert the blocks of a user vector into the sending list as one block, packed into full packets.
+      // Parameters:
+      //    0) [in] iov: the blocks of user data, in order.
+      //    1) [in] iovcnt: number of blocks in the vector.
+      //    2) [in] len: number of bytes to take from the vector, at most the sum of the block sizes.
+      // Returned value:
+      //    None.
+
+   void addBuffer(const iovec* iov, const int& iovcnt, const int& len);
+
       // Functionality:
       //    Read a block of data from file and insert it into the sending list.
       // Parameters:
@@ -80,10 +138,11 @@ public:
       // Parameters:
       //    0) [out] data: the pointer to the data position.
       //    1) [out] msgno: message number of the packet.
+      //    2) [out] msglen: number of packets skipped if the message has expired.
       // Returned value:
-      //    Actual length of data read.
+      //    Actual length of data read, or -1 if the rest of an expired message has been skipped.
 
-   int readData(char** data, int32_t& msgno);
+   int readData(char** data, int32_t& msgno, int& msglen);
 
       // Functionality:
       //    Find data position to pack a DATA packet for a retransmission.
@@ -115,43 +174,114 @@ public:
 
    int getCurrBufSize() const;
 
+      // Functionality:
+      //    Give back the memory of the upper half of the buffer, as long as the data fits into the lower half.
+      //    Only the thread that adds data may call it, the free slots are written without the lock.
+      // Parameters:
+      //    0) [in] size: number of packets the buffer has to hold, it keeps at least twice as many slots.
+      // Returned value:
+      //    None.
+
+   void shrink(const int size);
+
+      // Functionality:
+      //    Set the size of the packets that data added from now on is cut into.
+      // Parameters:
+      //    0) [in] size: payload size, up to the slot size the buffer was created with.
+      // Returned value:
+      //    None.
+
+   void setPayloadSize(const int size);
+
 private:
    void increase();
 
+      // Functionality:
+      //    Reserve address space for a buffer without backing it by memory.
+      // Parameters:
+      //    0) [in] size: size of the address space in bytes.
+      //    1) [out] pagesize: granularity in which the space is committed.
+      // Returned value:
+      //    start address of the space, or NULL if it cannot be reserved.
+
+   static char* reserve(const int64_t& size, int& pagesize);
+
+      // Functionality:
+      //    Ask for transparent huge pages to back a reserved space, once the buffer has grown to use them.
+      // Parameters:
+      //    0) [in] addr: start address of the reserved space.
+      //    1) [in] size: size of the space in bytes.
+      // Returned value:
+      //    None.
+
+   static void advise(char* addr, const int64_t& size);
+
+      // Functionality:
+      //    Back part of a reserved space by memory.
+      // Parameters:
+      //    0) [in] addr: start address of the reserved space.
+      //    1) [in] from: first byte to commit, a multiple of the page size.
+      //    2) [in] to: end of the range to commit, rounded up to the page size.
+      //    3) [in] pagesize: page size returned by reserve().
+      // Returned value:
+      //    true if the range can be used.
+
+   static bool commit(char* addr, const int64_t& from, const int64_t& to, const int& pagesize);
+
+      // Functionality:
+      //    Release a space returned by reserve().
+      // Parameters:
+      //    0) [in] addr: start address of the reserved space.
+      //    1) [in] size: size of the space in bytes.
+      //    2) [in] pagesize: page size returned by reserve().
+      // Returned value:
+      //    None.
+
+   static void release(char* addr, const int64_t& size, const int& pagesize);
+
+      // Functionality:
+      //    Take the memory away from part of a reserved space, the space stays reserved.
+      // Parameters:
+      //    0) [in] addr: start address of the reserved space.
+      //    1) [in] from: first byte to decommit, rounded up to the page size.
+      //    2) [in] to: end of the range to decommit, rounded up to the page size.
+      //    3) [in] pagesize: page size returned by reserve().
+      // Returned value:
+      //    None.
+
+   static void decommit(char* addr, const int64_t& from, const int64_t& to, const int& pagesize);
+
 private:
    pthread_mutex_t m_BufLock;           // used to synchronize buffer operation
 
    struct Block
    {
-      char* m_pcData;                   // pointer to the data block
       int m_iLength;                    // length of the block
 
       int32_t m_iMsgNo;                 // message number
       uint64_t m_OriginTime;            // original request time
       int m_iTTL;                       // time to live (milliseconds)
+   } *m_pBlock;                         // per packet information, m_pBlock[i] describes slot i of m_pcData; read under the lock only, it moves as the ring grows
 
-      Block* m_pNext;                   // next block
-   } *m_pBlock, *m_pFirstBlock, *m_pCurrBlock, *m_pLastBlock;
-
-   // m_pBlock:         The head pointer
-   // m_pFirstBlock:    The first block
-   // m_pCurrBlock:	The current block
-   // m_pLastBlock:     The last block (if first == last, buffer is empty)
+   char* m_pcData;                      // packet slots, slot i starts at m_pcData + i * m_iMSS
 
-   struct Buffer
-   {
-      char* m_pcData;			// buffer
-      int m_iSize;			// size
-      Buffer* m_pNext;			// next buffer
-   } *m_pBuffer;			// physical buffer
+   int m_iStartPos;                     // the first block
+   int m_iCurrPos;                      // the current block
+   int m_iLastPos;                      // the last block (if first == last, buffer is empty)
 
    int32_t m_iNextMsgNo;                // next message number
 
    int m_iSize;				// buffer size (number of packets)
+   int m_iMaxSize;                      // number of packets the reserved space can hold
+   int m_iMinSize;                      // initial size, the buffer does not shrink below it
    int m_iMSS;                          // maximum seqment/packet size
+   volatile int m_iPayloadSize;         // size new data is cut into, at most m_iMSS
+   int m_iDataPageSize;                 // commit granularity of m_pcData
 
    int m_iCount;			// number of used blocks
 
+   static const int m_iHugePageSize = 2 * 1024 * 1024;    // huge page size assumed for the advice and for -DHUGETLB
+
 private:
    CSndBuffer(const CSndBuffer&);
    CSndBuffer& operator=(const CSndBuffer&);
@@ -46,7 +46,16 @@ written by
    #endif
 #endif
 
+#ifndef WIN32
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/file.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+#endif
+
 #include <cstring>
+#include <ctime>
 #include "cache.h"
 #include "core.h"
 
@@ -71,18 +80,27 @@ bool CIPComp::operator()(const CInfoBlock* ib1, const CInfoBlock* ib2) const
 
 bool CTSComp::operator()(const CInfoBlock* ib1, const CInfoBlock* ib2) const
 {
-   return (ib1->m_ullTimeStamp > ib2->m_ullTimeStamp);
+   // newest first; entries updated in the same microsecond (or loaded from the same second) stay distinct
+   if (ib1->m_ullTimeStamp != ib2->m_ullTimeStamp)
+      return (ib1->m_ullTimeStamp > ib2->m_ullTimeStamp);
+   return (ib1 < ib2);
 }
 
 CCache::CCache():
 m_uiSize(1024),
 m_sIPIndex(),
 m_sTSIndex(),
+m_ullMaxAge(0),
+m_pcMap(NULL),
+m_iMapSize(0),
 m_Lock()
 {
    #ifndef WIN32
+      m_iFile = -1;
       pthread_mutex_init(&m_Lock, NULL);
    #else
+      m_hFile = INVALID_HANDLE_VALUE;
+      m_hMap = NULL;
       m_Lock = CreateMutex(NULL, false, NULL);
    #endif
 }
@@ -91,17 +109,25 @@ CCache::CCache(const unsigned int& size):
 m_uiSize(size),
 m_sIPIndex(),
 m_sTSIndex(),
+m_ullMaxAge(0),
+m_pcMap(NULL),
+m_iMapSize(0),
 m_Lock()
 {
    #ifndef WIN32
+      m_iFile = -1;
       pthread_mutex_init(&m_Lock, NULL);
    #else
+      m_hFile = INVALID_HANDLE_VALUE;
+      m_hMap = NULL;
       m_Lock = CreateMutex(NULL, false, NULL);
    #endif
 }
 
 CCache::~CCache()
 {
+   close();
+
    for (set<CInfoBlock*, CTSComp>::iterator i = m_sTSIndex.begin(); i != m_sTSIndex.end(); ++ i)
       delete *i;
 
@@ -120,29 +146,31 @@ void CCache::update(const sockaddr* addr, const int& ver, CInfoBlock* ib)
    convert(addr, ver, newib->m_piIP);
    newib->m_iIPversion = ver;
 
+   newib->m_iRTT = ib->m_iRTT;
+   newib->m_iBandwidth = ib->m_iBandwidth;
+   newib->m_iLossRate = ib->m_iLossRate;
+   newib->m_iReorderDistance = ib->m_iReorderDistance;
+   newib->m_dInterval = ib->m_dInterval;
+   newib->m_dCWnd = ib->m_dCWnd;
+   newib->m_ullTimeStamp = CTimer::getTime();
+
    set<CInfoBlock*, CIPComp>::iterator i = m_sIPIndex.find(newib);
 
    if (i != m_sIPIndex.end())
    {
+      // a connection that sent no data learned nothing about the sending rate, keep the old values
+      if (newib->m_dInterval <= 0)
+         newib->m_dInterval = (*i)->m_dInterval;
+      if (newib->m_dCWnd <= 0)
+         newib->m_dCWnd = (*i)->m_dCWnd;
+
       m_sTSIndex.erase(*i);
       delete *i;
       m_sIPIndex.erase(i);
    }
 
-   newib->m_iRTT = ib->m_iRTT;
-   newib->m_iBandwidth = ib->m_iBandwidth;
-   newib->m_ullTimeStamp = CTimer::getTime();
-
-   m_sIPIndex.insert(newib);
-   m_sTSIndex.insert(newib);
-
-   if (m_sTSIndex.size() > m_uiSize)
-   {
-      CInfoBlock* tmp = *m_sTSIndex.begin();
-      m_sIPIndex.erase(tmp);
-      m_sTSIndex.erase(m_sTSIndex.begin());
-      delete tmp;
-   }
+   insert(newib);
+   store(newib);
 }
 
 int CCache::lookup(const sockaddr* addr, const int& ver, CInfoBlock* ib)
@@ -157,13 +185,239 @@ int CCache::lookup(const sockaddr* addr, const int& ver, CInfoBlock* ib)
    if (i == m_sIPIndex.end())
       return -1;
 
+   if ((m_ullMaxAge > 0) && (CTimer::getTime() - (*i)->m_ullTimeStamp > m_ullMaxAge))
+   {
+      CInfoBlock* tmp = *i;
+      m_sTSIndex.erase(tmp);
+      m_sIPIndex.erase(i);
+      delete tmp;
+      return -1;
+   }
+
    ib->m_ullTimeStamp = (*i)->m_ullTimeStamp;
    ib->m_iRTT = (*i)->m_iRTT;
    ib->m_iBandwidth = (*i)->m_iBandwidth;
+   ib->m_iLossRate = (*i)->m_iLossRate;
+   ib->m_iReorderDistance = (*i)->m_iReorderDistance;
+   ib->m_dInterval = (*i)->m_dInterval;
+   ib->m_dCWnd = (*i)->m_dCWnd;
 
    return 1;
 }
 
+int CCache::open(const char* path, const int& maxage)
+{
+   CGuard cacheguard(m_Lock);
+
+   close();
+
+   m_ullMaxAge = (uint64_t)maxage * 1000000ULL;
+   m_iMapSize = sizeof(CCacheFileHeader) + m_uiSize * sizeof(CCacheRecord);
+
+   #ifndef WIN32
+      m_iFile = ::open(path, O_RDWR | O_CREAT, 0644);
+      if (m_iFile < 0)
+         return -1;
+
+      // a new (or foreign sized) file is grown to the full table, the added bytes read as empty records
+      struct stat st;
+      if ((fstat(m_iFile, &st) < 0) || ((st.st_size < m_iMapSize) && (ftruncate(m_iFile, m_iMapSize) < 0)))
+      {
+         close();
+         return -1;
+      }
+
+      void* map = mmap(NULL, m_iMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_iFile, 0);
+      if (MAP_FAILED == map)
+      {
+         close();
+         return -1;
+      }
+      m_pcMap = (char*)map;
+   #else
+      m_hFile = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+      if (INVALID_HANDLE_VALUE == m_hFile)
+         return -1;
+
+      // mapping past the end of the file grows it, the added bytes read as empty records
+      m_hMap = CreateFileMapping(m_hFile, NULL, PAGE_READWRITE, 0, m_iMapSize, NULL);
+      if (NULL == m_hMap)
+      {
+         close();
+         return -1;
+      }
+
+      m_pcMap = (char*)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, m_iMapSize);
+      if (NULL == m_pcMap)
+      {
+         close();
+         return -1;
+      }
+   #endif
+
+   lockFile();
+
+   CCacheFileHeader* header = (CCacheFileHeader*)m_pcMap;
+   if ((0 != memcmp(header->m_pcMagic, "UDTCACHE", 8)) || (1 != header->m_iVersion) || (header->m_iSize != (int32_t)m_uiSize))
+   {
+      // new file, or written by an incompatible version: start empty
+      memset(m_pcMap, 0, m_iMapSize);
+      memcpy(header->m_pcMagic, "UDTCACHE", 8);
+      header->m_iVersion = 1;
+      header->m_iSize = m_uiSize;
+   }
+   else
+      load();
+
+   unlockFile();
+
+   return 0;
+}
+
+void CCache::insert(CInfoBlock* ib)
+{
+   m_sIPIndex.insert(ib);
+   m_sTSIndex.insert(ib);
+
+   if (m_sTSIndex.size() > m_uiSize)
+   {
+      // the time index is newest first, drop the oldest entry
+      set<CInfoBlock*, CTSComp>::iterator last = -- m_sTSIndex.end();
+      CInfoBlock* tmp = *last;
+      m_sIPIndex.erase(tmp);
+      m_sTSIndex.erase(last);
+      delete tmp;
+   }
+}
+
+void CCache::close()
+{
+   #ifndef WIN32
+      if (NULL != m_pcMap)
+         munmap(m_pcMap, m_iMapSize);
+      if (m_iFile >= 0)
+         ::close(m_iFile);
+      m_iFile = -1;
+   #else
+      if (NULL != m_pcMap)
+         UnmapViewOfFile(m_pcMap);
+      if (NULL != m_hMap)
+         CloseHandle(m_hMap);
+      if (INVALID_HANDLE_VALUE != m_hFile)
+         CloseHandle(m_hFile);
+      m_hMap = NULL;
+      m_hFile = INVALID_HANDLE_VALUE;
+   #endif
+
+   m_pcMap = NULL;
+}
+
+void CCache::load()
+{
+   uint64_t currtime = CTimer::getTime();
+   int64_t now = time(NULL);
+
+   CCacheRecord* records = (CCacheRecord*)(m_pcMap + sizeof(CCacheFileHeader));
+   for (unsigned int r = 0; r < m_uiSize; ++ r)
+   {
+      const CCacheRecord& rec = records[r];
+      if (0 == rec.m_iIPversion)
+         continue;
+
+      // records from the future (clock changes) count as new; the local timer may count from boot,
+      // so records older than it cannot be placed on it and are dropped as well
+      uint64_t age = (now > rec.m_llTime) ? (uint64_t)(now - rec.m_llTime) * 1000000ULL : 0;
+      if (((m_ullMaxAge > 0) && (age > m_ullMaxAge)) || (age > currtime))
+         continue;
+
+      CInfoBlock* ib = new CInfoBlock;
+      ib->m_iIPversion = rec.m_iIPversion;
+      memcpy(ib->m_piIP, rec.m_piIP, sizeof(ib->m_piIP));
+      ib->m_ullTimeStamp = currtime - age;
+      ib->m_iRTT = rec.m_iRTT;
+      ib->m_iBandwidth = rec.m_iBandwidth;
+      ib->m_iLossRate = rec.m_iLossRate;
+      ib->m_iReorderDistance = rec.m_iReorderDistance;
+      ib->m_dInterval = rec.m_dInterval;
+      ib->m_dCWnd = rec.m_dCWnd;
+
+      set<CInfoBlock*, CIPComp>::iterator i = m_sIPIndex.find(ib);
+      if (i != m_sIPIndex.end())
+      {
+         if ((*i)->m_ullTimeStamp >= ib->m_ullTimeStamp)
+         {
+            delete ib;
+            continue;
+         }
+
+         m_sTSIndex.erase(*i);
+         delete *i;
+         m_sIPIndex.erase(i);
+      }
+
+      insert(ib);
+   }
+}
+
+void CCache::store(const CInfoBlock* ib)
+{
+   if (NULL == m_pcMap)
+      return;
+
+   lockFile();
+
+   // the record of the same peer if there is one, otherwise an empty or the oldest record
+   CCacheRecord* records = (CCacheRecord*)(m_pcMap + sizeof(CCacheFileHeader));
+   CCacheRecord* slot = NULL;
+   for (unsigned int r = 0; r < m_uiSize; ++ r)
+   {
+      CCacheRecord* rec = records + r;
+      if ((rec->m_iIPversion == ib->m_iIPversion) && (0 == memcmp(rec->m_piIP, ib->m_piIP, sizeof(rec->m_piIP))))
+      {
+         slot = rec;
+         break;
+      }
+
+      if ((NULL == slot) || ((0 != slot->m_iIPversion) && ((0 == rec->m_iIPversion) || (rec->m_llTime < slot->m_llTime))))
+         slot = rec;
+   }
+
+   slot->m_iIPversion = ib->m_iIPversion;
+   memcpy(slot->m_piIP, ib->m_piIP, sizeof(slot->m_piIP));
+   slot->m_llTime = time(NULL);
+   slot->m_iRTT = ib->m_iRTT;
+   slot->m_iBandwidth = ib->m_iBandwidth;
+   slot->m_iLossRate = ib->m_iLossRate;
+   slot->m_iReorderDistance = ib->m_iReorderDistance;
+   slot->m_dInterval = ib->m_dInterval;
+   slot->m_dCWnd = ib->m_dCWnd;
+
+   unlockFile();
+}
+
+void CCache::lockFile()
+{
+   // serializes the processes sharing the file, m_Lock covers the threads of this one
+   #ifndef WIN32
+      flock(m_iFile, LOCK_EX);
+   #else
+      OVERLAPPED ov;
+      memset(&ov, 0, sizeof(OVERLAPPED));
+      LockFileEx(m_hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, m_iMapSize, 0, &ov);
+   #endif
+}
+
+void CCache::unlockFile()
+{
+   #ifndef WIN32
+      flock(m_iFile, LOCK_UN);
+   #else
+      OVERLAPPED ov;
+      memset(&ov, 0, sizeof(OVERLAPPED));
+      UnlockFileEx(m_hFile, 0, m_iMapSize, 0, &ov);
+   #endif
+}
+
 void CCache::convert(const sockaddr* addr, const int& ver, uint32_t* ip)
 {
    if (ver == AF_INET)
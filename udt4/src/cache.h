@@ -72,6 +72,27 @@ struct CTSComp
    bool operator()(const CInfoBlock* ib1, const CInfoBlock* ib2) const;
 };
 
+// on-disk layout of a persistent cache: a header followed by m_iSize fixed-size records
+struct CCacheFileHeader
+{
+   char m_pcMagic[8];                   // "UDTCACHE"
+   int32_t m_iVersion;
+   int32_t m_iSize;                     // number of records
+};
+
+struct CCacheRecord
+{
+   int32_t m_iIPversion;                // 0 for an empty record
+   uint32_t m_piIP[4];
+   int64_t m_llTime;                    // wall clock of the last update, seconds since the epoch
+   int32_t m_iRTT;
+   int32_t m_iBandwidth;
+   int32_t m_iLossRate;
+   int32_t m_iReorderDistance;
+   double m_dInterval;
+   double m_dCWnd;
+};
+
 class CCache
 {
 public:
@@ -83,13 +104,40 @@ public:
    int lookup(const sockaddr* addr, const int& ver, CInfoBlock* hb);
    void update(const sockaddr* addr, const int& ver, CInfoBlock* hb);
 
+      // Functionality:
+      //    Back the cache with a memory mapped file shared by all processes using the same path.
+      //    Unexpired records are loaded and every update is written through.
+      // Parameters:
+      //    0) [in] path: cache file, created if it does not exist.
+      //    1) [in] maxage: seconds after which an entry is ignored, 0 to keep entries forever.
+      // Returned value:
+      //    0 if success, otherwise -1.
+
+   int open(const char* path, const int& maxage);
+
 private:
    void convert(const sockaddr* addr, const int& ver, uint32_t* ip);
+   void insert(CInfoBlock* ib);
+   void close();
+   void load();
+   void store(const CInfoBlock* ib);
+   void lockFile();
+   void unlockFile();
 
 private:
    unsigned int m_uiSize;
    std::set<CInfoBlock*, CIPComp> m_sIPIndex;
    std::set<CInfoBlock*, CTSComp> m_sTSIndex;
+   uint64_t m_ullMaxAge;                // entry lifetime in microseconds, 0 for no expiry
+
+   char* m_pcMap;                       // mapped cache file, NULL if the cache is not persistent
+   int m_iMapSize;                      // size of the mapping in bytes
+   #ifndef WIN32
+      int m_iFile;
+   #else
+      HANDLE m_hFile;
+      HANDLE m_hMap;
+   #endif
 
    pthread_mutex_t m_Lock;
 
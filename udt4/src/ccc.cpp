@@ -55,6 +55,10 @@ m_iMSS(),
 m_iSndCurrSeqNo(),
 m_iRcvRate(),
 m_iRTT(),
+m_iOWD(),
+m_bOWD(false),
+m_dCachedSndPeriod(0),
+m_dCachedCWndSize(0),
 m_pcParam(NULL),
 m_iPSize(0),
 m_UDT(),
@@ -62,7 +66,8 @@ m_iACKPeriod(0),
 m_iACKInterval(0),
 m_bUserDefinedRTO(false),
 m_iRTO(-1),
-m_PerfInfo()
+m_PerfInfo(),
+m_pTrace(NULL)
 {
 }
 
@@ -140,6 +145,18 @@ void CCC::setRTT(const int& rtt)
    m_iRTT = rtt;
 }
 
+void CCC::setOneWayDelay(const int& owd)
+{
+   m_iOWD = owd;
+   m_bOWD = true;
+}
+
+void CCC::setCachedPath(const double& period, const double& cwnd)
+{
+   m_dCachedSndPeriod = period;
+   m_dCachedCWndSize = cwnd;
+}
+
 void CCC::setUserParam(const char* param, const int& size)
 {
    delete [] m_pcParam;
@@ -148,6 +165,12 @@ void CCC::setUserParam(const char* param, const int& size)
    m_iPSize = size;
 }
 
+void CCC::trace(const int32_t& code, const double& value) const
+{
+   if (NULL != m_pTrace)
+      m_pTrace->record(UDT_TRACE_CC_USER, code, m_dPktSndPeriod, m_dCWndSize, value);
+}
+
 //
 CUDTCC::CUDTCC():
 m_iRCInterval(),
@@ -181,6 +204,15 @@ void CUDTCC::init()
 
    m_dCWndSize = 16;
    m_dPktSndPeriod = 1;
+
+   // the path is known from an earlier connection, start at the rate it ended with instead of probing
+   if ((m_dCachedSndPeriod > 0) && (m_dCachedCWndSize > 0))
+   {
+      m_bSlowStart = false;
+      m_dPktSndPeriod = m_dCachedSndPeriod;
+      m_dLastDecPeriod = m_dCachedSndPeriod;
+      m_dCWndSize = m_dCachedCWndSize;
+   }
 }
 
 void CUDTCC::onACK(const int32_t& ack)
@@ -46,6 +46,8 @@ written by
 #include "udt.h"
 #include "packet.h"
 
+class CTraceRing;
+
 
 class UDT_API CCC
 {
@@ -194,6 +196,16 @@ protected:
 
    void setUserParam(const char* param, const int& size);
 
+      // Functionality:
+      //    Log an algorithm specific event to the socket's trace ring, if tracing is on.
+      // Parameters:
+      //    0) [in] code: event code chosen by the algorithm, stored as the event seqno.
+      //    1) [in] value: value to record with the current sending period and window.
+      // Returned value:
+      //    None.
+
+   void trace(const int32_t& code, const double& value) const;
+
 private:
    void setMSS(const int& mss);
    void setMaxCWndSize(const int& cwnd);
@@ -201,6 +213,8 @@ private:
    void setSndCurrSeqNo(const int32_t& seqno);
    void setRcvRate(const int& rcvrate);
    void setRTT(const int& rtt);
+   void setOneWayDelay(const int& owd);
+   void setCachedPath(const double& period, const double& cwnd);
 
 protected:
    const int32_t& m_iSYNInterval;	// UDT constant parameter, SYN
@@ -215,6 +229,10 @@ protected:
    int32_t m_iSndCurrSeqNo;		// current maximum seq no sent out
    int m_iRcvRate;			// packet arrive rate at receiver side, packets per second
    int m_iRTT;				// current estimated RTT, microsecond
+   int m_iOWD;				// smallest one-way delay in the last ACK, microsecond, offset by the peer clock difference
+   bool m_bOWD;				// if the receiver reports one-way delay (m_iOWD is valid)
+   double m_dCachedSndPeriod;           // sending period the last connection to this peer ended with, 0 if unknown
+   double m_dCachedCWndSize;            // window the last connection to this peer ended with, 0 if unknown
 
    char* m_pcParam;			// user defined parameter
    int m_iPSize;			// size of m_pcParam
@@ -229,6 +247,8 @@ private:
    int m_iRTO;                          // RTO value, microseconds
 
    CPerfMon m_PerfInfo;                 // protocol statistics information
+
+   CTraceRing* m_pTrace;                // event trace of the bound UDT entity
 };
 
 class CCCVirtualFactory
@@ -55,6 +55,7 @@ written by
 #endif
 #include "channel.h"
 #include "packet.h"
+#include "common.h"
 
 #ifdef WIN32
    #define socklen_t int
@@ -71,20 +72,41 @@ CChannel::CChannel():
 m_iIPversion(AF_INET),
 m_iSocket(),
 m_iSndBufSize(65536),
-m_iRcvBufSize(65536)
+m_iRcvBufSize(65536),
+m_iDFSize(0),
+m_bDFApplied(false),
+m_DFLock()
 {
+   #ifndef WIN32
+      pthread_mutex_init(&m_DFLock, NULL);
+   #else
+      m_DFLock = CreateMutex(NULL, false, NULL);
+   #endif
 }
 
 CChannel::CChannel(const int& version):
 m_iIPversion(version),
 m_iSocket(),
 m_iSndBufSize(65536),
-m_iRcvBufSize(65536)
+m_iRcvBufSize(65536),
+m_iDFSize(0),
+m_bDFApplied(false),
+m_DFLock()
 {
+   #ifndef WIN32
+      pthread_mutex_init(&m_DFLock, NULL);
+   #else
+      m_DFLock = CreateMutex(NULL, false, NULL);
+   #endif
 }
 
 CChannel::~CChannel()
 {
+   #ifndef WIN32
+      pthread_mutex_destroy(&m_DFLock);
+   #else
+      CloseHandle(m_DFLock);
+   #endif
 }
 
 void CChannel::open(const sockaddr* addr)
@@ -152,6 +174,10 @@ void CChannel::setUDPSockOpt()
          throw CUDTException(1, 3, NET_ERROR);
    #endif
 
+   // the system default may set the bit already, packets are let through in fragments until they are larger than the base size
+   if (m_iDFSize > 0)
+      applyDontFragment(false);
+
    timeval tv;
    tv.tv_sec = 0;
    #if defined (BSD) || defined (OSX)
@@ -179,6 +205,37 @@ void CChannel::setUDPSockOpt()
    #endif
 }
 
+void CChannel::applyDontFragment(const bool& df) const
+{
+   // Linux sets the bit but does not hold the packets to the path MTU it has learned, the probes need to go out
+   #if defined(IP_MTU_DISCOVER) && defined(IP_PMTUDISC_PROBE)
+      int mode = df ? IP_PMTUDISC_PROBE : IP_PMTUDISC_DONT;
+      if (AF_INET == m_iIPversion)
+         setsockopt(m_iSocket, IPPROTO_IP, IP_MTU_DISCOVER, (char*)&mode, sizeof(int));
+      #if defined(IPV6_MTU_DISCOVER) && defined(IPV6_PMTUDISC_PROBE)
+         else
+         {
+            mode = df ? IPV6_PMTUDISC_PROBE : IPV6_PMTUDISC_DONT;
+            setsockopt(m_iSocket, IPPROTO_IPV6, IPV6_MTU_DISCOVER, (char*)&mode, sizeof(int));
+         }
+      #endif
+   #elif defined(IP_DONTFRAG) || defined(IP_DONTFRAGMENT)
+      #ifdef IP_DONTFRAG
+         int flag = df ? 1 : 0;
+         if (AF_INET == m_iIPversion)
+            setsockopt(m_iSocket, IPPROTO_IP, IP_DONTFRAG, (char*)&flag, sizeof(int));
+      #else
+         DWORD flag = df ? 1 : 0;
+         if (AF_INET == m_iIPversion)
+            setsockopt(m_iSocket, IPPROTO_IP, IP_DONTFRAGMENT, (char*)&flag, sizeof(DWORD));
+      #endif
+      #ifdef IPV6_DONTFRAG
+         else
+            setsockopt(m_iSocket, IPPROTO_IPV6, IPV6_DONTFRAG, (char*)&flag, sizeof(flag));
+      #endif
+   #endif
+}
+
 void CChannel::close() const
 {
    #ifndef WIN32
@@ -216,6 +273,11 @@ void CChannel::setRcvBufSize(const int& size)
    m_iRcvBufSize = size;
 }
 
+void CChannel::setDontFragment(const int& size)
+{
+   m_iDFSize = size;
+}
+
 void CChannel::getSockAddr(sockaddr* addr) const
 {
    socklen_t namelen = (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
@@ -230,28 +292,58 @@ void CChannel::getPeerAddr(sockaddr* addr) const
    getpeername(m_iSocket, addr, &namelen);
 }
 
-int CChannel::sendto(const sockaddr* addr, CPacket& packet) const
+int CChannel::sendto(const sockaddr* addr, CPacket& packet, const bool& fragment) const
 {
-   // convert control information into network order
-   if (packet.getFlag())
-      for (int i = 0, n = packet.getLength() / 4; i < n; ++ i)
-         *((uint32_t *)packet.m_pcData + i) = htonl(*((uint32_t *)packet.m_pcData + i));
+   // the bit is switched only when a packet needs the other setting, and it stays as it is until the packet is sent;
+   // an MTU probe that got through in fragments would pass for a larger path MTU. Packets small enough for
+   // any path go out with whatever is set.
+   bool exclusive = false;
+   if (m_iDFSize > 0)
+   {
+      int size = CPacket::m_iPktHdrSize + packet.getLength();
+      bool probe = (1 == packet.getFlag()) && (12 == packet.getType());
+      if (probe || (size > m_iDFMinSize))
+      {
+         bool df = probe || (!fragment && (size > m_iDFSize));
+         exclusive = true;
+         CGuard::enterCS(m_DFLock);
+         if (df != m_bDFApplied)
+         {
+            applyDontFragment(df);
+            m_bDFApplied = df;
+         }
+      }
+   }
 
-   // convert packet header into network order
-   //for (int j = 0; j < 4; ++ j)
-   //   packet.m_nHeader[j] = htonl(packet.m_nHeader[j]);
-   uint32_t* p = packet.m_nHeader;
-   for (int j = 0; j < 4; ++ j)
+   // the packet stays in host order: the header, and the control information, are converted into
+   // scratch buffers that are sent in their place; four header words are faster inline than in a vector kernel
+   uint32_t header[4];
+   for (int i = 0; i < 4; ++ i)
+      header[i] = htonl(packet.m_nHeader[i]);
+
+   iovec vec[2];
+   vec[0] = packet.m_PacketVector[0];
+   vec[0].iov_base = (char*)header;
+   vec[1] = packet.m_PacketVector[1];
+
+   // large enough for the control packets of a 1500-byte MSS, bigger loss reports and MTU probes take the heap
+   uint32_t control[375];
+   uint32_t* info = NULL;
+   if (packet.getFlag())
    {
-      *p = htonl(*p);
-      ++ p;
+      int len = packet.getLength();
+      info = (len <= (int)sizeof(control)) ? control : new uint32_t[(len + 3) / 4];
+      CByteOrder::hton(info, (uint32_t*)packet.m_pcData, len / 4);
+      // trailing bytes that do not make a full word go out as they are
+      memcpy((char*)info + len / 4 * 4, packet.m_pcData + len / 4 * 4, len % 4);
+      vec[1].iov_base = (char*)info;
    }
 
    #ifndef WIN32
       msghdr mh;
       mh.msg_name = (sockaddr*)addr;
       mh.msg_namelen = (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
-      mh.msg_iov = (iovec*)packet.m_PacketVector;
+      mh.msg_iov = vec;
       mh.msg_iovlen = 2;
       mh.msg_control = NULL;
       mh.msg_controllen = 0;
@@ -261,28 +353,20 @@ int CChannel::sendto(const sockaddr* addr, CPacket& packet) const
    #else
       DWORD size = CPacket::m_iPktHdrSize + packet.getLength();
       int addrsize = (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
-      int res = WSASendTo(m_iSocket, (LPWSABUF)packet.m_PacketVector, 2, &size, 0, addr, addrsize, NULL, NULL);
+      int res = WSASendTo(m_iSocket, (LPWSABUF)vec, 2, &size, 0, addr, addrsize, NULL, NULL);
       res = (0 == res) ? size : -1;
    #endif
 
-   // convert back into local host order
-   //for (int k = 0; k < 4; ++ k)
-   //   packet.m_nHeader[k] = ntohl(packet.m_nHeader[k]);
-   p = packet.m_nHeader;
-   for (int k = 0; k < 4; ++ k)
-   {
-      *p = ntohl(*p);
-       ++ p;
-   }
+   if ((NULL != info) && (control != info))
+      delete [] info;
 
-   if (packet.getFlag())
-      for (int l = 0, n = packet.getLength() / 4; l < n; ++ l)
-         *((uint32_t *)packet.m_pcData + l) = ntohl(*((uint32_t *)packet.m_pcData + l));
+   if (exclusive)
+      CGuard::leaveCS(m_DFLock);
 
    return res;
 }
 
-int CChannel::recvfrom(sockaddr* addr, CPacket& packet) const
+int CChannel::recvfrom(sockaddr* addr, CPacket& packet, bool block) const
 {
    #ifndef WIN32
       msghdr mh;   
@@ -295,17 +379,31 @@ int CChannel::recvfrom(sockaddr* addr, CPacket& packet) const
       mh.msg_flags = 0;
 
       #ifdef UNIX
-         fd_set set;
-         timeval tv;
-         FD_ZERO(&set);
-         FD_SET(m_iSocket, &set);
-         tv.tv_sec = 0;
-         tv.tv_usec = 10000;
-         select(m_iSocket+1, &set, NULL, &set, &tv);
+         if (block)
+         {
+            fd_set set;
+            timeval tv;
+            FD_ZERO(&set);
+            FD_SET(m_iSocket, &set);
+            tv.tv_sec = 0;
+            tv.tv_usec = 10000;
+            select(m_iSocket+1, &set, NULL, &set, &tv);
+         }
       #endif
 
-      int res = recvmsg(m_iSocket, &mh, 0);
+      int res = recvmsg(m_iSocket, &mh, block ? 0 : MSG_DONTWAIT);
    #else
+      if (!block)
+      {
+         // the socket has a receiving time-out, so check for a queued packet first
+         u_long pending = 0;
+         if ((0 != ioctlsocket(m_iSocket, FIONREAD, &pending)) || (0 == pending))
+         {
+            packet.setLength(-1);
+            return -1;
+         }
+      }
+
       DWORD size = CPacket::m_iPktHdrSize + packet.getLength();
       DWORD flag = 0;
       int addrsize = (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
@@ -333,8 +431,7 @@ int CChannel::recvfrom(sockaddr* addr, CPacket& packet) const
    }
 
    if (packet.getFlag())
-      for (int j = 0, n = packet.getLength() / 4; j < n; ++ j)
-         *((uint32_t *)packet.m_pcData + j) = ntohl(*((uint32_t *)packet.m_pcData + j));
+      CByteOrder::ntoh((uint32_t*)packet.m_pcData, (uint32_t*)packet.m_pcData, packet.getLength() / 4);
 
    return packet.getLength();
 }
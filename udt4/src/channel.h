@@ -44,6 +44,7 @@ written by
 
 #include "udt.h"
 #include "packet.h"
+#include "common.h"
 
 
 class CChannel
@@ -116,6 +117,15 @@ public:
 
    void setRcvBufSize(const int& size);
 
+      // Functionality:
+      //    Send the larger packets with fragmentation off, so that a packet too large for the path is lost instead of split.
+      // Parameters:
+      //    0) [in] size: packets with a larger UDP payload, and MTU probes, get the don't fragment bit; 0 for none.
+      // Returned value:
+      //    None.
+
+   void setDontFragment(const int& size);
+
       // Functionality:
       //    Query the socket address that the channel is using.
       // Parameters:
@@ -139,23 +149,26 @@ public:
       // Parameters:
       //    0) [in] addr: pointer to the destination address.
       //    1) [in] packet: reference to a CPacket entity.
+      //    2) [in] fragment: send it without the don't fragment bit whatever its size, for data cut before the path MTU was lowered.
       // Returned value:
       //    Actual size of data sent.
 
-   int sendto(const sockaddr* addr, CPacket& packet) const;
+   int sendto(const sockaddr* addr, CPacket& packet, const bool& fragment = false) const;
 
       // Functionality:
       //    Receive a packet from the channel and record the source address.
       // Parameters:
       //    0) [in] addr: pointer to the source address.
       //    1) [in] packet: reference to a CPacket entity.
+      //    2) [in] block: if false, return immediately when no packet is queued.
       // Returned value:
       //    Actual size of data received.
 
-   int recvfrom(sockaddr* addr, CPacket& packet) const;
+   int recvfrom(sockaddr* addr, CPacket& packet, bool block = true) const;
 
 private:
    void setUDPSockOpt();
+   void applyDontFragment(const bool& df) const;
 
 private:
    int m_iIPversion;                    // IP version
@@ -164,6 +177,11 @@ private:
 
    int m_iSndBufSize;                   // UDP sending buffer size
    int m_iRcvBufSize;                   // UDP receiving buffer size
+   int m_iDFSize;                       // packets with a larger UDP payload are sent with the don't fragment bit, 0 if none is
+   mutable bool m_bDFApplied;           // if the bit is set on the socket now
+   mutable pthread_mutex_t m_DFLock;    // held while the bit is switched and a packet that depends on it is sent
+
+   static const int m_iDFMinSize = 548; // UDP payload of a 576-byte IPv4 packet, which every path carries
 };
 
 
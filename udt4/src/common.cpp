@@ -52,9 +52,30 @@ written by
 #endif
 #
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
 #include "md5.h"
 #include "common.h"
 
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+   #define UDT_BIG_ENDIAN
+#endif
+
+#if !defined(UDT_BIG_ENDIAN) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+   #define UDT_SWAP_X86
+   #ifdef _MSC_VER
+      #include <intrin.h>
+      #define UDT_TARGET(isa)
+   #else
+      #include <immintrin.h>
+      #define UDT_TARGET(isa) __attribute__((target(isa)))
+   #endif
+#elif !defined(UDT_BIG_ENDIAN) && defined(__ARM_NEON)
+   #define UDT_SWAP_NEON
+   #include <arm_neon.h>
+#endif
+
 uint64_t CTimer::s_ullCPUFrequency = CTimer::readCPUFrequency();
 #ifndef WIN32
    pthread_mutex_t CTimer::m_EventLock = PTHREAD_MUTEX_INITIALIZER;
@@ -311,6 +332,17 @@ m_iLocked()
    #endif
 }
 
+CGuard::CGuard(pthread_mutex_t& lock, const bool& enabled):
+m_Mutex(lock),
+m_iLocked()
+{
+   #ifndef WIN32
+      m_iLocked = enabled ? pthread_mutex_lock(&m_Mutex) : -1;
+   #else
+      m_iLocked = enabled ? WaitForSingleObject(m_Mutex, INFINITE) : WAIT_FAILED;
+   #endif
+}
+
 // Automatically unlock in destructor
 CGuard::~CGuard()
 {
@@ -378,6 +410,166 @@ void CGuard::releaseCond(pthread_cond_t& cond)
 
 }
 
+//
+CHistogram::CHistogram():
+m_llSum(0)
+{
+   for (int i = 0; i < UDT_HIST_BUCKETS; ++ i)
+      m_aiCount[i] = 0;
+}
+
+void CHistogram::record(int64_t value)
+{
+   if (value < 0)
+      value = 0;
+
+   CAtomic::add(m_aiCount[bucket(value)], 1);
+   CAtomic::add(m_llSum, value);
+}
+
+void CHistogram::snapshot(CPerfHistogram* hist) const
+{
+   // buckets are copied one by one while writers go on, so the count is taken from the copy itself
+   hist->count = 0;
+   for (int i = 0; i < UDT_HIST_BUCKETS; ++ i)
+   {
+      hist->counts[i] = CAtomic::load(m_aiCount[i]);
+      hist->count += hist->counts[i];
+   }
+   hist->usSum = CAtomic::load(m_llSum);
+}
+
+int CHistogram::bucket(int64_t value)
+{
+   // values below 16 are exact, above that the top 4 significant bits select the bucket
+   if (value < 16)
+      return (value < 0) ? 0 : int(value);
+
+   if (value >= (int64_t(1) << 36))
+      return UDT_HIST_BUCKETS - 1;
+
+   int msb = 4;
+   while ((value >> (msb + 1)) > 0)
+      ++ msb;
+
+   int shift = msb - 3;
+   return shift * 8 + int(value >> shift);
+}
+
+int64_t CHistogram::bound(int bucket)
+{
+   if (bucket < 16)
+      return (bucket < 0) ? 0 : bucket;
+
+   if (bucket >= UDT_HIST_BUCKETS)
+      bucket = UDT_HIST_BUCKETS - 1;
+
+   int shift = bucket / 8 - 1;
+   return ((int64_t(bucket % 8 + 9)) << shift) - 1;
+}
+
+//
+CTraceRing::CTraceRing():
+m_bEnabled(false),
+m_pEvents(NULL),
+m_llNext(0),
+m_ullStartTSC(0),
+m_llStartTime(0)
+{
+}
+
+CTraceRing::~CTraceRing()
+{
+   delete [] m_pEvents;
+}
+
+void CTraceRing::enable(bool on)
+{
+   if (on && (NULL == m_pEvents))
+   {
+      m_pEvents = new CTraceEvent[UDT_TRACE_EVENTS];
+      for (int i = 0; i < UDT_TRACE_EVENTS; ++ i)
+         m_pEvents[i].index = -1;
+
+      CTimer::rdtsc(m_ullStartTSC);
+      m_llStartTime = CTimer::getTime();
+
+      // the ring must be visible before any writer sees the flag
+      CAtomic::releaseFence();
+   }
+
+   m_bEnabled = on;
+}
+
+void CTraceRing::write(int32_t type, int32_t seqno, double period, double cwnd, double value)
+{
+   int64_t index = CAtomic::add(m_llNext, 1);
+   CTraceEvent& e = m_pEvents[index & (UDT_TRACE_EVENTS - 1)];
+
+   // invalidate the slot first so that dump() never takes a half written event
+   CAtomic::publish(e.index, -1);
+   CAtomic::releaseFence();
+
+   CTimer::rdtsc(e.tsc);
+   e.type = type;
+   e.seqno = seqno;
+   e.sndPeriod = period;
+   e.cwnd = cwnd;
+   e.value = value;
+
+   CAtomic::publish(e.index, index);
+}
+
+void CTraceRing::dump(const char* path, UDTSOCKET id) const
+{
+   std::vector<CTraceEvent> events;
+
+   if (NULL != m_pEvents)
+   {
+      int64_t next = CAtomic::load(m_llNext);
+      int64_t first = (next > UDT_TRACE_EVENTS) ? next - UDT_TRACE_EVENTS : 0;
+      events.reserve(int(next - first));
+
+      for (int64_t i = first; i < next; ++ i)
+      {
+         const CTraceEvent& slot = m_pEvents[i & (UDT_TRACE_EVENTS - 1)];
+
+         // skip events that are still being written or were overwritten while being copied
+         if (CAtomic::acquire(slot.index) != i)
+            continue;
+         CTraceEvent e = slot;
+         CAtomic::acquireFence();
+         if (CAtomic::load(slot.index) != i)
+            continue;
+
+         e.index = i;
+         events.push_back(e);
+      }
+   }
+
+   CTraceHeader header;
+   memset(&header, 0, sizeof(CTraceHeader));
+   memcpy(header.magic, "UDTTRACE", 8);
+   header.version = 1;
+   header.socket = id;
+   header.ticksPerUs = double(CTimer::getCPUFrequency());
+   header.startTSC = m_ullStartTSC;
+   header.startTime = m_llStartTime;
+   header.count = events.size();
+
+   std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+   if (!ofs)
+      throw CUDTException(4, 4, 0);
+
+   ofs.write((char*)&header, sizeof(CTraceHeader));
+   if (!events.empty())
+      ofs.write((char*)&events[0], events.size() * sizeof(CTraceEvent));
+   ofs.close();
+
+   if (ofs.fail())
+      throw CUDTException(4, 4, 0);
+}
+
 //
 CUDTException::CUDTException(int major, int minor, int err):
 m_iMajor(major),
@@ -745,3 +937,176 @@ void CMD5::compute(const char* input, unsigned char result[16])
    md5_append(&state, (const md5_byte_t *)input, strlen(input));
    md5_finish(&state, result);
 }
+
+#define SIPROUND \
+   do { \
+      v0 += v1; v1 = (v1 << 13) | (v1 >> 51); v1 ^= v0; v0 = (v0 << 32) | (v0 >> 32); \
+      v2 += v3; v3 = (v3 << 16) | (v3 >> 48); v3 ^= v2; \
+      v0 += v3; v3 = (v3 << 21) | (v3 >> 43); v3 ^= v0; \
+      v2 += v1; v1 = (v1 << 17) | (v1 >> 47); v1 ^= v2; v2 = (v2 << 32) | (v2 >> 32); \
+   } while (0)
+
+static uint64_t siphash_load(const unsigned char* p, const int& len)
+{
+   // little endian on every platform, so that the value does not depend on the host
+   uint64_t v = 0;
+   for (int i = len - 1; i >= 0; -- i)
+      v = (v << 8) | p[i];
+   return v;
+}
+
+uint64_t CSipHash::compute(const unsigned char key[16], const void* input, const int& len)
+{
+   uint64_t k0 = siphash_load(key, 8);
+   uint64_t k1 = siphash_load(key + 8, 8);
+
+   uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+   uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+   uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+   uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+   const unsigned char* p = (const unsigned char*)input;
+   int left = len;
+   for (; left >= 8; p += 8, left -= 8)
+   {
+      uint64_t m = siphash_load(p, 8);
+      v3 ^= m;
+      SIPROUND;
+      SIPROUND;
+      v0 ^= m;
+   }
+
+   // the last block carries the remaining bytes and the length
+   uint64_t b = ((uint64_t)len << 56) | siphash_load(p, left);
+   v3 ^= b;
+   SIPROUND;
+   SIPROUND;
+   v0 ^= b;
+
+   v2 ^= 0xff;
+   SIPROUND;
+   SIPROUND;
+   SIPROUND;
+   SIPROUND;
+
+   return v0 ^ v1 ^ v2 ^ v3;
+}
+
+//
+static void swap_scalar(uint32_t* dst, const uint32_t* src, int n)
+{
+   #ifndef UDT_BIG_ENDIAN
+      for (int i = 0; i < n; ++ i)
+      {
+         uint32_t w = src[i];
+         dst[i] = (w >> 24) | ((w >> 8) & 0xFF00) | ((w << 8) & 0xFF0000) | (w << 24);
+      }
+   #else
+      if (dst != src)
+         memcpy(dst, src, n * 4);
+   #endif
+}
+
+#ifdef UDT_SWAP_X86
+UDT_TARGET("ssse3") static void swap_ssse3(uint32_t* dst, const uint32_t* src, int n)
+{
+   const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+   int i = 0;
+   for (; i + 4 <= n; i += 4)
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), mask));
+
+   swap_scalar(dst + i, src + i, n - i);
+}
+
+UDT_TARGET("avx2") static void swap_avx2(uint32_t* dst, const uint32_t* src, int n)
+{
+   // the shuffle works within each 128-bit lane, so both lanes get the same pattern
+   const __m256i mask = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+   int i = 0;
+   for (; i + 16 <= n; i += 16)
+   {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(a, mask));
+      _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_shuffle_epi8(b, mask));
+   }
+   for (; i + 8 <= n; i += 8)
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), mask));
+
+   // the last 0-7 words of the payload go through the 128-bit shuffle and the scalar loop
+   swap_ssse3(dst + i, src + i, n - i);
+}
+
+// 2 with AVX2, 1 with SSSE3, 0 otherwise
+static int cpu_swap_level()
+{
+   #ifndef _MSC_VER
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+         return 2;
+      return __builtin_cpu_supports("ssse3") ? 1 : 0;
+   #else
+      int info[4];
+      __cpuid(info, 0);
+      int top = info[0];
+      __cpuid(info, 1);
+      bool ssse3 = 0 != (info[2] & (1 << 9));
+
+      // AVX2 also needs the OS to save the YMM registers
+      if ((top >= 7) && (0 != (info[2] & (1 << 27))) && (6 == (_xgetbv(0) & 6)))
+      {
+         __cpuidex(info, 7, 0);
+         if (0 != (info[1] & (1 << 5)))
+            return 2;
+      }
+      return ssse3 ? 1 : 0;
+   #endif
+}
+#endif
+
+#ifdef UDT_SWAP_NEON
+static void swap_neon(uint32_t* dst, const uint32_t* src, int n)
+{
+   int i = 0;
+   for (; i + 4 <= n; i += 4)
+      vst1q_u8((uint8_t*)(dst + i), vrev32q_u8(vld1q_u8((const uint8_t*)(src + i))));
+
+   swap_scalar(dst + i, src + i, n - i);
+}
+#endif
+
+static void swap_select(uint32_t* dst, const uint32_t* src, int n);
+
+// resolved at the first call; threads racing on it all store the same value
+static void (* volatile swap_kernel)(uint32_t*, const uint32_t*, int) = swap_select;
+
+static void swap_select(uint32_t* dst, const uint32_t* src, int n)
+{
+   void (*kernel)(uint32_t*, const uint32_t*, int) = swap_scalar;
+
+   #if defined(UDT_SWAP_X86)
+      int level = cpu_swap_level();
+      if (2 == level)
+         kernel = swap_avx2;
+      else if (1 == level)
+         kernel = swap_ssse3;
+   #elif defined(UDT_SWAP_NEON)
+      kernel = swap_neon;
+   #endif
+
+   swap_kernel = kernel;
+   kernel(dst, src, n);
+}
+
+void CByteOrder::hton(uint32_t* dst, const uint32_t* src, const int& n)
+{
+   swap_kernel(dst, src, n);
+}
+
+void CByteOrder::ntoh(uint32_t* dst, const uint32_t* src, const int& n)
+{
+   swap_kernel(dst, src, n);
+}
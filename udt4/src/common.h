@@ -184,6 +184,7 @@ class CGuard
 {
 public:
    CGuard(pthread_mutex_t& lock);
+   CGuard(pthread_mutex_t& lock, const bool& enabled);     // takes the lock only if enabled
    ~CGuard();
 
 public:
@@ -203,6 +204,248 @@ private:
    CGuard& operator=(const CGuard&);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Atomic operations on 64-bit counters. add() and load() are relaxed: they impose no ordering on
+// other memory accesses, readers just see each counter move forward and never a torn value.
+// publish() and acquire() pair up to hand other data over together with the counter.
+
+class CAtomic
+{
+public:
+   inline static int64_t add(volatile int64_t& counter, const int64_t& delta)
+   {
+   #ifndef WIN32
+      #ifdef __ATOMIC_RELAXED
+         return __atomic_fetch_add(&counter, delta, __ATOMIC_RELAXED);
+      #else
+         return __sync_fetch_and_add(&counter, delta);
+      #endif
+   #else
+      return InterlockedExchangeAdd64((volatile LONGLONG*)&counter, delta);
+   #endif
+   }
+
+   inline static int64_t load(const volatile int64_t& counter)
+   {
+   #ifndef WIN32
+      #ifdef __ATOMIC_RELAXED
+         return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+      #else
+         return __sync_fetch_and_add(const_cast<volatile int64_t*>(&counter), 0);
+      #endif
+   #else
+      return InterlockedCompareExchange64((volatile LONGLONG*)&counter, 0, 0);
+   #endif
+   }
+
+   inline static void publish(volatile int64_t& counter, const int64_t& value)
+   {
+   #ifndef WIN32
+      #ifdef __ATOMIC_RELEASE
+         __atomic_store_n(&counter, value, __ATOMIC_RELEASE);
+      #else
+         __sync_synchronize();
+         counter = value;
+      #endif
+   #else
+      InterlockedExchange64((volatile LONGLONG*)&counter, value);
+   #endif
+   }
+
+   inline static int64_t acquire(const volatile int64_t& counter)
+   {
+   #ifndef WIN32
+      #ifdef __ATOMIC_ACQUIRE
+         return __atomic_load_n(&counter, __ATOMIC_ACQUIRE);
+      #else
+         int64_t value = counter;
+         __sync_synchronize();
+         return value;
+      #endif
+   #else
+      return InterlockedCompareExchange64((volatile LONGLONG*)&counter, 0, 0);
+   #endif
+   }
+
+      // Functionality:
+      //    Keep the stores before this call ahead of the stores after it.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   inline static void releaseFence()
+   {
+   #ifndef WIN32
+      #ifdef __ATOMIC_RELEASE
+         __atomic_thread_fence(__ATOMIC_RELEASE);
+      #else
+         __sync_synchronize();
+      #endif
+   #else
+      MemoryBarrier();
+   #endif
+   }
+
+      // Functionality:
+      //    Keep the loads before this call ahead of the loads after it.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   inline static void acquireFence()
+   {
+   #ifndef WIN32
+      #ifdef __ATOMIC_ACQUIRE
+         __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      #else
+         __sync_synchronize();
+      #endif
+   #else
+      MemoryBarrier();
+   #endif
+   }
+
+      // Functionality:
+      //    Keep the loads and stores before this call ahead of the loads and stores after it.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   inline static void fullFence()
+   {
+   #ifndef WIN32
+      #ifdef __ATOMIC_SEQ_CST
+         __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      #else
+         __sync_synchronize();
+      #endif
+   #else
+      MemoryBarrier();
+   #endif
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// the cache line size assumed when keeping counters of different threads apart
+#define UDT_CACHE_LINE 64
+
+class CHistogram
+{
+public:
+   CHistogram();
+
+      // Functionality:
+      //    Record one value without taking any lock.
+      // Parameters:
+      //    0) [in] value: the value, in microseconds; negative values count as 0.
+      // Returned value:
+      //    None.
+
+   void record(int64_t value);
+
+      // Functionality:
+      //    Copy the histogram without disturbing concurrent record() calls.
+      // Parameters:
+      //    0) [out] hist: the copy; its count is the sum of the copied buckets.
+      // Returned value:
+      //    None.
+
+   void snapshot(CPerfHistogram* hist) const;
+
+      // Functionality:
+      //    Find the bucket a value falls into.
+      // Parameters:
+      //    0) [in] value: the value, in microseconds.
+      // Returned value:
+      //    bucket index.
+
+   static int bucket(int64_t value);
+
+      // Functionality:
+      //    Largest value that falls into a bucket.
+      // Parameters:
+      //    0) [in] bucket: bucket index.
+      // Returned value:
+      //    inclusive upper bound of the bucket, in microseconds.
+
+   static int64_t bound(int bucket);
+
+private:
+   volatile int64_t m_aiCount[UDT_HIST_BUCKETS];        // values recorded per bucket
+   volatile int64_t m_llSum;                            // sum of all recorded values
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// capacity of a trace ring, in events; a power of 2
+#define UDT_TRACE_EVENTS 16384
+
+class CTraceRing
+{
+public:
+   CTraceRing();
+   ~CTraceRing();
+
+      // Functionality:
+      //    Start or stop recording. The ring is allocated when first enabled and kept until
+      //    destruction, so writers racing with a disable never touch freed memory.
+      // Parameters:
+      //    0) [in] on: true to record events.
+      // Returned value:
+      //    None.
+
+   void enable(bool on);
+
+   inline bool enabled() const {return m_bEnabled;}
+
+      // Functionality:
+      //    Record one event; costs a flag test when tracing is off. Safe from any thread.
+      // Parameters:
+      //    0) [in] type: one of UDTTraceEvent.
+      //    1) [in] seqno: sequence number the event is about.
+      //    2) [in] period: packet sending period, in microseconds.
+      //    3) [in] cwnd: congestion window size, in packets.
+      //    4) [in] value: event specific value.
+      // Returned value:
+      //    None.
+
+   inline void record(int32_t type, int32_t seqno, double period, double cwnd, double value)
+   {
+      if (m_bEnabled)
+         write(type, seqno, period, cwnd, value);
+   }
+
+      // Functionality:
+      //    Write the recorded events to a file, oldest first, without stopping the writers.
+      // Parameters:
+      //    0) [in] path: file to create.
+      //    1) [in] id: socket written into the file header.
+      // Returned value:
+      //    None.
+
+   void dump(const char* path, UDTSOCKET id) const;
+
+private:
+   void write(int32_t type, int32_t seqno, double period, double cwnd, double value);
+
+private:
+   volatile bool m_bEnabled;                    // if events are being recorded
+   CTraceEvent* m_pEvents;                      // the ring, NULL until first enabled
+   char m_acPad[UDT_CACHE_LINE];
+   volatile int64_t m_llNext;                   // index of the next event to be written
+   char m_acNextPad[UDT_CACHE_LINE];
+   uint64_t m_ullStartTSC;                      // time stamp counter when first enabled
+   int64_t m_llStartTime;                       // wall clock time when first enabled
+
+   CTraceRing(const CTraceRing&);
+   CTraceRing& operator=(const CTraceRing&);
+};
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -312,5 +555,38 @@ struct CMD5
    static void compute(const char* input, unsigned char result[16]);
 };
 
+struct CSipHash
+{
+      // Functionality:
+      //    SipHash-2-4 of a binary input, a keyed hash that is cheap enough for every incoming packet.
+      // Parameters:
+      //    0) [in] key: 128-bit secret key.
+      //    1) [in] input: data to be hashed.
+      //    2) [in] len: size of the data.
+      // Returned value:
+      //    64-bit hash value.
+
+   static uint64_t compute(const unsigned char key[16], const void* input, const int& len);
+};
+
+// Byte order conversion of 32-bit words, vectorized where the CPU allows (AVX2 or SSSE3 on x86, NEON on ARM),
+// chosen at the first call. Converting to and from network order is the same swap on a little-endian host,
+// and a plain copy on a big-endian one.
+
+struct CByteOrder
+{
+      // Functionality:
+      //    Convert an array of 32-bit words between host and network order.
+      // Parameters:
+      //    0) [out] dst: the converted words; it may be src itself, but must not overlap it otherwise.
+      //    1) [in] src: the words to be converted.
+      //    2) [in] n: number of words.
+      // Returned value:
+      //    None.
+
+   static void hton(uint32_t* dst, const uint32_t* src, const int& n);
+   static void ntoh(uint32_t* dst, const uint32_t* src, const int& n);
+};
+
 
 #endif
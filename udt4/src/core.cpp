@@ -76,6 +76,23 @@ const int32_t CMsgNo::m_iMaxMsgNo = 0x1FFFFFFF;
 const int CUDT::m_iVersion = 4;
 const int CUDT::m_iSYNInterval = 10000;
 const int CUDT::m_iSelfClockInterval = 64;
+const int CUDT::m_iLightACKPeriod = 1000;
+const int CUDT::m_iLightACKsPerRTT = 4;
+const int CUDT::m_iMaxNAKsPerRTT = 4;
+const int CUDT::m_iMaxPathCount = 8;
+const int CUDT::m_iJoinInterval = 250000;
+const int CUDT::m_iMaxJoinCount = 16;
+const int CUDT::m_iChallengeInterval = 100000;
+const int CUDT::m_iTicketLifetime = 86400;
+const int CUDT::m_iMaxEarlyDataSize = 256;
+const int CUDT::m_iMaxUsedTickets = 65536;
+const int CUDT::m_iInitBufLimit = 256;
+const int CUDT::m_iMinBufLimit = 32;
+const int CUDT::m_iPMTUBase = 1500;
+const int CUDT::m_iPMTUMaxProbes = 3;
+const int CUDT::m_iPMTUResolution = 64;
+const int CUDT::m_iPMTURaiseInterval = 600;
+const int CUDT::m_iPMTUBlackHoleCount = 3;
 
 
 CUDT::CUDT()
@@ -87,12 +104,29 @@ CUDT::CUDT()
    m_pACKWindow = NULL;
    m_pSndTimeWindow = NULL;
    m_pRcvTimeWindow = NULL;
+   m_pFECEncoder = NULL;
+   m_pFECDecoder = NULL;
 
    m_pSndQueue = NULL;
    m_pRcvQueue = NULL;
    m_pPeerAddr = NULL;
    m_pSNode = NULL;
    m_pRNode = NULL;
+   m_pPath = NULL;
+   m_iPathCount = 0;
+   m_pcSeqPath = NULL;
+   m_iProbePath = 0;
+   m_iToken = 0;
+   m_iPeerToken = 0;
+   m_pMigrationAddr = NULL;
+   m_iChallenge = 0;
+   m_ullChallengeTime = 0;
+   memset(m_piCookieKey, 0, sizeof(m_piCookieKey));
+   m_piTicket[0] = m_piTicket[1] = 0;
+   memset(m_piTicketKey, 0, sizeof(m_piTicketKey));
+   m_pcEarlyData = NULL;
+   m_iEarlyDataSize = 0;
+   m_iResumeChallenge = 0;
 
    // Initilize mutex and condition variables
    initSynch();
@@ -115,9 +149,19 @@ CUDT::CUDT()
    m_iRcvTimeOut = -1;
    m_bReuseAddr = true;
    m_llMaxBW = -1;
+   m_bFEC = false;
+   m_bAutoTune = false;
+   m_bPMTUD = false;
+   m_iSndBufLimit = 0;
+   m_iRcvBufLimit = 0;
+   m_iSndBufFloor = 0;
+   m_ullSndTuneTime = 0;
+   m_iSndPayloadSize = 0;
+   m_iPMTU = m_iPMTULow = m_iPMTUHigh = m_iPMTUProbeSize = 0;
 
    m_pCCFactory = new CCCFactory<CUDTCC>;
    m_pCC = NULL;
+   m_pPendingCCFactory = NULL;
    m_pCache = NULL;
 
    // Initial status
@@ -139,12 +183,29 @@ CUDT::CUDT(const CUDT& ancestor)
    m_pACKWindow = NULL;
    m_pSndTimeWindow = NULL;
    m_pRcvTimeWindow = NULL;
+   m_pFECEncoder = NULL;
+   m_pFECDecoder = NULL;
 
    m_pSndQueue = NULL;
    m_pRcvQueue = NULL;
    m_pPeerAddr = NULL;
    m_pSNode = NULL;
    m_pRNode = NULL;
+   m_pPath = NULL;
+   m_iPathCount = 0;
+   m_pcSeqPath = NULL;
+   m_iProbePath = 0;
+   m_iToken = 0;
+   m_iPeerToken = 0;
+   m_pMigrationAddr = NULL;
+   m_iChallenge = 0;
+   m_ullChallengeTime = 0;
+   memset(m_piCookieKey, 0, sizeof(m_piCookieKey));
+   m_piTicket[0] = m_piTicket[1] = 0;
+   memset(m_piTicketKey, 0, sizeof(m_piTicketKey));
+   m_pcEarlyData = NULL;
+   m_iEarlyDataSize = 0;
+   m_iResumeChallenge = 0;
 
    // Initilize mutex and condition variables
    initSynch();
@@ -166,9 +227,23 @@ CUDT::CUDT(const CUDT& ancestor)
    m_iRcvTimeOut = ancestor.m_iRcvTimeOut;
    m_bReuseAddr = true;	// this must be true, because all accepted sockets shared the same port with the listener
    m_llMaxBW = ancestor.m_llMaxBW;
-
-   m_pCCFactory = ancestor.m_pCCFactory->clone();
+   m_bFEC = ancestor.m_bFEC;
+   m_bAutoTune = ancestor.m_bAutoTune;
+   m_bPMTUD = ancestor.m_bPMTUD;
+   m_iSndBufLimit = 0;
+   m_iRcvBufLimit = 0;
+   m_iSndBufFloor = 0;
+   m_ullSndTuneTime = 0;
+   m_iSndPayloadSize = 0;
+   m_iPMTU = m_iPMTULow = m_iPMTUHigh = m_iPMTUProbeSize = 0;
+   m_Trace.enable(ancestor.m_Trace.enabled());
+
+   // the listener may be handed a new factory meanwhile, the old one stays alive until it is closed
+   CCCVirtualFactory* factory = ancestor.m_pCCFactory;
+   CAtomic::acquireFence();
+   m_pCCFactory = factory->clone();
    m_pCC = NULL;
+   m_pPendingCCFactory = NULL;
    m_pCache = ancestor.m_pCache;
 
    // Initial status
@@ -194,14 +269,40 @@ CUDT::~CUDT()
    delete m_pACKWindow;
    delete m_pSndTimeWindow;
    delete m_pRcvTimeWindow;
+   delete m_pFECEncoder;
+   delete m_pFECDecoder;
    delete m_pCCFactory;
    delete m_pCC;
+   delete m_pPendingCCFactory;
+   for (std::vector<CCC*>::iterator i = m_vRetiredCC.begin(); i != m_vRetiredCC.end(); ++ i)
+      delete *i;
+   for (std::vector<CCCVirtualFactory*>::iterator i = m_vRetiredCCFactory.begin(); i != m_vRetiredCCFactory.end(); ++ i)
+      delete *i;
    delete m_pPeerAddr;
+   delete m_pMigrationAddr;
+   delete [] m_pcEarlyData;
    delete m_pSNode;
    delete m_pRNode;
+
+   for (int i = 0; i < m_iPathCount; ++ i)
+   {
+      delete m_pPath[i]->m_pCC;
+      delete m_pPath[i]->m_pPeerAddr;
+      delete m_pPath[i]->m_pSNode;
+      delete m_pPath[i];
+   }
+   delete [] m_pPath;
+   delete [] m_pcSeqPath;
+   for (std::vector<sockaddr*>::iterator i = m_vPathPeerAddr.begin(); i != m_vPathPeerAddr.end(); ++ i)
+   {
+      if (AF_INET == m_iIPversion)
+         delete (sockaddr_in*)*i;
+      else
+         delete (sockaddr_in6*)*i;
+   }
 }
 
-void CUDT::setOpt(UDTOpt optName, const void* optval, const int&)
+void CUDT::setOpt(UDTOpt optName, const void* optval, const int& optlen)
 {
    if (m_bBroken || m_bClosing)
       throw CUDTException(2, 1, 0);
@@ -221,6 +322,10 @@ void CUDT::setOpt(UDTOpt optName, const void* optval, const int&)
 
       m_iMSS = *(int*)optval;
 
+      // an IP datagram is 64KB at most
+      if (m_iMSS > 65535)
+         m_iMSS = 65535;
+
       // Packet size cannot be greater than UDP buffer size
       if (m_iMSS > m_iUDPSndBufSize)
          m_iMSS = m_iUDPSndBufSize;
@@ -239,7 +344,22 @@ void CUDT::setOpt(UDTOpt optName, const void* optval, const int&)
 
    case UDT_CC:
       if (m_bConnected)
-         throw CUDTException(5, 1, 0);
+      {
+         // the controller is in use by the queue threads, checkTimers() swaps it
+         delete m_pPendingCCFactory;
+         m_pPendingCCFactory = ((CCCVirtualFactory *)optval)->clone();
+         break;
+      }
+      if (m_bListening)
+      {
+         // the handshake thread clones the factory for every accepted connection without taking any lock of
+         // this socket, so the replaced one is only freed with the listener
+         CCCVirtualFactory* factory = ((CCCVirtualFactory *)optval)->clone();
+         CAtomic::releaseFence();
+         m_vRetiredCCFactory.push_back(m_pCCFactory);
+         m_pCCFactory = factory;
+         break;
+      }
       if (NULL != m_pCCFactory)
          delete m_pCCFactory;
       m_pCCFactory = ((CCCVirtualFactory *)optval)->clone();
@@ -342,6 +462,49 @@ void CUDT::setOpt(UDTOpt optName, const void* optval, const int&)
          throw CUDTException(5, 1, 0);
       m_llMaxBW = *(int64_t*)optval;
       break;
+
+   case UDT_TRACE:
+      m_Trace.enable(*(bool*)optval);
+      break;
+
+   case UDT_FEC:
+      if (m_bConnected)
+         throw CUDTException(5, 2, 0);
+      m_bFEC = *(bool*)optval;
+      break;
+
+   case UDT_AUTOTUNE:
+      if (m_bConnected)
+         throw CUDTException(5, 2, 0);
+      m_bAutoTune = *(bool*)optval;
+      break;
+
+   case UDT_PMTUD:
+      // the channel of a probing socket sends its larger packets with fragmentation off
+      if (m_bOpened)
+         throw CUDTException(5, 1, 0);
+      m_bPMTUD = *(bool*)optval;
+      break;
+
+   case UDT_TICKET:
+      if (m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      if (optlen < (int)sizeof(m_piTicket))
+         throw CUDTException(5, 3, 0);
+
+      memcpy(m_piTicket, optval, sizeof(m_piTicket));
+      break;
+
+   case UDT_EARLYDATA:
+      if (m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      if ((optlen < 0) || (optlen > m_iMaxEarlyDataSize))
+         throw CUDTException(5, 3, 0);
+
+      setEarlyData((const char*)optval, optlen);
+      break;
     
    default:
       throw CUDTException(5, 0, 0);
@@ -434,6 +597,43 @@ void CUDT::getOpt(UDTOpt optName, void* optval, int& optlen)
       *(int64_t*)optval = m_llMaxBW;
       break;
 
+   case UDT_TRACE:
+      *(bool*)optval = m_Trace.enabled();
+      optlen = sizeof(bool);
+      break;
+
+   case UDT_FEC:
+      *(bool*)optval = m_bFEC;
+      optlen = sizeof(bool);
+      break;
+
+   case UDT_AUTOTUNE:
+      *(bool*)optval = m_bAutoTune;
+      optlen = sizeof(bool);
+      break;
+
+   case UDT_PMTUD:
+      *(bool*)optval = m_bPMTUD;
+      optlen = sizeof(bool);
+      break;
+
+   case UDT_TICKET:
+      if (optlen < (int)sizeof(m_piTicket))
+         throw CUDTException(5, 3, 0);
+
+      memcpy(optval, m_piTicket, sizeof(m_piTicket));
+      optlen = sizeof(m_piTicket);
+      break;
+
+   case UDT_EARLYDATA:
+      if (optlen < m_iEarlyDataSize)
+         throw CUDTException(5, 3, 0);
+
+      if (m_iEarlyDataSize > 0)
+         memcpy(optval, m_pcEarlyData, m_iEarlyDataSize);
+      optlen = m_iEarlyDataSize;
+      break;
+
    default:
       throw CUDTException(5, 0, 0);
    }
@@ -455,10 +655,13 @@ void CUDT::open()
 
    // trace information
    m_StartTime = CTimer::getTime();
-   m_llSentTotal = m_llRecvTotal = m_iSndLossTotal = m_iRcvLossTotal = m_FileBytesRecvd = m_iRetransTotal = m_iSentACKTotal = m_iRecvACKTotal = m_iSentNAKTotal = m_iRecvNAKTotal = 0;
+   m_llSentTotal = m_llRetransTotal = m_llSndParityTotal = m_llSentBytesTotal = m_llRecvBytesTotal = 0;
+   m_llRecvTotal = m_llSndLossTotal = m_llRcvLossTotal = m_llSentACKTotal = m_llRecvACKTotal = m_llSentNAKTotal = m_llRecvNAKTotal = m_llRcvRecoveredTotal = 0;
+   m_llSndDurationTotal = m_FileBytesRecvd = 0;
+   m_ullLastPktSendTime = 0;
+   m_ullLastAckSentTime = 0;
    m_LastSampleTime = CTimer::getTime();
-   m_llTraceSent = m_llTraceRecv = m_iTraceSndLoss = m_iTraceRcvLoss = m_iTraceRetrans = m_iSentACK = m_iRecvACK = m_iSentNAK = m_iRecvNAK = 0;
-   m_llSndDuration = m_llSndDurationTotal = 0;
+   memset(&m_LastSample, 0, sizeof(CPerfMon));
 
    // structures for queue
    if (NULL == m_pSNode)
@@ -466,6 +669,7 @@ void CUDT::open()
    m_pSNode->m_pUDT = this;
    m_pSNode->m_llTimeStamp = 1;
    m_pSNode->m_iHeapLoc = -1;
+   m_pSNode->m_iPath = 0;
 
    if (NULL == m_pRNode)
       m_pRNode = new CRNode;
@@ -497,6 +701,16 @@ void CUDT::open()
 
    m_iPktCount = 0;
    m_iLightACKCount = 1;
+   m_iLightACKInterval = m_iSelfClockInterval;
+   m_bAdaptiveACK = false;
+   m_bACKPending = false;
+   m_bRcvDelaySampled = false;
+   m_bCompactNAK = false;
+   m_iNAKCount = 0;
+   m_ullNAKWindowEnd = 0;
+   m_iNAKPendingSeq = -1;
+   m_iPeerPayloadSize = m_iPayloadSize;
+   m_llFECLastSent = m_llFECLastLoss = 0;
 
    m_ullTargetTime = 0;
    m_ullTimeDiff = 0;
@@ -519,6 +733,13 @@ void CUDT::listen()
    if (m_bListening)
       return;
 
+   // cookies and resumption tickets are keyed with secrets of this listener, so they do not survive it
+   for (int i = 0; i < 4; ++ i)
+   {
+      m_piCookieKey[i] = createToken();
+      m_piTicketKey[i] = createToken();
+   }
+
    // if there is already another socket listening on the same port
    if (m_pRcvQueue->setListener(this) < 0)
       throw CUDTException(5, 11, 0);
@@ -557,11 +778,17 @@ void CUDT::connect(const sockaddr* serv_addr)
    req.m_iFlightFlagSize = (m_iRcvBufSize < m_iFlightFlagSize)? m_iRcvBufSize : m_iFlightFlagSize;
    req.m_iReqType = (!m_bRendezvous) ? 1 : 0;
    req.m_iID = m_SocketID;
+   req.m_iACKMode = 1;
+   req.m_iLossMode = 1;
+   req.m_iFECMode = m_bFEC ? CFECEncoder::m_iInitGroupSize : 1;
+   req.m_iTicketTime = m_piTicket[0];
+   req.m_iTicket = m_piTicket[1];
    CIPAddress::ntop(serv_addr, req.m_piPeerIP, m_iIPversion);
 
    // Random Initial Sequence Number
    srand((unsigned int)CTimer::getTime());
    m_iISN = req.m_iISN = (int32_t)(CSeqNo::m_iMaxSeqNo * (double(rand()) / RAND_MAX));
+   m_iToken = req.m_iToken = createToken();
 
    m_iLastDecSeq = req.m_iISN - 1;
    m_iSndLastAck = req.m_iISN;
@@ -584,6 +811,16 @@ void CUDT::connect(const sockaddr* serv_addr)
    uint64_t entertime = CTimer::getTime();
    uint64_t last_req_time = 0;
 
+   // listeners older than the hand shake extension drop the extended request silently,
+   // so fall back to the basic hand shake if the first requests are not answered
+   int hslen = CHandShake::m_iExtContentSize;
+   int unanswered = 0;
+
+   // early data follows the hand shake in every request, the listener takes it from the one it accepts
+   int earlysize = m_bRendezvous ? 0 : m_iEarlyDataSize;
+   if (earlysize > 0)
+      memcpy(reqdata + CHandShake::m_iExtContentSize, m_pcEarlyData, earlysize);
+
    CUDTException e(0, 0);
    char* tmp = NULL;
 
@@ -592,8 +829,14 @@ void CUDT::connect(const sockaddr* serv_addr)
       // avoid sending too many requests, at most 1 request per 250ms
       if (CTimer::getTime() - last_req_time > 250000)
       {
-         req.serialize(reqdata, m_iPayloadSize);
-         request.setLength(CHandShake::m_iContentSize);
+         if (!m_bRendezvous && (++ unanswered > 2))
+         {
+            hslen = CHandShake::m_iContentSize;
+            earlysize = 0;
+         }
+
+         req.serialize(reqdata, hslen);
+         request.setLength(hslen + earlysize);
          m_pSndQueue->sendto(serv_addr, request);
 
          last_req_time = CTimer::getTime();
@@ -602,11 +845,13 @@ void CUDT::connect(const sockaddr* serv_addr)
       response.setLength(m_iPayloadSize);
       if (m_pRcvQueue->recvfrom(m_SocketID, response) > 0)
       {
+         unanswered = 0;
+
          if (m_bRendezvous && ((0 == response.getFlag()) || (1 == response.getType())) && (NULL != tmp))
          {
             // a data packet or a keep-alive packet comes, which means the peer side is already connected
             // in this situation, a previously recorded response (tmp) will be used
-            res.deserialize(tmp, CHandShake::m_iContentSize);
+            res.deserialize(tmp, CHandShake::m_iExtContentSize);
             memcpy(m_piSelfIP, res.m_piPeerIP, 16);
             break;
          }
@@ -697,11 +942,21 @@ void CUDT::connect(const sockaddr* serv_addr)
    m_iRcvLastAckAck = res.m_iISN;
    m_iRcvCurrSeqNo = res.m_iISN - 1;
    m_PeerID = res.m_iID;
+   m_bAdaptiveACK = (1 == res.m_iACKMode);
+   m_bCompactNAK = (1 == res.m_iLossMode);
+   m_iPeerToken = res.m_iToken;
+   m_piTicket[0] = res.m_iTicketTime;
+   m_piTicket[1] = res.m_iTicket;
+
+   // parity is sent only if the peer accepts it, and expected only if the peer announced it
+   bool fecsnd = m_bFEC && (res.m_iFECMode >= 1);
+   int fecrcv = (res.m_iFECMode < CFECEncoder::m_iMaxGroupSize) ? res.m_iFECMode : CFECEncoder::m_iMaxGroupSize;
+   m_iPeerPayloadSize = (fecrcv > 1) ? CFECEncoder::dataSize(m_iPayloadSize) : m_iPayloadSize;
 
    // Prepare all data structures
    try
    {
-      m_pSndBuffer = new CSndBuffer(32, m_iPayloadSize);
+      m_pSndBuffer = new CSndBuffer(32, fecsnd ? CFECEncoder::dataSize(m_iPayloadSize) : m_iPayloadSize, m_iSndBufSize);
       m_pRcvBuffer = new CRcvBuffer(m_iRcvBufSize, &(m_pRcvQueue->m_UnitQueue));
       // after introducing lite ACK, the sndlosslist may not be cleared in time, so it requires twice space.
       m_pSndLossList = new CSndLossList(m_iFlowWindowSize * 2);
@@ -709,23 +964,27 @@ void CUDT::connect(const sockaddr* serv_addr)
       m_pACKWindow = new CACKWindow(4096);
       m_pRcvTimeWindow = new CPktTimeWindow(16, 64);
       m_pSndTimeWindow = new CPktTimeWindow();
+      if (fecsnd)
+         m_pFECEncoder = new CFECEncoder(m_iISN, CFECEncoder::m_iInitGroupSize, CFECEncoder::dataSize(m_iPayloadSize));
+      if (fecrcv > 1)
+         m_pFECDecoder = new CFECDecoder(m_iPeerISN, fecrcv, m_iPayloadSize);
    }
    catch (...)
    {
       throw CUDTException(3, 2, 0);
    }
 
+   initBufLimits();
+
    m_pCC = m_pCCFactory->create();
    m_pCC->m_UDT = m_SocketID;
+   m_pCC->m_pTrace = &m_Trace;
    m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
    m_dCongestionWindow = m_pCC->m_dCWndSize;
 
    CInfoBlock ib;
    if (m_pCache->lookup(serv_addr, m_iIPversion, &ib) >= 0)
-   {
-      m_iRTT = ib.m_iRTT;
-      m_iBandwidth = ib.m_iBandwidth;
-   }
+      seedFromCache(ib);
 
    m_pCC->setMSS(m_iMSS);
    m_pCC->setMaxCWndSize((int&)m_iFlowWindowSize);
@@ -736,6 +995,8 @@ void CUDT::connect(const sockaddr* serv_addr)
    if (m_llMaxBW > 0) m_pCC->setUserParam((char*)&(m_llMaxBW), 8);
    m_pCC->init();
 
+   initPMTU();
+
    m_pPeerAddr = (AF_INET == m_iIPversion) ? (sockaddr*)new sockaddr_in : (sockaddr*)new sockaddr_in6;
    memcpy(m_pPeerAddr, serv_addr, (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
 
@@ -787,43 +1048,69 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
    m_iSndLastAck2 = m_iISN;
    m_ullSndLastAck2Time = CTimer::getTime();
 
+   // a request that still has type 1 was accepted on a ticket without the cookie round trip, the address it came from is unproven
+   bool resumed = (1 == hs->m_iReqType);
+
    // this is a reponse handshake
    hs->m_iReqType = -1;
 
+   // the extensions are used only if the peer asked for them, older peers leave the fields 0
+   m_bAdaptiveACK = (1 == hs->m_iACKMode);
+   m_bCompactNAK = (1 == hs->m_iLossMode);
+   m_iPeerToken = hs->m_iToken;
+   m_iToken = hs->m_iToken = createToken();
+
+   // checkTimers() challenges the peer at once, the answer lets the data go out
+   if (resumed)
+   {
+      m_iResumeChallenge = createToken();
+      m_ullChallengeTime = 0;
+   }
+
+   // parity is sent only if the peer accepts it, and expected only if the peer announced it
+   bool fecsnd = m_bFEC && (hs->m_iFECMode >= 1);
+   int fecrcv = (hs->m_iFECMode < CFECEncoder::m_iMaxGroupSize) ? hs->m_iFECMode : CFECEncoder::m_iMaxGroupSize;
+   hs->m_iFECMode = m_bFEC ? CFECEncoder::m_iInitGroupSize : 1;
+
    // get local IP address and send the peer its IP address (because UDP cannot get local IP address)
    memcpy(m_piSelfIP, hs->m_piPeerIP, 16);
    CIPAddress::ntop(peer, hs->m_piPeerIP, m_iIPversion);
   
    m_iPktSize = m_iMSS - 28;
    m_iPayloadSize = m_iPktSize - CPacket::m_iPktHdrSize;
+   m_iPeerPayloadSize = (fecrcv > 1) ? CFECEncoder::dataSize(m_iPayloadSize) : m_iPayloadSize;
 
    // Prepare all structures
    try
    {
-      m_pSndBuffer = new CSndBuffer(32, m_iPayloadSize);
+      m_pSndBuffer = new CSndBuffer(32, fecsnd ? CFECEncoder::dataSize(m_iPayloadSize) : m_iPayloadSize, m_iSndBufSize);
       m_pRcvBuffer = new CRcvBuffer(m_iRcvBufSize, &(m_pRcvQueue->m_UnitQueue));
       m_pSndLossList = new CSndLossList(m_iFlowWindowSize * 2);
       m_pRcvLossList = new CRcvLossList(m_iFlightFlagSize);
       m_pACKWindow = new CACKWindow(4096);
       m_pRcvTimeWindow = new CPktTimeWindow(16, 64);
       m_pSndTimeWindow = new CPktTimeWindow();
+      if (fecsnd)
+         m_pFECEncoder = new CFECEncoder(m_iISN, CFECEncoder::m_iInitGroupSize, CFECEncoder::dataSize(m_iPayloadSize));
+      if (fecrcv > 1)
+         m_pFECDecoder = new CFECDecoder(m_iPeerISN, fecrcv, m_iPayloadSize);
    }
    catch (...)
    {
       throw CUDTException(3, 2, 0);
    }
 
+   initBufLimits();
+
    m_pCC = m_pCCFactory->create();
    m_pCC->m_UDT = m_SocketID;
+   m_pCC->m_pTrace = &m_Trace;
    m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
    m_dCongestionWindow = m_pCC->m_dCWndSize;
 
    CInfoBlock ib;
    if (m_pCache->lookup(peer, m_iIPversion, &ib) >= 0)
-   {
-      m_iRTT = ib.m_iRTT;
-      m_iBandwidth = ib.m_iBandwidth;
-   }
+      seedFromCache(ib);
 
    m_pCC->setMSS(m_iMSS);
    m_pCC->setMaxCWndSize((int&)m_iFlowWindowSize);
@@ -834,6 +1121,8 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
    if (m_llMaxBW > 0) m_pCC->setUserParam((char*)&(m_llMaxBW), 8);
    m_pCC->init();
 
+   initPMTU();
+
    m_pPeerAddr = (AF_INET == m_iIPversion) ? (sockaddr*)new sockaddr_in : (sockaddr*)new sockaddr_in6;
    memcpy(m_pPeerAddr, peer, (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
 
@@ -846,9 +1135,10 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
 
    //send the response to the peer, see listen() for more discussions about this
    CPacket response;
-   char* buffer = new char[CHandShake::m_iContentSize];
-   hs->serialize(buffer, CHandShake::m_iContentSize);
-   response.pack(0, NULL, buffer, CHandShake::m_iContentSize);
+   // older peers read the basic hand shake only and ignore the extension
+   char* buffer = new char[CHandShake::m_iExtContentSize];
+   hs->serialize(buffer, CHandShake::m_iExtContentSize);
+   response.pack(0, NULL, buffer, CHandShake::m_iExtContentSize);
    response.m_iID = m_PeerID;
    m_pSndQueue->sendto(peer, response);
    delete [] buffer;
@@ -881,7 +1171,11 @@ void CUDT::close()
 
    // remove this socket from the snd queue
    if (m_bConnected)
+   {
       m_pSndQueue->m_pSndUList->remove(this);
+      for (int i = 0; i < getPathCount(); ++ i)
+         m_pPath[i]->m_pSndQueue->m_pSndUList->remove(m_pPath[i]->m_pSNode);
+   }
 
    CGuard cg(m_ConnectionLock);
 
@@ -909,7 +1203,23 @@ void CUDT::close()
       CInfoBlock ib;
       ib.m_iRTT = m_iRTT;
       ib.m_iBandwidth = m_iBandwidth;
+      ib.m_iReorderDistance = 0;
+      ib.m_iLossRate = 0;
+      ib.m_dInterval = 0;
+      ib.m_dCWnd = 0;
+      int64_t sent = CAtomic::load(m_llSentTotal);
+      if (sent > 0)
+      {
+         // what the path carried, rather than where the controller happened to stop
+         ib.m_iLossRate = int(CAtomic::load(m_llSndLossTotal) * 10000 / sent);
+         ib.m_dInterval = (m_iDeliveryRate > 0) ? 1000000.0 / m_iDeliveryRate : m_pCC->m_dPktSndPeriod;
+         ib.m_dCWnd = m_pCC->m_dCWndSize;
+      }
+      CGuard::enterCS(m_PeerAddrLock);
       m_pCache->update(m_pPeerAddr, m_iIPversion, &ib);
+      CGuard::leaveCS(m_PeerAddrLock);
+
+      releaseBufLimits();
 
       m_bConnected = false;
    }
@@ -923,6 +1233,15 @@ void CUDT::close()
 }
 
 int CUDT::send(const char* data, const int& len)
+{
+   iovec v;
+   v.iov_base = (char*)data;
+   v.iov_len = (len > 0) ? len : 0;
+
+   return sendv(&v, 1);
+}
+
+int CUDT::sendv(const iovec* iov, const int& iovcnt)
 {
    if (UDT_DGRAM == m_iSockType)
       throw CUDTException(5, 10, 0);
@@ -933,12 +1252,23 @@ int CUDT::send(const char* data, const int& len)
    else if (!m_bConnected)
       throw CUDTException(2, 2, 0);
 
+   int64_t total = 0;
+   for (int i = 0; i < iovcnt; ++ i)
+   {
+      if (int64_t(iov[i].iov_len) < 0)
+         throw CUDTException(5, 3, 0);
+      total += iov[i].iov_len;
+   }
+   if (total > 0x7FFFFFFF)
+      throw CUDTException(5, 3, 0);
+
+   int len = int(total);
    if (len <= 0)
       return 0;
 
    CGuard sendguard(m_SendLock);
 
-   if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
+   if (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())
    {
       if (!m_bSynSending)
          throw CUDTException(6, 1, 0);
@@ -949,7 +1279,7 @@ int CUDT::send(const char* data, const int& len)
             pthread_mutex_lock(&m_SendBlockLock);
             if (m_iSndTimeOut < 0) 
             { 
-               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
+               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
                   pthread_cond_wait(&m_SendBlockCond, &m_SendBlockLock);
             }
             else
@@ -960,21 +1290,21 @@ int CUDT::send(const char* data, const int& len)
                locktime.tv_sec = exptime / 1000000;
                locktime.tv_nsec = (exptime % 1000000) * 1000;
 
-               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth && (CTimer::getTime() < exptime))
+               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth && (CTimer::getTime() < exptime))
                   pthread_cond_timedwait(&m_SendBlockCond, &m_SendBlockLock, &locktime);
             }
             pthread_mutex_unlock(&m_SendBlockLock);
          #else
             if (m_iSndTimeOut < 0)
             {
-               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
+               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
                   WaitForSingleObject(m_SendBlockCond, INFINITE);
             }
             else 
             {
                uint64_t exptime = CTimer::getTime() + m_iSndTimeOut * 1000ULL;
 
-               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth && (CTimer::getTime() < exptime))
+               while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth && (CTimer::getTime() < exptime))
                   WaitForSingleObject(m_SendBlockCond, DWORD((exptime - CTimer::getTime()) / 1000)); 
             }
          #endif
@@ -992,10 +1322,38 @@ int CUDT::send(const char* data, const int& len)
       }
    }
 
-   if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
+   return addSendData(iov, iovcnt, len);
+}
+
+int CUDT::trySend(const char* data, const int& len)
+{
+   if (UDT_DGRAM == m_iSockType)
+      throw CUDTException(5, 10, 0);
+
+   if (m_bBroken || m_bClosing)
+      throw CUDTException(2, 1, 0);
+   else if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
+
+   if (len <= 0)
+      return 0;
+
+   iovec v;
+   v.iov_base = (char*)data;
+   v.iov_len = len;
+
+   CGuard sendguard(m_SendLock);
+
+   return addSendData(&v, 1, len);
+}
+
+int CUDT::addSendData(const iovec* iov, const int& iovcnt, const int& len)
+{
+   // m_SendLock is held by the caller
+   if (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())
       return 0; 
 
-   int size = (m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize;
+   int size = (m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize;
    if (size > len)
       size = len;
 
@@ -1003,22 +1361,39 @@ int CUDT::send(const char* data, const int& len)
    if (0 == m_pSndBuffer->getCurrBufSize())
       m_llSndDurationCounter = CTimer::getTime();
 
-   // insert the user buffer into the sening list
-   m_pSndBuffer->addBuffer(data, size);
+   // the memory above a lowered limit is given back here, only the thread that adds data may do it
+   if (m_bAutoTune)
+      m_pSndBuffer->shrink(m_iSndBufLimit);
+
+   // insert the user buffer into the sening list, the blocks of a vector share packets
+   m_pSndBuffer->addBuffer(iov, iovcnt, size);
 
    // insert this socket to snd list if it is not on the list yet
-   m_pSndQueue->m_pSndUList->update(this, false);
+   updateSndList(false);
 
-   if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
+   if (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())
    {
       // write is not available any more
       s_UDTUnited.m_EPoll.disable_write(m_SocketID, m_sPollID);
+
+      // an ACK that freed space after the check has had its event cleared above
+      if (m_iSndBufLimit > m_pSndBuffer->getCurrBufSize())
+         s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
    }
 
    return size;
 }
 
 int CUDT::recv(char* data, const int& len)
+{
+   iovec v;
+   v.iov_base = data;
+   v.iov_len = (len > 0) ? len : 0;
+
+   return recvv(&v, 1);
+}
+
+int CUDT::recvv(const iovec* iov, const int& iovcnt)
 {
    if (UDT_DGRAM == m_iSockType)
       throw CUDTException(5, 10, 0);
@@ -1029,7 +1404,17 @@ int CUDT::recv(char* data, const int& len)
    else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
       throw CUDTException(2, 1, 0);
 
-   if (len <= 0)
+   int64_t total = 0;
+   for (int i = 0; i < iovcnt; ++ i)
+   {
+      if (int64_t(iov[i].iov_len) < 0)
+         throw CUDTException(5, 3, 0);
+      total += iov[i].iov_len;
+   }
+   if (total > 0x7FFFFFFF)
+      throw CUDTException(5, 3, 0);
+
+   if (total <= 0)
       return 0;
 
    CGuard recvguard(m_RecvLock);
@@ -1091,12 +1476,57 @@ int CUDT::recv(char* data, const int& len)
    else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
       throw CUDTException(2, 1, 0);
 
+   // fill the blocks in order, stop at the first one the data available does not fill
+   int res = 0;
+   for (int i = 0; i < iovcnt; ++ i)
+   {
+      int rs = m_pRcvBuffer->readBuffer((char*)iov[i].iov_base, int(iov[i].iov_len));
+      res += rs;
+      if (rs < int(iov[i].iov_len))
+         break;
+   }
+
+   if (m_pRcvBuffer->getRcvDataSize() <= 0)
+   {
+      // read is not available any more
+      s_UDTUnited.m_EPoll.disable_read(m_SocketID, m_sPollID);
+
+      // data acknowledged after the check has had its event cleared above
+      if (m_pRcvBuffer->getRcvDataSize() > 0)
+         s_UDTUnited.m_EPoll.enable_read(m_SocketID, m_sPollID);
+   }
+
+   return res;
+}
+
+int CUDT::tryRecv(char* data, const int& len)
+{
+   if (UDT_DGRAM == m_iSockType)
+      throw CUDTException(5, 10, 0);
+
+   if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
+   else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
+      throw CUDTException(2, 1, 0);
+
+   if (len <= 0)
+      return 0;
+
+   CGuard recvguard(m_RecvLock);
+
+   if (0 == m_pRcvBuffer->getRcvDataSize())
+      return 0;
+
    int res = m_pRcvBuffer->readBuffer(data, len);
 
    if (m_pRcvBuffer->getRcvDataSize() <= 0)
    {
       // read is not available any more
       s_UDTUnited.m_EPoll.disable_read(m_SocketID, m_sPollID);
+
+      // data acknowledged after the check has had its event cleared above
+      if (m_pRcvBuffer->getRcvDataSize() > 0)
+         s_UDTUnited.m_EPoll.enable_read(m_SocketID, m_sPollID);
    }
 
    return res;
@@ -1116,12 +1546,27 @@ int CUDT::sendmsg(const char* data, const int& len, const int& msttl, const bool
    if (len <= 0)
       return 0;
 
-   if (len > m_iSndBufSize * m_iPayloadSize)
+   if (len > m_iSndBufSize * m_iSndPayloadSize)
       throw CUDTException(5, 12, 0);
 
    CGuard sendguard(m_SendLock);
 
-   if ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len)
+   // an autotuned buffer takes any message that UDT_SNDBUF allows, even if the budget is used up
+   int msgsize = (len + m_iSndPayloadSize - 1) / m_iSndPayloadSize;
+   if (m_bAutoTune && (msgsize > m_iSndBufFloor))
+   {
+      CGuard tuneguard(m_TuneLock);
+
+      // the budget share has been given back already
+      if (m_bClosing)
+         throw CUDTException(2, 1, 0);
+
+      m_iSndBufFloor = msgsize;
+      if (msgsize > m_iSndBufLimit)
+         m_iSndBufLimit = retuneLimit(m_iSndBufLimit, msgsize, msgsize);
+   }
+
+   if ((m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize < len)
    {
       if (!m_bSynSending)
          throw CUDTException(6, 1, 0);
@@ -1132,7 +1577,7 @@ int CUDT::sendmsg(const char* data, const int& len, const int& msttl, const bool
             pthread_mutex_lock(&m_SendBlockLock);
             if (m_iSndTimeOut < 0)
             {
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len))
+               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize < len))
                   pthread_cond_wait(&m_SendBlockCond, &m_SendBlockLock);
             }
             else
@@ -1143,21 +1588,21 @@ int CUDT::sendmsg(const char* data, const int& len, const int& msttl, const bool
                locktime.tv_sec = exptime / 1000000;
                locktime.tv_nsec = (exptime % 1000000) * 1000;
 
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len) && (CTimer::getTime() < exptime))
+               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize < len) && (CTimer::getTime() < exptime))
                   pthread_cond_timedwait(&m_SendBlockCond, &m_SendBlockLock, &locktime);
             }
             pthread_mutex_unlock(&m_SendBlockLock);
          #else
             if (m_iSndTimeOut < 0)
             {
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len))
+               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize < len))
                   WaitForSingleObject(m_SendBlockCond, INFINITE);
             }
             else
             {
                uint64_t exptime = CTimer::getTime() + m_iSndTimeOut * 1000ULL;
 
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len) && (CTimer::getTime() < exptime))
+               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize < len) && (CTimer::getTime() < exptime))
                   WaitForSingleObject(m_SendBlockCond, DWORD((exptime - CTimer::getTime()) / 1000));
             }
          #endif
@@ -1170,23 +1615,30 @@ int CUDT::sendmsg(const char* data, const int& len, const int& msttl, const bool
       }
    }
 
-   if ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len)
+   if ((m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize < len)
       return 0;
 
    // record total time used for sending
    if (0 == m_pSndBuffer->getCurrBufSize())
       m_llSndDurationCounter = CTimer::getTime();
 
+   if (m_bAutoTune)
+      m_pSndBuffer->shrink(m_iSndBufLimit);
+
    // insert the user buffer into the sening list
    m_pSndBuffer->addBuffer(data, len, msttl, inorder);
 
    // insert this socket to the snd list if it is not on the list yet
-   m_pSndQueue->m_pSndUList->update(this, false);
+   updateSndList(false);
 
-   if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
+   if (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())
    {
       // write is not available any more
       s_UDTUnited.m_EPoll.disable_write(m_SocketID, m_sPollID);
+
+      // an ACK that freed space after the check has had its event cleared above
+      if (m_iSndBufLimit > m_pSndBuffer->getCurrBufSize())
+         s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
    }
 
    return len;   
@@ -1327,11 +1779,11 @@ int64_t CUDT::sendfile(fstream& ifs, int64_t& offset, const int64_t& size, const
 
       #ifndef WIN32
          pthread_mutex_lock(&m_SendBlockLock);
-         while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
+         while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
             pthread_cond_wait(&m_SendBlockCond, &m_SendBlockLock);
          pthread_mutex_unlock(&m_SendBlockLock);
       #else
-         while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
+         while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
             WaitForSingleObject(m_SendBlockCond, INFINITE);
       #endif
 
@@ -1350,6 +1802,8 @@ int64_t CUDT::sendfile(fstream& ifs, int64_t& offset, const int64_t& size, const
       if (0 == m_pSndBuffer->getCurrBufSize())
          m_llSndDurationCounter = CTimer::getTime();
 
+      if (m_bAutoTune)
+         m_pSndBuffer->shrink(m_iSndBufLimit);
       int64_t sentsize = m_pSndBuffer->addBufferFromFile(ifs, unitsize);
 
       if (sentsize > 0)
@@ -1359,13 +1813,17 @@ int64_t CUDT::sendfile(fstream& ifs, int64_t& offset, const int64_t& size, const
       }
 
       // insert this socket to snd list if it is not on the list yet
-      m_pSndQueue->m_pSndUList->update(this, false);
+      updateSndList(false);
    }
 
-   if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
+   if (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())
    {
       // write is not available any more
       s_UDTUnited.m_EPoll.disable_write(m_SocketID, m_sPollID);
+
+      // an ACK that freed space after the check has had its event cleared above
+      if (m_iSndBufLimit > m_pSndBuffer->getCurrBufSize())
+         s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
    }
 
    return size - tosend;
@@ -1434,7 +1892,7 @@ int64_t CUDT::recvfile(fstream& ofs, int64_t& offset, const int64_t& size, const
       {
          torecv -= recvsize;
          offset += recvsize;
-		 m_FileBytesRecvd += recvsize;
+         CAtomic::add(m_FileBytesRecvd, recvsize);
       }
    }
 
@@ -1442,96 +1900,261 @@ int64_t CUDT::recvfile(fstream& ofs, int64_t& offset, const int64_t& size, const
    {
       // read is not available any more
       s_UDTUnited.m_EPoll.disable_read(m_SocketID, m_sPollID);
+
+      // data acknowledged after the check has had its event cleared above
+      if (m_pRcvBuffer->getRcvDataSize() > 0)
+         s_UDTUnited.m_EPoll.enable_read(m_SocketID, m_sPollID);
    }
 
    return size - torecv;
 }
 
-void CUDT::sample(CPerfMon* perf, bool clear)
+int64_t CUDT::trySendFile(fstream& ifs, int64_t& offset, const int64_t& size, const int& block)
 {
-   if (!m_bConnected)
-      throw CUDTException(2, 2, 0);
+   if (UDT_DGRAM == m_iSockType)
+      throw CUDTException(5, 10, 0);
+
    if (m_bBroken || m_bClosing)
       throw CUDTException(2, 1, 0);
+   else if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
 
-   uint64_t currtime = CTimer::getTime();
-   perf->msTimeStamp = (currtime - m_StartTime) / 1000;
+   if (size <= 0)
+      return 0;
 
-   perf->pktSent = m_llTraceSent;
-   perf->pktRecv = m_llTraceRecv;
-   perf->pktSndLoss = m_iTraceSndLoss;
-   perf->pktRcvLoss = m_iTraceRcvLoss;
-   perf->pktRetrans = m_iTraceRetrans;
-   perf->pktSentACK = m_iSentACK;
-   perf->pktRecvACK = m_iRecvACK;
-   perf->pktSentNAK = m_iSentNAK;
-   perf->pktRecvNAK = m_iRecvNAK;
-   perf->usSndDuration = m_llSndDuration;
-
-   perf->pktSentTotal = m_llSentTotal;
-   perf->pktRecvTotal = m_llRecvTotal;
-   perf->pktFileBytesRecvd = m_FileBytesRecvd;
-   perf->pktSndLossTotal = m_iSndLossTotal;
-   perf->pktRcvLossTotal = m_iRcvLossTotal;
-   perf->pktRetransTotal = m_iRetransTotal;
-   perf->pktSentACKTotal = m_iSentACKTotal;
-   perf->pktRecvACKTotal = m_iRecvACKTotal;
-   perf->pktSentNAKTotal = m_iSentNAKTotal;
-   perf->pktRecvNAKTotal = m_iRecvNAKTotal;
-   perf->usSndDurationTotal = m_llSndDurationTotal;
+   CGuard sendguard(m_SendLock);
 
-   double interval = double(currtime - m_LastSampleTime);
+   if (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())
+      return 0;
 
-   perf->mbpsSendRate = double(m_llTraceSent) * m_iPayloadSize * 8.0 / interval;
-   perf->mbpsRecvRate = double(m_llTraceRecv) * m_iPayloadSize * 8.0 / interval;
+   try
+   {
+      ifs.seekg((streamoff)offset);
+   }
+   catch (...)
+   {
+      throw CUDTException(4, 1);
+   }
 
-   perf->usPktSndPeriod = m_ullInterval / double(m_ullCPUFrequency);
-   perf->pktFlowWindow = m_iFlowWindowSize;
-   perf->pktCongestionWindow = (int)m_dCongestionWindow;
-   perf->pktFlightSize = CSeqNo::seqlen(const_cast<int32_t&>(m_iSndLastAck), CSeqNo::incseq(m_iSndCurrSeqNo)) - 1;
-   perf->msRTT = m_iRTT/1000.0;
-   perf->mbpsBandwidth = m_iBandwidth * m_iPayloadSize * 8.0 / 1000000.0;
+   int64_t tosend = size;
 
-   #ifndef WIN32
-      if (0 == pthread_mutex_trylock(&m_ConnectionLock))
-   #else
-      if (WAIT_OBJECT_0 == WaitForSingleObject(m_ConnectionLock, 0))
-   #endif
+   // unlike sendfile(), never take more than the free space of the buffer
+   while ((tosend > 0) && (m_iSndBufLimit > m_pSndBuffer->getCurrBufSize()))
    {
-      perf->byteAvailSndBuf = (NULL == m_pSndBuffer) ? 0 : (m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iMSS;
-      perf->byteAvailRcvBuf = (NULL == m_pRcvBuffer) ? 0 : m_pRcvBuffer->getAvailBufSize() * m_iMSS;
+      if (ifs.fail())
+         throw CUDTException(4, 4);
 
-      #ifndef WIN32
-         pthread_mutex_unlock(&m_ConnectionLock);
-      #else
-         ReleaseMutex(m_ConnectionLock);
-      #endif
-   }
-   else
-   {
-      perf->byteAvailSndBuf = 0;
-      perf->byteAvailRcvBuf = 0;
+      if (ifs.eof())
+         break;
+
+      int unitsize = (m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iSndPayloadSize;
+      if (unitsize > block)
+         unitsize = block;
+      if (unitsize > tosend)
+         unitsize = int(tosend);
+
+      // record total time used for sending
+      if (0 == m_pSndBuffer->getCurrBufSize())
+         m_llSndDurationCounter = CTimer::getTime();
+
+      if (m_bAutoTune)
+         m_pSndBuffer->shrink(m_iSndBufLimit);
+      int64_t sentsize = m_pSndBuffer->addBufferFromFile(ifs, unitsize);
+      if (sentsize <= 0)
+         break;
+
+      tosend -= sentsize;
+      offset += sentsize;
+
+      // insert this socket to snd list if it is not on the list yet
+      updateSndList(false);
    }
 
-   if (clear)
+   if (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())
    {
-      m_llTraceSent = m_llTraceRecv = m_iTraceSndLoss = m_iTraceRcvLoss = m_iTraceRetrans = m_iSentACK = m_iRecvACK = m_iSentNAK = m_iRecvNAK = 0;
-      m_llSndDuration = 0;
-      m_LastSampleTime = currtime;
+      // write is not available any more
+      s_UDTUnited.m_EPoll.disable_write(m_SocketID, m_sPollID);
+
+      // an ACK that freed space after the check has had its event cleared above
+      if (m_iSndBufLimit > m_pSndBuffer->getCurrBufSize())
+         s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
    }
+
+   return size - tosend;
 }
 
-void CUDT::initSynch()
+int64_t CUDT::tryRecvFile(fstream& ofs, int64_t& offset, const int64_t& size, const int& block)
 {
-   #ifndef WIN32
-      pthread_mutex_init(&m_SendBlockLock, NULL);
-      pthread_cond_init(&m_SendBlockCond, NULL);
-      pthread_mutex_init(&m_RecvDataLock, NULL);
-      pthread_cond_init(&m_RecvDataCond, NULL);
-      pthread_mutex_init(&m_SendLock, NULL);
+   if (UDT_DGRAM == m_iSockType)
+      throw CUDTException(5, 10, 0);
+
+   if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
+   else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
+      throw CUDTException(2, 1, 0);
+
+   if (size <= 0)
+      return 0;
+
+   CGuard recvguard(m_RecvLock);
+
+   if (0 == m_pRcvBuffer->getRcvDataSize())
+      return 0;
+
+   try
+   {
+      ofs.seekp((streamoff)offset);
+   }
+   catch (...)
+   {
+      throw CUDTException(4, 3);
+   }
+
+   int64_t torecv = size;
+
+   while ((torecv > 0) && (m_pRcvBuffer->getRcvDataSize() > 0))
+   {
+      if (ofs.fail())
+      {
+         // send the sender a signal so it will not be blocked forever
+         int32_t err_code = CUDTException::EFILE;
+         sendCtrl(8, &err_code);
+
+         throw CUDTException(4, 4);
+      }
+
+      int unitsize = int((torecv >= block) ? block : torecv);
+      int recvsize = m_pRcvBuffer->readBufferToFile(ofs, unitsize);
+
+      if (recvsize > 0)
+      {
+         torecv -= recvsize;
+         offset += recvsize;
+         CAtomic::add(m_FileBytesRecvd, recvsize);
+      }
+   }
+
+   if (m_pRcvBuffer->getRcvDataSize() <= 0)
+   {
+      // read is not available any more
+      s_UDTUnited.m_EPoll.disable_read(m_SocketID, m_sPollID);
+
+      // data acknowledged after the check has had its event cleared above
+      if (m_pRcvBuffer->getRcvDataSize() > 0)
+         s_UDTUnited.m_EPoll.enable_read(m_SocketID, m_sPollID);
+   }
+
+   return size - torecv;
+}
+
+void CUDT::sample(CPerfMon* perf, bool clear)
+{
+   if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
+   if (m_bBroken || m_bClosing)
+      throw CUDTException(2, 1, 0);
+
+   // only callers of sample() share the saved totals, the data path never waits for this lock
+   CGuard statsguard(m_StatsLock);
+
+   uint64_t currtime = CTimer::getTime();
+   perf->msTimeStamp = (currtime - m_StartTime) / 1000;
+
+   perf->pktSentTotal = CAtomic::load(m_llSentTotal);
+   perf->pktRecvTotal = CAtomic::load(m_llRecvTotal);
+   perf->pktFileBytesRecvd = CAtomic::load(m_FileBytesRecvd);
+   perf->pktSndLossTotal = int(CAtomic::load(m_llSndLossTotal));
+   perf->pktRcvLossTotal = int(CAtomic::load(m_llRcvLossTotal));
+   perf->pktRetransTotal = int(CAtomic::load(m_llRetransTotal));
+   perf->pktSentACKTotal = int(CAtomic::load(m_llSentACKTotal));
+   perf->pktRecvACKTotal = int(CAtomic::load(m_llRecvACKTotal));
+   perf->pktSentNAKTotal = int(CAtomic::load(m_llSentNAKTotal));
+   perf->pktRecvNAKTotal = int(CAtomic::load(m_llRecvNAKTotal));
+   perf->pktSndParityTotal = int(CAtomic::load(m_llSndParityTotal));
+   perf->pktRcvRecoveredTotal = int(CAtomic::load(m_llRcvRecoveredTotal));
+   perf->usSndDurationTotal = CAtomic::load(m_llSndDurationTotal);
+   perf->byteSentTotal = CAtomic::load(m_llSentBytesTotal);
+   perf->byteRecvTotal = CAtomic::load(m_llRecvBytesTotal);
+
+   // local measurements are what the totals gained since the last clearing call
+   perf->pktSent = perf->pktSentTotal - m_LastSample.pktSentTotal;
+   perf->pktRecv = perf->pktRecvTotal - m_LastSample.pktRecvTotal;
+   perf->pktSndLoss = perf->pktSndLossTotal - m_LastSample.pktSndLossTotal;
+   perf->pktRcvLoss = perf->pktRcvLossTotal - m_LastSample.pktRcvLossTotal;
+   perf->pktRetrans = perf->pktRetransTotal - m_LastSample.pktRetransTotal;
+   perf->pktSentACK = perf->pktSentACKTotal - m_LastSample.pktSentACKTotal;
+   perf->pktRecvACK = perf->pktRecvACKTotal - m_LastSample.pktRecvACKTotal;
+   perf->pktSentNAK = perf->pktSentNAKTotal - m_LastSample.pktSentNAKTotal;
+   perf->pktRecvNAK = perf->pktRecvNAKTotal - m_LastSample.pktRecvNAKTotal;
+   perf->pktSndParity = perf->pktSndParityTotal - m_LastSample.pktSndParityTotal;
+   perf->pktRcvRecovered = perf->pktRcvRecoveredTotal - m_LastSample.pktRcvRecoveredTotal;
+   perf->usSndDuration = perf->usSndDurationTotal - m_LastSample.usSndDurationTotal;
+
+   double interval = double(currtime - m_LastSampleTime);
+
+   // the packets are not all of one size when the path MTU is probed
+   perf->mbpsSendRate = double(perf->byteSentTotal - m_LastSample.byteSentTotal) * 8.0 / interval;
+   perf->mbpsRecvRate = double(perf->byteRecvTotal - m_LastSample.byteRecvTotal) * 8.0 / interval;
+
+   perf->usPktSndPeriod = m_ullInterval / double(m_ullCPUFrequency);
+   perf->pktFlowWindow = m_iFlowWindowSize;
+   perf->pktCongestionWindow = (int)m_dCongestionWindow;
+   perf->pktFlightSize = CSeqNo::seqlen(const_cast<int32_t&>(m_iSndLastAck), CSeqNo::incseq(m_iSndCurrSeqNo)) - 1;
+   perf->msRTT = m_iRTT/1000.0;
+   perf->mbpsBandwidth = m_iBandwidth * m_iSndPayloadSize * 8.0 / 1000000.0;
+
+   #ifndef WIN32
+      if (0 == pthread_mutex_trylock(&m_ConnectionLock))
+   #else
+      if (WAIT_OBJECT_0 == WaitForSingleObject(m_ConnectionLock, 0))
+   #endif
+   {
+      perf->byteAvailSndBuf = ((NULL == m_pSndBuffer) || (m_iSndBufLimit <= m_pSndBuffer->getCurrBufSize())) ? 0 : (m_iSndBufLimit - m_pSndBuffer->getCurrBufSize()) * m_iMSS;
+      perf->byteAvailRcvBuf = (NULL == m_pRcvBuffer) ? 0 : m_pRcvBuffer->getAvailBufSize() * m_iMSS;
+
+      #ifndef WIN32
+         pthread_mutex_unlock(&m_ConnectionLock);
+      #else
+         ReleaseMutex(m_ConnectionLock);
+      #endif
+   }
+   else
+   {
+      perf->byteAvailSndBuf = 0;
+      perf->byteAvailRcvBuf = 0;
+   }
+
+   if (clear)
+   {
+      m_LastSample = *perf;
+      m_LastSampleTime = currtime;
+   }
+}
+
+void CUDT::sample(CPerfStats* stats)
+{
+   sample(&stats->trace, false);
+
+   m_RTTHist.snapshot(&stats->usRTT);
+   m_SndIntervalHist.snapshot(&stats->usPktSndInterval);
+   m_AckNakHist.snapshot(&stats->usAckToNakDelay);
+}
+
+void CUDT::initSynch()
+{
+   #ifndef WIN32
+      pthread_mutex_init(&m_SendBlockLock, NULL);
+      pthread_cond_init(&m_SendBlockCond, NULL);
+      pthread_mutex_init(&m_RecvDataLock, NULL);
+      pthread_cond_init(&m_RecvDataCond, NULL);
+      pthread_mutex_init(&m_SendLock, NULL);
       pthread_mutex_init(&m_RecvLock, NULL);
       pthread_mutex_init(&m_AckLock, NULL);
       pthread_mutex_init(&m_ConnectionLock, NULL);
+      pthread_mutex_init(&m_StatsLock, NULL);
+      pthread_mutex_init(&m_PackLock, NULL);
+      pthread_mutex_init(&m_TuneLock, NULL);
+      pthread_mutex_init(&m_PeerAddrLock, NULL);
    #else
       m_SendBlockLock = CreateMutex(NULL, false, NULL);
       m_SendBlockCond = CreateEvent(NULL, false, false, NULL);
@@ -1541,6 +2164,10 @@ void CUDT::initSynch()
       m_RecvLock = CreateMutex(NULL, false, NULL);
       m_AckLock = CreateMutex(NULL, false, NULL);
       m_ConnectionLock = CreateMutex(NULL, false, NULL);
+      m_StatsLock = CreateMutex(NULL, false, NULL);
+      m_PackLock = CreateMutex(NULL, false, NULL);
+      m_TuneLock = CreateMutex(NULL, false, NULL);
+      m_PeerAddrLock = CreateMutex(NULL, false, NULL);
    #endif
 }
 
@@ -1555,6 +2182,10 @@ void CUDT::destroySynch()
       pthread_mutex_destroy(&m_RecvLock);
       pthread_mutex_destroy(&m_AckLock);
       pthread_mutex_destroy(&m_ConnectionLock);
+      pthread_mutex_destroy(&m_StatsLock);
+      pthread_mutex_destroy(&m_PackLock);
+      pthread_mutex_destroy(&m_TuneLock);
+      pthread_mutex_destroy(&m_PeerAddrLock);
    #else
       CloseHandle(m_SendBlockLock);
       CloseHandle(m_SendBlockCond);
@@ -1564,6 +2195,10 @@ void CUDT::destroySynch()
       CloseHandle(m_RecvLock);
       CloseHandle(m_AckLock);
       CloseHandle(m_ConnectionLock);
+      CloseHandle(m_StatsLock);
+      CloseHandle(m_PackLock);
+      CloseHandle(m_TuneLock);
+      CloseHandle(m_PeerAddrLock);
    #endif
 }
 
@@ -1620,7 +2255,7 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
       {
          ctrlpkt.pack(pkttype, NULL, &ack, size);
          ctrlpkt.m_iID = m_PeerID;
-         m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+         sendToPeer(ctrlpkt);
 
          break;
       }
@@ -1662,13 +2297,16 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
       // Send out the ACK only if has not been received by the sender before
       if (CSeqNo::seqcmp(m_iRcvLastAck, m_iRcvLastAckAck) > 0)
       {
-         int32_t data[6];
+         int32_t data[7];
 
          m_iAckSeqNo = CAckNo::incack(m_iAckSeqNo);
          data[0] = m_iRcvLastAck;
          data[1] = m_iRTT;
          data[2] = m_iRTTVar;
          data[3] = m_pRcvBuffer->getAvailBufSize();
+         // an autotuned receiver offers only what is left of its current limit
+         if (m_iRcvBufLimit - m_pRcvBuffer->getRcvDataSize() < data[3])
+            data[3] = m_iRcvBufLimit - m_pRcvBuffer->getRcvDataSize();
          // a minimum flow window of 2 is used, even if buffer is full, to break potential deadlock
          if (data[3] < 2)
             data[3] = 2;
@@ -1677,7 +2315,28 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
          {
             data[4] = m_pRcvTimeWindow->getPktRcvSpeed();
             data[5] = m_pRcvTimeWindow->getBandwidth();
-            ctrlpkt.pack(pkttype, &m_iAckSeqNo, data, 24);
+            tuneRcvBuffer(data[5]);
+
+            // with adaptive ACK frequency, light ACKs are sent a few times per RTT but at most every
+            // m_iLightACKPeriod, while leaving the sender at least 4 of them per flow window
+            if (m_bAdaptiveACK)
+            {
+               int period = (m_iRTT / m_iLightACKsPerRTT > m_iLightACKPeriod) ? m_iRTT / m_iLightACKsPerRTT : m_iLightACKPeriod;
+               int64_t interval = int64_t(data[4]) * period / 1000000;
+               if (interval > data[3] / 4)
+                  interval = data[3] / 4;
+               m_iLightACKInterval = (interval > m_iSelfClockInterval) ? int(interval) : m_iSelfClockInterval;
+            }
+
+            // the delay field is an extension, senders reading only the first 24 bytes ignore it
+            if (m_bRcvDelaySampled)
+            {
+               data[6] = m_iRcvMinDelay;
+               m_bRcvDelaySampled = false;
+               ctrlpkt.pack(pkttype, &m_iAckSeqNo, data, 28);
+            }
+            else
+               ctrlpkt.pack(pkttype, &m_iAckSeqNo, data, 24);
 
             CTimer::rdtsc(m_ullLastAckTime);
          }
@@ -1687,12 +2346,12 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
          }
 
          ctrlpkt.m_iID = m_PeerID;
-         m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+         sendToPeer(ctrlpkt);
 
          m_pACKWindow->store(m_iAckSeqNo, m_iRcvLastAck);
 
-         ++ m_iSentACK;
-         ++ m_iSentACKTotal;
+         m_ullLastAckSentTime = CTimer::getTime();
+         CAtomic::add(m_llSentACKTotal, 1);
       }
 
       break;
@@ -1701,7 +2360,7 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
    case 6: //110 - Acknowledgement of Acknowledgement
       ctrlpkt.pack(pkttype, lparam);
       ctrlpkt.m_iID = m_PeerID;
-      m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+      sendToPeer(ctrlpkt);
 
       break;
 
@@ -1720,28 +2379,48 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
          }
 
          ctrlpkt.m_iID = m_PeerID;
-         m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+         sendToPeer(ctrlpkt);
 
-         ++ m_iSentNAK;
-         ++ m_iSentNAKTotal;
+         if (0 != m_ullLastAckSentTime)
+            m_AckNakHist.record(CTimer::getTime() - m_ullLastAckSentTime);
+         CAtomic::add(m_llSentNAKTotal, 1);
       }
       else if (m_pRcvLossList->getLossLength() > 0)
       {
          // this is periodically NAK report
 
-         // read loss list from the local receiver loss list
+         // read loss list from the local receiver loss list, a coalesced report (lparam) holds the losses
+         // found since a seq. no. that have not been reported yet, so no retransmission can be on its way
          int32_t* data = new int32_t[m_iPayloadSize / 4];
          int losslen;
-         m_pRcvLossList->getLossArray(data, losslen, m_iPayloadSize / 4, m_iRTT + 4 * m_iRTTVar);
+         int32_t to = -1;
+         if (NULL != lparam)
+            m_pRcvLossList->getLossArray(data, losslen, m_iSndPayloadSize / 4, 0, *(int32_t *)lparam);
+         else
+         {
+            // the losses in groups whose parity is still on its way wait for it, see processCtrl()
+            if ((NULL != m_pFECDecoder) && (-1 != (to = m_pFECDecoder->getFirstPendingSeq())))
+               to = CSeqNo::decseq(to);
+            m_pRcvLossList->getLossArray(data, losslen, m_iSndPayloadSize / 4, m_iRTT + 4 * m_iRTTVar, -1, to);
+         }
 
          if (0 < losslen)
          {
-            ctrlpkt.pack(pkttype, NULL, data, losslen * 4);
+            int32_t bitmap = 1;
+            if (m_bCompactNAK && CLossReport::compress(data, losslen, m_iSndPayloadSize / 4))
+               ctrlpkt.pack(pkttype, &bitmap, data, losslen * 4);
+            else
+               ctrlpkt.pack(pkttype, NULL, data, losslen * 4);
             ctrlpkt.m_iID = m_PeerID;
-            m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+            sendToPeer(ctrlpkt);
 
-            ++ m_iSentNAK;
-            ++ m_iSentNAKTotal;
+            // a report of the whole list includes the losses held back by allowNAK()
+            if (-1 == to)
+               m_iNAKPendingSeq = -1;
+
+            if (0 != m_ullLastAckSentTime)
+               m_AckNakHist.record(CTimer::getTime() - m_ullLastAckSentTime);
+            CAtomic::add(m_llSentNAKTotal, 1);
          }
 
          delete [] data;
@@ -1752,7 +2431,7 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
    case 4: //100 - Congestion Warning
       ctrlpkt.pack(pkttype);
       ctrlpkt.m_iID = m_PeerID;
-      m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+      sendToPeer(ctrlpkt);
 
       CTimer::rdtsc(m_ullLastWarningTime);
 
@@ -1761,37 +2440,92 @@ void CUDT::sendCtrl(const int& pkttype, void* lparam, void* rparam, const int& s
    case 1: //001 - Keep-alive
       ctrlpkt.pack(pkttype);
       ctrlpkt.m_iID = m_PeerID;
-      m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+      sendToPeer(ctrlpkt);
  
       break;
 
    case 0: //000 - Handshake
       ctrlpkt.pack(pkttype, NULL, rparam, sizeof(CHandShake));
       ctrlpkt.m_iID = m_PeerID;
-      m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+      sendToPeer(ctrlpkt);
 
       break;
 
    case 5: //101 - Shutdown
       ctrlpkt.pack(pkttype);
       ctrlpkt.m_iID = m_PeerID;
-      m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+      sendToPeer(ctrlpkt);
 
       break;
 
    case 7: //111 - Msg drop request
       ctrlpkt.pack(pkttype, lparam, rparam, 8);
       ctrlpkt.m_iID = m_PeerID;
-      m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+      sendToPeer(ctrlpkt);
 
       break;
 
    case 8: //1000 - acknowledge the peer side a special error
       ctrlpkt.pack(pkttype, lparam);
       ctrlpkt.m_iID = m_PeerID;
-      m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
+      sendToPeer(ctrlpkt);
+
+      break;
+
+   case 10: //1010 - Path Join, the response; requests are sent by sendJoin() on the path itself
+      {
+      int32_t join[3];
+      join[0] = 1;
+      join[1] = m_iISN;
+      join[2] = m_SocketID;
+
+      ctrlpkt.pack(pkttype, lparam, join, 12);
+      ctrlpkt.m_iID = m_PeerID;
+      sendToPeer(ctrlpkt);
+
+      break;
+      }
+
+   case 11: //1011 - Path Validation, announcements and responses; challenges are sent by acceptMigration()
+      {
+      int32_t validation[3];
+      validation[0] = (NULL == lparam) ? 0 : *(int32_t *)lparam;
+      validation[1] = (NULL == rparam) ? 0 : *(int32_t *)rparam;
+      validation[2] = m_iPeerToken;
+
+      ctrlpkt.pack(pkttype, NULL, validation, 12);
+      ctrlpkt.m_iID = m_PeerID;
+      sendToPeer(ctrlpkt);
+
+      break;
+      }
+
+   case 12: //1100 - Path MTU Probe, probes and replies
+      {
+      int32_t* probe = (int32_t *)rparam;
+      if (0 == probe[0])
+      {
+         // the probe is padded to the packet size it tests
+         int len = probe[1] - 28 - CPacket::m_iPktHdrSize;
+         char* padding = new char [len];
+         memset(padding, 0, len);
+         memcpy(padding, probe, 8);
+
+         ctrlpkt.pack(pkttype, lparam, padding, len);
+         ctrlpkt.m_iID = m_PeerID;
+         sendToPeer(ctrlpkt);
+
+         delete [] padding;
+      }
+      else
+      {
+         ctrlpkt.pack(pkttype, lparam, rparam, 8);
+         ctrlpkt.m_iID = m_PeerID;
+         sendToPeer(ctrlpkt);
+      }
 
       break;
+      }
 
    case 32767: //0x7FFF - Resevered for future use
       break;
@@ -1857,6 +2591,7 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
          //this should not happen: attack or bug
          m_bBroken = true;
          m_iBrokenCounter = 0;
+         s_UDTUnited.notifyGC(m_SocketID);
          break;
       }
 
@@ -1867,55 +2602,29 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
          m_iSndLastAck = ack;
       }
 
-      // protect packet retransmission
-      CGuard::enterCS(m_AckLock);
-
-      int offset = CSeqNo::seqoff((int32_t&)m_iSndLastDataAck, ack);
-      if (offset <= 0)
+      // ACKs processed in one burst are coalesced, only the newest one is applied to the sender buffer
+      // and the congestion control, by flushACK() before the next timer check
+      if (CSeqNo::seqcmp(ack, m_bACKPending ? m_iPendingACK : (int32_t&)m_iSndLastDataAck) <= 0)
       {
          // discard it if it is a repeated ACK
-         CGuard::leaveCS(m_AckLock);
          break;
       }
 
-      // acknowledge the sending buffer
-      m_pSndBuffer->ackData(offset);
-
-      // record total time used for sending
-      m_llSndDuration += currtime - m_llSndDurationCounter;
-      m_llSndDurationTotal += currtime - m_llSndDurationCounter;
-      m_llSndDurationCounter = currtime;
-
-      // update sending variables
-      m_iSndLastDataAck = ack;
-      m_pSndLossList->remove(CSeqNo::decseq((int32_t&)m_iSndLastDataAck));
-
-      CGuard::leaveCS(m_AckLock);
-
-      #ifndef WIN32
-         pthread_mutex_lock(&m_SendBlockLock);
-         if (m_bSynSending)
-            pthread_cond_signal(&m_SendBlockCond);
-         pthread_mutex_unlock(&m_SendBlockLock);
-      #else
-         if (m_bSynSending)
-            SetEvent(m_SendBlockCond);
-      #endif
-
-      // acknowledde any waiting epolls to write
-      s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
-
-      // insert this socket to snd list if it is not on the list yet
-      m_pSndQueue->m_pSndUList->update(this, false);
+      m_iPendingACK = ack;
+      m_bACKPending = true;
 
       // Update RTT
       //m_iRTT = *((int32_t *)ctrlpkt.m_pcData + 1);
       //m_iRTTVar = *((int32_t *)ctrlpkt.m_pcData + 2);
       int rtt = *((int32_t *)ctrlpkt.m_pcData + 1);
+      m_RTTHist.record(rtt);
+      m_Trace.record(UDT_TRACE_ACK, ack, m_pCC->m_dPktSndPeriod, m_pCC->m_dCWndSize, rtt);
       m_iRTTVar = (m_iRTTVar * 3 + abs(rtt - m_iRTT)) >> 2;
       m_iRTT = (m_iRTT * 7 + rtt) >> 3;
 
       m_pCC->setRTT(m_iRTT);
+      for (int i = 0; i < getPathCount(); ++ i)
+         m_pPath[i]->m_pCC->setRTT(m_iRTT);
 
       m_ullEXPInt = (m_iRTT + 4 * m_iRTTVar) * m_ullCPUFrequency + m_ullSYNInt;
       if (m_ullEXPInt < m_ullMinExpInt)
@@ -1930,17 +2639,26 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
          if (*((int32_t *)ctrlpkt.m_pcData + 5) > 0)
             m_iBandwidth = (m_iBandwidth * 7 + *((int32_t *)ctrlpkt.m_pcData + 5)) >> 3;
 
-         m_pCC->setRcvRate(m_iDeliveryRate);
+         // the peer measures the arrivals of all paths together, each path is given an equal share,
+         // while the bandwidth is probed by packet pairs that never straddle two paths
+         int rate = m_iDeliveryRate / (getActivePathCount() + 1);
+         m_pCC->setRcvRate(rate);
          m_pCC->setBandwidth(m_iBandwidth);
+         for (int i = 0; i < getPathCount(); ++ i)
+         {
+            m_pPath[i]->m_pCC->setRcvRate(rate);
+            m_pPath[i]->m_pCC->setBandwidth(m_iBandwidth);
+         }
       }
 
-      m_pCC->onACK(ack);
-      // update CC parameters
-      m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
-      m_dCongestionWindow = m_pCC->m_dCWndSize;
+      if (ctrlpkt.getLength() > 24)
+      {
+         m_pCC->setOneWayDelay(*((int32_t *)ctrlpkt.m_pcData + 6));
+         for (int i = 0; i < getPathCount(); ++ i)
+            m_pPath[i]->m_pCC->setOneWayDelay(*((int32_t *)ctrlpkt.m_pcData + 6));
+      }
 
-      ++ m_iRecvACK;
-      ++ m_iRecvACKTotal;
+      CAtomic::add(m_llRecvACKTotal, 1);
 
       break;
       }
@@ -1956,6 +2674,8 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
       if (rtt <= 0)
          break;
 
+      m_RTTHist.record(rtt);
+
       //if increasing delay detected...
       //   sendCtrl(4);
 
@@ -1964,6 +2684,8 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
       m_iRTT = (m_iRTT * 7 + rtt) >> 3;
 
       m_pCC->setRTT(m_iRTT);
+      for (int i = 0; i < getPathCount(); ++ i)
+         m_pPath[i]->m_pCC->setRTT(m_iRTT);
 
       m_ullEXPInt = (m_iRTT + 4 * m_iRTTVar) * m_ullCPUFrequency + m_ullSYNInt;
       if (m_ullEXPInt < m_ullMinExpInt)
@@ -1979,66 +2701,94 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
    case 3: //011 - Loss Report
       {
       int32_t* losslist = (int32_t *)(ctrlpkt.m_pcData);
+      int losslen = ctrlpkt.getLength() / 4;
+      bool bitmap = m_bCompactNAK && (1 == ctrlpkt.getAckSeqNo());
 
-      m_pCC->onLoss(losslist, ctrlpkt.getLength() / 4);
-      // update CC parameters
-      m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
-      m_dCongestionWindow = m_pCC->m_dCWndSize;
+      // decode the report into ranges, a bitmap holds at most 16 ranges per word
+      int limit = bitmap ? losslen * 16 + 1 : losslen;
+      int32_t* ranges = new int32_t[limit * 2];
+      int num = CLossReport::decode(losslist, losslen, bitmap, ranges, limit);
+
+      // an empty or undecodable report carries nothing to act on, it is dropped as the original format would be
+      if (num <= 0)
+      {
+         delete [] ranges;
+         break;
+      }
+
+      // the congestion control reads loss arrays, a bitmap is converted back
+      int32_t* array = losslist;
+      int arraylen = losslen;
+      if (bitmap)
+      {
+         array = new int32_t[num * 2];
+         arraylen = CLossReport::encode(ranges, num, array);
+      }
 
       bool secure = true;
+      int lost = 0;
+      int valid = 0;
 
-      // decode loss list message and insert loss into the sender loss list
-      for (int i = 0, n = (int)(ctrlpkt.getLength() / 4); i < n; ++ i)
+      for (int i = 0; secure && (i < num); ++ i)
       {
-         if (0 != (losslist[i] & 0x80000000))
+         int32_t seqno1 = ranges[2 * i];
+         int32_t seqno2 = ranges[2 * i + 1];
+
+         if ((CSeqNo::seqcmp(seqno1, seqno2) > 0) || (CSeqNo::seqcmp(seqno2, const_cast<int32_t&>(m_iSndCurrSeqNo)) > 0))
          {
-            if ((CSeqNo::seqcmp(losslist[i] & 0x7FFFFFFF, losslist[i + 1]) > 0) || (CSeqNo::seqcmp(losslist[i + 1], const_cast<int32_t&>(m_iSndCurrSeqNo)) > 0))
-            {
-               // seq_a must not be greater than seq_b; seq_b must not be greater than the most recent sent seq
-               secure = false;
-               break;
-            }
+            // seq_a must not be greater than seq_b; seq_b must not be greater than the most recent sent seq
+            secure = false;
+            break;
+         }
 
-            int num = 0;
-            if (CSeqNo::seqcmp(losslist[i] & 0x7FFFFFFF, const_cast<int32_t&>(m_iSndLastAck)) >= 0)
-               num = m_pSndLossList->insert(losslist[i] & 0x7FFFFFFF, losslist[i + 1]);
-            else if (CSeqNo::seqcmp(losslist[i + 1], const_cast<int32_t&>(m_iSndLastAck)) >= 0)
-               num = m_pSndLossList->insert(const_cast<int32_t&>(m_iSndLastAck), losslist[i + 1]);
+         // keep the part that has not been acknowledged
+         if (CSeqNo::seqcmp(seqno2, const_cast<int32_t&>(m_iSndLastAck)) < 0)
+            continue;
+         if (CSeqNo::seqcmp(seqno1, const_cast<int32_t&>(m_iSndLastAck)) < 0)
+            seqno1 = m_iSndLastAck;
 
-            m_iTraceSndLoss += num;
-            m_iSndLossTotal += num;
+         ranges[2 * valid] = seqno1;
+         ranges[2 * valid + 1] = seqno2;
+         ++ valid;
+      }
 
-            ++ i;
-         }
-         else if (CSeqNo::seqcmp(losslist[i], const_cast<int32_t&>(m_iSndLastAck)) >= 0)
+      if (secure)
+      {
+         if (0 == getPathCount())
          {
-            if (CSeqNo::seqcmp(losslist[i], const_cast<int32_t&>(m_iSndCurrSeqNo)) > 0)
-            {
-               //seq_a must not be greater than the most recent sent seq
-               secure = false;
-               break;
-            }
-
-            int num = m_pSndLossList->insert(losslist[i], losslist[i]);
+            m_pCC->onLoss(array, arraylen);
 
-            m_iTraceSndLoss += num;
-            m_iSndLossTotal += num;
+            // update CC parameters
+            m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
+            m_dCongestionWindow = m_pCC->m_dCWndSize;
          }
+         else
+            splitLoss(ranges, valid);
+
+         // insert loss into the sender loss list in one batch
+         lost = m_pSndLossList->insert(ranges, valid);
+         CAtomic::add(m_llSndLossTotal, lost);
       }
 
+      delete [] ranges;
+      if (array != losslist)
+         delete [] array;
+
       if (!secure)
       {
          //this should not happen: attack or bug
          m_bBroken = true;
          m_iBrokenCounter = 0;
+         s_UDTUnited.notifyGC(m_SocketID);
          break;
       }
 
       // the lost packet (retransmission) should be sent out immediately
-      m_pSndQueue->m_pSndUList->update(this);
+      updateSndList();
 
-      ++ m_iRecvNAK;
-      ++ m_iRecvNAKTotal;
+      CAtomic::add(m_llRecvNAKTotal, 1);
+      m_Trace.record(UDT_TRACE_NAK, losslist[0] & 0x7FFFFFFF, m_pCC->m_dPktSndPeriod, m_pCC->m_dCWndSize, lost);
+      m_Trace.record(UDT_TRACE_CC, m_iSndCurrSeqNo, m_pCC->m_dPktSndPeriod, m_pCC->m_dCWndSize, 0);
 
       break;
       }
@@ -2068,6 +2818,10 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
          initdata.m_iFlightFlagSize = m_iFlightFlagSize;
          initdata.m_iReqType = (!m_bRendezvous) ? -1 : -2;
          initdata.m_iID = m_SocketID;
+         initdata.m_iACKMode = m_bAdaptiveACK ? 1 : 0;
+         initdata.m_iLossMode = m_bCompactNAK ? 1 : 0;
+         initdata.m_iFECMode = m_bFEC ? CFECEncoder::m_iInitGroupSize : 1;
+         initdata.m_iToken = m_iToken;
          sendCtrl(0, NULL, (char *)&initdata, sizeof(CHandShake));
       }
 
@@ -2078,10 +2832,15 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
       m_bClosing = true;
       m_bBroken = true;
       m_iBrokenCounter = 60;
+      s_UDTUnited.notifyGC(m_SocketID);
 
       // Signal the sender and recver if they are waiting for data.
       releaseSynch();
 
+      // epoll waiters block until an event arrives, so they learn about the closed connection from here
+      s_UDTUnited.m_EPoll.enable_read(m_SocketID, m_sPollID);
+      s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
+
       CTimer::triggerEvent();
 
       break;
@@ -2099,6 +2858,47 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
 
       break;
 
+   case 9: //1001 - FEC parity
+      {
+      if (NULL == m_pFECDecoder)
+         break;
+
+      // the rebuilt packet goes into a free unit, possibly the one that holds the parity
+      CUnit* unit = m_pRcvQueue->m_UnitQueue.getNextAvailUnit();
+      if (NULL == unit)
+         break;
+
+      int32_t* missing = new int32_t[CFECEncoder::m_iMaxGroupSize];
+      int num;
+      int res = m_pFECDecoder->recover(ctrlpkt, unit->m_Packet, missing, num);
+
+      if (1 == res)
+      {
+         CPacket& packet = unit->m_Packet;
+
+         // a retransmission may have arrived first
+         int32_t offset = CSeqNo::seqoff(m_iRcvLastAck, packet.m_iSeqNo);
+         if ((offset >= 0) && (offset < m_pRcvBuffer->getAvailBufSize()) && (m_pRcvBuffer->addData(unit, offset) >= 0))
+         {
+            if (CSeqNo::seqcmp(packet.m_iSeqNo, m_iRcvCurrSeqNo) > 0)
+               m_iRcvCurrSeqNo = packet.m_iSeqNo;
+            else
+               m_pRcvLossList->remove(packet.m_iSeqNo);
+
+            CAtomic::add(m_llRcvRecoveredTotal, 1);
+         }
+      }
+      else if (-1 == res)
+      {
+         // too many losses in the group, report the ones still missing now
+         reportMissing(missing, num);
+      }
+
+      delete [] missing;
+
+      break;
+      }
+
    case 8: // 1000 - An error has happened to the peer side
       //int err_type = packet.getAddInfo();
 
@@ -2110,34 +2910,212 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
 
       break;
 
-   case 32767: //0x7FFF - reserved and user defined messages
-      m_pCC->processCustomMsg(&ctrlpkt);
-      // update CC parameters
-      m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
-      m_dCongestionWindow = m_pCC->m_dCWndSize;
+   case 10: //1010 - Path Join
+      {
+      if (ctrlpkt.getLength() < 12)
+         break;
 
-      break;
+      int32_t* join = (int32_t *)ctrlpkt.m_pcData;
+      int32_t path = ctrlpkt.getAckSeqNo();
 
-   default:
-      break;
-   }
-}
+      // both sides know the ISN and the socket ID of each other from the handshake
+      if ((join[1] != m_iISN) || (join[2] != m_PeerID))
+         break;
 
-int CUDT::packData(CPacket& packet, uint64_t& ts)
-{
-   int payload = 0;
-   bool probe = false;
+      if (0 == join[0])
+      {
+         // the receiving queue let the new address in, confirm on the primary path, the request is repeated if this is lost
+         sendCtrl(10, &path);
+      }
+      else if ((path >= 1) && (path <= getPathCount()) && !m_pPath[path - 1]->m_bActive)
+      {
+         CPath* p = m_pPath[path - 1];
+         p->m_bActive = true;
 
-   uint64_t entertime;
-   CTimer::rdtsc(entertime);
+         // start sending on the path right away
+         p->m_pSndQueue->m_pSndUList->update(p->m_pSNode, false);
+      }
 
-   if ((0 != m_ullTargetTime) && (entertime > m_ullTargetTime))
-      m_ullTimeDiff += entertime - m_ullTargetTime;
+      break;
+      }
 
-   // Loss retransmission always has higher priority.
-   if ((packet.m_iSeqNo = m_pSndLossList->getLostSeq()) >= 0)
-   {
-      // protect m_iSndLastDataAck from updating by ACK processing
+   case 11: //1011 - Path Validation
+      {
+      if (ctrlpkt.getLength() < 12)
+         break;
+
+      // a challenge comes from the address the connection already uses and carries our own token;
+      // the response leaves from wherever the network now maps this socket to, see acceptMigration()
+      int32_t* validation = (int32_t *)ctrlpkt.m_pcData;
+      if ((1 == validation[0]) && (0 != m_iToken) && (validation[2] == m_iToken))
+      {
+         int32_t response = 2;
+         sendCtrl(11, &response, &validation[1]);
+      }
+      else if ((2 == validation[0]) && (0 != m_iResumeChallenge) && (validation[1] == m_iResumeChallenge) && (validation[2] == m_iToken))
+      {
+         // the peer of a resumed connection has seen our response, the data held back can go out
+         m_iResumeChallenge = 0;
+         updateSndList();
+      }
+
+      break;
+      }
+
+   case 12: //1100 - Path MTU Probe
+      {
+      if (ctrlpkt.getLength() < 8)
+         break;
+
+      int32_t* probe = (int32_t *)ctrlpkt.m_pcData;
+      int32_t probeno = ctrlpkt.getAckSeqNo();
+
+      if (0 == probe[0])
+      {
+         // the reply tells what arrived, not what the probe claims
+         int32_t reply[2];
+         reply[0] = 1;
+         reply[1] = ctrlpkt.getLength() + CPacket::m_iPktHdrSize + 28;
+         sendCtrl(12, &probeno, reply);
+      }
+      else if ((probeno == m_iPMTUProbeNo) && (0 != m_iPMTUProbeSize) && (probe[1] >= m_iPMTUProbeSize))
+      {
+         m_iPMTULow = m_iPMTUProbeSize;
+         m_iPMTUProbeSize = 0;
+         m_iPMTUProbeLoss = 0;
+         setPMTU(m_iPMTULow);
+
+         // go on with the next size at the next timer check
+         CTimer::rdtsc(m_ullPMTUProbeTime);
+      }
+
+      break;
+      }
+
+   case 32767: //0x7FFF - reserved and user defined messages
+      m_pCC->processCustomMsg(&ctrlpkt);
+      // update CC parameters
+      m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
+      m_dCongestionWindow = m_pCC->m_dCWndSize;
+
+      break;
+
+   default:
+      break;
+   }
+}
+
+void CUDT::flushACK()
+{
+   m_bACKPending = false;
+   int32_t ack = m_iPendingACK;
+   uint64_t currtime = CTimer::getTime();
+
+   // protect packet retransmission
+   CGuard::enterCS(m_AckLock);
+
+   int offset = CSeqNo::seqoff((int32_t&)m_iSndLastDataAck, ack);
+   if (offset <= 0)
+   {
+      CGuard::leaveCS(m_AckLock);
+      return;
+   }
+
+   // acknowledge the sending buffer
+   m_pSndBuffer->ackData(offset);
+
+   // record total time used for sending
+   CAtomic::add(m_llSndDurationTotal, currtime - m_llSndDurationCounter);
+   m_llSndDurationCounter = currtime;
+
+   // update sending variables
+   m_iSndLastDataAck = ack;
+   m_pSndLossList->remove(CSeqNo::decseq((int32_t&)m_iSndLastDataAck));
+
+   CGuard::leaveCS(m_AckLock);
+
+   #ifndef WIN32
+      pthread_mutex_lock(&m_SendBlockLock);
+      if (m_bSynSending)
+         pthread_cond_signal(&m_SendBlockCond);
+      pthread_mutex_unlock(&m_SendBlockLock);
+   #else
+      if (m_bSynSending)
+         SetEvent(m_SendBlockCond);
+   #endif
+
+   // acknowledde any waiting epolls to write
+   s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
+
+   // insert this socket to snd list if it is not on the list yet
+   updateSndList(false);
+
+   m_pCC->onACK(ack);
+   // update CC parameters
+   m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
+   m_dCongestionWindow = m_pCC->m_dCWndSize;
+   m_Trace.record(UDT_TRACE_CC, ack, m_pCC->m_dPktSndPeriod, m_pCC->m_dCWndSize, 0);
+
+   for (int i = 0; i < getPathCount(); ++ i)
+      m_pPath[i]->m_pCC->onACK(ack);
+   updatePaths();
+
+   tuneSndBuffer();
+
+   // the peer reports only the losses its parity could not repair, size the next groups after them
+   if (NULL != m_pFECEncoder)
+   {
+      int64_t sent = CAtomic::load(m_llSentTotal);
+      if (sent - m_llFECLastSent >= 4 * CFECEncoder::m_iMaxGroupSize)
+      {
+         int64_t loss = CAtomic::load(m_llSndLossTotal);
+         m_pFECEncoder->setLossRate(double(loss - m_llFECLastLoss) / (sent - m_llFECLastSent));
+         m_llFECLastSent = sent;
+         m_llFECLastLoss = loss;
+      }
+   }
+}
+
+int CUDT::packData(CPacket& packet, uint64_t& ts, const int& path)
+{
+   int payload = 0;
+   bool probe = false;
+
+   // a connection accepted on a ticket sends nothing before its peer has proven the round trip, see checkTimers()
+   if (0 != m_iResumeChallenge)
+      return 0;
+
+   // the additional paths pack from their own sending queues; a single-path connection has only one sending
+   // thread, and a new path does not send before its join round trip, long after a call that saw no paths
+   CGuard packguard(m_PackLock, getPathCount() > 0);
+
+   // the primary path keeps its pacing in the socket, an additional path in its CPath
+   CPath* p = (0 == path) ? NULL : m_pPath[path - 1];
+   CCC* cc = (NULL == p) ? m_pCC : p->m_pCC;
+   uint64_t interval = (NULL == p) ? m_ullInterval : p->m_ullInterval;
+   uint64_t& targettime = (NULL == p) ? m_ullTargetTime : p->m_ullTargetTime;
+   uint64_t& timediff = (NULL == p) ? m_ullTimeDiff : p->m_ullTimeDiff;
+
+   uint64_t entertime;
+   CTimer::rdtsc(entertime);
+
+   if ((0 != targettime) && (entertime > targettime))
+      timediff += entertime - targettime;
+
+   // the parity of a completed group follows it immediately, so that the peer can repair a loss early,
+   // but not between the two packets of a probing pair
+   if ((NULL != m_pFECEncoder) && m_pFECEncoder->ready() && (0 != (m_iSndCurrSeqNo & 0xF)))
+   {
+      // the parity takes the place of a data packet on the wire, but not in the congestion window
+      ts = entertime + interval;
+      targettime = ts;
+      return packParity(packet);
+   }
+
+   // Loss retransmission always has higher priority.
+   if ((packet.m_iSeqNo = m_pSndLossList->getLostSeq()) >= 0)
+   {
+      // protect m_iSndLastDataAck from updating by ACK processing
       CGuard ackguard(m_AckLock);
 
       int offset = CSeqNo::seqoff((int32_t&)m_iSndLastDataAck, packet.m_iSeqNo);
@@ -2150,57 +3128,117 @@ int CUDT::packData(CPacket& packet, uint64_t& ts)
 
       if (-1 == payload)
       {
+         // the range is inclusive, it ends with the last packet of the message
          int32_t seqpair[2];
          seqpair[0] = packet.m_iSeqNo;
-         seqpair[1] = CSeqNo::incseq(seqpair[0], msglen);
-         sendCtrl(7, &packet.m_iMsgNo, seqpair, 8);
+         seqpair[1] = CSeqNo::incseq(seqpair[0], msglen - 1);
 
          // only one msg drop request is necessary
          m_pSndLossList->remove(seqpair[1]);
 
-         // skip all dropped packets
-         if (CSeqNo::seqcmp(const_cast<int32_t&>(m_iSndCurrSeqNo), CSeqNo::incseq(seqpair[1])) < 0)
-             m_iSndCurrSeqNo = CSeqNo::incseq(seqpair[1]);
+         // skip the packets of the message not sent yet, readData() has moved past them in the buffer,
+         // going further would number the next packets out of step with their buffer positions;
+         // this must happen before the request goes out, the peer may acknowledge the range at once
+         if (CSeqNo::seqcmp(const_cast<int32_t&>(m_iSndCurrSeqNo), seqpair[1]) < 0)
+             m_iSndCurrSeqNo = seqpair[1];
+
+         sendCtrl(7, &packet.m_iMsgNo, seqpair, 8);
 
          return 0;
       }
       else if (0 == payload)
          return 0;
 
-      ++ m_iTraceRetrans;
-      ++ m_iRetransTotal;
+      CAtomic::add(m_llRetransTotal, 1);
+      m_Trace.record(UDT_TRACE_RETRANS, packet.m_iSeqNo, 0, 0, 0);
    }
    else
    {
       // If no loss, pack a new packet.
 
-      // check congestion/flow window limit
-      int cwnd = (m_iFlowWindowSize < (int)m_dCongestionWindow) ? m_iFlowWindowSize : (int)m_dCongestionWindow;
+      // the second packet of a probing pair must follow the first one on the same path
+      if ((0 != getPathCount()) && (1 == (CSeqNo::incseq(m_iSndCurrSeqNo) & 0xF)) && (path != m_iProbePath))
+      {
+         ts = entertime + interval;
+         return 0;
+      }
+
+      // check congestion/flow window limit, the paths share one window, the sum of theirs
+      int cwnd = (int)m_dCongestionWindow;
+      for (int i = 0; i < getPathCount(); ++ i)
+      {
+         if (m_pPath[i]->m_bActive)
+            cwnd += (int)m_pPath[i]->m_dCongestionWindow;
+      }
+      if (m_iFlowWindowSize < cwnd)
+         cwnd = m_iFlowWindowSize;
+
       if (cwnd >= CSeqNo::seqlen(const_cast<int32_t&>(m_iSndLastAck), CSeqNo::incseq(m_iSndCurrSeqNo)))
       {
-         if (0 != (payload = m_pSndBuffer->readData(&(packet.m_pcData), packet.m_iMsgNo)))
+         int msglen;
+         while (-1 == (payload = m_pSndBuffer->readData(&(packet.m_pcData), packet.m_iMsgNo, msglen)))
+         {
+            // the packets of a message that expired in the buffer keep their sequence numbers but are never
+            // sent, the receiver is told to skip them rather than finding them lost
+            int32_t seqpair[2];
+            seqpair[0] = CSeqNo::incseq(m_iSndCurrSeqNo);
+            seqpair[1] = CSeqNo::incseq(seqpair[0], msglen - 1);
+
+            m_iSndCurrSeqNo = seqpair[1];
+            m_pCC->setSndCurrSeqNo((int32_t&)m_iSndCurrSeqNo);
+            for (int i = 0; i < getPathCount(); ++ i)
+               m_pPath[i]->m_pCC->setSndCurrSeqNo((int32_t&)m_iSndCurrSeqNo);
+
+            sendCtrl(7, &packet.m_iMsgNo, seqpair, 8);
+         }
+
+         if (0 != payload)
          {
             m_iSndCurrSeqNo = CSeqNo::incseq(m_iSndCurrSeqNo);
             m_pCC->setSndCurrSeqNo((int32_t&)m_iSndCurrSeqNo);
+            for (int i = 0; i < getPathCount(); ++ i)
+               m_pPath[i]->m_pCC->setSndCurrSeqNo((int32_t&)m_iSndCurrSeqNo);
 
             packet.m_iSeqNo = m_iSndCurrSeqNo;
+            m_Trace.record(UDT_TRACE_SEND, packet.m_iSeqNo, 0, 0, 0);
+
+            if (NULL != m_pFECEncoder)
+            {
+               packet.setLength(payload);
+               m_pFECEncoder->add(packet);
+            }
 
             // every 16 (0xF) packets, a packet pair is sent
             if (0 == (packet.m_iSeqNo & 0xF))
+            {
                probe = true;
+               m_iProbePath = path;
+            }
          }
          else
          {
-            m_ullTargetTime = 0;
-            m_ullTimeDiff = 0;
+            // nothing more to send for now, do not leave the last packets without parity
+            if (NULL != m_pFECEncoder)
+            {
+               m_pFECEncoder->flush();
+               if (m_pFECEncoder->ready())
+               {
+                  ts = entertime + interval;
+                  targettime = ts;
+                  return packParity(packet);
+               }
+            }
+
+            targettime = 0;
+            timediff = 0;
             ts = 0;
             return 0;
          }
       }
       else
       {
-         m_ullTargetTime = 0;
-         m_ullTimeDiff = 0;
+         targettime = 0;
+         timediff = 0;
          ts = 0;
          return 0;
       }
@@ -2211,10 +3249,17 @@ int CUDT::packData(CPacket& packet, uint64_t& ts)
 
    packet.m_iID = m_PeerID;
 
-   m_pCC->onPktSent(&packet);
+   // a loss report is charged to the controller of the path that sent the packet last
+   if (NULL != m_pcSeqPath)
+      m_pcSeqPath[packet.m_iSeqNo % m_iFlightFlagSize] = (unsigned char)path;
+
+   cc->onPktSent(&packet);
 
-   ++ m_llTraceSent;
-   ++ m_llSentTotal;
+   CAtomic::add(m_llSentTotal, 1);
+   CAtomic::add(m_llSentBytesTotal, payload);
+   if (0 != m_ullLastPktSendTime)
+      m_SndIntervalHist.record(int64_t((entertime - m_ullLastPktSendTime) / m_ullCPUFrequency));
+   m_ullLastPktSendTime = entertime;
 
    if (probe)
    {
@@ -2225,22 +3270,22 @@ int CUDT::packData(CPacket& packet, uint64_t& ts)
    else
    {
       #ifndef NO_BUSY_WAITING
-         ts = entertime + m_ullInterval;
+         ts = entertime + interval;
       #else
-         if (m_ullTimeDiff >= m_ullInterval)
+         if (timediff >= interval)
          {
             ts = entertime;
-            m_ullTimeDiff -= m_ullInterval;
+            timediff -= interval;
          }
          else
          {
-            ts = entertime + m_ullInterval - m_ullTimeDiff;
-            m_ullTimeDiff = 0;
+            ts = entertime + interval - timediff;
+            timediff = 0;
          }
       #endif
    }
 
-   m_ullTargetTime = ts;
+   targettime = ts;
 
    packet.m_iID = m_PeerID;
    packet.setLength(payload);
@@ -2248,6 +3293,18 @@ int CUDT::packData(CPacket& packet, uint64_t& ts)
    return payload;
 }
 
+int CUDT::packParity(CPacket& packet)
+{
+   int size = m_pFECEncoder->pack(packet);
+
+   packet.m_iTimeStamp = int(CTimer::getTime() - m_StartTime);
+   packet.m_iID = m_PeerID;
+
+   CAtomic::add(m_llSndParityTotal, 1);
+
+   return size;
+}
+
 int CUDT::processData(CUnit* unit)
 {
    CPacket& packet = unit->m_Packet;
@@ -2259,6 +3316,14 @@ int CUDT::processData(CUnit* unit)
    if (m_ullEXPInt < m_ullMinExpInt)
        m_ullEXPInt = m_ullMinExpInt;
 
+   // one-way delay against the sender clock; both timestamps wrap at 32 bits, so only differences are meaningful
+   int32_t delay = int32_t(uint32_t(m_llLastRspTime - m_StartTime) - uint32_t(packet.m_iTimeStamp));
+   if (!m_bRcvDelaySampled || (int32_t(delay - m_iRcvMinDelay) < 0))
+   {
+      m_iRcvMinDelay = delay;
+      m_bRcvDelaySampled = true;
+   }
+
    if (CSeqNo::incseq(m_iSndCurrSeqNo) == m_iSndLastAck)
    {
       CTimer::rdtsc(m_ullNextEXPTime);
@@ -2281,8 +3346,8 @@ int CUDT::processData(CUnit* unit)
    else if (1 == (packet.m_iSeqNo & 0xF))
       m_pRcvTimeWindow->probe2Arrival();
 
-   ++ m_llTraceRecv;
-   ++ m_llRecvTotal;
+   CAtomic::add(m_llRecvTotal, 1);
+   CAtomic::add(m_llRecvBytesTotal, packet.getLength());
 
    int32_t offset = CSeqNo::seqoff(m_iRcvLastAck, packet.m_iSeqNo);
    if ((offset < 0) || (offset >= m_pRcvBuffer->getAvailBufSize()))
@@ -2291,28 +3356,40 @@ int CUDT::processData(CUnit* unit)
    if (m_pRcvBuffer->addData(unit, offset) < 0)
       return -1;
 
+   if (NULL != m_pFECDecoder)
+   {
+      m_pFECDecoder->add(packet);
+
+      // the parity of an old group should have arrived by now, report the losses it was to repair
+      if (m_pFECDecoder->overdue(packet.m_iSeqNo))
+      {
+         int32_t* missing = new int32_t[CFECEncoder::m_iMaxGroupSize];
+         reportMissing(missing, m_pFECDecoder->expire(missing));
+         delete [] missing;
+      }
+   }
+
    // Loss detection.
    if (CSeqNo::seqcmp(packet.m_iSeqNo, CSeqNo::incseq(m_iRcvCurrSeqNo)) > 0)
    {
-      // If loss found, insert them to the receiver loss list
-      m_pRcvLossList->insert(CSeqNo::incseq(m_iRcvCurrSeqNo), CSeqNo::decseq(packet.m_iSeqNo));
+      int32_t from = CSeqNo::incseq(m_iRcvCurrSeqNo);
+      int32_t to = CSeqNo::decseq(packet.m_iSeqNo);
 
-      // pack loss list for NAK
-      int32_t lossdata[2];
-      lossdata[0] = CSeqNo::incseq(m_iRcvCurrSeqNo) | 0x80000000;
-      lossdata[1] = CSeqNo::decseq(packet.m_iSeqNo);
+      // If loss found, insert them to the receiver loss list
+      m_pRcvLossList->insert(from, to);
 
-      // Generate loss report immediately.
-      sendCtrl(3, NULL, lossdata, (CSeqNo::incseq(m_iRcvCurrSeqNo) == CSeqNo::decseq(packet.m_iSeqNo)) ? 1 : 2);
+      // losses that a parity still on its way may repair are reported when it arrives, see processCtrl()
+      if ((NULL == m_pFECDecoder) || !m_pFECDecoder->pending(from) || !m_pFECDecoder->pending(to))
+         reportLoss(from, to);
 
       int loss = CSeqNo::seqlen(m_iRcvCurrSeqNo, packet.m_iSeqNo) - 2;
-      m_iTraceRcvLoss += loss;
-      m_iRcvLossTotal += loss;
+      CAtomic::add(m_llRcvLossTotal, loss);
+      m_Trace.record(UDT_TRACE_LOSS, CSeqNo::incseq(m_iRcvCurrSeqNo), 0, 0, loss);
    }
 
    // This is not a regular fixed size packet...   
    //an irregular sized packet usually indicates the end of a message, so send an ACK immediately   
-   if (packet.getLength() != m_iPayloadSize)   
+   if (packet.getLength() != m_iPeerPayloadSize)   
       CTimer::rdtsc(m_ullNextACKTime); 
 
    // Update the current largest sequence number that has been received.
@@ -2330,41 +3407,45 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
    if (m_bClosing)
       return 1002;
 
-   if (packet.getLength() != CHandShake::m_iContentSize)
+   if (packet.getLength() < CHandShake::m_iContentSize)
       return 1004;
 
    CHandShake hs;
    hs.deserialize(packet.m_pcData, packet.getLength());
 
+   // anything after the extension fields is application data sent along with the request, see
+   // UDT_EARLYDATA; responses are built in the same packet and must not carry it back
+   const char* earlydata = packet.m_pcData + CHandShake::m_iExtContentSize;
+   int earlysize = packet.getLength() - CHandShake::m_iExtContentSize;
+   if (earlysize > m_iMaxEarlyDataSize)
+      return 1004;
+   if (earlysize > 0)
+      packet.setLength(CHandShake::m_iExtContentSize);
+   else
+      earlysize = 0;
+
    // SYN cookie
-   char clienthost[NI_MAXHOST];
-   char clientport[NI_MAXSERV];
-   getnameinfo(addr, (AF_INET == m_iVersion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6), clienthost, sizeof(clienthost), clientport, sizeof(clientport), NI_NUMERICHOST|NI_NUMERICSERV);
    int64_t timestamp = (CTimer::getTime() - m_StartTime) / 60000000; // secret changes every one minute
-   char cookiestr[1024];
-   sprintf(cookiestr, "%s:%s:%lld", clienthost, clientport, (long long int)timestamp);
-   unsigned char cookie[16];
-   CMD5::compute(cookiestr, cookie);
+   int32_t cookie = computeCookie(addr, timestamp);
 
    if (1 == hs.m_iReqType)
    {
-      hs.m_iCookie = *(int*)cookie;
-      packet.m_iID = hs.m_iID;
-      hs.serialize(packet.m_pcData, packet.getLength());
-      m_pSndQueue->sendto(addr, packet);
-      return 0;
+      // a ticket issued with an earlier connection stands in for the cookie, so that the request is served
+      // without another round trip; it is good for one connection, a repeated request gets a cookie
+      if (!checkTicket(addr, hs))
+      {
+         hs.m_iCookie = cookie;
+         packet.m_iID = hs.m_iID;
+         hs.serialize(packet.m_pcData, packet.getLength());
+         m_pSndQueue->sendto(addr, packet);
+         return 0;
+      }
    }
    else
    {
-      if (hs.m_iCookie != *(int*)cookie)
-      {
-         timestamp --;
-         sprintf(cookiestr, "%s:%s:%lld", clienthost, clientport, (long long int)timestamp);
-         CMD5::compute(cookiestr, cookie);
-
-         if (hs.m_iCookie != *(int*)cookie)
-            return -1;
-      }
+      // cookies issued in the previous minute are still accepted
+      if ((hs.m_iCookie != cookie) && (hs.m_iCookie != computeCookie(addr, timestamp - 1)))
+         return -1;
    }
 
    int32_t id = hs.m_iID;
@@ -2376,13 +3457,15 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
       {
          // mismatch, reject the request
          hs.m_iReqType = 1002;
-         hs.serialize(packet.m_pcData, CHandShake::m_iContentSize);
+         hs.serialize(packet.m_pcData, packet.getLength());
          packet.m_iID = id;
          m_pSndQueue->sendto(addr, packet);
       }
       else
       {
-         int result = s_UDTUnited.newConnection(m_SocketID, addr, &hs);
+         issueTicket(addr, hs);
+
+         int result = s_UDTUnited.newConnection(m_SocketID, addr, &hs, earlydata, earlysize);
          if (result == -1)
             hs.m_iReqType = 1002;
 
@@ -2390,7 +3473,7 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
          // new connection response should be sent in connect()
          if (result != 1)
          {
-            hs.serialize(packet.m_pcData, CHandShake::m_iContentSize);
+            hs.serialize(packet.m_pcData, packet.getLength());
             packet.m_iID = id;
             m_pSndQueue->sendto(addr, packet);
          }
@@ -2405,11 +3488,140 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
    return hs.m_iReqType;
 }
 
+void CUDT::switchCC()
+{
+   // held throughout, addPath() creates controllers from the current factory
+   CGuard cg(m_ConnectionLock);
+
+   CCCVirtualFactory* factory = m_pPendingCCFactory;
+   m_pPendingCCFactory = NULL;
+   if (NULL == factory)
+      return;
+
+   CCC* cc = createCC(factory, m_pCC);
+
+   m_pCC->close();
+   m_vRetiredCC.push_back(m_pCC);
+   m_pCC = cc;
+
+   // the paths switch along with the primary one
+   for (int i = 0; i < getPathCount(); ++ i)
+   {
+      cc = createCC(factory, m_pPath[i]->m_pCC);
+
+      m_pPath[i]->m_pCC->close();
+      m_vRetiredCC.push_back(m_pPath[i]->m_pCC);
+      m_pPath[i]->m_pCC = cc;
+   }
+
+   delete m_pCCFactory;
+   m_pCCFactory = factory;
+
+   m_Trace.record(UDT_TRACE_CC, m_iSndCurrSeqNo, m_pCC->m_dPktSndPeriod, m_pCC->m_dCWndSize, 0);
+}
+
+CCC* CUDT::createCC(CCCVirtualFactory* factory, const CCC* current)
+{
+   CCC* cc = factory->create();
+   cc->m_UDT = m_SocketID;
+   cc->m_pTrace = &m_Trace;
+   cc->setMSS(m_iPMTU);
+   cc->setMaxCWndSize((int&)m_iFlowWindowSize);
+   cc->setSndCurrSeqNo((int32_t&)m_iSndCurrSeqNo);
+   cc->setRcvRate(m_iDeliveryRate);
+   cc->setRTT(m_iRTT);
+   cc->setBandwidth(m_iBandwidth);
+   // the user parameters carry the rate limit, from UDT_MAXBW or set by the application since
+   if (NULL != current->m_pcParam)
+      cc->setUserParam(current->m_pcParam, current->m_iPSize);
+   else if (m_llMaxBW > 0)
+      cc->setUserParam((char*)&(m_llMaxBW), 8);
+   cc->init();
+
+   return cc;
+}
+
+void CUDT::seedFromCache(const CInfoBlock& ib)
+{
+   m_iRTT = ib.m_iRTT;
+   m_iRTTVar = m_iRTT >> 1;
+   m_iBandwidth = ib.m_iBandwidth;
+   if (ib.m_dInterval > 0)
+      m_iDeliveryRate = int(1000000.0 / ib.m_dInterval);
+
+   // open() derived the timer intervals from the default RTT
+   m_ullNAKInt = (m_iRTT + 4 * m_iRTTVar) * m_ullCPUFrequency;
+   m_ullEXPInt = (m_iRTT + 4 * m_iRTTVar) * m_ullCPUFrequency + m_ullSYNInt;
+   if (m_ullEXPInt < m_ullMinExpInt)
+      m_ullEXPInt = m_ullMinExpInt;
+
+   m_pCC->setCachedPath(ib.m_dInterval, ib.m_dCWnd);
+}
+
+bool CUDT::allowNAK()
+{
+   if (!m_bCompactNAK)
+      return true;
+
+   uint64_t currtime;
+   CTimer::rdtsc(currtime);
+   if (currtime > m_ullNAKWindowEnd)
+   {
+      m_ullNAKWindowEnd = currtime + m_iRTT * m_ullCPUFrequency;
+      m_iNAKCount = 0;
+   }
+
+   if (m_iNAKCount >= m_iMaxNAKsPerRTT)
+      return false;
+
+   ++ m_iNAKCount;
+   return true;
+}
+
+void CUDT::reportLoss(const int32_t& from, const int32_t& to)
+{
+   // pack loss list for NAK
+   int32_t lossdata[2];
+   lossdata[0] = from | 0x80000000;
+   lossdata[1] = to;
+
+   // Generate loss report immediately, unless too many have been sent in this RTT already,
+   // then the new losses go out in one coalesced report at the next timer check that allows it
+   if ((-1 == m_iNAKPendingSeq) && allowNAK())
+      sendCtrl(3, NULL, lossdata, (from == to) ? 1 : 2);
+   else if ((-1 == m_iNAKPendingSeq) || (CSeqNo::seqcmp(from, m_iNAKPendingSeq) < 0))
+      m_iNAKPendingSeq = from;
+}
+
+void CUDT::reportMissing(const int32_t* missing, const int& num)
+{
+   // the packets of a group that are still in the loss list, one report per run of consecutive ones
+   for (int i = 0; i < num; ++ i)
+   {
+      if (!m_pRcvLossList->find(missing[i], missing[i]))
+         continue;
+
+      int j = i;
+      while ((j + 1 < num) && (CSeqNo::incseq(missing[j]) == missing[j + 1]) && m_pRcvLossList->find(missing[j + 1], missing[j + 1]))
+         ++ j;
+
+      reportLoss(missing[i], missing[j]);
+      i = j;
+   }
+}
+
 void CUDT::checkTimers()
 {
+   if (NULL != m_pPendingCCFactory)
+      switchCC();
+
+   if (m_bACKPending)
+      flushACK();
+
    // update CC parameters
    m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
    m_dCongestionWindow = m_pCC->m_dCWndSize;
+   updatePaths();
    //uint64_t minint = (uint64_t)(m_ullCPUFrequency * m_pSndTimeWindow->getMinPktSndInt() * 0.9);
    //if (m_ullInterval < minint)
    //   m_ullInterval = minint;
@@ -2432,15 +3644,26 @@ void CUDT::checkTimers()
       m_iPktCount = 0;
       m_iLightACKCount = 1;
    }
-   else if (m_iSelfClockInterval * m_iLightACKCount <= m_iPktCount)
+   else if (m_iLightACKInterval * m_iLightACKCount <= m_iPktCount)
    {
       //send a "light" ACK
       sendCtrl(2, NULL, NULL, 4);
       ++ m_iLightACKCount;
    }
 
+   if ((-1 != m_iNAKPendingSeq) && allowNAK())
+   {
+      // send the losses held back by the loss report limit, in one report
+      sendCtrl(3, &m_iNAKPendingSeq);
+      m_iNAKPendingSeq = -1;
+   }
+
    if ((loss >= 0) && (currtime > m_ullNextNAKTime))
    {
+      // a parity is waited for during two NAK intervals at most, it may have been lost
+      if (NULL != m_pFECDecoder)
+         m_pFECDecoder->expire();
+
       // NAK timer expired, and there is loss to be reported.
       sendCtrl(3);
 
@@ -2448,6 +3671,25 @@ void CUDT::checkTimers()
       m_ullNextNAKTime = currtime + m_ullNAKInt;
    }
 
+   // a connection accepted on a ticket repeats its challenge until the peer answers from the address it uses,
+   // and sends neither data nor MTU probes there until then
+   if ((0 != m_iResumeChallenge) && (currtime > m_ullChallengeTime + m_iChallengeInterval * m_ullCPUFrequency))
+   {
+      int32_t challenge = 1;
+      sendCtrl(11, &challenge, &m_iResumeChallenge);
+      m_ullChallengeTime = currtime;
+   }
+
+   if (m_bPMTUD && (0 == m_iResumeChallenge))
+      probePMTU(currtime);
+
+   // repeat the join requests the peer has not answered yet
+   for (int i = 0; i < getPathCount(); ++ i)
+   {
+      if (!m_pPath[i]->m_bActive && (m_pPath[i]->m_iJoinCount < m_iMaxJoinCount) && (currtime > m_pPath[i]->m_ullNextJoinTime))
+         sendJoin(i + 1);
+   }
+
    if (currtime > m_ullNextEXPTime)
    {
       // Haven't receive any information from the peer, is it dead?!
@@ -2462,9 +3704,10 @@ void CUDT::checkTimers()
          m_bClosing = true;
          m_bBroken = true;
          m_iBrokenCounter = 30;
+         s_UDTUnited.notifyGC(m_SocketID);
 
          // update snd U list to remove this socket
-         m_pSndQueue->m_pSndUList->update(this);
+         updateSndList();
 
          releaseSynch();
 
@@ -2480,27 +3723,58 @@ void CUDT::checkTimers()
       // recver: Send out a keep-alive packet
       if (m_pSndBuffer->getCurrBufSize() > 0)
       {
+         int num = 0;
          if (CSeqNo::incseq(m_iSndCurrSeqNo) != m_iSndLastAck)
          {
             int32_t csn = m_iSndCurrSeqNo;
-            int num = m_pSndLossList->insert(const_cast<int32_t&>(m_iSndLastAck), csn);
-            m_iTraceSndLoss += num;
-            m_iSndLossTotal += num;
+            num = m_pSndLossList->insert(const_cast<int32_t&>(m_iSndLastAck), csn);
+            CAtomic::add(m_llSndLossTotal, num);
          }
+         m_Trace.record(UDT_TRACE_TIMEOUT, m_iSndLastAck, m_pCC->m_dPktSndPeriod, m_pCC->m_dCWndSize, num);
 
          m_pCC->onTimeout();
          // update CC parameters
          m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
          m_dCongestionWindow = m_pCC->m_dCWndSize;
+         m_Trace.record(UDT_TRACE_CC, m_iSndCurrSeqNo, m_pCC->m_dPktSndPeriod, m_pCC->m_dCWndSize, 0);
+
+         for (int i = 0; i < getPathCount(); ++ i)
+            m_pPath[i]->m_pCC->onTimeout();
+         updatePaths();
+
+         // nothing at all gets through since the packets grew: the route may have changed to a smaller MTU and drop
+         // them without a word, new data goes back to the base size and the search starts over later
+         if (m_bPMTUD && (m_iPMTU > m_iPMTUBase))
+         {
+            if (m_iSndLastAck != m_iPMTUStallAck)
+            {
+               m_iPMTUStallAck = m_iSndLastAck;
+               m_iPMTUStallCount = 0;
+            }
+            else if (++ m_iPMTUStallCount >= m_iPMTUBlackHoleCount)
+            {
+               m_iPMTULow = m_iPMTUBase;
+               m_iPMTUHigh = m_iMSS;
+               m_iPMTUProbeSize = 0;
+               m_iPMTUStallCount = 0;
+               setPMTU(m_iPMTUBase);
+               m_ullPMTUProbeTime = currtime + uint64_t(m_iPMTURaiseInterval) * 1000000 * m_ullCPUFrequency;
+            }
+         }
 
          // immediately restart transmission
-         m_pSndQueue->m_pSndUList->update(this);
+         updateSndList();
       }
       else
       {
          sendCtrl(1);
       }
 
+      // if a NAT has moved this socket to another port, the peer drops everything it sends from there,
+      // a packet with the token lets the peer validate the new address and follow it
+      if (0 != m_iPeerToken)
+         sendCtrl(11);
+
       ++ m_iEXPCount;
       m_ullEXPInt = (m_iEXPCount * (m_iRTT + 4 * m_iRTTVar) + m_iSYNInterval) * m_ullCPUFrequency;
       if (m_ullEXPInt < m_iEXPCount * m_ullMinExpInt)
@@ -2510,6 +3784,563 @@ void CUDT::checkTimers()
    }
 }
 
+void CUDT::addPath(const int& mux, CSndQueue* sndqueue, const sockaddr* peer)
+{
+   CGuard cg(m_ConnectionLock);
+
+   if (!m_bConnected || m_bClosing || m_bBroken)
+      throw CUDTException(2, 2, 0);
+
+   if (m_iPathCount >= m_iMaxPathCount)
+      throw CUDTException(5, 3, 0);
+
+   if (NULL == m_pPath)
+   {
+      m_pPath = new CPath*[m_iMaxPathCount];
+
+      // everything sent so far went out on the primary path
+      m_pcSeqPath = new unsigned char[m_iFlightFlagSize];
+      memset(m_pcSeqPath, 0, m_iFlightFlagSize);
+   }
+
+   CPath* p = new CPath;
+   p->m_iMuxID = mux;
+   p->m_pSndQueue = sndqueue;
+   p->m_pPeerAddr = (AF_INET == m_iIPversion) ? (sockaddr*)new sockaddr_in : (sockaddr*)new sockaddr_in6;
+   memcpy(p->m_pPeerAddr, peer, (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+
+   p->m_pSNode = new CSNode;
+   p->m_pSNode->m_pUDT = this;
+   p->m_pSNode->m_llTimeStamp = 1;
+   p->m_pSNode->m_iHeapLoc = -1;
+   p->m_pSNode->m_iPath = m_iPathCount + 1;
+
+   // every path has a controller of its own, it starts from what the connection has learned so far
+   p->m_pCC = createCC(m_pCCFactory, m_pCC);
+   p->m_ullInterval = (uint64_t)(p->m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
+   p->m_dCongestionWindow = p->m_pCC->m_dCWndSize;
+   p->m_ullTargetTime = 0;
+   p->m_ullTimeDiff = 0;
+
+   p->m_bActive = false;
+   p->m_iJoinCount = 0;
+   p->m_ullNextJoinTime = 0;
+
+   // the other threads only look at the paths below m_iPathCount, which is stored after the path it counts
+   int path = m_iPathCount + 1;
+   m_pPath[path - 1] = p;
+   CAtomic::releaseFence();
+   m_iPathCount = path;
+
+   sendJoin(path);
+}
+
+void CUDT::sendJoin(const int& path)
+{
+   CPath* p = m_pPath[path - 1];
+
+   int32_t join[4];
+   join[0] = 0;
+   join[1] = m_iISN;
+   join[2] = m_SocketID;
+   join[3] = computeJoinMAC(m_iPeerToken, m_iISN, m_SocketID, path);
+
+   // the request goes out on the path itself, the peer accepts packets from the address it comes from
+   CPacket ctrlpkt;
+   ctrlpkt.pack(10, (void*)&path, join, 16);
+   ctrlpkt.m_iID = m_PeerID;
+   p->m_pSndQueue->sendto(p->m_pPeerAddr, ctrlpkt);
+
+   ++ p->m_iJoinCount;
+   CTimer::rdtsc(p->m_ullNextJoinTime);
+   p->m_ullNextJoinTime += m_iJoinInterval * m_ullCPUFrequency;
+}
+
+bool CUDT::acceptPath(const sockaddr* addr, const CPacket& packet)
+{
+   for (std::vector<sockaddr*>::iterator i = m_vPathPeerAddr.begin(); i != m_vPathPeerAddr.end(); ++ i)
+   {
+      if (CIPAddress::ipcmp(addr, *i, m_iIPversion))
+         return true;
+   }
+
+   // an unknown address can only join with a MAC keyed with the connection token, the ISN and the socket ID
+   // alone are seen by anyone on the primary path
+   if ((0 == m_iToken) || (1 != packet.getFlag()) || (10 != packet.getType()) || (packet.getLength() < 16))
+      return false;
+
+   int32_t* join = (int32_t *)packet.m_pcData;
+   if ((0 != join[0]) || (join[1] != m_iISN) || (join[2] != m_PeerID) || ((int)m_vPathPeerAddr.size() >= m_iMaxPathCount))
+      return false;
+   if (join[3] != computeJoinMAC(m_iToken, m_iISN, m_PeerID, packet.getAckSeqNo()))
+      return false;
+
+   sockaddr* a = (AF_INET == m_iIPversion) ? (sockaddr*)new sockaddr_in : (sockaddr*)new sockaddr_in6;
+   memcpy(a, addr, (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+   m_vPathPeerAddr.push_back(a);
+
+   return true;
+}
+
+int32_t CUDT::computeJoinMAC(const int32_t& token, const int32_t& isn, const int32_t& id, const int32_t& path)
+{
+   // the token is the secret, the other values tie the MAC to this connection and path
+   int32_t key[4];
+   key[0] = token;
+   key[1] = isn;
+   key[2] = id;
+   key[3] = 0x6A6F696E;
+
+   int32_t input = path;
+   uint64_t mac = CSipHash::compute((const unsigned char*)key, &input, 4);
+
+   return (int32_t)(mac ^ (mac >> 32));
+}
+
+void CUDT::splitLoss(const int32_t* ranges, const int& num)
+{
+   int total = 0;
+   for (int i = 0; i < num; ++ i)
+      total += CSeqNo::seqlen(ranges[2 * i], ranges[2 * i + 1]);
+   if (0 == total)
+      return;
+
+   // each controller is told about the packets its own path lost, in the loss list coding
+   int32_t* array = new int32_t[total * 2];
+
+   for (int path = 0; path <= getPathCount(); ++ path)
+   {
+      int len = 0;
+      int32_t last = -1;
+      bool range = false;
+
+      for (int i = 0; i < num; ++ i)
+      {
+         for (int32_t seq = ranges[2 * i]; ; seq = CSeqNo::incseq(seq))
+         {
+            if (path == m_pcSeqPath[seq % m_iFlightFlagSize])
+            {
+               if ((len > 0) && (CSeqNo::incseq(last) == seq))
+               {
+                  if (!range)
+                  {
+                     array[len - 1] |= 0x80000000;
+                     array[len ++] = seq;
+                     range = true;
+                  }
+                  else
+                     array[len - 1] = seq;
+               }
+               else
+               {
+                  array[len ++] = seq;
+                  range = false;
+               }
+               last = seq;
+            }
+
+            if (seq == ranges[2 * i + 1])
+               break;
+         }
+      }
+
+      if (0 == len)
+         continue;
+
+      if (0 == path)
+      {
+         m_pCC->onLoss(array, len);
+         m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
+         m_dCongestionWindow = m_pCC->m_dCWndSize;
+      }
+      else
+         m_pPath[path - 1]->m_pCC->onLoss(array, len);
+   }
+
+   delete [] array;
+
+   updatePaths();
+}
+
+void CUDT::updatePaths()
+{
+   for (int i = 0; i < getPathCount(); ++ i)
+   {
+      CPath* p = m_pPath[i];
+      p->m_ullInterval = (uint64_t)(p->m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
+      p->m_dCongestionWindow = p->m_pCC->m_dCWndSize;
+   }
+}
+
+int CUDT::getActivePathCount() const
+{
+   int count = 0;
+   for (int i = 0; i < getPathCount(); ++ i)
+   {
+      if (m_pPath[i]->m_bActive)
+         ++ count;
+   }
+
+   return count;
+}
+
+void CUDT::updateSndList(const bool& reschedule)
+{
+   m_pSndQueue->m_pSndUList->update(this, reschedule);
+
+   for (int i = 0; i < getPathCount(); ++ i)
+   {
+      if (m_pPath[i]->m_bActive)
+         m_pPath[i]->m_pSndQueue->m_pSndUList->update(m_pPath[i]->m_pSNode, reschedule);
+   }
+}
+
+int32_t CUDT::createToken()
+{
+   // a digest like the SYN cookie, over values that another host cannot learn
+   uint64_t tsc;
+   CTimer::rdtsc(tsc);
+
+   char tokenstr[256];
+   sprintf(tokenstr, "%d:%d:%lld:%llu", m_SocketID, m_iISN, (long long int)CTimer::getTime(), (unsigned long long int)tsc);
+
+   unsigned char token[16];
+   CMD5::compute(tokenstr, token);
+
+   // 0 means that migration is not supported
+   return (0 != *(int32_t*)token) ? *(int32_t*)token : 1;
+}
+
+bool CUDT::acceptMigration(const sockaddr* addr, const CPacket& packet)
+{
+   if ((0 == m_iToken) || (1 != packet.getFlag()) || (11 != packet.getType()) || (packet.getLength() < 12))
+      return false;
+
+   int32_t* validation = (int32_t *)packet.m_pcData;
+   if (validation[2] != m_iToken)
+      return false;
+
+   uint64_t currtime;
+   CTimer::rdtsc(currtime);
+
+   if (0 == validation[0])
+   {
+      // the peer announces itself from a new address: check that it can be reached there before
+      // sending anything else to it, at most one challenge per interval
+      if ((NULL != m_pMigrationAddr) && (currtime < m_ullChallengeTime + m_iChallengeInterval * m_ullCPUFrequency))
+         return false;
+
+      if (NULL == m_pMigrationAddr)
+         m_pMigrationAddr = (AF_INET == m_iIPversion) ? (sockaddr*)new sockaddr_in : (sockaddr*)new sockaddr_in6;
+      memcpy(m_pMigrationAddr, addr, (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+      m_iChallenge = createToken();
+      m_ullChallengeTime = currtime;
+
+      int32_t challenge[3];
+      challenge[0] = 1;
+      challenge[1] = m_iChallenge;
+      challenge[2] = m_iPeerToken;
+
+      CPacket ctrlpkt;
+      ctrlpkt.pack(11, NULL, challenge, 12);
+      ctrlpkt.m_iID = m_PeerID;
+      m_pSndQueue->sendto(m_pMigrationAddr, ctrlpkt);
+
+      return false;
+   }
+
+   if ((2 != validation[0]) || (NULL == m_pMigrationAddr) || (0 == m_iChallenge) || (validation[1] != m_iChallenge)
+      || !CIPAddress::ipcmp(addr, m_pMigrationAddr, m_iIPversion))
+      return false;
+
+   // validated, the connection follows the peer with its congestion state; the address is rewritten in
+   // place, the threads sending to it copy it or send under the same lock, see sendToPeer() and getPeerAddr()
+   CGuard::enterCS(m_PeerAddrLock);
+   memcpy(m_pPeerAddr, m_pMigrationAddr, (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+   CGuard::leaveCS(m_PeerAddrLock);
+   m_iChallenge = 0;
+
+   return true;
+}
+
+void CUDT::sendToPeer(CPacket& packet)
+{
+   CGuard peerguard(m_PeerAddrLock);
+   m_pSndQueue->sendto(m_pPeerAddr, packet);
+}
+
+void CUDT::getPeerAddr(sockaddr* addr)
+{
+   CGuard peerguard(m_PeerAddrLock);
+   memcpy(addr, m_pPeerAddr, (AF_INET == m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+}
+
+int32_t CUDT::computeCookie(const sockaddr* addr, const int64_t& timestamp) const
+{
+   // a keyed hash over the binary address and time slot, cheap enough to answer request floods
+   int32_t input[7];
+   memset(input, 0, sizeof(input));
+   CIPAddress::ntop(addr, (uint32_t*)input, m_iIPversion);
+   input[4] = (AF_INET == m_iIPversion) ? ((sockaddr_in*)addr)->sin_port : ((sockaddr_in6*)addr)->sin6_port;
+   input[5] = (int32_t)timestamp;
+   input[6] = (int32_t)(timestamp >> 32);
+
+   return (int32_t)CSipHash::compute((const unsigned char*)m_piCookieKey, input, sizeof(input));
+}
+
+int32_t CUDT::signTicket(const sockaddr* addr, const int32_t& expiry) const
+{
+   // the ticket is bound to the client host only, a reconnect usually comes from a new port
+   int32_t input[5];
+   memset(input, 0, sizeof(input));
+   CIPAddress::ntop(addr, (uint32_t*)input, m_iIPversion);
+   input[4] = expiry;
+
+   return (int32_t)CSipHash::compute((const unsigned char*)m_piTicketKey, input, sizeof(input));
+}
+
+bool CUDT::checkTicket(const sockaddr* addr, const CHandShake& hs)
+{
+   // the connection it resumes challenges the peer with the token, see connect(peer, hs)
+   if ((0 == hs.m_iTicketTime) || (0 == hs.m_iToken))
+      return false;
+
+   // expired, or issued by an earlier listener with a longer running clock
+   int32_t now = (int32_t)((CTimer::getTime() - m_StartTime) / 1000000);
+   if ((hs.m_iTicketTime < now) || (hs.m_iTicketTime > now + m_iTicketLifetime))
+      return false;
+
+   if (hs.m_iTicket != signTicket(addr, hs.m_iTicketTime))
+      return false;
+
+   // the set is ordered by expiry, the expired tickets are at its front and can no longer be presented anyway
+   while (!m_sUsedTickets.empty() && ((int32_t)(*m_sUsedTickets.begin() >> 32) < now))
+      m_sUsedTickets.erase(m_sUsedTickets.begin());
+
+   // tickets are single use, a replayed one, or any once too many are remembered, costs the cookie round trip
+   if ((int)m_sUsedTickets.size() >= m_iMaxUsedTickets)
+      return false;
+   return m_sUsedTickets.insert(((int64_t)hs.m_iTicketTime << 32) | (uint32_t)hs.m_iTicket).second;
+}
+
+void CUDT::issueTicket(const sockaddr* addr, CHandShake& hs) const
+{
+   hs.m_iTicketTime = (int32_t)((CTimer::getTime() - m_StartTime) / 1000000) + m_iTicketLifetime;
+   hs.m_iTicket = signTicket(addr, hs.m_iTicketTime);
+}
+
+void CUDT::setEarlyData(const char* data, const int& size)
+{
+   delete [] m_pcEarlyData;
+   m_pcEarlyData = NULL;
+   m_iEarlyDataSize = 0;
+
+   if (size <= 0)
+      return;
+
+   m_pcEarlyData = new char [size];
+   memcpy(m_pcEarlyData, data, size);
+   m_iEarlyDataSize = size;
+}
+
+void CUDT::initBufLimits()
+{
+   CGuard tuneguard(m_TuneLock);
+
+   if (!m_bAutoTune)
+   {
+      m_iSndBufLimit = m_iSndBufSize;
+      m_iRcvBufLimit = m_iRcvBufSize;
+      return;
+   }
+
+   // both buffers start small, the first ACKs tell how much the path needs
+   m_iSndBufLimit = retuneLimit(0, (m_iInitBufLimit < m_iSndBufSize) ? m_iInitBufLimit : m_iSndBufSize, m_iMinBufLimit);
+   m_iRcvBufLimit = retuneLimit(0, (m_iInitBufLimit < m_iRcvBufSize) ? m_iInitBufLimit : m_iRcvBufSize, m_iMinBufLimit);
+}
+
+void CUDT::releaseBufLimits()
+{
+   CGuard tuneguard(m_TuneLock);
+
+   if (m_bAutoTune)
+      s_UDTUnited.m_BufferBudget.release(m_iSndBufLimit + m_iRcvBufLimit, m_iPayloadSize);
+
+   m_iSndBufLimit = 0;
+   m_iRcvBufLimit = 0;
+}
+
+void CUDT::tuneSndBuffer()
+{
+   if (!m_bAutoTune)
+      return;
+
+   uint64_t currtime;
+   CTimer::rdtsc(currtime);
+   if (currtime - m_ullSndTuneTime < m_ullSYNInt)
+      return;
+   m_ullSndTuneTime = currtime;
+
+   // the path holds a bandwidth-delay product, or a congestion window if that is larger; the buffer keeps
+   // as much again for the application to queue ahead of the sending thread
+   int64_t bandwidth = m_iBandwidth;
+   if ((m_llMaxBW > 0) && (bandwidth > m_llMaxBW / m_iSndPayloadSize))
+      bandwidth = m_llMaxBW / m_iSndPayloadSize;
+   int64_t target = bandwidth * (m_iRTT + m_iSYNInterval) / 1000000;
+
+   double cwnd = m_dCongestionWindow;
+   for (int i = 0; i < getPathCount(); ++ i)
+      cwnd += m_pPath[i]->m_dCongestionWindow;
+   if (target < cwnd)
+      target = int64_t(cwnd);
+
+   target *= 2;
+   if (target < m_iSndBufFloor)
+      target = m_iSndBufFloor;
+   if (target < m_iMinBufLimit)
+      target = m_iMinBufLimit;
+   if (target > m_iSndBufSize)
+      target = m_iSndBufSize;
+
+   CGuard tuneguard(m_TuneLock);
+
+   // the budget share has been given back already
+   if (m_bClosing)
+      return;
+
+   m_iSndBufLimit = retuneLimit(m_iSndBufLimit, int(target), m_iMinBufLimit);
+}
+
+void CUDT::tuneRcvBuffer(const int& bandwidth)
+{
+   if (!m_bAutoTune)
+      return;
+
+   // the peer may have a bandwidth-delay product in flight, the margin covers the swings of the estimate
+   // and the data that waits for the application
+   int64_t target = 2 * int64_t(bandwidth) * (m_iRTT + m_iSYNInterval) / 1000000;
+   if (target < m_iMinBufLimit)
+      target = m_iMinBufLimit;
+   if (target > m_iRcvBufSize)
+      target = m_iRcvBufSize;
+
+   CGuard tuneguard(m_TuneLock);
+
+   if (m_bClosing)
+      return;
+
+   m_iRcvBufLimit = retuneLimit(m_iRcvBufLimit, int(target), m_iMinBufLimit);
+}
+
+int CUDT::retuneLimit(const int limit, const int target, const int minimum)
+{
+   if (target > limit)
+   {
+      // up to the minimum, the growth is granted even when the budget is used up
+      int floor = minimum - limit;
+      if (floor > target - limit)
+         floor = target - limit;
+      if (floor < 0)
+         floor = 0;
+
+      return limit + s_UDTUnited.m_BufferBudget.acquire(target - limit, m_iPayloadSize, floor);
+   }
+
+   // a limit comes down only when the target is well below it, so that it does not follow every swing of the estimates
+   if (target * 2 <= limit)
+   {
+      s_UDTUnited.m_BufferBudget.release(limit - target, m_iPayloadSize);
+      return target;
+   }
+
+   return limit;
+}
+
+void CUDT::initPMTU()
+{
+   m_iPMTU = m_iMSS;
+   m_iSndPayloadSize = (NULL != m_pFECEncoder) ? CFECEncoder::dataSize(m_iPayloadSize) : m_iPayloadSize;
+   m_iPMTULow = m_iPMTUHigh = m_iMSS;
+   m_iPMTUProbeSize = 0;
+   m_iPMTUProbeNo = 0;
+   m_iPMTUProbeLoss = 0;
+   m_iPMTUStallAck = m_iSndLastAck;
+   m_iPMTUStallCount = 0;
+
+   // parity packets are as large as the largest packet of their group, a connection that sends them keeps its size
+   if (!m_bPMTUD || (NULL != m_pFECEncoder) || (m_iMSS <= m_iPMTUBase))
+      return;
+
+   // start with what every path is expected to carry, the first probe tries the largest size right away
+   m_iPMTULow = m_iPMTUBase;
+   setPMTU(m_iPMTUBase);
+   CTimer::rdtsc(m_ullPMTUProbeTime);
+}
+
+void CUDT::probePMTU(const uint64_t& currtime)
+{
+   if ((m_iMSS <= m_iPMTUBase) || (NULL != m_pFECEncoder) || (currtime < m_ullPMTUProbeTime))
+      return;
+
+   if (0 != m_iPMTUProbeSize)
+   {
+      // a probe may be lost by chance like any other packet, a size is given up after a few of them
+      if (++ m_iPMTUProbeLoss >= m_iPMTUMaxProbes)
+      {
+         m_iPMTUHigh = m_iPMTUProbeSize - 1;
+         m_iPMTUProbeLoss = 0;
+      }
+      m_iPMTUProbeSize = 0;
+   }
+
+   uint64_t raise = uint64_t(m_iPMTURaiseInterval) * 1000000 * m_ullCPUFrequency;
+
+   // the additional paths go over other links, a connection that has any of them stays at the base size
+   if (getPathCount() > 0)
+   {
+      if (m_iPMTU > m_iPMTUBase)
+         setPMTU(m_iPMTUBase);
+      m_iPMTULow = m_iPMTUBase;
+      m_iPMTUHigh = m_iMSS;
+      m_ullPMTUProbeTime = currtime + raise;
+      return;
+   }
+
+   if (m_iPMTUHigh - m_iPMTULow < m_iPMTUResolution)
+   {
+      // close enough, the route may change and carry larger packets later
+      m_iPMTUHigh = m_iMSS;
+      m_ullPMTUProbeTime = currtime + raise;
+      return;
+   }
+
+   // try the largest size first and then a jumbo frame, which settles loopback and most LANs in one or two probes;
+   // a size that failed lowers the upper bound below it, so each of them is tried once per search
+   int32_t probe[2];
+   probe[0] = 0;
+   if (m_iPMTUHigh == m_iMSS)
+      probe[1] = m_iMSS;
+   else if ((m_iPMTULow < 9000) && (m_iPMTUHigh >= 9000))
+      probe[1] = 9000;
+   else
+      probe[1] = (m_iPMTULow + m_iPMTUHigh + 1) / 2;
+
+   m_iPMTUProbeSize = probe[1];
+   ++ m_iPMTUProbeNo;
+   sendCtrl(12, &m_iPMTUProbeNo, probe);
+
+   m_ullPMTUProbeTime = currtime + (m_iRTT + 4 * m_iRTTVar + m_iSYNInterval) * m_ullCPUFrequency;
+}
+
+void CUDT::setPMTU(const int& size)
+{
+   // packets already in the sender buffer keep their size, also when they are sent again
+   m_iPMTU = size;
+   m_iSndPayloadSize = size - 28 - CPacket::m_iPktHdrSize;
+   m_pSndBuffer->setPayloadSize(m_iSndPayloadSize);
+   m_pCC->setMSS(size);
+}
+
 void CUDT::addEPoll(const int eid)
 {
    CGuard::enterCS(s_UDTUnited.m_EPoll.m_EPollLock);
@@ -2524,7 +4355,7 @@ void CUDT::addEPoll(const int eid)
    else if ((UDT_DGRAM == m_iSockType) && (m_pRcvBuffer->getRcvMsgNum() > 0))
       s_UDTUnited.m_EPoll.enable_read(m_SocketID, m_sPollID);
 
-   if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
+   if (m_iSndBufLimit > m_pSndBuffer->getCurrBufSize())
       s_UDTUnited.m_EPoll.enable_write(m_SocketID, m_sPollID);
 }
 
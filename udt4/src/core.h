@@ -52,10 +52,29 @@ written by
 #include "api.h"
 #include "ccc.h"
 #include "cache.h"
+#include "fec.h"
 #include "queue.h"
 
 enum UDTSockType {UDT_STREAM = 1, UDT_DGRAM};
 
+struct CPath
+{
+   int m_iMuxID;                                // multiplexer of the path, bound to its own local address
+   CSndQueue* m_pSndQueue;                      // sending queue of the path
+   sockaddr* m_pPeerAddr;                       // peer address the path sends to
+   CSNode* m_pSNode;                            // node of the path in its sending queue
+
+   CCC* m_pCC;                                  // congestion control of the path
+   volatile uint64_t m_ullInterval;             // inter-packet time on the path, in CPU clock cycles
+   volatile double m_dCongestionWindow;         // congestion window size of the path
+   uint64_t m_ullTargetTime;                    // target time of next packet sending on the path
+   uint64_t m_ullTimeDiff;                      // aggregate difference in inter-packet time
+
+   volatile bool m_bActive;                     // if the peer has accepted the path
+   int m_iJoinCount;                            // number of join requests sent
+   uint64_t m_ullNextJoinTime;                  // time to repeat the join request, in CPU clock cycles
+};
+
 class CUDT
 {
 friend class CUDTSocket;
@@ -67,6 +86,7 @@ friend class CSndQueue;
 friend class CRcvQueue;
 friend class CSndUList;
 friend class CRcvUList;
+friend class CAsyncIO;
 
 private: // constructor and desctructor
    CUDT();
@@ -90,10 +110,16 @@ public: //API
    static int setsockopt(UDTSOCKET u, int level, UDTOpt optname, const void* optval, int optlen);
    static int send(UDTSOCKET u, const char* buf, int len, int flags);
    static int recv(UDTSOCKET u, char* buf, int len, int flags);
+   static int sendv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags);
+   static int recvv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags);
    static int sendmsg(UDTSOCKET u, const char* buf, int len, int ttl = -1, bool inorder = false);
    static int recvmsg(UDTSOCKET u, char* buf, int len);
    static int64_t sendfile(UDTSOCKET u, std::fstream& ifs, int64_t& offset, const int64_t& size, const int& block = 364000);
    static int64_t recvfile(UDTSOCKET u, std::fstream& ofs, int64_t& offset, const int64_t& size, const int& block = 7280000);
+   static int async_send(UDTSOCKET u, const char* buf, int len, UDT_ASYNC_HANDLER handler, void* context);
+   static int async_recv(UDTSOCKET u, char* buf, int len, UDT_ASYNC_HANDLER handler, void* context);
+   static int async_sendfile(UDTSOCKET u, std::fstream& ifs, int64_t offset, int64_t size, UDT_ASYNC_HANDLER handler, void* context, int block = 364000);
+   static int async_recvfile(UDTSOCKET u, std::fstream& ofs, int64_t offset, int64_t size, UDT_ASYNC_HANDLER handler, void* context, int block = 7280000);
    static int select(int nfds, ud_set* readfds, ud_set* writefds, ud_set* exceptfds, const timeval* timeout);
    static int selectEx(const std::vector<UDTSOCKET>& fds, std::vector<UDTSOCKET>* readfds, std::vector<UDTSOCKET>* writefds, std::vector<UDTSOCKET>* exceptfds, int64_t msTimeOut);
    static int epoll_create();
@@ -105,6 +131,11 @@ public: //API
    static int epoll_release(const int eid);
    static CUDTException& getlasterror();
    static int perfmon(UDTSOCKET u, CPerfMon* perf, bool clear = true);
+   static int perfstats(UDTSOCKET u, CPerfStats* stats);
+   static int tracedump(UDTSOCKET u, const char* path);
+   static int setcachefile(const char* path, const int& maxage);
+   static int setbufferbudget(const int64_t& bytes);
+   static int addpath(UDTSOCKET u, const sockaddr* name, int namelen, const sockaddr* peer = NULL, int peerlen = 0);
 
 public: // internal API
    static CUDT* getUDTHandle(UDTSOCKET u);
@@ -175,6 +206,26 @@ private:
 
    int recv(char* data, const int& len);
 
+      // Functionality:
+      //    Request UDT to send the memory blocks of a vector as one contiguous block of data.
+      // Parameters:
+      //    0) [in] iov: the blocks to be sent, in order.
+      //    1) [in] iovcnt: number of blocks in the vector.
+      // Returned value:
+      //    Actual size of data sent.
+
+   int sendv(const iovec* iov, const int& iovcnt);
+
+      // Functionality:
+      //    Request UDT to receive data and scatter it over the memory blocks of a vector, in order.
+      // Parameters:
+      //    0) [in] iov: the blocks to receive the data into.
+      //    1) [in] iovcnt: number of blocks in the vector.
+      // Returned value:
+      //    Actual size of data received.
+
+   int recvv(const iovec* iov, const int& iovcnt);
+
       // Functionality:
       //    send a message of a memory block "data" with size of "len".
       // Parameters:
@@ -221,6 +272,50 @@ private:
 
    int64_t recvfile(std::fstream& ofs, int64_t& offset, const int64_t& size, const int& block = 7320000);
 
+      // Functionality:
+      //    Send as much of a data block as the sending buffer takes, never blocks.
+      // Parameters:
+      //    0) [in] data: The address of the application data to be sent.
+      //    1) [in] len: The size of the data block.
+      // Returned value:
+      //    Actual size of data sent, 0 if the buffer is full.
+
+   int trySend(const char* data, const int& len);
+
+      // Functionality:
+      //    Receive the data that has arrived, never blocks.
+      // Parameters:
+      //    0) [out] data: data received.
+      //    1) [in] len: The desired size of data to be received.
+      // Returned value:
+      //    Actual size of data received, 0 if there is none.
+
+   int tryRecv(char* data, const int& len);
+
+      // Functionality:
+      //    Send as much of a file as the sending buffer takes, never blocks.
+      // Parameters:
+      //    0) [in] ifs: The input file stream.
+      //    1) [in, out] offset: From where to read and send data; output is the new offset when the call returns.
+      //    2) [in] size: How many data to be sent.
+      //    3) [in] block: size of block per read from disk
+      // Returned value:
+      //    Actual size of data sent, 0 if the buffer is full.
+
+   int64_t trySendFile(std::fstream& ifs, int64_t& offset, const int64_t& size, const int& block);
+
+      // Functionality:
+      //    Write the data that has arrived into a file, never blocks.
+      // Parameters:
+      //    0) [out] ofs: The output file stream.
+      //    1) [in, out] offset: From where to write data; output is the new offset when the call returns.
+      //    2) [in] size: How many data to be received.
+      //    3) [in] block: size of block per write to disk
+      // Returned value:
+      //    Actual size of data received, 0 if there is none.
+
+   int64_t tryRecvFile(std::fstream& ofs, int64_t& offset, const int64_t& size, const int& block);
+
       // Functionality:
       //    Configure UDT options.
       // Parameters:
@@ -253,6 +348,26 @@ private:
 
    void sample(CPerfMon* perf, bool clear = true);
 
+      // Functionality:
+      //    read the cumulative statistics and latency histograms; never clears anything.
+      // Parameters:
+      //    0) [out] stats: pointer to a CPerfStats structure to record the statistics.
+      // Returned value:
+      //    None.
+
+   void sample(CPerfStats* stats);
+
+      // Functionality:
+      //    Add a path to a connected socket, the peer accepts it after a join handshake.
+      // Parameters:
+      //    0) [in] mux: ID of the multiplexer bound to the local address of the path.
+      //    1) [in] sndqueue: sending queue of that multiplexer.
+      //    2) [in] peer: peer address the path sends to.
+      // Returned value:
+      //    None.
+
+   void addPath(const int& mux, CSndQueue* sndqueue, const sockaddr* peer);
+
 private:
    static CUDTUnited s_UDTUnited;               // UDT global management base
 
@@ -286,12 +401,22 @@ private: // Options
    int m_iRcvTimeOut;                           // receiving timeout in milliseconds
    bool m_bReuseAddr;				// reuse an exiting port or not, for UDP multiplexer
    int64_t m_llMaxBW;				// maximum data transfer rate (threshold)
+   bool m_bFEC;                                 // send FEC parity packets, if the peer supports them
+   bool m_bAutoTune;                            // size the buffers after the bandwidth-delay product, see UDT_AUTOTUNE
+   bool m_bPMTUD;                               // probe for the largest packet size the path carries, see UDT_PMTUD
 
 private: // congestion control
    CCCVirtualFactory* m_pCCFactory;             // Factory class to create a specific CC instance
    CCC* m_pCC;                                  // congestion control class
+   CCCVirtualFactory* m_pPendingCCFactory;      // controller to switch to at the next timer check, set on a connected socket
+   std::vector<CCC*> m_vRetiredCC;              // replaced controllers, the sending thread may still be inside one
+   std::vector<CCCVirtualFactory*> m_vRetiredCCFactory; // replaced factories of a listener, a connection being accepted may still clone one
    CCache* m_pCache;				// network information cache
 
+   void switchCC();
+   CCC* createCC(CCCVirtualFactory* factory, const CCC* current);
+   void seedFromCache(const CInfoBlock& ib);
+
 private: // Status
    volatile bool m_bListening;                  // If the UDT entit is listening to connection
    volatile bool m_bConnected;                  // Whether the connection is on or off
@@ -307,6 +432,8 @@ private: // Status
    int m_iRTT;                                  // RTT
    int m_iRTTVar;                               // RTT variance
    int m_iDeliveryRate;				// Packet arrival rate at the receiver side
+   bool m_bAdaptiveACK;                         // if both sides agreed on adaptive ACK frequency in the handshake
+   bool m_bCompactNAK;                          // if both sides agreed on bitmap encoded, coalesced loss reports
 
 private: // Sending related data
    CSndBuffer* m_pSndBuffer;                    // Sender buffer
@@ -325,6 +452,11 @@ private: // Sending related data
    int32_t m_iLastDecSeq;                       // Sequence number sent last decrease occurs
    int32_t m_iSndLastAck2;                      // Last ACK2 sent back
    uint64_t m_ullSndLastAck2Time;               // The time when last ACK2 was sent back
+   int32_t m_iPendingACK;                       // newest ACK of the current burst, applied to the sender buffer by flushACK()
+   bool m_bACKPending;                          // if m_iPendingACK has not been applied yet
+   CFECEncoder* m_pFECEncoder;                  // parity of the new data packets, NULL if no parity is sent
+   int64_t m_llFECLastSent;                     // m_llSentTotal at the last parity group size update
+   int64_t m_llFECLastLoss;                     // m_llSndLossTotal at the last group size update
 
    int32_t m_iISN;                              // Initial Sequence Number
 
@@ -339,6 +471,13 @@ private: // Receiving related data
    int32_t m_iRcvLastAckAck;                    // Last sent ACK that has been acknowledged
    int32_t m_iAckSeqNo;                         // Last ACK sequence number
    int32_t m_iRcvCurrSeqNo;                     // Largest received sequence number
+   int32_t m_iRcvMinDelay;                      // smallest one-way delay (arrival time - packet timestamp) since the last full ACK
+   bool m_bRcvDelaySampled;                     // if m_iRcvMinDelay holds a sample
+   int m_iNAKCount;                             // loss reports sent in the current RTT, with compact loss reports
+   uint64_t m_ullNAKWindowEnd;                  // end of the current RTT for m_iNAKCount, in CPU clock cycles
+   int32_t m_iNAKPendingSeq;                    // first loss detected but not reported because of the limit, or -1
+   CFECDecoder* m_pFECDecoder;                  // rebuilds lost packets from the peer's parity, NULL if the peer sends none
+   int m_iPeerPayloadSize;                      // payload of a full data packet from the peer
 
    uint64_t m_ullLastWarningTime;               // Last time that a warning message is sent
 
@@ -362,45 +501,77 @@ private: // synchronization: mutexes and conditions
    void destroySynch();
    void releaseSynch();
 
+   int addSendData(const iovec* iov, const int& iovcnt, const int& len);
+
 private: // Generation and processing of packets
    void sendCtrl(const int& pkttype, void* lparam = NULL, void* rparam = NULL, const int& size = 0);
+   void sendToPeer(CPacket& packet);
+   void getPeerAddr(sockaddr* addr);
    void processCtrl(CPacket& ctrlpkt);
-   int packData(CPacket& packet, uint64_t& ts);
+   void flushACK();
+   bool allowNAK();
+   void reportLoss(const int32_t& from, const int32_t& to);
+   void reportMissing(const int32_t* missing, const int& num);
+   int packParity(CPacket& packet);
+   int packData(CPacket& packet, uint64_t& ts, const int& path = 0);
    int processData(CUnit* unit);
    int listen(sockaddr* addr, CPacket& packet);
 
 private: // Trace
+   // The cumulative counters below are only ever advanced with CAtomic::add() and never reset, so
+   // sample() reads them without taking any lock the data path uses. They are grouped by the thread
+   // that usually updates them, with a cache line of padding between groups, so that polling the
+   // statistics and the sending/receiving threads do not keep stealing the same lines.
+
    uint64_t m_StartTime;                        // timestamp when the UDT entity is started
-   int64_t m_llSentTotal;                       // total number of sent data packets, including retransmissions
-   int64_t m_llRecvTotal;                       // total number of received packets
-   int64_t m_FileBytesRecvd;					// total file bytes received ADDED BY ZAC MORRIS
-   int m_iSndLossTotal;                         // total number of lost packets (sender side)
-   int m_iRcvLossTotal;                         // total number of lost packets (receiver side)
-   int m_iRetransTotal;                         // total number of retransmitted packets
-   int m_iSentACKTotal;                         // total number of sent ACK packets
-   int m_iRecvACKTotal;                         // total number of received ACK packets
-   int m_iSentNAKTotal;                         // total number of sent NAK packets
-   int m_iRecvNAKTotal;                         // total number of received NAK packets
-   int64_t m_llSndDurationTotal;		// total real time for sending
 
+   char m_acSndStatsPad[UDT_CACHE_LINE];
+   volatile int64_t m_llSentTotal;              // total number of sent data packets, including retransmissions
+   volatile int64_t m_llRetransTotal;           // total number of retransmitted packets
+   volatile int64_t m_llSndParityTotal;         // total number of sent FEC parity packets
+   volatile int64_t m_llSentBytesTotal;         // total payload of the sent data packets, including retransmissions
+   uint64_t m_ullLastPktSendTime;               // time the previous data packet was packed, in CPU ticks
+
+   char m_acRcvStatsPad[UDT_CACHE_LINE];
+   volatile int64_t m_llRecvTotal;              // total number of received packets
+   volatile int64_t m_llRecvBytesTotal;         // total payload of the received data packets
+   volatile int64_t m_llSndLossTotal;           // total number of lost packets (sender side)
+   volatile int64_t m_llRcvLossTotal;           // total number of lost packets (receiver side)
+   volatile int64_t m_llSentACKTotal;           // total number of sent ACK packets
+   volatile int64_t m_llRecvACKTotal;           // total number of received ACK packets
+   volatile int64_t m_llSentNAKTotal;           // total number of sent NAK packets
+   volatile int64_t m_llRecvNAKTotal;           // total number of received NAK packets
+   volatile int64_t m_llRcvRecoveredTotal;      // total number of lost packets rebuilt from FEC parity
+   volatile int64_t m_llSndDurationTotal;       // total real time for sending
+   uint64_t m_ullLastAckSentTime;               // time the latest ACK was sent, in microseconds
+
+   char m_acAppStatsPad[UDT_CACHE_LINE];
+   volatile int64_t m_FileBytesRecvd;           // total file bytes received ADDED BY ZAC MORRIS
+   int64_t m_llSndDurationCounter;              // timers to record the sending duration
+
+   char m_acHistPad[UDT_CACHE_LINE];
+   CHistogram m_RTTHist;                        // RTT samples, in microseconds
+   char m_acRTTHistPad[UDT_CACHE_LINE];
+   CHistogram m_SndIntervalHist;                // time between consecutive data packets, in microseconds
+   char m_acSndIntervalHistPad[UDT_CACHE_LINE];
+   CHistogram m_AckNakHist;                     // time from the latest ACK to each NAK, in microseconds
+   char m_acAckNakHistPad[UDT_CACHE_LINE];
+
+   // the legacy local measurements are the difference to the totals saved by the last clearing sample()
+   pthread_mutex_t m_StatsLock;                 // serializes readers of m_LastSample, never taken by the data path
    uint64_t m_LastSampleTime;                   // last performance sample time
-   int64_t m_llTraceSent;                       // number of pakctes sent in the last trace interval
-   int64_t m_llTraceRecv;                       // number of pakctes received in the last trace interval
-   int m_iTraceSndLoss;                         // number of lost packets in the last trace interval (sender side)
-   int m_iTraceRcvLoss;                         // number of lost packets in the last trace interval (receiver side)
-   int m_iTraceRetrans;                         // number of retransmitted packets in the last trace interval
-   int m_iSentACK;                              // number of ACKs sent in the last trace interval
-   int m_iRecvACK;                              // number of ACKs received in the last trace interval
-   int m_iSentNAK;                              // number of NAKs sent in the last trace interval
-   int m_iRecvNAK;                              // number of NAKs received in the last trace interval
-   int64_t m_llSndDuration;			// real time for sending
-   int64_t m_llSndDurationCounter;		// timers to record the sending duration
+   CPerfMon m_LastSample;                       // totals at the last clearing sample() call
+
+   CTraceRing m_Trace;                          // packet and congestion control event trace, see UDT_TRACE
 
 private: // Timers
    uint64_t m_ullCPUFrequency;                  // CPU clock frequency, used for Timer
 
    static const int m_iSYNInterval;             // Periodical Rate Control Interval, 10 ms
    static const int m_iSelfClockInterval;       // ACK interval for self-clocking
+   static const int m_iLightACKPeriod;          // minimum time between adaptive light ACKs, 1 ms
+   static const int m_iLightACKsPerRTT;         // adaptive light ACKs sent per RTT
+   static const int m_iMaxNAKsPerRTT;           // loss reports sent per RTT on new losses, with compact loss reports
 
    uint64_t m_ullNextACKTime;			// Next ACK time, in CPU clock cycles
    uint64_t m_ullNextNAKTime;			// Next NAK time
@@ -416,6 +587,7 @@ private: // Timers
 
    int m_iPktCount;				// packet counter for ACK
    int m_iLightACKCount;			// light ACK counter
+   int m_iLightACKInterval;			// packets between light ACKs, m_iSelfClockInterval unless adaptive
 
    uint64_t m_ullTargetTime;			// target time of next packet sending
 
@@ -429,6 +601,113 @@ private: // for UDP multiplexer
    CSNode* m_pSNode;				// node information for UDT list used in snd queue
    CRNode* m_pRNode;                            // node information for UDT list used in rcv queue
 
+private: // for multipath
+   CPath** m_pPath;                             // additional paths, path i (from 1) is m_pPath[i - 1]
+   volatile int m_iPathCount;                   // number of additional paths, published after the path; read it with getPathCount()
+   unsigned char* m_pcSeqPath;                  // path each packet was last sent on, indexed by seq. no. % m_iFlightFlagSize
+   int m_iProbePath;                            // path that sent the first packet of the latest probing pair
+   std::vector<sockaddr*> m_vPathPeerAddr;      // peer addresses that have joined the connection, receiver side
+   pthread_mutex_t m_PackLock;                  // serializes packData(), every path sends from its own queue
+
+   static const int m_iMaxPathCount;            // maximum number of additional paths
+   static const int m_iJoinInterval;            // time between join requests, 250 ms
+   static const int m_iMaxJoinCount;            // join requests sent before a path is given up
+
+      // Functionality:
+      //    Read the number of additional paths, so that m_pPath[] below it is seen as addPath() left it.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    number of additional paths.
+
+   inline int getPathCount() const
+   {
+      int count = m_iPathCount;
+      CAtomic::acquireFence();
+      return count;
+   }
+
+   void sendJoin(const int& path);
+   bool acceptPath(const sockaddr* addr, const CPacket& packet);
+   static int32_t computeJoinMAC(const int32_t& token, const int32_t& isn, const int32_t& id, const int32_t& path);
+   void splitLoss(const int32_t* ranges, const int& num);
+   void updatePaths();
+   int getActivePathCount() const;
+   void updateSndList(const bool& reschedule = true);
+
+private: // for connection migration
+   int32_t m_iToken;                            // token the peer presents to move the connection to a new address, 0 if not supported
+   int32_t m_iPeerToken;                        // token presented to the peer, 0 if the peer does not support migration
+   sockaddr* m_pMigrationAddr;                  // new peer address under validation, NULL until the peer first announces one
+   int32_t m_iChallenge;                        // challenge sent to m_pMigrationAddr, 0 once answered
+   uint64_t m_ullChallengeTime;                 // time the challenge was sent, in CPU clock cycles
+   pthread_mutex_t m_PeerAddrLock;              // held while m_pPeerAddr is rewritten, and by the threads sending to it
+
+   static const int m_iChallengeInterval;       // minimum time between two challenges, 100 ms
+
+   int32_t createToken();
+   bool acceptMigration(const sockaddr* addr, const CPacket& packet);
+
+private: // for connection requests
+   int32_t m_piCookieKey[4];                    // listener side, secret the SYN cookies are keyed with
+
+   int32_t computeCookie(const sockaddr* addr, const int64_t& timestamp) const;
+
+private: // for resumption
+   int32_t m_piTicket[2];                       // ticket issued by the listener, expiry and signature, 0s if none
+   int32_t m_piTicketKey[4];                    // listener side, secret the tickets are signed with
+   char* m_pcEarlyData;                         // data sent with the connection request, see UDT_EARLYDATA
+   int m_iEarlyDataSize;                        // size of m_pcEarlyData
+   std::set<int64_t> m_sUsedTickets;            // listener side, tickets accepted and not expired yet, expiry << 32 | signature
+   int32_t m_iResumeChallenge;                  // connection accepted on a ticket, sends no data until the peer echoes this, 0 once it has
+
+   static const int m_iTicketLifetime;          // time a ticket can be used for, 24 hours, in seconds
+   static const int m_iMaxEarlyDataSize;        // maximum data sent with the connection request, 256 bytes
+   static const int m_iMaxUsedTickets;          // tickets remembered at most, further ones are not accepted until some expire
+
+   int32_t signTicket(const sockaddr* addr, const int32_t& expiry) const;
+   bool checkTicket(const sockaddr* addr, const CHandShake& hs);
+   void issueTicket(const sockaddr* addr, CHandShake& hs) const;
+   void setEarlyData(const char* data, const int& size);
+
+private: // for buffer autotuning
+   volatile int m_iSndBufLimit;                 // packets the sender buffer may hold now, m_iSndBufSize unless autotuned
+   volatile int m_iRcvBufLimit;                 // packets the peer may have outstanding in the receiver buffer now
+   pthread_mutex_t m_TuneLock;                  // serializes changes of the limits and the share of the budget they hold
+   int m_iSndBufFloor;                          // packets of the largest message sent, the sender limit keeps room for it
+   uint64_t m_ullSndTuneTime;                   // time the sender limit was last set, in CPU clock cycles
+
+   static const int m_iInitBufLimit;            // limit an autotuned buffer starts with, 256 packets
+   static const int m_iMinBufLimit;             // the budget cannot take a buffer below this, 32 packets
+
+   void initBufLimits();
+   void releaseBufLimits();
+   void tuneSndBuffer();
+   void tuneRcvBuffer(const int& bandwidth);
+   int retuneLimit(const int limit, const int target, const int minimum);
+
+private: // for path MTU discovery
+   volatile int m_iSndPayloadSize;              // payload of the data packets sent now, at most m_iPayloadSize
+   int m_iPMTU;                                 // packet size the data is sent in, m_iMSS unless probed
+   int m_iPMTULow;                              // largest packet size the path is known to carry
+   int m_iPMTUHigh;                             // largest packet size that is not known to be lost
+   int m_iPMTUProbeSize;                        // packet size of the probe on the way, 0 if there is none
+   int32_t m_iPMTUProbeNo;                      // number of the last probe, the reply carries it back
+   int m_iPMTUProbeLoss;                        // probes of the current size that were lost in a row
+   uint64_t m_ullPMTUProbeTime;                 // time the probe is given up or the next search starts, in CPU clock cycles
+   int32_t m_iPMTUStallAck;                     // last acknowledged sequence number at the previous expiration
+   int m_iPMTUStallCount;                       // expirations in a row that did not see the acknowledgement move
+
+   static const int m_iPMTUBase;                // packet size every path is expected to carry, 1500 bytes
+   static const int m_iPMTUMaxProbes;           // lost probes before a size is given up, 3
+   static const int m_iPMTUResolution;          // the search stops when the bounds are this close, 64 bytes
+   static const int m_iPMTURaiseInterval;       // seconds before a finished search looks for a larger size again, 600
+   static const int m_iPMTUBlackHoleCount;      // expirations without progress that fall back to the base size, 3
+
+   void initPMTU();
+   void probePMTU(const uint64_t& currtime);
+   void setPMTU(const int& size);
+
 private: // for epoll
    std::set<int> m_sPollID;                     // set of epoll ID to trigger
    void addEPoll(const int eid);
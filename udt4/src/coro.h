@@ -0,0 +1,253 @@
+/*****************************************************************************
+Copyright (c) 2001 - 2009, The Board of Trustees of the University of Illinois.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the
+  above copyright notice, this list of conditions
+  and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the University of Illinois
+  nor the names of its contributors may be used to
+  endorse or promote products derived from this
+  software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*****************************************************************************/
+
+#ifndef __UDT_CORO_H__
+#define __UDT_CORO_H__
+
+// C++20 coroutine adapters over the asynchronous UDT calls (UDT::async_send() etc.), header only.
+//
+//    UDT::coro::executor ex(2);
+//
+//    UDT::coro::task stream(UDTSOCKET u, char* buf, int len, UDT::coro::executor& ex)
+//    {
+//       int64_t n = co_await UDT::coro::recv(u, buf, len, ex);
+//       co_await UDT::coro::send(u, buf, int(n), ex);
+//    }
+//
+// A suspended coroutine holds no thread. When its operation completes, the UDT worker thread posts it
+// to the executor, so thousands of streams can run on a few executor threads. co_await returns the
+// bytes transferred and throws UDT::ERRORINFO if the operation failed.
+
+#if defined(__cpp_impl_coroutine) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 202002L))
+
+#include <coroutine>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "udt.h"
+
+namespace UDT
+{
+namespace coro
+{
+
+// a fixed pool of threads that resume coroutines
+class executor
+{
+public:
+   explicit executor(int threads = 1)
+   {
+      for (int i = 0; i < threads; ++ i)
+         m_vThreads.emplace_back([this] { run(); });
+   }
+
+   ~executor()
+   {
+      stop();
+   }
+
+   executor(const executor&) = delete;
+   executor& operator=(const executor&) = delete;
+
+      // Functionality:
+      //    Queue a coroutine to be resumed on one of the threads.
+      // Parameters:
+      //    0) [in] h: the suspended coroutine.
+      // Returned value:
+      //    None.
+
+   void post(std::coroutine_handle<> h)
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_Lock);
+         m_Ready.push_back(h);
+      }
+      m_Cond.notify_one();
+   }
+
+      // Functionality:
+      //    Resume the queued coroutines, then stop the threads.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void stop()
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_Lock);
+         m_bStopping = true;
+      }
+      m_Cond.notify_all();
+
+      for (std::thread& t : m_vThreads)
+      {
+         if (t.joinable())
+            t.join();
+      }
+      m_vThreads.clear();
+   }
+
+private:
+   void run()
+   {
+      std::unique_lock<std::mutex> lock(m_Lock);
+      while (true)
+      {
+         m_Cond.wait(lock, [this] { return !m_Ready.empty() || m_bStopping; });
+         if (m_Ready.empty())
+            return;
+
+         std::coroutine_handle<> h = m_Ready.front();
+         m_Ready.pop_front();
+
+         lock.unlock();
+         h.resume();
+         lock.lock();
+      }
+   }
+
+private:
+   std::mutex m_Lock;
+   std::condition_variable m_Cond;
+   std::deque<std::coroutine_handle<> > m_Ready;
+   bool m_bStopping = false;
+   std::vector<std::thread> m_vThreads;
+};
+
+// a coroutine that starts right away and frees itself when it finishes;
+// an exception escaping from it terminates the program, so catch UDT::ERRORINFO inside
+struct task
+{
+   struct promise_type
+   {
+      task get_return_object() {return task();}
+      std::suspend_never initial_suspend() noexcept {return std::suspend_never();}
+      std::suspend_never final_suspend() noexcept {return std::suspend_never();}
+      void return_void() {}
+      void unhandled_exception() {std::terminate();}
+   };
+};
+
+// awaits one asynchronous call; Start queues the call with the completion handler and context it is given
+template <typename Start>
+class operation
+{
+public:
+   operation(Start start, executor* ex): m_Start(start), m_pExecutor(ex) {}
+
+   bool await_ready() const noexcept {return false;}
+
+   bool await_suspend(std::coroutine_handle<> h)
+   {
+      m_Handle = h;
+
+      // once the call is queued, the handler may resume the coroutine on another thread at any time,
+      // so nothing of this object is touched after a successful call
+      if (UDT::ERROR != m_Start(&operation::complete, this))
+         return true;
+
+      m_llResult = -1;
+      m_Error = UDT::getlasterror();
+      return false;
+   }
+
+   int64_t await_resume()
+   {
+      if (m_llResult < 0)
+         throw m_Error;
+      return m_llResult;
+   }
+
+private:
+   static void complete(UDTSOCKET, int64_t result, const UDT::ERRORINFO* error, void* context)
+   {
+      operation* self = static_cast<operation*>(context);
+      self->m_llResult = result;
+      if (NULL != error)
+         self->m_Error = *error;
+
+      // the coroutine does not run on the UDT worker thread, which serves all the other sockets
+      self->m_pExecutor->post(self->m_Handle);
+   }
+
+private:
+   Start m_Start;
+   executor* m_pExecutor;
+   std::coroutine_handle<> m_Handle;
+   int64_t m_llResult = 0;
+   UDT::ERRORINFO m_Error;
+};
+
+template <typename Start>
+operation<Start> make_operation(Start start, executor* ex)
+{
+   return operation<Start>(start, ex);
+}
+
+   // co_await send(...) completes when the whole buffer is in the sending buffer
+inline auto send(UDTSOCKET u, const char* buf, int len, executor& ex)
+{
+   return make_operation([=](UDT::ASYNCHANDLER handler, void* context) {return UDT::async_send(u, buf, len, handler, context);}, &ex);
+}
+
+   // co_await recv(...) completes when some data has arrived
+inline auto recv(UDTSOCKET u, char* buf, int len, executor& ex)
+{
+   return make_operation([=](UDT::ASYNCHANDLER handler, void* context) {return UDT::async_recv(u, buf, len, handler, context);}, &ex);
+}
+
+inline auto sendfile(UDTSOCKET u, std::fstream& ifs, int64_t offset, int64_t size, executor& ex, int block = 364000)
+{
+   std::fstream* file = &ifs;
+   return make_operation([=](UDT::ASYNCHANDLER handler, void* context) {return UDT::async_sendfile(u, *file, offset, size, handler, context, block);}, &ex);
+}
+
+inline auto recvfile(UDTSOCKET u, std::fstream& ofs, int64_t offset, int64_t size, executor& ex, int block = 7280000)
+{
+   std::fstream* file = &ofs;
+   return make_operation([=](UDT::ASYNCHANDLER handler, void* context) {return UDT::async_recvfile(u, *file, offset, size, handler, context, block);}, &ex);
+}
+
+}
+}
+
+#endif
+
+#endif
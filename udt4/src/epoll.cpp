@@ -37,15 +37,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 written by
    Yunhong Gu, last updated 10/12/2010
 *****************************************************************************/
-
 #include "udt.h"
 #include "common.h"
 #include "epoll.h"
 #include <errno.h>
 #include <algorithm>
 #include <iterator>
+#include <vector>
 #ifdef LINUX
    #include <sys/epoll.h>
+   #include <sys/eventfd.h>
+   #include <poll.h>
    #include <unistd.h>
 #endif
 
@@ -67,11 +69,32 @@ int CEPoll::create()
    CGuard pg(m_EPollLock);
 
    int localid = 0;
+   int eventfd = -1;
 
    #ifdef LINUX
    localid = epoll_create(1024);
    if (localid < 0)
       throw CUDTException(-1, 0, errno);
+
+   // UDT sockets signal their events through this descriptor, so that wait() sleeps in the kernel for all of them
+   eventfd = ::eventfd(0, EFD_NONBLOCK);
+   if (eventfd < 0)
+   {
+      int err = errno;
+      ::close(localid);
+      throw CUDTException(-1, 0, err);
+   }
+
+   epoll_event ev;
+   ev.events = EPOLLIN;
+   ev.data.fd = eventfd;
+   if (epoll_ctl(localid, EPOLL_CTL_ADD, eventfd, &ev) < 0)
+   {
+      int err = errno;
+      ::close(eventfd);
+      ::close(localid);
+      throw CUDTException(-1, 0, err);
+   }
    #else
    // on BSD, use kqueue
    // on Solaris, use /dev/poll
@@ -84,21 +107,52 @@ int CEPoll::create()
    CEPollDesc desc;
    desc.m_iID = m_iIDSeed;
    desc.m_iLocalID = localid;
+   desc.m_iEventFD = eventfd;
+   desc.m_iWaiters = 0;
+   desc.m_bReleased = false;
    m_mPolls[desc.m_iID] = desc;
 
    return desc.m_iID;
 }
 
-int CEPoll::add_usock(const int eid, const UDTSOCKET& u, const int* /*events*/)
+int CEPoll::add_usock(const int eid, const UDTSOCKET& u, const int* events)
 {
    CGuard pg(m_EPollLock);
 
    map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-   if (p == m_mPolls.end())
+   if ((p == m_mPolls.end()) || p->second.m_bReleased)
       throw CUDTException(5, 13);
 
    p->second.m_sUDTSocks.insert(u);
 
+   if ((NULL == events) || (*events & UDT_EPOLL_IN))
+      p->second.m_sUDTSocksIn.insert(u);
+   if ((NULL == events) || (*events & UDT_EPOLL_OUT))
+      p->second.m_sUDTSocksOut.insert(u);
+
+   bool readable = (p->second.m_sUDTReads.find(u) != p->second.m_sUDTReads.end()) && (p->second.m_sUDTSocksIn.find(u) != p->second.m_sUDTSocksIn.end());
+   bool writable = (p->second.m_sUDTWrites.find(u) != p->second.m_sUDTWrites.end()) && (p->second.m_sUDTSocksOut.find(u) != p->second.m_sUDTSocksOut.end());
+
+   if ((NULL != events) && (*events & UDT_EPOLL_ET))
+   {
+      // the socket has already reported its state, which is the first edge; adding it again re-arms it
+      p->second.m_sUDTSocksEdge.insert(u);
+      if (readable)
+         p->second.m_sUDTEdgeReads.insert(u);
+      if (writable)
+         p->second.m_sUDTEdgeWrites.insert(u);
+   }
+   else
+   {
+      p->second.m_sUDTSocksEdge.erase(u);
+      p->second.m_sUDTEdgeReads.erase(u);
+      p->second.m_sUDTEdgeWrites.erase(u);
+   }
+
+   // a socket that is ready already will not report again, so the waiters have to look now
+   if (readable || writable)
+      signal(p->second);
+
    return 0;
 }
 
@@ -107,11 +161,12 @@ int CEPoll::add_ssock(const int eid, const SYSSOCKET& s, const int* events)
    CGuard pg(m_EPollLock);
 
    map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-   if (p == m_mPolls.end())
+   if ((p == m_mPolls.end()) || p->second.m_bReleased)
       throw CUDTException(5, 13);
 
 #ifdef LINUX
    epoll_event ev;
+   ev.events = 0;
 
    if (NULL == events)
       ev.events = EPOLLIN | EPOLLOUT | EPOLLERR;
@@ -123,6 +178,8 @@ int CEPoll::add_ssock(const int eid, const SYSSOCKET& s, const int* events)
          ev.events |= EPOLLOUT;
       if (*events & UDT_EPOLL_ERR)
          ev.events |= EPOLLERR;
+      if (*events & UDT_EPOLL_ET)
+         ev.events |= EPOLLET;
    }
 
    ev.data.fd = s;
@@ -135,7 +192,7 @@ int CEPoll::add_ssock(const int eid, const SYSSOCKET& s, const int* events)
    return 0;
 }
 
-int CEPoll::remove_usock(const int eid, const UDTSOCKET& u, const int* /*events*/)
+int CEPoll::remove_usock(const int eid, const UDTSOCKET& u, const int* events)
 {
    CGuard pg(m_EPollLock);
 
@@ -143,7 +200,23 @@ int CEPoll::remove_usock(const int eid, const UDTSOCKET& u, const int* /*events*
    if (p == m_mPolls.end())
       throw CUDTException(5, 13);
 
-   p->second.m_sUDTSocks.erase(u);
+   if ((NULL == events) || (*events & UDT_EPOLL_IN))
+      p->second.m_sUDTSocksIn.erase(u);
+   if ((NULL == events) || (*events & UDT_EPOLL_OUT))
+      p->second.m_sUDTSocksOut.erase(u);
+
+   // the socket is removed only if there is no more events to watch
+   if (p->second.m_sUDTSocksIn.find(u) == p->second.m_sUDTSocksIn.end() && p->second.m_sUDTSocksOut.find(u) == p->second.m_sUDTSocksOut.end())
+   {
+      p->second.m_sUDTSocks.erase(u);
+      p->second.m_sUDTReads.erase(u);
+      p->second.m_sUDTWrites.erase(u);
+      p->second.m_sUDTSocksEdge.erase(u);
+      p->second.m_sUDTEdgeReads.erase(u);
+      p->second.m_sUDTEdgeWrites.erase(u);
+
+      return 1;
+   }
 
    return 0;
 }
@@ -158,6 +231,7 @@ int CEPoll::remove_ssock(const int eid, const SYSSOCKET& s, const int* events)
 
 #ifdef LINUX
    epoll_event ev;
+   ev.events = 0;
 
    if (NULL == events)
       ev.events = EPOLLIN | EPOLLOUT | EPOLLERR;
@@ -186,56 +260,139 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
    int total = 0;
 
    int64_t entertime = CTimer::getTime();
+
+   CGuard::enterCS(m_EPollLock);
+
+   map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
+   if ((p == m_mPolls.end()) || p->second.m_bReleased)
+   {
+      CGuard::leaveCS(m_EPollLock);
+      throw CUDTException(5, 13);
+   }
+
+   // from here the descriptor stays in m_mPolls until this thread leaves, see release()
+   CEPollDesc& desc = p->second;
+   ++ desc.m_iWaiters;
+
    while (true)
    {
-      CGuard::enterCS(m_EPollLock);
+      // only report the events that the application asked for;
+      // a level-triggered socket is reported while it is ready, an edge-triggered one once for every new event
+      // the level-triggered sets are only scanned if there are such sockets
+      bool level = desc.m_sUDTSocksEdge.size() < desc.m_sUDTSocks.size();
 
-      map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-      if (p == m_mPolls.end())
+      if (NULL != readfds)
       {
-         CGuard::leaveCS(m_EPollLock);
-         throw CUDTException(5, 13);
+         readfds->clear();
+         for (set<UDTSOCKET>::iterator i = desc.m_sUDTEdgeReads.begin(); i != desc.m_sUDTEdgeReads.end(); ++ i)
+         {
+            if (desc.m_sUDTSocksIn.find(*i) != desc.m_sUDTSocksIn.end())
+               readfds->insert(*i);
+         }
+         desc.m_sUDTEdgeReads.clear();
+
+         for (set<UDTSOCKET>::iterator i = desc.m_sUDTReads.begin(); level && (i != desc.m_sUDTReads.end()); ++ i)
+         {
+            if ((desc.m_sUDTSocksIn.find(*i) != desc.m_sUDTSocksIn.end()) && (desc.m_sUDTSocksEdge.find(*i) == desc.m_sUDTSocksEdge.end()))
+               readfds->insert(*i);
+         }
+         total += readfds->size();
       }
 
-      if ((NULL != readfds) && !p->second.m_sUDTReads.empty())
+      if (NULL != writefds)
       {
-         *readfds = p->second.m_sUDTReads;
-         total += p->second.m_sUDTReads.size();
+         writefds->clear();
+         for (set<UDTSOCKET>::iterator i = desc.m_sUDTEdgeWrites.begin(); i != desc.m_sUDTEdgeWrites.end(); ++ i)
+         {
+            if (desc.m_sUDTSocksOut.find(*i) != desc.m_sUDTSocksOut.end())
+               writefds->insert(*i);
+         }
+         desc.m_sUDTEdgeWrites.clear();
+
+         for (set<UDTSOCKET>::iterator i = desc.m_sUDTWrites.begin(); level && (i != desc.m_sUDTWrites.end()); ++ i)
+         {
+            if ((desc.m_sUDTSocksOut.find(*i) != desc.m_sUDTSocksOut.end()) && (desc.m_sUDTSocksEdge.find(*i) == desc.m_sUDTSocksEdge.end()))
+               writefds->insert(*i);
+         }
+         total += writefds->size();
       }
 
-      if ((NULL != writefds) && !p->second.m_sUDTWrites.empty())
+      if (lrfds)
+         lrfds->clear();
+      if (lwfds)
+         lwfds->clear();
+
+      // how long to sleep if nothing is ready; system sockets are still checked when UDT sockets are ready
+      int64_t wait = 0;
+      if (total == 0)
       {
-         *writefds = p->second.m_sUDTWrites;
-         total += p->second.m_sUDTWrites.size();
+         if (msTimeOut < 0)
+            wait = -1;
+         else
+         {
+            wait = msTimeOut - int64_t(CTimer::getTime() - entertime) / 1000;
+            if (wait < 0)
+               wait = 0;
+         }
       }
 
+      #ifdef LINUX
+      if ((total > 0) && (NULL == lrfds) && (NULL == lwfds))
+         break;
+
+      // the descriptors are not closed while this thread waits, see release()
+      int localid = desc.m_iLocalID;
+      int eventfd = desc.m_iEventFD;
+      const int max_events = desc.m_sLocals.size() + 1;
+
+      CGuard::leaveCS(m_EPollLock);
+
+      // system sockets are left out if the application does not want their events, or they would keep waking this thread
+      vector<epoll_event> ev(max_events);
+      int nfds = 0;
       if (lrfds || lwfds)
+         nfds = epoll_wait(localid, &ev[0], max_events, int(wait));
+      else
       {
-         if (lrfds)
-            lrfds->clear();
+         pollfd pfd;
+         pfd.fd = eventfd;
+         pfd.events = POLLIN;
+         if (poll(&pfd, 1, int(wait)) > 0)
+         {
+            ev[0].data.fd = eventfd;
+            ev[0].events = EPOLLIN;
+            nfds = 1;
+         }
+      }
 
-         if (lwfds)
-            lwfds->clear();
+      CGuard::enterCS(m_EPollLock);
 
-         #ifdef LINUX
-         const int max_events = p->second.m_sLocals.size();
-         epoll_event ev[max_events];
-         int nfds = epoll_wait(p->second.m_iLocalID, ev, max_events, 0);
+      for (int i = 0; i < nfds; ++ i)
+      {
+         if (ev[i].data.fd == eventfd)
+         {
+            // consume the signal, the UDT socket sets are read again in the next round; once the descriptor
+            // is released the signal is left in place, so that every other waiter wakes up and leaves too
+            uint64_t count;
+            if (!desc.m_bReleased && (read(eventfd, &count, sizeof(uint64_t)) < 0))
+               count = 0;
+            continue;
+         }
 
-         for (int i = 0; i < nfds; ++ i)
+         if ((NULL != lrfds) && (ev[i].events & EPOLLIN))
          {
-            if ((NULL != lrfds) && (ev[i].events & EPOLLIN))
-            {
-               lrfds->insert(ev[i].data.fd);
-               ++ total;
-            }
-            if ((NULL != lwfds) && (ev[i].events & EPOLLOUT))
-            {
-               lwfds->insert(ev[i].data.fd);
-               ++ total;
-            }
+            lrfds->insert(ev[i].data.fd);
+            ++ total;
+         }
+         if ((NULL != lwfds) && (ev[i].events & EPOLLOUT))
+         {
+            lwfds->insert(ev[i].data.fd);
+            ++ total;
          }
-         #else
+      }
+      #else
+      if (lrfds || lwfds)
+      {
          //currently "select" is used for all non-Linux platforms.
          //faster approaches can be applied for specific systems in the future.
 
@@ -246,7 +403,7 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
          FD_ZERO(&readfds);
          FD_ZERO(&writefds);
 
-         for (set<SYSSOCKET>::const_iterator i = p->second.m_sLocals.begin(); i != p->second.m_sLocals.end(); ++ i)
+         for (set<SYSSOCKET>::const_iterator i = desc.m_sLocals.begin(); i != desc.m_sLocals.end(); ++ i)
          {
             if (lrfds)
                FD_SET(*i, &readfds);
@@ -261,7 +418,7 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
 
          if (r > 0)
          {
-            for (set<SYSSOCKET>::const_iterator i = p->second.m_sLocals.begin(); i != p->second.m_sLocals.end(); ++ i)
+            for (set<SYSSOCKET>::const_iterator i = desc.m_sLocals.begin(); i != desc.m_sLocals.end(); ++ i)
             {
                if (lrfds)
                {
@@ -282,21 +439,35 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
                }
             }
          }
-         #endif
       }
 
-      CGuard::leaveCS(m_EPollLock);
-
-      if (total > 0)
-         return total;
+      if ((total == 0) && (wait != 0))
+      {
+         // UDT socket events trigger the timer event, see signal(); system sockets are checked again after it times out
+         CGuard::leaveCS(m_EPollLock);
+         CTimer::waitForEvent();
+         CGuard::enterCS(m_EPollLock);
+         continue;
+      }
+      #endif
 
-      if ((msTimeOut >= 0) && (int64_t(CTimer::getTime() - entertime) >= msTimeOut * 1000LL))
+      if (desc.m_bReleased)
          break;
 
-      CTimer::waitForEvent();
+      if ((total > 0) || ((msTimeOut >= 0) && (int64_t(CTimer::getTime() - entertime) >= msTimeOut * 1000LL)))
+         break;
    }
 
-   return 0;
+   bool released = desc.m_bReleased;
+   if ((0 == -- desc.m_iWaiters) && released)
+      destroy(p);
+
+   CGuard::leaveCS(m_EPollLock);
+
+   if (released)
+      throw CUDTException(5, 13);
+
+   return total;
 }
 
 int CEPoll::release(const int eid)
@@ -304,15 +475,18 @@ int CEPoll::release(const int eid)
    CGuard pg(m_EPollLock);
 
    map<int, CEPollDesc>::iterator i = m_mPolls.find(eid);
-   if (i == m_mPolls.end())
+   if ((i == m_mPolls.end()) || i->second.m_bReleased)
       throw CUDTException(5, 13);
 
-   #ifdef LINUX
-   // release local/system epoll descriptor
-   ::close(i->second.m_iLocalID);
-   #endif
+   // threads still waiting on it are woken up, the signal stays set until the last of them destroys it
+   if (i->second.m_iWaiters > 0)
+   {
+      i->second.m_bReleased = true;
+      signal(i->second);
+      return 0;
+   }
 
-   m_mPolls.erase(i);
+   destroy(i);
 
    return 0;
 }
@@ -333,7 +507,13 @@ int CEPoll::enable_write(const UDTSOCKET& uid, set<int>& eids)
       }
       else
       {
-         p->second.m_sUDTWrites.insert(uid);
+         // every call is a new event for an edge-triggered socket, a level-triggered one only changes once
+         bool changed = p->second.m_sUDTWrites.insert(uid).second;
+         if (p->second.m_sUDTSocksEdge.find(uid) != p->second.m_sUDTSocksEdge.end())
+            changed = p->second.m_sUDTEdgeWrites.insert(uid).second;
+
+         if (changed && (p->second.m_sUDTSocksOut.find(uid) != p->second.m_sUDTSocksOut.end()))
+            signal(p->second);
       }
    }
 
@@ -359,7 +539,12 @@ int CEPoll::enable_read(const UDTSOCKET& uid, set<int>& eids)
       }
       else
       {
-         p->second.m_sUDTReads.insert(uid);
+         bool changed = p->second.m_sUDTReads.insert(uid).second;
+         if (p->second.m_sUDTSocksEdge.find(uid) != p->second.m_sUDTSocksEdge.end())
+            changed = p->second.m_sUDTEdgeReads.insert(uid).second;
+
+         if (changed && (p->second.m_sUDTSocksIn.find(uid) != p->second.m_sUDTSocksIn.end()))
+            signal(p->second);
       }
    }
 
@@ -386,6 +571,7 @@ int CEPoll::disable_write(const UDTSOCKET& uid, set<int>& eids)
       else
       {
          p->second.m_sUDTWrites.erase(uid);
+         p->second.m_sUDTEdgeWrites.erase(uid);
       }
    }
 
@@ -412,6 +598,7 @@ int CEPoll::disable_read(const UDTSOCKET& uid, set<int>& eids)
       else
       {
          p->second.m_sUDTReads.erase(uid);
+         p->second.m_sUDTEdgeReads.erase(uid);
       }
    }
 
@@ -420,3 +607,31 @@ int CEPoll::disable_read(const UDTSOCKET& uid, set<int>& eids)
 
    return 0;
 }
+
+void CEPoll::signal(CEPollDesc& desc)
+{
+   // nobody to wake up, the next wait() reads the UDT socket sets before it sleeps
+   if (0 == desc.m_iWaiters)
+      return;
+
+   #ifdef LINUX
+      uint64_t one = 1;
+      if (write(desc.m_iEventFD, &one, sizeof(uint64_t)) < 0)
+      {
+         // the counter is saturated, the waiters are woken up anyway
+      }
+   #else
+      CTimer::triggerEvent();
+   #endif
+}
+
+void CEPoll::destroy(map<int, CEPollDesc>::iterator p)
+{
+   #ifdef LINUX
+   // release local/system epoll descriptor
+   ::close(p->second.m_iEventFD);
+   ::close(p->second.m_iLocalID);
+   #endif
+
+   m_mPolls.erase(p);
+}
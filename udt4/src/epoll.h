@@ -51,12 +51,22 @@ struct CEPollDesc
 {
    int m_iID;                                // epoll ID
    std::set<UDTSOCKET> m_sUDTSocks;          // set of UDT sockets waiting for events
+   std::set<UDTSOCKET> m_sUDTSocksIn;        // UDT sockets waiting for read events
+   std::set<UDTSOCKET> m_sUDTSocksOut;       // UDT sockets waiting for write events
 
    int m_iLocalID;                           // local system epoll ID
    std::set<SYSSOCKET> m_sLocals;            // set of local (non-UDT) descriptors
 
    std::set<UDTSOCKET> m_sUDTWrites;         // UDT sockets ready for write
    std::set<UDTSOCKET> m_sUDTReads;          // UDT sockets ready for read
+
+   std::set<UDTSOCKET> m_sUDTSocksEdge;      // UDT sockets watched edge-triggered
+   std::set<UDTSOCKET> m_sUDTEdgeWrites;     // edge-triggered UDT sockets with a write event not reported yet
+   std::set<UDTSOCKET> m_sUDTEdgeReads;      // edge-triggered UDT sockets with a read event not reported yet
+
+   int m_iEventFD;                           // eventfd in the local epoll, signaled when a UDT socket gets an event
+   int m_iWaiters;                           // number of threads in wait()
+   bool m_bReleased;                         // released while threads were waiting, the last of them frees it
 };
 
 class CEPoll
@@ -107,7 +117,7 @@ public: // for CUDTUnited API
       //    1) [in] u: UDT socket ID.
       //    2) [in] events: events to delete.
       // Returned value:
-      //    0 if success, otherwise an error number.
+      //    1 if the socket is no longer watched for any event, 0 if it still is.
 
    int remove_usock(const int eid, const UDTSOCKET& u, const int* events = NULL);
 
@@ -187,6 +197,25 @@ public: // for CUDT to acknowledge IO status
 
    int disable_read(const UDTSOCKET& uid, std::set<int>& eids);
 
+private:
+      // Functionality:
+      //    wake up the threads waiting on an EPoll.
+      // Parameters:
+      //    0) [in] desc: the EPoll.
+      // Returned value:
+      //    None.
+
+   static void signal(CEPollDesc& desc);
+
+      // Functionality:
+      //    free the resources of an EPoll.
+      // Parameters:
+      //    0) [in] p: the EPoll.
+      // Returned value:
+      //    None.
+
+   void destroy(std::map<int, CEPollDesc>::iterator p);
+
 private:
    int m_iIDSeed;                            // seed to generate a new ID
    pthread_mutex_t m_SeedLock;
@@ -0,0 +1,475 @@
+/*****************************************************************************
+Copyright (c) 2001 - 2009, The Board of Trustees of the University of Illinois.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the
+  above copyright notice, this list of conditions
+  and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the University of Illinois
+  nor the names of its contributors may be used to
+  endorse or promote products derived from this
+  software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*****************************************************************************/
+
+#ifndef WIN32
+   #include <arpa/inet.h>
+#endif
+#include <cstring>
+#include "fec.h"
+
+// XOR a buffer into another, 8 bytes at a time; neither needs to be aligned
+static void xorData(char* dst, const char* src, const int& len)
+{
+   int i = 0;
+   for (; i + 8 <= len; i += 8)
+   {
+      uint64_t a, b;
+      memcpy(&a, dst + i, 8);
+      memcpy(&b, src + i, 8);
+      a ^= b;
+      memcpy(dst + i, &a, 8);
+   }
+   for (; i < len; ++ i)
+      dst[i] ^= src[i];
+}
+
+const int CFECEncoder::m_iParityOverhead = 12;
+const int CFECEncoder::m_iInitGroupSize = 16;
+const int CFECEncoder::m_iMinGroupSize = 4;
+const int CFECEncoder::m_iMaxGroupSize = 64;
+
+CFECEncoder::CFECEncoder(const int32_t& isn, const int& groupsize, const int& payloadsize):
+m_iPayloadSize(payloadsize),
+m_iStart(isn),
+m_iSize(groupsize),
+m_iCount(0),
+m_iLength(0),
+m_iNextSize(groupsize),
+m_pcGroup(NULL),
+m_bReady(false),
+m_iParityStart(isn),
+m_iParitySize(0),
+m_iParityNextSize(groupsize),
+m_iParityLength(0),
+m_pcParity(NULL)
+{
+   m_pcGroup = new char [m_iParityOverhead + m_iPayloadSize];
+   m_pcParity = new char [m_iParityOverhead + m_iPayloadSize];
+   memset(m_pcGroup, 0, m_iParityOverhead + m_iPayloadSize);
+   memset(m_pcParity, 0, m_iParityOverhead + m_iPayloadSize);
+}
+
+CFECEncoder::~CFECEncoder()
+{
+   delete [] m_pcGroup;
+   delete [] m_pcParity;
+}
+
+void CFECEncoder::add(const CPacket& packet)
+{
+   // first transmissions are consecutive, restart the group if they are not
+   if (packet.m_iSeqNo != CSeqNo::incseq(m_iStart, m_iCount))
+   {
+      close();
+      m_iStart = packet.m_iSeqNo;
+   }
+
+   int len = packet.getLength();
+   if (len > m_iPayloadSize)
+      return;
+
+   int32_t* p = (int32_t*)m_pcGroup;
+   p[1] ^= len;
+   p[2] ^= packet.m_iMsgNo;
+
+   xorData(m_pcGroup + m_iParityOverhead, packet.m_pcData, len);
+
+   if (len > m_iLength)
+      m_iLength = len;
+
+   if (++ m_iCount >= m_iSize)
+      close();
+}
+
+void CFECEncoder::flush()
+{
+   close();
+}
+
+int CFECEncoder::pack(CPacket& packet)
+{
+   int32_t* p = (int32_t*)m_pcParity;
+   p[0] = (m_iParitySize << 16) | m_iParityNextSize;
+
+   // CChannel swaps every word of a control packet into network order, undo it for the payload bytes
+   for (int i = m_iParityOverhead / 4, n = m_iParityLength / 4; i < n; ++ i)
+      p[i] = ntohl(p[i]);
+
+   packet.pack(9, &m_iParityStart, m_pcParity, m_iParityLength);
+
+   m_bReady = false;
+
+   return m_iParityLength;
+}
+
+void CFECEncoder::setLossRate(const double& loss)
+{
+   // losses left to the retransmissions mean groups with more than one loss, halve the groups then,
+   // and let them grow slowly back while the parity repairs everything
+   int size = m_iNextSize;
+   if (loss > 0)
+      size /= 2;
+   else
+      ++ size;
+
+   if (size < m_iMinGroupSize)
+      size = m_iMinGroupSize;
+   else if (size > m_iMaxGroupSize)
+      size = m_iMaxGroupSize;
+
+   m_iNextSize = size;
+}
+
+int CFECEncoder::dataSize(const int& payloadsize)
+{
+   // keep the parity payload a multiple of 4 bytes, it is converted word by word
+   return (payloadsize - m_iParityOverhead) & ~3;
+}
+
+void CFECEncoder::close()
+{
+   if (0 == m_iCount)
+      return;
+
+   char* tmp = m_pcParity;
+   m_pcParity = m_pcGroup;
+   m_pcGroup = tmp;
+
+   m_iParityStart = m_iStart;
+   m_iParitySize = m_iCount;
+   m_iParityNextSize = m_iNextSize;
+   m_iParityLength = m_iParityOverhead + ((m_iLength + 3) & ~3);
+   m_bReady = true;
+
+   m_iStart = CSeqNo::incseq(m_iStart, m_iCount);
+   m_iSize = m_iParityNextSize;
+   m_iCount = 0;
+   m_iLength = 0;
+   memset(m_pcGroup, 0, m_iParityOverhead + m_iPayloadSize);
+}
+
+//
+const int CFECDecoder::m_iGroupCount = 8;
+const int CFECDecoder::m_iReorderDist = 4;
+
+CFECDecoder::CFECDecoder(const int32_t& isn, const int& groupsize, const int& payloadsize):
+m_pGroup(NULL),
+m_iNewest(-1),
+m_iPayloadSize(payloadsize),
+m_iNextStart(isn),
+m_iNextSize(groupsize)
+{
+   m_pGroup = new CGroup [m_iGroupCount];
+   for (int i = 0; i < m_iGroupCount; ++ i)
+   {
+      m_pGroup[i].m_iStart = 0;
+      m_pGroup[i].m_iSize = 0;
+      m_pGroup[i].m_iCount = 0;
+      m_pGroup[i].m_ullMask = 0;
+      m_pGroup[i].m_bDone = false;
+      m_pGroup[i].m_bWaited = false;
+      m_pGroup[i].m_pcData = new char [m_iPayloadSize];
+   }
+}
+
+CFECDecoder::~CFECDecoder()
+{
+   for (int i = 0; i < m_iGroupCount; ++ i)
+      delete [] m_pGroup[i].m_pcData;
+   delete [] m_pGroup;
+}
+
+void CFECDecoder::add(const CPacket& packet)
+{
+   CGroup* g = locate(packet.m_iSeqNo);
+   if ((NULL == g) || g->m_bDone)
+      return;
+
+   int len = packet.getLength();
+   if (len > m_iPayloadSize - CFECEncoder::m_iParityOverhead)
+      return;
+
+   uint64_t bit = uint64_t(1) << CSeqNo::seqoff(g->m_iStart, packet.m_iSeqNo);
+   if (0 != (g->m_ullMask & bit))
+      return;
+   g->m_ullMask |= bit;
+   ++ g->m_iCount;
+
+   int32_t* p = (int32_t*)g->m_pcData;
+   p[1] ^= len;
+   p[2] ^= packet.m_iMsgNo;
+
+   xorData(g->m_pcData + CFECEncoder::m_iParityOverhead, packet.m_pcData, len);
+}
+
+bool CFECDecoder::pending(const int32_t& seqno) const
+{
+   CGroup* g = find(seqno);
+
+   return (NULL != g) && !g->m_bDone;
+}
+
+int32_t CFECDecoder::getFirstPendingSeq() const
+{
+   CGroup* g = oldestPending();
+
+   return (NULL != g) ? g->m_iStart : -1;
+}
+
+bool CFECDecoder::overdue(const int32_t& seqno) const
+{
+   CGroup* g = oldestPending();
+
+   return (NULL != g) && (CSeqNo::seqoff(g->m_iStart, seqno) >= g->m_iSize + m_iReorderDist);
+}
+
+void CFECDecoder::expire()
+{
+   for (int i = 0; i < m_iGroupCount; ++ i)
+   {
+      CGroup* g = m_pGroup + i;
+      if ((0 == g->m_iSize) || g->m_bDone)
+         continue;
+
+      if (g->m_bWaited)
+         g->m_bDone = true;
+      else
+         g->m_bWaited = true;
+   }
+}
+
+int CFECDecoder::expire(int32_t* missing)
+{
+   CGroup* g = oldestPending();
+   if (NULL == g)
+      return 0;
+
+   g->m_bDone = true;
+
+   int num = 0;
+   for (int i = 0; i < g->m_iSize; ++ i)
+      if (0 == (g->m_ullMask & (uint64_t(1) << i)))
+         missing[num ++] = CSeqNo::incseq(g->m_iStart, i);
+
+   return num;
+}
+
+int CFECDecoder::recover(const CPacket& parity, CPacket& packet, int32_t* missing, int& num)
+{
+   num = 0;
+
+   int len = parity.getLength();
+   if ((len < CFECEncoder::m_iParityOverhead) || (len > m_iPayloadSize) || (0 != len % 4))
+      return 0;
+
+   int32_t start = parity.getAckSeqNo();
+   int32_t* q = (int32_t*)parity.m_pcData;
+   int size = (q[0] >> 16) & 0xFFFF;
+   int nextsize = q[0] & 0xFFFF;
+   if ((size < 1) || (size > CFECEncoder::m_iMaxGroupSize) || (nextsize < 1) || (nextsize > CFECEncoder::m_iMaxGroupSize))
+      return 0;
+
+   CGroup* g = find(start);
+   if ((NULL != g) && ((g->m_iStart != start) || (g->m_iSize < size) || ((size < 64) && (0 != (g->m_ullMask >> size)))))
+   {
+      // the groups have been laid out differently from the sender, start over from this one
+      for (int i = 0; i < m_iGroupCount; ++ i)
+         m_pGroup[i].m_iSize = 0;
+      m_iNewest = -1;
+      g = NULL;
+   }
+
+   if (NULL == g)
+   {
+      // too old, or a group none of whose packets has arrived yet
+      if ((-1 != m_iNewest) && (CSeqNo::seqcmp(start, m_iNextStart) < 0))
+         return 0;
+
+      m_iNextStart = start;
+      m_iNextSize = size;
+      g = locate(start);
+   }
+
+   if (g->m_bDone)
+      return 0;
+   g->m_bDone = true;
+
+   if (g->m_iSize > size)
+   {
+      // the sender closed the group early, the groups laid out after it are shifted
+      g->m_iSize = size;
+      truncate(g, nextsize);
+   }
+   else if (g == m_pGroup + m_iNewest)
+      m_iNextSize = nextsize;
+   else
+   {
+      // the next group has been laid out before this parity announced its size,
+      // e.g., the parity was held back behind a probing pair
+      CGroup* n = m_pGroup + (g - m_pGroup + 1) % m_iGroupCount;
+      if (n->m_iSize != nextsize)
+      {
+         if ((n == m_pGroup + m_iNewest) && ((nextsize >= 64) || (0 == (n->m_ullMask >> nextsize))))
+         {
+            n->m_iSize = nextsize;
+            m_iNextStart = CSeqNo::incseq(n->m_iStart, nextsize);
+         }
+         else
+            truncate(g, nextsize);
+      }
+   }
+
+   if (g->m_iCount == size)
+      return 0;
+
+   if (g->m_iCount < size - 1)
+   {
+      for (int i = 0; i < size; ++ i)
+         if (0 == (g->m_ullMask & (uint64_t(1) << i)))
+            missing[num ++] = CSeqNo::incseq(start, i);
+      return -1;
+   }
+
+   int i = 0;
+   while (0 != (g->m_ullMask & (uint64_t(1) << i)))
+      ++ i;
+
+   // finish reading the parity before writing the packet, they may share the same buffer
+   int32_t* p = (int32_t*)g->m_pcData;
+   int datalen = p[1] ^ q[1];
+   int32_t msgno = p[2] ^ q[2];
+   for (int j = CFECEncoder::m_iParityOverhead / 4, n = len / 4; j < n; ++ j)
+      p[j] ^= htonl(q[j]);
+   int32_t timestamp = parity.m_iTimeStamp;
+   int32_t id = parity.m_iID;
+
+   if ((datalen <= 0) || (datalen > len - CFECEncoder::m_iParityOverhead))
+      return 0;
+
+   packet.m_iSeqNo = CSeqNo::incseq(start, i);
+   packet.m_iMsgNo = msgno;
+   packet.m_iTimeStamp = timestamp;
+   packet.m_iID = id;
+   memcpy(packet.m_pcData, g->m_pcData + CFECEncoder::m_iParityOverhead, datalen);
+   packet.setLength(datalen);
+
+   return 1;
+}
+
+CFECDecoder::CGroup* CFECDecoder::locate(const int32_t& seqno)
+{
+   CGroup* g = find(seqno);
+   if (NULL != g)
+      return g;
+
+   if ((-1 != m_iNewest) && (CSeqNo::seqcmp(seqno, m_iNextStart) < 0))
+      return NULL;
+
+   // skip the groups that would fall out of the ring anyway
+   int offset = CSeqNo::seqoff(m_iNextStart, seqno);
+   if (offset >= m_iGroupCount * m_iNextSize)
+      m_iNextStart = CSeqNo::incseq(m_iNextStart, (offset / m_iNextSize - m_iGroupCount + 1) * m_iNextSize);
+
+   while (CSeqNo::seqcmp(seqno, m_iNextStart) >= 0)
+   {
+      m_iNewest = (m_iNewest + 1) % m_iGroupCount;
+      g = m_pGroup + m_iNewest;
+      g->m_iStart = m_iNextStart;
+      g->m_iSize = m_iNextSize;
+      g->m_iCount = 0;
+      g->m_ullMask = 0;
+      g->m_bDone = false;
+      g->m_bWaited = false;
+      memset(g->m_pcData, 0, m_iPayloadSize);
+
+      m_iNextStart = CSeqNo::incseq(m_iNextStart, m_iNextSize);
+   }
+
+   return g;
+}
+
+void CFECDecoder::truncate(CGroup* g, const int& nextsize)
+{
+   for (int i = 0; i < m_iGroupCount; ++ i)
+      if ((0 != m_pGroup[i].m_iSize) && (CSeqNo::seqcmp(m_pGroup[i].m_iStart, g->m_iStart) > 0))
+         m_pGroup[i].m_iSize = 0;
+
+   m_iNewest = int(g - m_pGroup);
+   m_iNextStart = CSeqNo::incseq(g->m_iStart, g->m_iSize);
+   m_iNextSize = nextsize;
+}
+
+CFECDecoder::CGroup* CFECDecoder::find(const int32_t& seqno) const
+{
+   if (-1 == m_iNewest)
+      return NULL;
+
+   for (int i = 0, j = m_iNewest; i < m_iGroupCount; ++ i, j = (j + m_iGroupCount - 1) % m_iGroupCount)
+   {
+      CGroup* g = m_pGroup + j;
+      if (0 == g->m_iSize)
+         break;
+
+      int offset = CSeqNo::seqoff(g->m_iStart, seqno);
+      if ((offset >= 0) && (offset < g->m_iSize))
+         return g;
+
+      // groups are ordered, older ones start further back
+      if (offset >= g->m_iSize)
+         break;
+   }
+
+   return NULL;
+}
+
+CFECDecoder::CGroup* CFECDecoder::oldestPending() const
+{
+   if (-1 == m_iNewest)
+      return NULL;
+
+   // walk from the newest group back, the last one found is the oldest
+   CGroup* p = NULL;
+   for (int i = 0, j = m_iNewest; i < m_iGroupCount; ++ i, j = (j + m_iGroupCount - 1) % m_iGroupCount)
+   {
+      CGroup* g = m_pGroup + j;
+      if (0 == g->m_iSize)
+         break;
+
+      if (!g->m_bDone)
+         p = g;
+   }
+
+   return p;
+}
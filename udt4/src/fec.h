@@ -0,0 +1,251 @@
+/*****************************************************************************
+Copyright (c) 2001 - 2009, The Board of Trustees of the University of Illinois.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the
+  above copyright notice, this list of conditions
+  and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the University of Illinois
+  nor the names of its contributors may be used to
+  endorse or promote products derived from this
+  software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*****************************************************************************/
+
+#ifndef __UDT_FEC_H__
+#define __UDT_FEC_H__
+
+
+#include "udt.h"
+#include "common.h"
+#include "packet.h"
+
+// XOR parity over groups of consecutive data packets (first transmissions only).
+// A group of N packets starting at seq. no. S covers S ... S + N - 1, the next group starts at S + N.
+// The parity is a control packet of type 9, its additional information field holds S and the control
+// information is N << 16 | size of the next group, the XOR of the payload lengths, the XOR of the
+// message number fields and the XOR of the payloads, in network byte order like a data payload.
+// The parity is m_iParityOverhead bytes longer than the data it protects, so the sender shortens its
+// data packets accordingly. One lost packet per group can be rebuilt without waiting for a retransmission.
+
+class CFECEncoder
+{
+public:
+   CFECEncoder(const int32_t& isn, const int& groupsize, const int& payloadsize);
+   ~CFECEncoder();
+
+      // Functionality:
+      //    Add a newly sent data packet to the current group.
+      // Parameters:
+      //    0) [in] packet: the data packet, first transmission.
+      // Returned value:
+      //    None.
+
+   void add(const CPacket& packet);
+
+      // Functionality:
+      //    Close the current group early, e.g., when the sender runs out of data.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void flush();
+
+      // Functionality:
+      //    Check if a parity packet is waiting to be sent.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    true if there is a parity to be sent, otherwise false.
+
+   bool ready() const {return m_bReady;}
+
+      // Functionality:
+      //    Pack the waiting parity packet.
+      // Parameters:
+      //    0) [out] packet: the parity control packet, its data points to the encoder.
+      // Returned value:
+      //    Size of the control information.
+
+   int pack(CPacket& packet);
+
+      // Functionality:
+      //    Adapt the size of the next groups to the losses that the parity could not repair.
+      // Parameters:
+      //    0) [in] loss: fraction of the packets sent since the last call that had to be retransmitted.
+      // Returned value:
+      //    None.
+
+   void setLossRate(const double& loss);
+
+      // Functionality:
+      //    Calculate the largest data payload that leaves room for the parity header.
+      // Parameters:
+      //    0) [in] payloadsize: largest packet payload.
+      // Returned value:
+      //    largest data payload when FEC is on.
+
+   static int dataSize(const int& payloadsize);
+
+public:
+   static const int m_iParityOverhead;  // bytes of the parity header in front of the XOR of the payloads
+   static const int m_iInitGroupSize;   // group size at the beginning of a connection
+   static const int m_iMinGroupSize;    // smallest group size
+   static const int m_iMaxGroupSize;    // largest group size
+
+private:
+   void close();
+
+private:
+   int m_iPayloadSize;                  // largest payload of the data packets
+
+   int32_t m_iStart;                    // first seq. no. of the current group
+   int m_iSize;                         // size of the current group
+   int m_iCount;                        // packets added to the current group
+   int m_iLength;                       // largest payload in the current group
+   volatile int m_iNextSize;            // size of the group after the current one
+   char* m_pcGroup;                     // parity of the current group being built
+
+   bool m_bReady;                       // if m_pcParity waits to be sent
+   int32_t m_iParityStart;              // first seq. no. covered by m_pcParity
+   int m_iParitySize;                   // number of packets covered by m_pcParity
+   int m_iParityNextSize;               // size of the group following m_pcParity
+   int m_iParityLength;                 // size of the control information of m_pcParity
+   char* m_pcParity;                    // parity waiting to be sent
+
+private:
+   CFECEncoder(const CFECEncoder&);
+   CFECEncoder& operator=(const CFECEncoder&);
+};
+
+class CFECDecoder
+{
+public:
+   CFECDecoder(const int32_t& isn, const int& groupsize, const int& payloadsize);
+   ~CFECDecoder();
+
+      // Functionality:
+      //    Add a received data packet to its group.
+      // Parameters:
+      //    0) [in] packet: the data packet.
+      // Returned value:
+      //    None.
+
+   void add(const CPacket& packet);
+
+      // Functionality:
+      //    Check if a seq. no. is covered by a group whose parity is still expected.
+      // Parameters:
+      //    0) [in] seqno: sequence number.
+      // Returned value:
+      //    true if a parity may still rebuild the packet, otherwise false.
+
+   bool pending(const int32_t& seqno) const;
+
+      // Functionality:
+      //    Read the first seq. no. of the oldest group whose parity is still expected.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    the sequence number or -1 if no parity is expected.
+
+   int32_t getFirstPendingSeq() const;
+
+      // Functionality:
+      //    Stop waiting for the parity of the groups that were already waited for at the last call,
+      //    so that a lost parity does not hold back the loss reports for long.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void expire();
+
+      // Functionality:
+      //    Check if the parity of the oldest group is overdue, the sender sends it right after the last
+      //    packet of the group, so it should arrive before the packets sent well after it.
+      // Parameters:
+      //    0) [in] seqno: sequence number of the newly arrived packet.
+      // Returned value:
+      //    true if the parity is overdue, otherwise false.
+
+   bool overdue(const int32_t& seqno) const;
+
+      // Functionality:
+      //    Stop waiting for the parity of the oldest group.
+      // Parameters:
+      //    0) [out] missing: the seq. no. still missing in the group, with room for m_iMaxGroupSize values.
+      // Returned value:
+      //    number of missing seq. no.
+
+   int expire(int32_t* missing);
+
+      // Functionality:
+      //    Process a parity packet.
+      // Parameters:
+      //    0) [in] parity: the parity control packet.
+      //    1) [out] packet: the rebuilt data packet, with room for the payload size; it may share the unit of the parity.
+      //    2) [out] missing: the seq. no. still missing in the group, with room for m_iMaxGroupSize values.
+      //    3) [out] num: number of missing seq. no.
+      // Returned value:
+      //    1 if a packet has been rebuilt, 0 if nothing is missing or the group is unknown, -1 if too many are missing.
+
+   int recover(const CPacket& parity, CPacket& packet, int32_t* missing, int& num);
+
+private:
+   struct CGroup
+   {
+      int32_t m_iStart;                 // first seq. no.
+      int m_iSize;                      // number of packets, 0 if the slot is unused
+      int m_iCount;                     // packets received
+      uint64_t m_ullMask;               // received packets, bit i for m_iStart + i
+      bool m_bDone;                     // parity processed or no longer expected
+      bool m_bWaited;                   // still expected at the last expire() call
+      char* m_pcData;                   // XOR of the received packets, in the parity layout
+   };
+
+   CGroup* locate(const int32_t& seqno);
+   void truncate(CGroup* g, const int& nextsize);
+   CGroup* find(const int32_t& seqno) const;
+   CGroup* oldestPending() const;
+
+private:
+   static const int m_iGroupCount;      // groups kept while their parity is expected
+   static const int m_iReorderDist;     // packets after the end of a group that may arrive before its parity
+
+   CGroup* m_pGroup;                    // ring of groups, ordered by seq. no.
+   int m_iNewest;                       // index of the newest group in the ring, -1 if none
+   int m_iPayloadSize;                  // largest payload of the parity
+
+   int32_t m_iNextStart;                // first seq. no. of the group after the newest one
+   int m_iNextSize;                     // size of the group after the newest one
+
+private:
+   CFECDecoder(const CFECDecoder&);
+   CFECDecoder& operator=(const CFECDecoder&);
+};
+
+
+#endif
@@ -38,6 +38,7 @@ written by
    Yunhong Gu, last updated 05/05/2009
 *****************************************************************************/
 
+#include <cstring>
 #include "list.h"
 
 CSndLossList::CSndLossList(const int& size):
@@ -86,6 +87,24 @@ int CSndLossList::insert(const int32_t& seqno1, const int32_t& seqno2)
 {
    CGuard listguard(m_ListLock);
 
+   return insert_(seqno1, seqno2);
+}
+
+int CSndLossList::insert(const int32_t* ranges, const int& num)
+{
+   CGuard listguard(m_ListLock);
+
+   // one lock for the whole batch; insert_() searches for the prior node from m_iLastInsertPos when that lies
+   // before the new range, and with the ranges in increasing order it always does after the first one
+   int inserted = 0;
+   for (int i = 0; i < num; ++ i)
+      inserted += insert_(ranges[2 * i], ranges[2 * i + 1]);
+
+   return inserted;
+}
+
+int CSndLossList::insert_(const int32_t& seqno1, const int32_t& seqno2)
+{
    if (0 == m_iLength)
    {
       // insert data into an empty list
@@ -686,7 +705,7 @@ int CRcvLossList::getFirstLostSeq() const
    return m_piData1[m_iHead];
 }
 
-void CRcvLossList::getLossArray(int32_t* array, int& len, const int& limit, const int& threshold)
+void CRcvLossList::getLossArray(int32_t* array, int& len, const int& limit, const int& threshold, const int32_t& from, const int32_t& to)
 {
    len = 0;
 
@@ -696,15 +715,34 @@ void CRcvLossList::getLossArray(int32_t* array, int& len, const int& limit, cons
 
    int i = m_iHead;
 
+   // skip the ranges that end before "from"
+   if (-1 != from)
+   {
+      while ((-1 != i) && (CSeqNo::seqcmp((-1 == m_piData2[i]) ? m_piData1[i] : m_piData2[i], from) < 0))
+         i = m_piNext[i];
+   }
+
    while ((len < limit - 1) && (-1 != i))
    {
-      array[len] = m_piData1[i];
-      if (-1 != m_piData2[i])
+      int32_t first = m_piData1[i];
+      if ((-1 != from) && (CSeqNo::seqcmp(first, from) < 0))
+         first = from;
+
+      // the ranges are ordered, none of the following ones is reported either
+      if ((-1 != to) && (CSeqNo::seqcmp(first, to) > 0))
+         break;
+
+      int32_t last = m_piData2[i];
+      if ((-1 != to) && (-1 != last) && (CSeqNo::seqcmp(last, to) > 0))
+         last = to;
+
+      array[len] = first;
+      if ((-1 != last) && (first != last))
       {
          // there are more than 1 loss in the sequence
          array[len] |= 0x80000000;
          ++ len;
-         array[len] = m_piData2[i];
+         array[len] = last;
       }
 
       ++ len;
@@ -714,3 +752,124 @@ void CRcvLossList::getLossArray(int32_t* array, int& len, const int& limit, cons
 
    m_TimeStamp = CTimer::getTime();
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool CLossReport::compress(int32_t* array, int& len, const int& limit)
+{
+   if (len < 3)
+      return false;
+
+   int32_t first = array[0] & 0x7FFFFFFF;
+   int32_t last = array[len - 1];
+
+   // bit k of word j stands for first + 1 + 32 * j + k
+   int words = (CSeqNo::seqoff(first, last) + 31) / 32;
+   if ((1 + words >= len) || (1 + words > limit))
+      return false;
+
+   uint32_t* bitmap = new uint32_t[words];
+   memset(bitmap, 0, words * 4);
+
+   for (int i = 0; i < len; ++ i)
+   {
+      int32_t seqno1 = array[i] & 0x7FFFFFFF;
+      int32_t seqno2 = seqno1;
+      if (0 != (array[i] & 0x80000000))
+         seqno2 = array[++ i];
+
+      for (int off = CSeqNo::seqoff(first, seqno1), end = CSeqNo::seqoff(first, seqno2); off <= end; ++ off)
+      {
+         if (off > 0)
+            bitmap[(off - 1) >> 5] |= 1U << ((off - 1) & 31);
+      }
+   }
+
+   array[0] = first;
+   memcpy(array + 1, bitmap, words * 4);
+   len = 1 + words;
+
+   delete [] bitmap;
+
+   return true;
+}
+
+int CLossReport::decode(const int32_t* report, const int& len, const bool& bitmap, int32_t* ranges, const int& limit)
+{
+   int num = 0;
+
+   if (!bitmap)
+   {
+      for (int i = 0; i < len; ++ i)
+      {
+         if (num == limit)
+            return -1;
+
+         ranges[2 * num] = report[i] & 0x7FFFFFFF;
+         if (0 != (report[i] & 0x80000000))
+         {
+            // a range must have its end
+            if (++ i == len)
+               return -1;
+            ranges[2 * num + 1] = report[i];
+         }
+         else
+            ranges[2 * num + 1] = report[i];
+
+         ++ num;
+      }
+
+      return num;
+   }
+
+   if ((len < 1) || (0 != (report[0] & 0x80000000)))
+      return -1;
+
+   ranges[0] = ranges[1] = report[0];
+   num = 1;
+
+   // extend the current range while the bits are set, start a new one after a gap
+   int prev = 0;
+   for (int j = 0; j < len - 1; ++ j)
+   {
+      for (uint32_t word = report[j + 1]; 0 != word; word &= word - 1)
+      {
+         int k = 0;
+         while (0 == (word & (1U << k)))
+            ++ k;
+
+         int off = 32 * j + k + 1;
+         if (off == prev + 1)
+            ranges[2 * num - 1] = CSeqNo::incseq(ranges[2 * num - 1]);
+         else
+         {
+            if (num == limit)
+               return -1;
+
+            ranges[2 * num] = ranges[2 * num + 1] = CSeqNo::incseq(report[0], off);
+            ++ num;
+         }
+         prev = off;
+      }
+   }
+
+   return num;
+}
+
+int CLossReport::encode(const int32_t* ranges, const int& num, int32_t* array)
+{
+   int len = 0;
+
+   for (int i = 0; i < num; ++ i)
+   {
+      if (ranges[2 * i] == ranges[2 * i + 1])
+         array[len ++] = ranges[2 * i];
+      else
+      {
+         array[len ++] = ranges[2 * i] | 0x80000000;
+         array[len ++] = ranges[2 * i + 1];
+      }
+   }
+
+   return len;
+}
@@ -62,6 +62,16 @@ public:
 
    int insert(const int32_t& seqno1, const int32_t& seqno2);
 
+      // Functionality:
+      //    Insert a batch of seq. no. ranges, e.g., all the ranges of one loss report, into the sender loss list.
+      // Parameters:
+      //    0) [in] ranges: pairs of starting and ending sequence numbers, in increasing order.
+      //    1) [in] num: number of pairs.
+      // Returned value:
+      //    number of packets that are not in the list previously.
+
+   int insert(const int32_t* ranges, const int& num);
+
       // Functionality:
       //    Remove ALL the seq. no. that are not greater than the parameter.
       // Parameters:
@@ -89,6 +99,9 @@ public:
 
    int32_t getLostSeq();
 
+private:
+   int insert_(const int32_t& seqno1, const int32_t& seqno2);
+
 private:
    int32_t* m_piData1;                  // sequence number starts
    int32_t* m_piData2;                  // seqnence number ends
@@ -178,10 +191,12 @@ public:
       //    1) [out] physical length of the result array.
       //    2) [in] limit: maximum length of the array.
       //    3) [in] threshold: Time threshold from last NAK report.
+      //    4) [in] from: only report the seq. no. not smaller than this one, -1 for the whole list.
+      //    5) [in] to: only report the seq. no. not greater than this one, -1 for the whole list.
       // Returned value:
       //    None.
 
-   void getLossArray(int32_t* array, int& len, const int& limit, const int& threshold);
+   void getLossArray(int32_t* array, int& len, const int& limit, const int& threshold, const int32_t& from = -1, const int32_t& to = -1);
 
 private:
    int32_t* m_piData1;                  // sequence number starts
@@ -201,5 +216,51 @@ private:
    CRcvLossList& operator=(const CRcvLossList&);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Loss reports (NAK) carry a loss array: a seq. no. with the highest bit set starts a range that ends with
+// the next seq. no., any other seq. no. is a single loss. Between peers that agreed on compact loss reports
+// a NAK may instead carry a bitmap, flagged by 1 in the additional information field of the packet header:
+// the first lost seq. no. followed by 32-bit words in which bit k of word j marks seq. no. + 1 + 32 * j + k.
+
+class CLossReport
+{
+public:
+      // Functionality:
+      //    Replace a loss array by its bitmap encoding if that is shorter.
+      // Parameters:
+      //    0) [in, out] array: the loss array, with room for "limit" values.
+      //    1) [in, out] len: length of the array.
+      //    2) [in] limit: maximum length of the array.
+      // Returned value:
+      //    true if the array has been replaced by a bitmap, otherwise false.
+
+   static bool compress(int32_t* array, int& len, const int& limit);
+
+      // Functionality:
+      //    Decode a loss report into seq. no. ranges.
+      // Parameters:
+      //    0) [in] report: the loss array or bitmap.
+      //    1) [in] len: length of the report.
+      //    2) [in] bitmap: if the report is a bitmap.
+      //    3) [out] ranges: pairs of starting and ending sequence numbers, with room for "limit" pairs.
+      //    4) [in] limit: maximum number of pairs.
+      // Returned value:
+      //    number of pairs, or -1 if the report is malformed.
+
+   static int decode(const int32_t* report, const int& len, const bool& bitmap, int32_t* ranges, const int& limit);
+
+      // Functionality:
+      //    Encode seq. no. ranges as a loss array.
+      // Parameters:
+      //    0) [in] ranges: pairs of starting and ending sequence numbers.
+      //    1) [in] num: number of pairs.
+      //    2) [out] array: the loss array, with room for 2 * "num" values.
+      // Returned value:
+      //    length of the loss array.
+
+   static int encode(const int32_t* ranges, const int& num, int32_t* array);
+};
+
 
 #endif
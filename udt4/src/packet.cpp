@@ -119,6 +119,27 @@ written by
 //      8: Error Signal from the Peer Side
 //              Add. Info:    Error code
 //              Control Info: None
+//      9: FEC Parity
+//              Add. Info:    first sequence number of the group
+//              Control Info: group size << 16 | size of the next group
+//                            XOR of the payload lengths, XOR of the message numbers, XOR of the payloads
+//     10: Path Join
+//              Add. Info:    path number, from 1
+//              Control Info: 0 for a request (sent on the new path), 1 for the response (sent on the primary path)
+//                            initial sequence number of the connection
+//                            socket ID of the sender
+//                            request only: MAC of the path number, keyed with the connection token of the receiver
+//     11: Path Validation
+//              Add. Info:    Undefined
+//              Control Info: 0 for an announcement (the peer may see a new address), 1 for a challenge (sent to
+//                            the new address, or by a connection accepted on a ticket), 2 for the response
+//                            random challenge, 0 in an announcement
+//                            connection token of the receiver, from the hand shake
+//     12: Path MTU Probe
+//              Add. Info:    probe number
+//              Control Info: 0 for a probe, 1 for the reply
+//                            packet size (probe: size being tested, reply: size that arrived)
+//                            a probe is padded with zeros to the size it tests
 //      0x7FFF: Explained by bits 16 - 31
 //              
 //   bit 16 - 31:
@@ -149,6 +170,7 @@ written by
 
 const int CPacket::m_iPktHdrSize = 16;
 const int CHandShake::m_iContentSize = 48;
+const int CHandShake::m_iExtContentSize = 72;
 
 
 // Set up the aliases in the constructure
@@ -214,6 +236,10 @@ void CPacket::pack(const int& pkttype, void* lparam, void* rparam, const int& si
       break;
 
    case 3: //0011 - Loss Report (NAK)
+      // loss list encoding, 1 for a bitmap, see CLossReport
+      if (NULL != lparam)
+         m_nHeader[1] = *(int32_t *)lparam;
+
       // loss list
       m_PacketVector[1].iov_base = (char *)rparam;
       m_PacketVector[1].iov_len = size;
@@ -261,6 +287,43 @@ void CPacket::pack(const int& pkttype, void* lparam, void* rparam, const int& si
 
       break;
 
+   case 9: //1001 - FEC Parity
+      // first seq. no. of the group
+      m_nHeader[1] = *(int32_t *)lparam;
+
+      // group sizes and XOR of the group, see CFECEncoder
+      m_PacketVector[1].iov_base = (char *)rparam;
+      m_PacketVector[1].iov_len = size;
+
+      break;
+
+   case 10: //1010 - Path Join
+      // path number
+      m_nHeader[1] = *(int32_t *)lparam;
+
+      // request or response, ISN, socket ID
+      m_PacketVector[1].iov_base = (char *)rparam;
+      m_PacketVector[1].iov_len = size;
+
+      break;
+
+   case 11: //1011 - Path Validation
+      // announcement, challenge or response, challenge, token
+      m_PacketVector[1].iov_base = (char *)rparam;
+      m_PacketVector[1].iov_len = size;
+
+      break;
+
+   case 12: //1100 - Path MTU Probe
+      // probe number
+      m_nHeader[1] = *(int32_t *)lparam;
+
+      // probe or reply, packet size, padding
+      m_PacketVector[1].iov_base = (char *)rparam;
+      m_PacketVector[1].iov_len = size;
+
+      break;
+
    case 8: //1000 - Error Signal from the Peer Side
       // Error type
       m_nHeader[1] = *(int32_t *)lparam;
@@ -361,7 +424,13 @@ m_iFlightFlagSize(0),
 m_iReqType(0),
 m_iID(0),
 m_iCookie(0),
-m_piPeerIP()
+m_piPeerIP(),
+m_iACKMode(0),
+m_iLossMode(0),
+m_iFECMode(0),
+m_iToken(0),
+m_iTicketTime(0),
+m_iTicket(0)
 {
 }
 
@@ -382,6 +451,21 @@ int CHandShake::serialize(char* buf, const int& size)
    for (int i = 0; i < 4; ++ i)
       *p++ = m_piPeerIP[i];
 
+   // the extension fields are only written when the packet has room for them
+   if (size >= m_iContentSize + 4)
+      *p++ = m_iACKMode;
+   if (size >= m_iContentSize + 8)
+      *p++ = m_iLossMode;
+   if (size >= m_iContentSize + 12)
+      *p++ = m_iFECMode;
+   if (size >= m_iContentSize + 16)
+      *p++ = m_iToken;
+   if (size >= m_iContentSize + 24)
+   {
+      *p++ = m_iTicketTime;
+      *p++ = m_iTicket;
+   }
+
    return 0;
 }
 
@@ -402,5 +486,13 @@ int CHandShake::deserialize(const char* buf, const int& size)
    for (int i = 0; i < 4; ++ i)
       m_piPeerIP[i] = *p++;
 
+   // older peers send the basic hand shake only, or fewer extension fields
+   m_iACKMode = (size >= m_iContentSize + 4) ? *p++ : 0;
+   m_iLossMode = (size >= m_iContentSize + 8) ? *p++ : 0;
+   m_iFECMode = (size >= m_iContentSize + 12) ? *p++ : 0;
+   m_iToken = (size >= m_iContentSize + 16) ? *p++ : 0;
+   m_iTicketTime = (size >= m_iContentSize + 24) ? *p++ : 0;
+   m_iTicket = (size >= m_iContentSize + 24) ? *p++ : 0;
+
    return 0;
 }
@@ -44,14 +44,6 @@ written by
 
 #include "udt.h"
 
-#ifdef WIN32
-   struct iovec
-   {
-      int iov_len;
-      char* iov_base;
-   };
-#endif
-
 class CChannel;
 
 class CPacket
@@ -206,6 +198,7 @@ public:
 
 public:
    static const int m_iContentSize;	// Size of hand shake data
+   static const int m_iExtContentSize;	// Size of hand shake data with the extension fields
 
 public:
    int32_t m_iVersion;          // UDT version
@@ -217,6 +210,14 @@ public:
    int32_t m_iID;		// socket ID
    int32_t m_iCookie;		// cookie
    uint32_t m_piPeerIP[4];	// The IP address that the peer's UDP port is bound to
+
+   // extension, absent in hand shakes from older peers
+   int32_t m_iACKMode;		// ACK frequency: 0: a light ACK every 64 packets, 1: adaptive to rate and RTT
+   int32_t m_iLossMode;		// loss reports: 0: loss arrays, 1: loss arrays or bitmaps, coalesced per RTT
+   int32_t m_iFECMode;		// FEC: 0: not supported, 1: parity accepted, > 1: parity sent, with this initial group size
+   int32_t m_iToken;		// connection token the peer has to present to move the connection to a new address, 0: no migration
+   int32_t m_iTicketTime;	// resumption ticket: expiry, in seconds of the issuing listener's clock, 0: no ticket
+   int32_t m_iTicket;		// resumption ticket: the listener's signature over the client host and the expiry
 };
 
 
@@ -187,7 +187,54 @@ int CUnitQueue::increase()
 
 int CUnitQueue::shrink()
 {
-   // currently queue cannot be shrunk.
+   // recount like increase() does, the receiving buffers free units without telling the queue exactly
+   int real_count = 0;
+   CQEntry* p = m_pQEntry;
+   while (p != NULL)
+   {
+      CUnit* u = p->m_pUnit;
+      for (CUnit* end = u + p->m_iSize; u != end; ++ u)
+         if (u->m_iFlag != 0)
+            ++ real_count;
+
+      if (p == m_pLastQueue)
+         p = NULL;
+      else
+         p = p->m_pNext;
+   }
+   m_iCount = real_count;
+
+   // leave room for the queue to fill up to half again, increase() adds a block at 90%
+   if ((m_pQEntry == m_pLastQueue) || (m_iCount * 4 > m_iSize))
+      return -1;
+
+   // any block of which no unit is in use can go, the first one stays
+   CQEntry* prev = m_pQEntry;
+   for (CQEntry* q = m_pQEntry->m_pNext; q != m_pQEntry; prev = q, q = q->m_pNext)
+   {
+      bool used = false;
+      for (CUnit* u = q->m_pUnit, *end = q->m_pUnit + q->m_iSize; (u != end) && !used; ++ u)
+         used = (u->m_iFlag != 0);
+      if (used)
+         continue;
+
+      prev->m_pNext = q->m_pNext;
+      if (q == m_pLastQueue)
+         m_pLastQueue = prev;
+      if (q == m_pCurrQueue)
+      {
+         m_pCurrQueue = q->m_pNext;
+         m_pAvailUnit = m_pCurrQueue->m_pUnit;
+      }
+      m_iSize -= q->m_iSize;
+
+      delete [] q->m_pUnit;
+      delete [] q->m_pBuffer;
+      delete q;
+
+      return 0;
+   }
+
    return -1;
 }
 
@@ -276,14 +323,17 @@ void CSndUList::insert(const int64_t& ts, const CUDT* u)
       m_pHeap = temp;
    }
 
-   insert_(ts, u);
+   insert_(ts, u->m_pSNode);
 }
 
 void CSndUList::update(const CUDT* u, const bool& reschedule)
 {
-   CGuard listguard(m_ListLock);
+   update(u->m_pSNode, reschedule);
+}
 
-   CSNode* n = u->m_pSNode;
+void CSndUList::update(CSNode* n, const bool& reschedule)
+{
+   CGuard listguard(m_ListLock);
 
    if (n->m_iHeapLoc >= 0)
    {
@@ -297,44 +347,63 @@ void CSndUList::update(const CUDT* u, const bool& reschedule)
          return;
       }
 
-      remove_(u);
+      remove_(n);
    }
 
-   insert_(1, u);
+   insert_(1, n);
 }
 
-int CSndUList::pop(sockaddr*& addr, CPacket& pkt)
+int CSndUList::pop(sockaddr* addr, CPacket& pkt, bool& fragment)
 {
    CGuard listguard(m_ListLock);
 
    if (-1 == m_iLastEntry)
       return -1;
 
-   CUDT* u = m_pHeap[0]->m_pUDT;
-   remove_(u);
+   CSNode* n = m_pHeap[0];
+   CUDT* u = n->m_pUDT;
+   remove_(n);
 
    if (!u->m_bConnected || u->m_bBroken)
       return -1;
 
    // pack a packet from the socket
-   uint64_t ts;
-   if (u->packData(pkt, ts) <= 0)
+   uint64_t ts = 0;
+   if (u->packData(pkt, ts, n->m_iPath) <= 0)
+   {
+      // a path may have to wait for another one, e.g., to finish a probing pair
+      if (ts > 0)
+         insert_(ts, n);
       return -1;
+   }
 
-   addr = u->m_pPeerAddr;
+   // the peer address may be rewritten by a migration while the packet is sent, see CUDT::acceptMigration()
+   if (0 == n->m_iPath)
+      u->getPeerAddr(addr);
+   else
+      memcpy(addr, u->m_pPath[n->m_iPath - 1]->m_pPeerAddr, (AF_INET == u->m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+
+   // the data cut before the path MTU was lowered keeps its size, see CUDT::setPMTU(); with the don't
+   // fragment bit it would be lost on the path again and again
+   fragment = u->m_bPMTUD && (u->m_iPMTU < u->m_iMSS) && (pkt.getLength() > u->m_iSndPayloadSize);
 
    // insert a new entry, ts is the next processing time
    if (ts > 0)
-      insert_(ts, u);
+      insert_(ts, n);
 
    return 1;
 }
 
 void CSndUList::remove(const CUDT* u)
+{
+   remove(u->m_pSNode);
+}
+
+void CSndUList::remove(CSNode* n)
 {
    CGuard listguard(m_ListLock);
 
-   remove_(u);
+   remove_(n);
 }
 
 uint64_t CSndUList::getNextProcTime()
@@ -347,10 +416,8 @@ uint64_t CSndUList::getNextProcTime()
    return m_pHeap[0]->m_llTimeStamp;
 }
 
-void CSndUList::insert_(const int64_t& ts, const CUDT* u)
+void CSndUList::insert_(const int64_t& ts, CSNode* n)
 {
-   CSNode* n = u->m_pSNode;
-
    // do not insert repeated node
    if (n->m_iHeapLoc >= 0)
       return;
@@ -391,10 +458,8 @@ void CSndUList::insert_(const int64_t& ts, const CUDT* u)
    }
 }
 
-void CSndUList::remove_(const CUDT* u)
+void CSndUList::remove_(CSNode* n)
 {
-   CSNode* n = u->m_pSNode;
-
    if (n->m_iHeapLoc >= 0)
    {
       // remove the node from heap
@@ -520,12 +585,13 @@ void CSndQueue::init(const CChannel* c, const CTimer* t)
 		 uint64_t currenttime;
 		 CTimer::rdtsc(currenttime);
          // it is time to process it, pop it out/remove from the list
-         sockaddr* addr;
+         sockaddr_in6 addr;
          CPacket pkt;
-         if (self->m_pSndUList->pop(addr, pkt) < 0)
+         bool fragment;
+         if (self->m_pSndUList->pop((sockaddr*)&addr, pkt, fragment) < 0)
             continue;
 
-         self->m_pChannel->sendto(addr, pkt);
+         self->m_pChannel->sendto((sockaddr*)&addr, pkt, fragment);
       }
       else
       {
@@ -814,6 +880,12 @@ bool CRendezvousQueue::retrieve(const sockaddr* addr, UDTSOCKET& id)
 }
 
 
+const int CRcvQueue::m_iACKBatchSize = 64;
+const int CRcvQueue::m_iHSQueueSize = 1024;
+const int CRcvQueue::m_iMaxHSSize = CHandShake::m_iExtContentSize + CUDT::m_iMaxEarlyDataSize;
+const int CRcvQueue::m_iHSRate = 20000;
+const int CRcvQueue::m_iHSBurst = 256;
+
 //
 CRcvQueue::CRcvQueue():
 m_WorkerThread(),
@@ -827,24 +899,37 @@ m_bClosing(false),
 m_ExitCond(),
 m_LSLock(),
 m_pListener(NULL),
+m_pServing(NULL),
 m_pRendezvousQueue(NULL),
 m_vNewEntry(),
 m_IDLock(),
 m_mBuffer(),
 m_PassLock(),
-m_PassCond()
+m_PassCond(),
+m_HSThread(),
+m_pHSQueue(NULL),
+m_iHSHead(0),
+m_iHSCount(0),
+m_HSLock(),
+m_HSCond(),
+m_HSExitCond()
 {
    #ifndef WIN32
       pthread_mutex_init(&m_PassLock, NULL);
       pthread_cond_init(&m_PassCond, NULL);
       pthread_mutex_init(&m_LSLock, NULL);
       pthread_mutex_init(&m_IDLock, NULL);
+      pthread_mutex_init(&m_HSLock, NULL);
+      pthread_cond_init(&m_HSCond, NULL);
    #else
       m_PassLock = CreateMutex(NULL, false, NULL);
       m_PassCond = CreateEvent(NULL, false, false, NULL);
       m_LSLock = CreateMutex(NULL, false, NULL);
       m_IDLock = CreateMutex(NULL, false, NULL);
       m_ExitCond = CreateEvent(NULL, false, false, NULL);
+      m_HSLock = CreateMutex(NULL, false, NULL);
+      m_HSCond = CreateEvent(NULL, false, false, NULL);
+      m_HSExitCond = CreateEvent(NULL, false, false, NULL);
    #endif
 }
 
@@ -855,21 +940,46 @@ CRcvQueue::~CRcvQueue()
    #ifndef WIN32
       if (0 != m_WorkerThread)
          pthread_join(m_WorkerThread, NULL);
+      if (0 != m_HSThread)
+      {
+         pthread_mutex_lock(&m_HSLock);
+         pthread_cond_signal(&m_HSCond);
+         pthread_mutex_unlock(&m_HSLock);
+         pthread_join(m_HSThread, NULL);
+      }
       pthread_mutex_destroy(&m_PassLock);
       pthread_cond_destroy(&m_PassCond);
       pthread_mutex_destroy(&m_LSLock);
       pthread_mutex_destroy(&m_IDLock);
+      pthread_mutex_destroy(&m_HSLock);
+      pthread_cond_destroy(&m_HSCond);
    #else
       if (NULL != m_WorkerThread)
          WaitForSingleObject(m_ExitCond, INFINITE);
+      if (NULL != m_HSThread)
+      {
+         SetEvent(m_HSCond);
+         WaitForSingleObject(m_HSExitCond, INFINITE);
+      }
       CloseHandle(m_WorkerThread);
+      CloseHandle(m_HSThread);
       CloseHandle(m_PassLock);
       CloseHandle(m_PassCond);
       CloseHandle(m_LSLock);
       CloseHandle(m_IDLock);
       CloseHandle(m_ExitCond);
+      CloseHandle(m_HSLock);
+      CloseHandle(m_HSCond);
+      CloseHandle(m_HSExitCond);
    #endif
 
+   if (NULL != m_pHSQueue)
+   {
+      for (int i = 0; i < m_iHSQueueSize; ++ i)
+         delete [] m_pHSQueue[i].m_Packet.m_pcData;
+      delete [] m_pHSQueue;
+   }
+
    delete m_pRcvUList;
    delete m_pHash;
    delete m_pRendezvousQueue;
@@ -928,6 +1038,13 @@ void CRcvQueue::init(const int& qsize, const int& payload, const int& version, c
    CUDT* u = NULL;
    int32_t id;
 
+   // socket whose timer check is held back while it receives a burst of ACKs
+   CUDT* batched = NULL;
+   int batchsize = 0;
+
+   // when the unit queue may give back what a burst of packets made it allocate next
+   uint64_t shrinktime = 0;
+
    while (!self->m_bClosing)
    {
       #ifdef NO_BUSY_WAITING
@@ -935,15 +1052,7 @@ void CRcvQueue::init(const int& qsize, const int& payload, const int& version, c
       #endif
 
       // check waiting list, if new socket, insert it to the list
-      while (self->ifNewEntry())
-      {
-         CUDT* ne = self->getNewEntry();
-         if (NULL != ne)
-         {
-            self->m_pRcvUList->insert(ne);
-            self->m_pHash->insert(ne->m_SocketID, ne);
-         }
-      }
+      self->insertNewEntries();
 
       // find next available slot for incoming packet
       CUnit* unit = self->m_UnitQueue.getNextAvailUnit();
@@ -960,8 +1069,8 @@ void CRcvQueue::init(const int& qsize, const int& payload, const int& version, c
 
       unit->m_Packet.setLength(self->m_iPayloadSize);
 
-      // reading next incoming packet
-      if (self->m_pChannel->recvfrom(addr, unit->m_Packet) <= 0)
+      // reading next incoming packet, during an ACK burst only the packets already queued are read
+      if (self->m_pChannel->recvfrom(addr, unit->m_Packet, NULL == batched) <= 0)
          goto TIMER_CHECK;
 
       id = unit->m_Packet.m_iID;
@@ -970,25 +1079,52 @@ void CRcvQueue::init(const int& qsize, const int& payload, const int& version, c
       if (0 == id)
       {
          if (NULL != self->m_pListener)
-            ((CUDT*)self->m_pListener)->listen(addr, unit->m_Packet);
+            self->queueRequest(addr, unit->m_Packet);
          else if (self->m_pRendezvousQueue->retrieve(addr, id))
             self->storePkt(id, unit->m_Packet.clone());
       }
       else if (id > 0)
       {
-         if (NULL != (u = self->m_pHash->lookup(id)))
+         // a socket that connected while this thread was waiting for the packet is not in the hash table yet
+         if (NULL == (u = self->m_pHash->lookup(id)))
+         {
+            self->insertNewEntries();
+            u = self->m_pHash->lookup(id);
+         }
+
+         if (NULL != u)
          {
-            if (CIPAddress::ipcmp(addr, u->m_pPeerAddr, u->m_iIPversion))
+            // besides the peer address, the addresses of the additional paths that have joined are accepted,
+            // and a peer that has moved to a new address is followed once the address is validated
+            if (CIPAddress::ipcmp(addr, u->m_pPeerAddr, u->m_iIPversion) || u->acceptPath(addr, unit->m_Packet) || u->acceptMigration(addr, unit->m_Packet))
             {
                if (u->m_bConnected && !u->m_bBroken && !u->m_bClosing)
                {
+                  if ((NULL != batched) && (batched != u))
+                  {
+                     batched->checkTimers();
+                     self->m_pRcvUList->update(batched);
+                     batched = NULL;
+                     batchsize = 0;
+                  }
+
                   if (0 == unit->m_Packet.getFlag())
                      u->processData(unit);
                   else
                      u->processCtrl(unit->m_Packet);
 
+                  // back to back ACKs are processed as one batch: the timer check, which applies the newest
+                  // ACK to the sender buffer and the congestion control, runs once at the end of the burst
+                  if ((1 == unit->m_Packet.getFlag()) && (2 == unit->m_Packet.getType()) && (++ batchsize < m_iACKBatchSize))
+                  {
+                     batched = u;
+                     continue;
+                  }
+
                   u->checkTimers();
                   self->m_pRcvUList->update(u);
+                  batched = NULL;
+                  batchsize = 0;
                }
             }
          }
@@ -997,6 +1133,15 @@ void CRcvQueue::init(const int& qsize, const int& payload, const int& version, c
       }
 
 TIMER_CHECK:
+      // the ACK burst is over, sockets must not be held back across the removal below
+      if (NULL != batched)
+      {
+         batched->checkTimers();
+         self->m_pRcvUList->update(batched);
+         batched = NULL;
+         batchsize = 0;
+      }
+
       // take care of the timing event for all UDT sockets
 
       CRNode* ul = self->m_pRcvUList->m_pUList;
@@ -1004,6 +1149,12 @@ TIMER_CHECK:
       CTimer::rdtsc(currtime);
       uint64_t ctime = currtime - 100000 * CTimer::getCPUFrequency();
 
+      if (currtime > shrinktime)
+      {
+         self->m_UnitQueue.shrink();
+         shrinktime = currtime + 1000000 * CTimer::getCPUFrequency();
+      }
+
       while ((NULL != ul) && (ul->m_llTimeStamp < ctime))
       {
          CUDT* u = ul->m_pUDT;
@@ -1038,6 +1189,123 @@ TIMER_CHECK:
    #endif
 }
 
+#ifndef WIN32
+   void* CRcvQueue::handshaker(void* param)
+#else
+   DWORD WINAPI CRcvQueue::handshaker(LPVOID param)
+#endif
+{
+   CRcvQueue* self = (CRcvQueue*)param;
+
+   int addrlen = (AF_INET == self->m_UnitQueue.m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+   sockaddr* addr = (AF_INET == self->m_UnitQueue.m_iIPversion) ? (sockaddr*) new sockaddr_in : (sockaddr*) new sockaddr_in6;
+   CPacket packet;
+   packet.m_pcData = new char [m_iMaxHSSize];
+
+   // token bucket, every request served takes one token; while it is empty the requests wait in the
+   // ring, and the receiving worker drops new ones once the ring is full
+   double tokens = m_iHSBurst;
+   uint64_t lasttime = CTimer::getTime();
+
+   while (!self->m_bClosing)
+   {
+      uint64_t currtime = CTimer::getTime();
+      tokens += (currtime - lasttime) * (m_iHSRate / 1000000.0);
+      if (tokens > m_iHSBurst)
+         tokens = m_iHSBurst;
+      lasttime = currtime;
+
+      CGuard::enterCS(self->m_HSLock);
+
+      if ((0 == self->m_iHSCount) || (tokens < 1))
+      {
+         // wait for a request, or for the next token, up to 1 second so that closing is noticed
+         uint64_t wait = (tokens < 1) ? (uint64_t)((1 - tokens) * 1000000 / m_iHSRate) + 1 : 1000000;
+
+         #ifndef WIN32
+            uint64_t exptime = currtime + wait;
+            timespec timeout;
+            timeout.tv_sec = exptime / 1000000;
+            timeout.tv_nsec = (exptime % 1000000) * 1000;
+            pthread_cond_timedwait(&self->m_HSCond, &self->m_HSLock, &timeout);
+         #else
+            ReleaseMutex(self->m_HSLock);
+            WaitForSingleObject(self->m_HSCond, DWORD(wait / 1000) + 1);
+            WaitForSingleObject(self->m_HSLock, INFINITE);
+         #endif
+
+         CGuard::leaveCS(self->m_HSLock);
+         continue;
+      }
+
+      CHSRequest& r = self->m_pHSQueue[self->m_iHSHead];
+      memcpy(packet.m_nHeader, r.m_Packet.m_nHeader, CPacket::m_iPktHdrSize);
+      memcpy(packet.m_pcData, r.m_Packet.m_pcData, r.m_Packet.getLength());
+      packet.setLength(r.m_Packet.getLength());
+      memcpy(addr, &r.m_Addr, addrlen);
+      self->m_iHSHead = (self->m_iHSHead + 1) % m_iHSQueueSize;
+      -- self->m_iHSCount;
+
+      CGuard::leaveCS(self->m_HSLock);
+
+      tokens -= 1;
+
+      // the listener is read again for every request, it may have been removed meanwhile; while the request is
+      // served it is held, the socket is not deleted before ifServing() lets it go, see CUDTUnited::removeSocket()
+      CGuard::enterCS(self->m_LSLock);
+      CUDT* listener = (CUDT*)self->m_pListener;
+      self->m_pServing = listener;
+      CGuard::leaveCS(self->m_LSLock);
+
+      if (NULL != listener)
+         listener->listen(addr, packet);
+
+      CGuard::enterCS(self->m_LSLock);
+      self->m_pServing = NULL;
+      CGuard::leaveCS(self->m_LSLock);
+   }
+
+   delete [] packet.m_pcData;
+   if (AF_INET == self->m_UnitQueue.m_iIPversion)
+      delete (sockaddr_in*)addr;
+   else
+      delete (sockaddr_in6*)addr;
+
+   #ifndef WIN32
+      return NULL;
+   #else
+      SetEvent(self->m_HSExitCond);
+      return 0;
+   #endif
+}
+
+bool CRcvQueue::queueRequest(const sockaddr* addr, const CPacket& packet)
+{
+   // no valid request is larger, listen() would reject it anyway
+   if ((packet.getLength() < 0) || (packet.getLength() > m_iMaxHSSize))
+      return false;
+
+   CGuard hsguard(m_HSLock);
+
+   if (m_iHSCount == m_iHSQueueSize)
+      return false;
+
+   CHSRequest& r = m_pHSQueue[(m_iHSHead + m_iHSCount) % m_iHSQueueSize];
+   memcpy(r.m_Packet.m_nHeader, packet.m_nHeader, CPacket::m_iPktHdrSize);
+   memcpy(r.m_Packet.m_pcData, packet.m_pcData, packet.getLength());
+   r.m_Packet.setLength(packet.getLength());
+   memcpy(&r.m_Addr, addr, (AF_INET == m_UnitQueue.m_iIPversion) ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+   ++ m_iHSCount;
+
+   #ifndef WIN32
+      pthread_cond_signal(&m_HSCond);
+   #else
+      SetEvent(m_HSCond);
+   #endif
+
+   return true;
+}
+
 int CRcvQueue::recvfrom(const int32_t& id, CPacket& packet)
 {
    CGuard bufferlock(m_PassLock);
@@ -1101,6 +1369,33 @@ int CRcvQueue::setListener(const CUDT* u)
    if (NULL != m_pListener)
       return -1;
 
+   // the connection requests are served by their own thread, started with the first listener
+   if (NULL == m_pHSQueue)
+   {
+      m_pHSQueue = new CHSRequest[m_iHSQueueSize];
+      for (int i = 0; i < m_iHSQueueSize; ++ i)
+         m_pHSQueue[i].m_Packet.m_pcData = new char [m_iMaxHSSize];
+
+      #ifndef WIN32
+         if (0 != pthread_create(&m_HSThread, NULL, CRcvQueue::handshaker, this))
+            m_HSThread = 0;
+         bool started = (0 != m_HSThread);
+      #else
+         DWORD threadID;
+         m_HSThread = CreateThread(NULL, 0, CRcvQueue::handshaker, this, 0, &threadID);
+         bool started = (NULL != m_HSThread);
+      #endif
+
+      if (!started)
+      {
+         for (int i = 0; i < m_iHSQueueSize; ++ i)
+            delete [] m_pHSQueue[i].m_Packet.m_pcData;
+         delete [] m_pHSQueue;
+         m_pHSQueue = NULL;
+         throw CUDTException(3, 1);
+      }
+   }
+
    m_pListener = (CUDT*)u;
    return 1;
 }
@@ -1113,6 +1408,13 @@ void CRcvQueue::removeListener(const CUDT* u)
       m_pListener = NULL;
 }
 
+bool CRcvQueue::ifServing(const CUDT* u)
+{
+   CGuard lslock(m_LSLock);
+
+   return u == m_pServing;
+}
+
 void CRcvQueue::setNewEntry(CUDT* u)
 {
    CGuard listguard(m_IDLock);
@@ -1137,6 +1439,19 @@ CUDT* CRcvQueue::getNewEntry()
    return u;
 }
 
+void CRcvQueue::insertNewEntries()
+{
+   while (ifNewEntry())
+   {
+      CUDT* ne = getNewEntry();
+      if (NULL != ne)
+      {
+         m_pRcvUList->insert(ne);
+         m_pHash->insert(ne->m_SocketID, ne);
+      }
+   }
+}
+
 void CRcvQueue::storePkt(const int32_t& id, CPacket* pkt)
 {
    CGuard bufferlock(m_PassLock);   
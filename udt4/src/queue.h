@@ -89,7 +89,7 @@ public:
    int increase();
 
       // Functionality:
-      //    Decrease (halve) the unit queue size.
+      //    Release a block of units none of which is in use, if at most a quarter of the queue is used.
       // Parameters:
       //    None.
       // Returned value:
@@ -138,6 +138,7 @@ struct CSNode
    uint64_t m_llTimeStamp;      // Time Stamp
 
    int m_iHeapLoc;		// location on the heap, -1 means not on the heap
+   int m_iPath;			// path the packets of this node are sent on, 0 for the primary path
 };
 
 class CSndUList
@@ -170,15 +171,26 @@ public:
 
    void update(const CUDT* u, const bool& reschedule = true);
 
+      // Functionality:
+      //    Update the timestamp of a node on the list, e.g., the node of an additional path.
+      // Parameters:
+      //    1) [in] n: pointer to the node
+      //    2) [in] resechedule: if the timestampe shoudl be rescheduled
+      // Returned value:
+      //    None.
+
+   void update(CSNode* n, const bool& reschedule = true);
+
       // Functionality:
       //    Retrieve the next packet and peer address from the first entry, and reschedule it in the queue.
       // Parameters:
-      //    0) [out] addr: destination address of the next packet
+      //    0) [out] addr: destination address of the next packet, copied into storage for a sockaddr_in6
       //    1) [out] pkt: the next packet to be sent
+      //    2) [out] fragment: if the packet is larger than the path MTU now allows and goes out in fragments
       // Returned value:
       //    1 if successfully retrieved, -1 if no packet found.
 
-   int pop(sockaddr*& addr, CPacket& pkt);
+   int pop(sockaddr* addr, CPacket& pkt, bool& fragment);
 
       // Functionality:
       //    Remove UDT instance from the list.
@@ -189,6 +201,15 @@ public:
 
    void remove(const CUDT* u);
 
+      // Functionality:
+      //    Remove a node from the list.
+      // Parameters:
+      //    1) [in] n: pointer to the node
+      // Returned value:
+      //    None.
+
+   void remove(CSNode* n);
+
       // Functionality:
       //    Retrieve the next scheduled processing time.
       // Parameters:
@@ -199,8 +220,8 @@ public:
    uint64_t getNextProcTime();
 
 private:
-   void insert_(const int64_t& ts, const CUDT* u);
-   void remove_(const CUDT* u);
+   void insert_(const int64_t& ts, CSNode* n);
+   void remove_(CSNode* n);
 
 private:
    CSNode** m_pHeap;			// The heap array
@@ -460,6 +481,8 @@ private:
 
    pthread_t m_WorkerThread;
 
+   static const int m_iACKBatchSize;	// maximum number of back to back ACKs read before the timers are checked
+
 private:
    CUnitQueue m_UnitQueue;		// The received packet queue
 
@@ -476,16 +499,19 @@ private:
 private:
    int setListener(const CUDT* u);
    void removeListener(const CUDT* u);
+   bool ifServing(const CUDT* u);
 
    void setNewEntry(CUDT* u);
    bool ifNewEntry();
    CUDT* getNewEntry();
+   void insertNewEntries();
 
    void storePkt(const int32_t& id, CPacket* pkt);
 
 private:
    pthread_mutex_t m_LSLock;
    volatile CUDT* m_pListener;                          // pointer to the (unique, if any) listening UDT entity
+   CUDT* m_pServing;                                    // listener whose connection request is being served, NULL if none
    CRendezvousQueue* m_pRendezvousQueue;                // The list of sockets in rendezvous mode
 
    std::vector<CUDT*> m_vNewEntry;                      // newly added entries, to be inserted
@@ -495,6 +521,35 @@ private:
    pthread_mutex_t m_PassLock;
    pthread_cond_t m_PassCond;
 
+private: // connection requests for the listener, served by their own thread so that a flood of them
+         // cannot hold up the data of the connected sockets
+#ifndef WIN32
+   static void* handshaker(void* param);
+#else
+   static DWORD WINAPI handshaker(LPVOID param);
+#endif
+
+   bool queueRequest(const sockaddr* addr, const CPacket& packet);
+
+   struct CHSRequest
+   {
+      sockaddr_in6 m_Addr;			// address of the requesting peer, sockaddr_in for IPv4
+      CPacket m_Packet;				// the request
+   };
+
+   pthread_t m_HSThread;
+   CHSRequest* m_pHSQueue;			// ring of pending requests, allocated for the first listener
+   int m_iHSHead;				// first pending request
+   int m_iHSCount;				// number of pending requests, new ones are dropped while the ring is full
+   pthread_mutex_t m_HSLock;
+   pthread_cond_t m_HSCond;
+   pthread_cond_t m_HSExitCond;
+
+   static const int m_iHSQueueSize;		// capacity of the ring, 1024 requests
+   static const int m_iMaxHSSize;		// largest request kept: extended hand shake and the most early data
+   static const int m_iHSRate;			// requests served per second, at most
+   static const int m_iHSBurst;			// requests served back to back after an idle period
+
 private:
    CRcvQueue(const CRcvQueue&);
    CRcvQueue& operator=(const CRcvQueue&);
@@ -510,6 +565,7 @@ struct CMultiplexer
    int m_iPort;			// The UDP port number of this multiplexer
    int m_iIPversion;		// IP version
    int m_iMSS;			// Maximum Segment Size
+   bool m_bPMTUD;		// if the channel sends with fragmentation off, for path MTU probing
    int m_iRefCount;		// number of UDT instances that are associated with this multiplexer
    bool m_bReusable;		// if this one can be shared with others
 
@@ -45,6 +45,7 @@ written by
 #ifndef WIN32
    #include <sys/types.h>
    #include <sys/socket.h>
+   #include <sys/uio.h>
    #include <netinet/in.h>
 #else
    #include <windows.h>
@@ -117,6 +118,15 @@ typedef int UDTSOCKET;
    typedef SOCKET SYSSOCKET;
 #endif
 
+#ifdef WIN32
+   // laid out as WSABUF, so that a vector can be passed to WSASendTo()/WSARecvFrom() as it is
+   struct iovec
+   {
+      int iov_len;
+      char* iov_base;
+   };
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 
 typedef std::set<UDTSOCKET> ud_set;
@@ -131,7 +141,8 @@ enum EPOLLOpt
    // so that if system values are used by mistake, they should have the same effect
    UDT_EPOLL_IN = 0x1,
    UDT_EPOLL_OUT = 0x4,
-   UDT_EPOLL_ERR = 0x8
+   UDT_EPOLL_ERR = 0x8,
+   UDT_EPOLL_ET = 1u << 31
 };
 
 
@@ -155,7 +166,13 @@ enum UDTOpt
    UDT_SNDTIMEO,        // send() timeout
    UDT_RCVTIMEO,        // recv() timeout
    UDT_REUSEADDR,	// reuse an existing port or create a new one
-   UDT_MAXBW		// maximum bandwidth (bytes per second) that the connection can use
+   UDT_MAXBW,		// maximum bandwidth (bytes per second) that the connection can use
+   UDT_TRACE,           // record packet and congestion control events in the trace ring
+   UDT_FEC,             // send XOR parity packets so that the peer can rebuild single losses
+   UDT_TICKET,          // resumption ticket that lets a reconnect skip the cookie round trip
+   UDT_EARLYDATA,       // data carried in the connection request, up to 256 bytes
+   UDT_AUTOTUNE,        // size the buffers after the bandwidth-delay product, UDT_SNDBUF and UDT_RCVBUF become the limits
+   UDT_PMTUD            // start with 1500-byte packets and probe for the largest size the path carries, up to UDT_MSS
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -199,6 +216,75 @@ struct CPerfMon
    double mbpsBandwidth;                // estimated bandwidth, in Mb/s
    int byteAvailSndBuf;                 // available UDT sender buffer size
    int byteAvailRcvBuf;                 // available UDT receiver buffer size
+
+   // appended to the original layout, so that the fields above keep their offsets
+   int pktSndParityTotal;               // total number of sent FEC parity packets
+   int pktRcvRecoveredTotal;            // total number of lost packets rebuilt from FEC parity
+   int pktSndParity;                    // number of sent FEC parity packets
+   int pktRcvRecovered;                 // number of lost packets rebuilt from FEC parity
+   int64_t byteSentTotal;               // total payload of the sent data packets, including retransmissions
+   int64_t byteRecvTotal;               // total payload of the received data packets
+};
+
+// Log-linear latency histogram: values below 16us have a bucket each, every larger power of two is
+// split into 8 buckets (at most 12.5% error), and values above 2^36us land in the last bucket.
+#define UDT_HIST_BUCKETS 272
+
+struct CPerfHistogram
+{
+   int64_t count;                       // number of recorded values
+   int64_t usSum;                       // sum of all recorded values, in microseconds
+   int64_t counts[UDT_HIST_BUCKETS];    // number of values per bucket, see UDT::histogram_bound()
+};
+
+struct CPerfStats
+{
+   CPerfMon trace;                      // legacy view; local measurements cover the time since the last clearing perfmon()
+
+   // cumulative distributions since the connection was set up
+   CPerfHistogram usRTT;                // RTT samples: ACK/ACK2 round trips on the receiver, peer reports on the sender
+   CPerfHistogram usPktSndInterval;     // time between two consecutive data packets leaving the sender
+   CPerfHistogram usAckToNakDelay;      // time from the latest ACK to each NAK sent by the receiver
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Event trace, enabled per socket with UDT_TRACE and written out by UDT::tracedump().
+// A dump file is one CTraceHeader followed by "count" CTraceEvent records, oldest first,
+// in the byte order of the machine that wrote it.
+
+enum UDTTraceEvent
+{
+   UDT_TRACE_SEND = 1,  // data packet sent: seqno
+   UDT_TRACE_RETRANS,   // data packet retransmitted: seqno
+   UDT_TRACE_ACK,       // ACK received: seqno acknowledged, value = RTT reported by the peer
+   UDT_TRACE_NAK,       // NAK received: seqno of the first loss, value = packets newly reported lost
+   UDT_TRACE_LOSS,      // receiver found a gap: seqno of the first loss, value = packets lost
+   UDT_TRACE_TIMEOUT,   // retransmission timeout: seqno of the last ACK, value = packets queued again
+   UDT_TRACE_CC,        // congestion control state after an onACK/onLoss/onTimeout callback
+   UDT_TRACE_CC_USER    // congestion control specific event logged through CCC::trace()
+};
+
+struct CTraceEvent
+{
+   int64_t index;                       // position in the ring; gaps mean events were overwritten
+   uint64_t tsc;                        // CPU time stamp counter when the event was recorded
+   int32_t type;                        // one of UDTTraceEvent
+   int32_t seqno;                       // sequence number the event is about, if any
+   double sndPeriod;                    // packet sending period, in microseconds
+   double cwnd;                         // congestion window size, in packets
+   double value;                        // event specific value, see UDTTraceEvent
+};
+
+struct CTraceHeader
+{
+   char magic[8];                       // "UDTTRACE"
+   int32_t version;                     // format version, currently 1
+   UDTSOCKET socket;                    // socket the events were recorded on
+   double ticksPerUs;                   // CPU time stamp counter frequency, ticks per microsecond
+   uint64_t startTSC;                   // time stamp counter when tracing was first enabled
+   int64_t startTime;                   // wall clock time matching startTSC, microseconds since the epoch
+   int64_t count;                       // number of events that follow
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -294,6 +380,10 @@ public: // Error Code
    static const int EUNKNOWN;
 };
 
+// completion handler of the asynchronous calls: the socket, the bytes transferred (-1 on failure),
+// the error (NULL on success) and the context given with the call
+typedef void (*UDT_ASYNC_HANDLER)(UDTSOCKET u, int64_t result, const CUDTException* error, void* context);
+
 ////////////////////////////////////////////////////////////////////////////////
 
 namespace UDT
@@ -301,7 +391,10 @@ namespace UDT
 typedef CUDTException ERRORINFO;
 typedef UDTOpt SOCKOPT;
 typedef CPerfMon TRACEINFO;
+typedef CPerfStats TRACESTATS;
+typedef CPerfHistogram HISTOGRAM;
 typedef ud_set UDSET;
+typedef UDT_ASYNC_HANDLER ASYNCHANDLER;
 
 UDT_API extern const UDTSOCKET INVALID_SOCK;
 #undef ERROR
@@ -322,10 +415,16 @@ UDT_API int getsockopt(UDTSOCKET u, int level, SOCKOPT optname, void* optval, in
 UDT_API int setsockopt(UDTSOCKET u, int level, SOCKOPT optname, const void* optval, int optlen);
 UDT_API int send(UDTSOCKET u, const char* buf, int len, int flags);
 UDT_API int recv(UDTSOCKET u, char* buf, int len, int flags);
+UDT_API int sendv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags);
+UDT_API int recvv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags);
 UDT_API int sendmsg(UDTSOCKET u, const char* buf, int len, int ttl = -1, bool inorder = false);
 UDT_API int recvmsg(UDTSOCKET u, char* buf, int len);
 UDT_API int64_t sendfile(UDTSOCKET u, std::fstream& ifs, int64_t& offset, int64_t size, int block = 364000);
 UDT_API int64_t recvfile(UDTSOCKET u, std::fstream& ofs, int64_t& offset, int64_t size, int block = 7280000);
+UDT_API int async_send(UDTSOCKET u, const char* buf, int len, ASYNCHANDLER handler, void* context);
+UDT_API int async_recv(UDTSOCKET u, char* buf, int len, ASYNCHANDLER handler, void* context);
+UDT_API int async_sendfile(UDTSOCKET u, std::fstream& ifs, int64_t offset, int64_t size, ASYNCHANDLER handler, void* context, int block = 364000);
+UDT_API int async_recvfile(UDTSOCKET u, std::fstream& ofs, int64_t offset, int64_t size, ASYNCHANDLER handler, void* context, int block = 7280000);
 UDT_API int select(int nfds, UDSET* readfds, UDSET* writefds, UDSET* exceptfds, const struct timeval* timeout);
 UDT_API int selectEx(const std::vector<UDTSOCKET>& fds, std::vector<UDTSOCKET>* readfds, std::vector<UDTSOCKET>* writefds, std::vector<UDTSOCKET>* exceptfds, int64_t msTimeOut);
 UDT_API int epoll_create();
@@ -337,6 +436,13 @@ UDT_API int epoll_wait(const int eid, std::set<UDTSOCKET>* readfds, std::set<UDT
 UDT_API int epoll_release(const int eid);
 UDT_API ERRORINFO& getlasterror();
 UDT_API int perfmon(UDTSOCKET u, TRACEINFO* perf, bool clear = true);
+UDT_API int perfstats(UDTSOCKET u, TRACESTATS* stats);
+UDT_API int64_t histogram_bound(int bucket);
+UDT_API int64_t histogram_percentile(const HISTOGRAM& hist, double percentile);
+UDT_API int tracedump(UDTSOCKET u, const char* path);
+UDT_API int setcachefile(const char* path, int maxage);
+UDT_API int setbufferbudget(int64_t bytes);
+UDT_API int addpath(UDTSOCKET u, const struct sockaddr* name, int namelen, const struct sockaddr* peer = NULL, int peerlen = 0);
 }
 
 #endif